@@ -43,6 +43,7 @@
 
 #include "i_system.h"
 #include "m_misc.h"
+#include "m_argv.h"
 #include "i_input.h"
 #include "m_fileio.h"
 
@@ -937,7 +938,8 @@ void I_InitHardware()
 {
 	if (I_IsHeadless())
 	{
-		video_subsystem = new IDummyVideoSubsystem();
+		// -renderbench draws the view on the dummy window's surface
+		video_subsystem = new IDummyVideoSubsystem(Args.CheckParm("-renderbench") != 0);
 	}
 	else
 	{
@@ -560,9 +560,9 @@ public:
 class IDummyWindow : public IWindow
 {
 public:
-	IDummyWindow() :
+	IDummyWindow(bool any_mode = false) :
 		IWindow(), mPrimarySurface(NULL), mVideoMode(320, 200, 8, WINDOW_Windowed),
-		mPixelFormat(8, 0, 0, 0, 0, 0, 0, 0, 0)
+		mPixelFormat(8, 0, 0, 0, 0, 0, 0, 0, 0), mAnyMode(any_mode)
 	{ }
 
 	virtual ~IDummyWindow()
@@ -579,10 +579,20 @@ public:
 
 	virtual bool setMode(const IVideoMode& video_mode)
 	{
+		// ignore the requested mode and setup the hardcoded mode unless
+		// the surface is going to be drawn on, such as for -renderbench
+		if (mAnyMode && video_mode != mVideoMode)
+		{
+			delete mPrimarySurface;
+			mPrimarySurface = NULL;
+			mVideoMode = video_mode;
+		}
+
 		if (mPrimarySurface == NULL)
 		{
-			// ignore the requested mode and setup the hardcoded mode
 			mPrimarySurface = I_AllocateSurface(mVideoMode.width, mVideoMode.height, mVideoMode.bpp);
+			if (mPrimarySurface)
+				mPixelFormat = *mPrimarySurface->getPixelFormat();
 		}
 		return mPrimarySurface != NULL;
 	}
@@ -608,6 +618,8 @@ private:
 
 	IVideoMode			mVideoMode;
 	PixelFormat			mPixelFormat;
+
+	bool				mAnyMode;
 };
 
 
@@ -655,10 +667,10 @@ public:
 class IDummyVideoSubsystem : public IVideoSubsystem
 {
 public:
-	IDummyVideoSubsystem() : IVideoSubsystem()
+	IDummyVideoSubsystem(bool any_mode = false) : IVideoSubsystem()
 	{
 		mVideoCapabilities = new IDummyVideoCapabilities();
-		mWindow = new IDummyWindow();
+		mWindow = new IDummyWindow(any_mode);
 	}
 
 	virtual ~IDummyVideoSubsystem()
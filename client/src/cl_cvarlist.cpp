@@ -363,6 +363,14 @@ CVAR(				cl_predictweapons, "1", "Draw weapon effects immediately",
 CVAR(				cl_netgraph, "0", "Show a graph of network related statistics",
 					CVARTYPE_BOOL, CVAR_NULL)
 
+CVAR_RANGE(			cl_packetcompression, "3", "Compression the server should use for packets it sends, " \
+											"takes effect on the next connect\n" \
+											"// 0 - None\n" \
+											"// 1 - Minilzo\n" \
+											"// 2 - Adaptive huffman\n" \
+											"// 3 - Deflate with a shared dictionary",
+					CVARTYPE_INT, CVAR_CLIENTARCHIVE | CVAR_NOENABLEDISABLE, 0.0f, 3.0f)
+
 CVAR(				cl_serverdownload, "1", "Enable or disable downloading game files and resources from the server" \
 											"(requires downloading enabled on server)",
 					CVARTYPE_BOOL, CVAR_CLIENTARCHIVE)
@@ -805,6 +813,14 @@ CVAR_FUNC_DECL(	vid_filter, "", "Set render scale quality setting for SDL 2.0, o
 CVAR_FUNC_DECL(	r_optimize, "detect", "Rendering optimizations",
 				CVARTYPE_STRING, CVAR_CLIENTARCHIVE | CVAR_NOENABLEDISABLE)
 
+// Number of threads drawing the view, each drawing a slice of its columns
+CVAR_RANGE(			r_threads, "1", "Number of threads used to draw the view",
+					CVARTYPE_BYTE, CVAR_CLIENTARCHIVE | CVAR_NOENABLEDISABLE, 1.0f, 16.0f)
+
+// Experimental, off until -renderbench shows it is faster
+CVAR(				r_quadcolumns, "0", "Draw runs of four adjacent wall and sprite columns together",
+					CVARTYPE_BOOL, CVAR_CLIENTARCHIVE)
+
 CVAR_RANGE_FUNC_DECL(screenblocks, "10", "Selects the size of the visible window",
 				CVARTYPE_BYTE, CVAR_CLIENTARCHIVE | CVAR_NOENABLEDISABLE, 3.0f, 12.0f)
 
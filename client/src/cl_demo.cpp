@@ -930,6 +930,70 @@ void NetDemo::readMessageBody(buf_t *netbuffer, uint32_t len)
 }
 
 
+//
+// readPackets()
+//
+//   Reads every captured network message of a netdemo file without playing
+//   it.  A message holds one tic worth of packets, so it is cut into pieces
+//   no bigger than the packets the server sends.  Used to benchmark packet
+//   compression against real traffic.
+
+bool NetDemo::readPackets(const std::string &filename, std::vector<buf_t> &packets)
+{
+	if (isPlaying() || isRecording())
+	{
+		error("Cannot read packets from a netdemo while using this one.");
+		return false;
+	}
+
+	if (!(demofp = fopen(filename.c_str(), "rb")))
+	{
+		error("Unable to open netdemo file.");
+		return false;
+	}
+
+	if (!readHeader() || header.version != NETDEMOVER)
+	{
+		fclose(demofp);
+		demofp = NULL;
+		error("Unable to read netdemo header.");
+		return false;
+	}
+
+	fseek(demofp, NetDemo::HEADER_SIZE, SEEK_SET);
+
+	netdemo_message_t type;
+	uint32_t len, tic;
+	std::vector<byte> body;
+
+	while (ftell(demofp) < (long)header.snapshot_index_offset &&
+	       readMessageHeader(type, len, tic))
+	{
+		if (type != NetDemo::msg_packet)
+		{
+			fseek(demofp, len, SEEK_CUR);
+			continue;
+		}
+
+		body.resize(len);
+		if (len && fread(&body[0], 1, len, demofp) < len)
+			break;
+
+		for (size_t pos = 0; pos < len; pos += MAX_UDP_SIZE)
+		{
+			const size_t size = MIN<size_t>(MAX_UDP_SIZE, len - pos);
+			packets.push_back(buf_t(MAX_UDP_PACKET));
+			packets.back().WriteChunk((const char*)&body[pos], size);
+		}
+	}
+
+	fclose(demofp);
+	demofp = NULL;
+
+	return true;
+}
+
+
 //
 // readMessages()
 //
@@ -41,6 +41,8 @@ public:
 	int calculateTotalTime();
 	const std::vector<int> getMapChangeTimes();
 	const std::string &getFileName() { return filename; }
+
+	bool readPackets(const std::string &filename, std::vector<buf_t> &packets);
 	
 private:
 	typedef enum
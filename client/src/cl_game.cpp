@@ -55,6 +55,7 @@
 #include "gstrings.h"
 #include "r_sky.h"
 #include "r_draw.h"
+#include "r_bench.h"
 #include "g_game.h"
 #include "cl_main.h"
 #include "cl_demo.h"
@@ -103,6 +104,7 @@ EXTERN_CVAR (co_nosilentspawns)
 EXTERN_CVAR (in_autosr50)
 
 EXTERN_CVAR (chasedemo)
+EXTERN_CVAR (sv_aithreads)
 
 gameaction_t	gameaction;
 gamestate_t 	gamestate = GS_STARTUP;
@@ -842,6 +844,29 @@ void P_MovePlayer (player_t *player);
 void P_CalcHeight (player_t *player);
 void P_DeathThink (player_t *player);
 void CL_SimulateWorld();
+
+//
+// P_PrepareMonsterSight
+//
+// Work out the sight checks monsters are about to make this tic before the
+// thinkers run.  The client has no worker threads for them, but taking the
+// same path as the server lets a demo check that the answers never change
+// what monsters do.
+//
+void P_PrepareMonsterSight()
+{
+	if (sv_aithreads.asInt() == 0)
+		return;
+
+	P_GatherSightQueries();
+
+	size_t count = P_PrepareSightQueries();
+	for (size_t i = 0; i < count; i++)
+		P_RunSightQuery(i);
+
+	P_StartSightQueries();
+}
+
 //
 // G_Ticker
 // Make ticcmd_ts for the players.
@@ -2025,6 +2050,24 @@ void G_TestDemo(const char* name)
 }
 
 
+//
+// G_RenderBenchDemo
+//
+// Plays the demo without a window, drawing the view of every tic for the
+// render benchmark.
+//
+void G_RenderBenchDemo(const char* name)
+{
+	nodrawers = false;
+	noblit = true;
+	timingdemo = true;
+	renderbench = true;
+
+	defdemoname = name;
+	gameaction = ga_playdemo;
+}
+
+
 //
 // G_CleanupDemo
 //
@@ -2078,7 +2121,15 @@ BOOL G_CheckDemoStatus (void)
 
 		if (singledemo || timingdemo)
 		{
-			if (timingdemo)
+			if (renderbench)
+			{
+				R_PrintRenderBench();
+
+				// exit the application
+				CL_QuitCommand();
+				return false;
+			}
+			else if (timingdemo)
 			{
 				extern dtime_t starttime;
 				dtime_t endtime = I_MSTime() - starttime;
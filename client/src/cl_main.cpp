@@ -67,6 +67,7 @@
 #include "g_gametype.h"
 #include "cl_parse.h"
 #include "cl_replay.h"
+#include "svc_message.h"
 
 #include <bitset>
 #include <map>
@@ -150,6 +151,7 @@ EXTERN_CVAR (sv_teamsinplay)
 
 EXTERN_CVAR (sv_downloadsites)
 EXTERN_CVAR (cl_downloadsites)
+EXTERN_CVAR (cl_packetcompression)
 
 EXTERN_CVAR (cl_predictsectors)
 
@@ -287,7 +289,7 @@ EXTERN_CVAR (waddirs)
 
 void CL_PlayerTimes (void);
 void CL_TryToConnect(DWORD server_token);
-void CL_Decompress();
+bool CL_Decompress(int sequence, byte flags);
 
 bool M_FindFreeName(std::string &filename, const std::string &extension);
 
@@ -658,6 +660,8 @@ void CL_DisplayTics()
 //
 void CL_RunTics()
 {
+	SVC_ResetArena();
+
 	std::string cmd = I_ConsoleInput();
 	if (cmd.length())
 		AddCommandString(cmd);
@@ -1299,6 +1303,147 @@ BEGIN_COMMAND(netprevmap)
 }
 END_COMMAND(netprevmap)
 
+/**
+ * @brief Totals of one packet compression method over a packet stream.
+ */
+struct CodecBench
+{
+	const char* name;
+	size_t inbytes;
+	size_t outbytes;
+	dtime_t encode;
+	dtime_t decode;
+	size_t failed;
+
+	CodecBench(const char* name)
+	    : name(name), inbytes(0), outbytes(0), encode(0), decode(0), failed(0)
+	{
+	}
+
+	void print() const
+	{
+		const double bytes = MAX<size_t>(inbytes, 1);
+		Printf(PRINT_HIGH, "%-8s ratio %.3f, encode %.2f ns/byte, decode %.2f ns/byte",
+		       name, outbytes / bytes, encode / bytes, decode / bytes);
+		if (failed)
+			Printf(PRINT_HIGH, ", %" PRIuSIZE " packets failed to round trip", failed);
+		Printf(PRINT_HIGH, "\n");
+	}
+};
+
+/**
+ * @brief Run a packet stream through one compression method the way the
+ *        server and client would, with every packet acknowledged at once.
+ */
+static void CL_BenchCodec(CodecBench& bench, const packetCompression_e method,
+                          const std::vector<buf_t>& packets)
+{
+	CompressScratch scratch;
+	huffman_server server;
+	huffman_client client;
+
+	buf_t work(MAX_UDP_PACKET);
+
+	for (size_t i = 0; i < packets.size(); i++)
+	{
+		const buf_t& packet = packets[i];
+		const size_t len = packet.size();
+
+		work.clear();
+		work.WriteChunk((const char*)packet.data, len);
+
+		bool compressed = false;
+		bool tracked = false;
+		byte codec = 0;
+
+		dtime_t start = I_GetTime();
+		switch (method)
+		{
+		case PACKETCOMP_NONE:
+			break;
+		case PACKETCOMP_MINILZO:
+			compressed = MSG_CompressMinilzo(work, 0, 0, scratch);
+			break;
+		case PACKETCOMP_HUFFMAN:
+			tracked = server.packet_sent(i, work.ptr(), len);
+			codec = server.get_codec_id();
+			compressed = MSG_CompressAdaptive(server.get_codec(), work, 0, 0, scratch);
+			break;
+		case PACKETCOMP_DEFLATE:
+			compressed = MSG_CompressDeflate(work, 0, 0, scratch);
+			break;
+		default:
+			break;
+		}
+		bench.encode += I_GetTime() - start;
+		bench.inbytes += len;
+		bench.outbytes += work.size();
+
+		start = I_GetTime();
+		bool ok = true;
+		if (compressed)
+		{
+			switch (method)
+			{
+			case PACKETCOMP_MINILZO:
+				ok = MSG_DecompressMinilzo(work);
+				break;
+			case PACKETCOMP_HUFFMAN: {
+				huffman* huff = client.codec_for_received(i, codec);
+				ok = huff && MSG_DecompressAdaptive(*huff, work);
+				break;
+			}
+			case PACKETCOMP_DEFLATE:
+				ok = MSG_DecompressDeflate(work);
+				break;
+			default:
+				break;
+			}
+		}
+		if (ok && tracked)
+			client.packet_tracked(i, codec, work.ptr(), work.size());
+		bench.decode += I_GetTime() - start;
+
+		if (method == PACKETCOMP_HUFFMAN)
+			server.packet_acked(i);
+
+		if (!ok || work.size() != len || memcmp(work.ptr(), packet.data, len) != 0)
+			bench.failed++;
+	}
+}
+
+BEGIN_COMMAND(netcodecbench)
+{
+	if (argc <= 1)
+	{
+		Printf(PRINT_HIGH, "Usage: netcodecbench <demoname>\n");
+		return;
+	}
+
+	std::string found = M_FindUserFileName(argv[1], ".odd");
+	if (found.empty())
+	{
+		Printf(PRINT_WARNING, "Could not find demo %s.\n", argv[1]);
+		return;
+	}
+
+	NetDemo demo;
+	std::vector<buf_t> packets;
+	if (!demo.readPackets(found, packets))
+		return;
+
+	Printf(PRINT_HIGH, "%" PRIuSIZE " packets from %s\n", packets.size(), found.c_str());
+
+	const char* names[NUM_PACKETCOMP] = {"none", "minilzo", "huffman", "deflate"};
+	for (int i = 0; i < NUM_PACKETCOMP; i++)
+	{
+		CodecBench bench(names[i]);
+		CL_BenchCodec(bench, static_cast<packetCompression_e>(i), packets);
+		bench.print();
+	}
+}
+END_COMMAND(netcodecbench)
+
 //
 // CL_MoveThing
 //
@@ -1783,9 +1928,9 @@ bool CL_Connect()
 		Printf(PRINT_WARNING, "Protocol flag bits (%u) were not understood.", flags);
 		CL_QuitNetGame(NQ_PROTO);
 	}
-	else if (flags & SVF_COMPRESSED)
+	else if (!CL_Decompress(0, flags))
 	{
-		CL_Decompress();
+		SZ_Clear(&::net_message);
 	}
 	CL_ParseCommands();
 
@@ -1886,6 +2031,14 @@ void CL_TryToConnect(DWORD server_token)
 
         MSG_WriteString(&net_buffer, (char *)connectpasshash.c_str());
 
+		// Packet compression methods we can read, and the one we want.
+		MSG_WriteByte(&net_buffer, BIT(PACKETCOMP_NONE) | BIT(PACKETCOMP_MINILZO) |
+		                               BIT(PACKETCOMP_HUFFMAN) | BIT(PACKETCOMP_DEFLATE));
+		MSG_WriteByte(&net_buffer, cl_packetcompression.asInt());
+
+		// Protocol features we can handle.
+		MSG_WriteByte(&net_buffer, CLF_MOBJDELTAS);
+
 		NET_SendPacket(net_buffer, serveraddr);
 		SZ_Clear(&net_buffer);
 	}
@@ -1932,12 +2085,40 @@ void CL_ClearSectorSnapshots()
 // [Russell] - reason this was failing is because of huffman routines, so just
 // use minilzo for now (cuts a packet size down by roughly 45%), huffman is the
 // if 0'd sections
-void CL_Decompress()
+//
+// Returns false if the packet can't be read and should be dropped.
+//
+bool CL_Decompress(int sequence, byte flags)
 {
+	if (flags & SVF_HUFFMAN || flags & SVF_HUFFMAN_TRACK)
+	{
+		const byte codec = (flags & SVF_HUFFMAN_CODEC) ? 1 : 0;
+
+		if (flags & SVF_HUFFMAN)
+		{
+			huffman* huff = compressor.codec_for_received(sequence, codec);
+			if (!huff || !MSG_DecompressAdaptive(*huff))
+				return false;
+		}
+
+		// The server builds its next codec out of this packet.
+		if (flags & SVF_HUFFMAN_TRACK)
+			compressor.packet_tracked(sequence, codec, net_message.ptr() + net_message.BytesRead(),
+			                          MSG_BytesLeft());
+
+		return true;
+	}
+
 	if(!MSG_BytesLeft())
-		return;
+		return true;
+
+	if (flags & SVF_DEFLATE)
+		return MSG_DecompressDeflate();
 
-	MSG_DecompressMinilzo();
+	if (flags & SVF_COMPRESSED)
+		return MSG_DecompressMinilzo();
+
+	return true;
 }
 
 /**
@@ -1972,9 +2153,10 @@ bool CL_ReadPacketHeader()
 		Printf(PRINT_WARNING, "Protocol flag bits (%u) were not understood.", flags);
 		CL_QuitNetGame(NQ_PROTO);
 	}
-	else if (flags & SVF_COMPRESSED)
+	else if (!CL_Decompress(sequence, flags))
 	{
-		CL_Decompress();
+		SZ_Clear(&::net_message);
+		return false;
 	}
 
 	netgraph.addPacketIn();
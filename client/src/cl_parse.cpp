@@ -28,6 +28,8 @@
 
 #include <bitset>
 
+#include <google/protobuf/arena.h>
+
 #include "server.pb.h"
 
 #include "c_console.h"
@@ -177,6 +179,52 @@ static void ActivateLine(AActor* mo, line_s* line, byte side,
 	s_SpecialFromServer = false;
 }
 
+/**
+ * @brief The last few tracked states of an actor, that the server may send
+ *        updates relative to.
+ */
+struct MobjHistory
+{
+	uint32_t tags[baseline_t::HISTORY];
+	baseline_t states[baseline_t::HISTORY];
+	size_t next;
+
+	MobjHistory() : next(0)
+	{
+		for (size_t i = 0; i < ARRAY_LENGTH(tags); i++)
+			tags[i] = 0;
+	}
+
+	const baseline_t* find(const uint32_t tag) const
+	{
+		for (size_t i = 0; i < ARRAY_LENGTH(tags); i++)
+		{
+			if (tags[i] == tag)
+				return &states[i];
+		}
+		return NULL;
+	}
+
+	void add(const uint32_t tag, const baseline_t& state)
+	{
+		// A tag that comes around again replaces its old state.
+		for (size_t i = 0; i < ARRAY_LENGTH(tags); i++)
+		{
+			if (tags[i] == tag)
+			{
+				states[i] = state;
+				return;
+			}
+		}
+
+		tags[next] = tag;
+		states[next] = state;
+		next = (next + 1) % ARRAY_LENGTH(tags);
+	}
+};
+typedef std::map<uint32_t, MobjHistory> MobjHistories;
+static MobjHistories mobjhistories;
+
 /**
  * @brief svc_noop - Nothing to see here. Move along.
  */
@@ -493,6 +541,7 @@ static void CL_SpawnMobj(const odaproto::svc::SpawnMobj* msg)
 		return;
 
 	P_ClearId(netid);
+	::mobjhistories.erase(netid);
 
 	AActor* mo = new AActor(base.pos.x, base.pos.y, base.pos.z, type);
 	mo->baseline = base;
@@ -749,6 +798,7 @@ static void CL_DisconnectClient(const odaproto::svc::DisconnectClient* msg)
 static void CL_LoadMap(const odaproto::svc::LoadMap* msg)
 {
 	ClientReplay::getInstance().reset();
+	::mobjhistories.clear();
 	bool splitnetdemo =
 	    (netdemo.isRecording() && ::cl_splitnetdemos) || ::forcenetdemosplit;
 	::forcenetdemosplit = false;
@@ -926,6 +976,7 @@ static void CL_RemoveMobj(const odaproto::svc::RemoveMobj* msg)
 		level.found_items++;
 
 	P_ClearId(netid);
+	::mobjhistories.erase(netid);
 }
 
 //
@@ -969,6 +1020,21 @@ static void CL_UpdateMobj(const odaproto::svc::UpdateMobj* msg)
 	uint32_t flags = msg->flags();
 
 	baseline_t update = mo->baseline;
+	if (msg->basetag())
+	{
+		// Relative to a state we already had, which we can't apply if we
+		// don't have it anymore.
+		MobjHistories::const_iterator it = ::mobjhistories.find(mo->netid);
+		if (it == ::mobjhistories.end())
+			return;
+
+		const baseline_t* base = it->second.find(msg->basetag());
+		if (base == NULL)
+			return;
+
+		update = *base;
+	}
+
 	if (flags & baseline_t::POSX)
 	{
 		update.pos.x = msg->actor().pos().x();
@@ -1019,6 +1085,9 @@ static void CL_UpdateMobj(const odaproto::svc::UpdateMobj* msg)
 		update.mom.z = msg->actor().mom().z();
 	}
 
+	if (msg->tag())
+		::mobjhistories[mo->netid].add(msg->tag(), update);
+
 	if (mo->player)
 	{
 		// [SL] 2013-07-21 - Save the position information to a snapshot
@@ -1077,6 +1146,7 @@ static void CL_SpawnPlayer(const odaproto::svc::SpawnPlayer* msg)
 	fixed_t z = msg->actor().pos().z();
 
 	P_ClearId(netid);
+	::mobjhistories.erase(netid);
 
 	// first disassociate the corpse
 	if (p->mo)
@@ -2894,6 +2964,50 @@ const Protos& CL_GetTicProtos()
 	return ::protos;
 }
 
+// Size of the memory block the parse arena starts out with.
+#define PARSE_ARENA_INITIAL_SIZE (64 * 1024)
+
+/**
+ * @brief Arena that server messages are decoded into.
+ */
+static google::protobuf::Arena& ParseArena()
+{
+	static uint64_t initial[PARSE_ARENA_INITIAL_SIZE / sizeof(uint64_t)];
+	static google::protobuf::Arena* arena = NULL;
+	if (arena == NULL)
+	{
+		google::protobuf::ArenaOptions options;
+		options.initial_block = reinterpret_cast<char*>(initial);
+		options.initial_block_size = sizeof(initial);
+		arena = new google::protobuf::Arena(options);
+	}
+	return *arena;
+}
+
+/**
+ * @brief Reset the parse arena once the outermost command is handled.
+ *
+ * Message handlers can end up parsing more commands, for example when a
+ * netdemo snapshot is loaded, so only the outermost scope resets.
+ */
+struct ParseArenaScope
+{
+	static int depth;
+
+	ParseArenaScope()
+	{
+		depth++;
+	}
+
+	~ParseArenaScope()
+	{
+		if (--depth == 0)
+			ParseArena().Reset();
+	}
+};
+
+int ParseArenaScope::depth = 0;
+
 /**
  * @brief Given a message type and buffer, return a decoded message in "out".
  *
@@ -2922,8 +3036,9 @@ parseError_e CL_ParseMessage(google::protobuf::Message*& out, const byte cmd,
 		return PERR_UNKNOWN_MESSAGE;
 	}
 
-	// Allocated with "new" - can't be null, and we own it.
-	google::protobuf::Message* msg = defmsg->New();
+	// Allocated in the parse arena - can't be null, and must not be deleted.
+	// It stays valid until the outermost CL_ParseCommand returns.
+	google::protobuf::Message* msg = defmsg->New(&ParseArena());
 	if (!msg->ParseFromArray(buffer, size))
 	{
 		return PERR_BAD_DECODE;
@@ -2952,7 +3067,8 @@ parseError_e CL_ParseCommand()
 	// The message itself.
 	void* data = MSG_ReadChunk(size);
 
-	// Turn the message into a protobuf.
+	// Turn the message into a protobuf, which is freed on scope exit.
+	ParseArenaScope scope;
 	google::protobuf::Message* msg = NULL;
 	parseError_e err = CL_ParseMessage(msg, cmd, data, size);
 	if (err)
@@ -2960,10 +3076,6 @@ parseError_e CL_ParseCommand()
 		return err;
 	}
 
-	// Delete pointer on scope exit.
-	// [AM] Should be unique_ptr as of C++11.
-	std::auto_ptr<google::protobuf::Message> autoMSG(msg);
-
 	// Run the proper message function.
 	switch (cmd)
 	{
@@ -73,6 +73,7 @@
 #include "p_setup.h"
 #include "r_local.h"
 #include "r_sky.h"
+#include "r_bench.h"
 #include "d_main.h"
 #include "d_dehacked.h"
 #include "cl_download.h"
@@ -238,6 +239,12 @@ void D_DisplayTicker()
 //
 void D_Display()
 {
+	if (renderbench)
+	{
+		R_RenderBenchFrame();	// draws nothing but the view, offscreen
+		return;
+	}
+
 	if (nodrawers || I_IsHeadless())
 		return; 				// for comparative timing / profiling
 
@@ -624,7 +631,7 @@ void D_Init()
 	// start the Zone memory manager
 	Z_Init();
 	if (first_time)
-		Printf("Z_Init: Using native allocator with OZone bookkeeping.\n");
+		Printf("Z_Init: Using native allocator with tag arenas for level memory.\n");
 
 	// Load palette and set up colormaps
 	V_Init();
@@ -798,6 +805,7 @@ void D_DoomMain()
 		const char* skipParams[] = {
 		    "+connect", "+demotest", "+map",      "+netplay",  "+playdemo",
 		    "-connect", "-file",     "-playdemo", "-timedemo", "-warp",
+		    "-renderbench",
 		};
 
 		bool shouldSkip = false;
@@ -998,6 +1006,14 @@ void D_DoomMain()
 		G_TimeDemo(Args.GetArg(p + 1));
 	}
 
+	// run a demo with the render benchmark and quit
+	p = Args.CheckParm("-renderbench");
+	if (p && p < Args.NumArgs() - 1)
+	{
+		singledemo = true;
+		G_RenderBenchDemo(Args.GetArg(p + 1));
+	}
+
 	// denis - this will run a demo and quit
 	p = Args.CheckParm("+demotest");
 	if (p && p < Args.NumArgs() - 1)
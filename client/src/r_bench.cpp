@@ -0,0 +1,133 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// $Id$
+//
+// Copyright (C) 2006-2020 by The Odamex Team.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//	Headless render benchmark.
+//
+//	-renderbench <demo> plays back a demo as fast as possible without a
+//	window and draws the view of every tic to the dummy window's surface,
+//	using the resolution and bit depth given with -width, -height and
+//	-bits.  When the demo ends, the average time each part of the view took
+//	is printed along with a checksum of every frame drawn, so that two
+//	builds can be compared for both speed and output.
+//
+//-----------------------------------------------------------------------------
+
+
+#include "odamex.h"
+
+#include "i_system.h"
+#include "i_video.h"
+#include "r_local.h"
+#include "r_bench.h"
+
+bool renderbench = false;
+
+static int benchframes = 0;
+static dtime_t benchtotal = 0;
+static dtime_t benchphasetime[NUMRENDERPHASES];
+static uint32_t benchchecksum = 2166136261u;
+
+static const uint32_t FNV_PRIME = 16777619u;
+
+static const char* phasenames[NUMRENDERPHASES] = {
+	"bsp", "walls", "planes", "masked"
+};
+
+
+//
+// R_HashView
+//
+// Returns the FNV-1a hash of the pixels in the view window.
+//
+static uint32_t R_HashView(const IWindowSurface* surface)
+{
+	uint32_t hash = 2166136261u;
+	const int rowsize = viewwidth * surface->getBytesPerPixel();
+
+	for (int y = viewwindowy; y < viewwindowy + viewheight; y++)
+	{
+		const uint8_t* row = surface->getBuffer(viewwindowx, y);
+		for (int i = 0; i < rowsize; i++)
+			hash = (hash ^ row[i]) * FNV_PRIME;
+	}
+
+	return hash;
+}
+
+
+//
+// R_RenderBenchFrame
+//
+// Called by D_Display in place of drawing the screen.  Only the view is
+// drawn, since the status bar, HUD and so on are not part of the renderer.
+//
+void R_RenderBenchFrame()
+{
+	if (gamestate != GS_LEVEL || !gametic || !g_ValidLevel)
+		return;
+
+	V_AdjustVideoMode();
+
+	IWindowSurface* surface = R_GetRenderingSurface();
+	surface->lock();
+
+	r_timephases = true;
+	const dtime_t start = I_GetTime();
+	R_RenderPlayerView(&displayplayer());
+	const dtime_t elapsed = I_GetTime() - start;
+	r_timephases = false;
+
+	const uint32_t hash = R_HashView(surface);
+	surface->unlock();
+
+	benchframes++;
+	benchtotal += elapsed;
+	for (int i = 0; i < NUMRENDERPHASES; i++)
+		benchphasetime[i] += r_phasetime[i];
+
+	for (int i = 0; i < 4; i++)
+		benchchecksum = (benchchecksum ^ ((hash >> (i * 8)) & 0xFF)) * FNV_PRIME;
+
+	DPrintf("renderbench: gametic %d frame %08x\n", gametic, hash);
+}
+
+
+//
+// R_PrintRenderBench
+//
+// Called by G_CheckDemoStatus when the demo has ended.
+//
+void R_PrintRenderBench()
+{
+	const IWindowSurface* surface = R_GetRenderingSurface();
+
+	Printf(PRINT_HIGH, "renderbench: drew %d frames of %dx%d at %dbpp\n",
+			benchframes, viewwidth, viewheight, surface ? surface->getBitsPerPixel() : 0);
+
+	if (benchframes == 0)
+		return;
+
+	for (int i = 0; i < NUMRENDERPHASES; i++)
+		Printf(PRINT_HIGH, "%8s: %8.3f ms/frame\n", phasenames[i],
+				double(benchphasetime[i]) / 1e6 / benchframes);
+
+	Printf(PRINT_HIGH, "%8s: %8.3f ms/frame\n", "total", double(benchtotal) / 1e6 / benchframes);
+	Printf(PRINT_HIGH, "renderbench: checksum %08x\n", benchchecksum);
+}
+
+VERSION_CONTROL (r_bench_cpp, "$Id$")
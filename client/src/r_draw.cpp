@@ -42,6 +42,8 @@
 #include "gi.h"
 #include "v_text.h"
 #include "st_stuff.h"
+#include "c_dispatch.h"
+#include "i_system.h"
 
 #undef RANGECHECK
 
@@ -80,64 +82,24 @@ int 			viewwindowy;
 // [RH] Pointers to the different column drawers.
 //		These get changed depending on the current
 //		screen depth.
-void (*R_DrawColumn)(void);
-void (*R_DrawFuzzColumn)(void);
-void (*R_DrawTranslucentColumn)(void);
-void (*R_DrawTranslatedColumn)(void);
-void (*R_DrawTlatedLucentColumn)(void);
-void (*R_DrawSpan)(void);
-void (*R_DrawSlopeSpan)(void);
-void (*R_FillColumn)(void);
-void (*R_FillSpan)(void);
-void (*R_FillTranslucentSpan)(void);
+void (*R_DrawColumn)(drawcolumn_t&);
+void (*R_DrawFuzzColumn)(drawcolumn_t&);
+void (*R_DrawTranslucentColumn)(drawcolumn_t&);
+void (*R_DrawTranslatedColumn)(drawcolumn_t&);
+void (*R_DrawTlatedLucentColumn)(drawcolumn_t&);
+void (*R_DrawSpan)(drawspan_t&);
+void (*R_DrawSlopeSpan)(drawspan_t&);
+void (*R_FillColumn)(drawcolumn_t&);
+void (*R_FillSpan)(drawspan_t&);
+void (*R_FillTranslucentSpan)(drawspan_t&);
 
 // Possibly vectorized functions:
-void (*R_DrawSpanD)(void);
-void (*R_DrawSlopeSpanD)(void);
+void (*R_DrawSpanD)(drawspan_t&);
+void (*R_DrawSlopeSpanD)(drawspan_t&);
+void (*R_DrawColumnQuadD)(drawcolumn_t*);
+void (*R_DrawTranslucentColumnQuadD)(drawcolumn_t*);
 void (*r_dimpatchD)(IWindowSurface* surface, argb_t color, int alpha, int x1, int y1, int w, int h);
 
-// ============================================================================
-//
-// Fuzz Table
-//
-// Framebuffer postprocessing.
-// Creates a fuzzy image by copying pixels from adjacent ones to left and right.
-// Used with an all black colormap, this could create the SHADOW effect,
-// i.e. spectres and invisible players.
-//
-// ============================================================================
-
-class FuzzTable
-{
-public:
-	FuzzTable() : pos(0) { }
-
-	forceinline void incrementRow()
-	{
-		pos = (pos + 1) % FuzzTable::size;
-	}
-
-	forceinline void incrementColumn()
-	{
-		pos = (pos + 3) % FuzzTable::size;
-	}
-
-	forceinline int getValue() const
-	{
-		// [SL] quickly convert the table value (-1 or 1) into (-pitch or pitch).
-		// [AM] Replaced with a multiply that returns accurate results.  Hopefully
-		//      we can find a way to improve upon an imul someday.
-		int pitch = R_GetRenderingSurface()->getPitchInPixels();
-		int value = table[pos];
-		return pitch * value;
-	}
-
-private:
-	static const size_t size = 64;
-	static const int table[FuzzTable::size];
-	int pos;
-};
-
 const int FuzzTable::table[FuzzTable::size] = {
 		1,-1, 1,-1, 1, 1,-1, 1,
 		1,-1, 1, 1, 1,-1, 1, 1,
@@ -530,7 +492,7 @@ void R_BuildPlayerTranslation(int player, argb_t dest_color)
 // [SL] - Does nothing (obviously). Used when a column drawing function
 // pointer should not draw anything.
 //
-void R_BlankColumn()
+void R_BlankColumn(drawcolumn_t& drawcolumn)
 {
 }
 
@@ -540,7 +502,7 @@ void R_BlankColumn()
 // [SL] - Does nothing (obviously). Used when a span drawing function
 // pointer should not draw anything.
 //
-void R_BlankSpan()
+void R_BlankSpan(drawspan_t& drawspan)
 {
 }
 
@@ -932,17 +894,20 @@ private:
 class PaletteFuzzyFunc
 {
 public:
-	PaletteFuzzyFunc(const drawcolumn_t& drawcolum) :
-			colormap(&V_GetDefaultPalette()->maps, 6) { }
+	PaletteFuzzyFunc(const drawcolumn_t& drawcolumn) :
+			colormap(&V_GetDefaultPalette()->maps, 6),
+			fuzz(*drawcolumn.fuzz), pitch(drawcolumn.pitch_in_pixels) { }
 
 	forceinline void operator()(byte c, palindex_t* dest) const
 	{
-		*dest = colormap.index(dest[fuzztable.getValue()]);
-		fuzztable.incrementRow();
+		*dest = colormap.index(dest[fuzz.getValue(pitch)]);
+		fuzz.incrementRow();
 	}
 
 private:
 	shaderef_t colormap;
+	FuzzTable& fuzz;
+	int pitch;
 };
 
 class PaletteTranslucentColormapFunc
@@ -1035,39 +1000,39 @@ private:
 //
 // ----------------------------------------------------------------------------
 
-#define FB_COLDEST_P ((palindex_t*)dcol.destination + dcol.yl * dcol.pitch_in_pixels + dcol.x)
+#define FB_COLDEST_P ((palindex_t*)drawcolumn.destination + drawcolumn.yl * drawcolumn.pitch_in_pixels + drawcolumn.x)
 
 //
 // R_FillColumnP
 //
 // Fills a column in the 8bpp palettized screen buffer with a solid color,
-// determined by dcol.color. Performs no shading.
+// determined by drawcolumn.color. Performs no shading.
 //
-void R_FillColumnP()
+void R_FillColumnP(drawcolumn_t& drawcolumn)
 {
-	R_FillColumnGeneric<palindex_t, PaletteFunc>(FB_COLDEST_P, dcol);
+	R_FillColumnGeneric<palindex_t, PaletteFunc>(FB_COLDEST_P, drawcolumn);
 }
 
 //
 // R_DrawColumnP
 //
 // Renders a column to the 8bpp palettized screen buffer from the source buffer
-// dcol.source and scaled by dcol.iscale. Shading is performed using dcol.colormap.
+// drawcolumn.source and scaled by drawcolumn.iscale. Shading is performed using drawcolumn.colormap.
 //
-void R_DrawColumnP()
+void R_DrawColumnP(drawcolumn_t& drawcolumn)
 {
-	R_DrawColumnGeneric<palindex_t, PaletteColormapFunc>(FB_COLDEST_P, dcol);
+	R_DrawColumnGeneric<palindex_t, PaletteColormapFunc>(FB_COLDEST_P, drawcolumn);
 }
 
 //
 // R_StretchColumnP
 //
 // Renders a column to the 8bpp palettized screen buffer from the source buffer
-// dcol.source and scaled by dcol.iscale. Performs no shading.
+// drawcolumn.source and scaled by drawcolumn.iscale. Performs no shading.
 //
-void R_StretchColumnP()
+void R_StretchColumnP(drawcolumn_t& drawcolumn)
 {
-	R_DrawColumnGeneric<palindex_t, PaletteFunc>(FB_COLDEST_P, dcol);
+	R_DrawColumnGeneric<palindex_t, PaletteFunc>(FB_COLDEST_P, drawcolumn);
 }
 
 //
@@ -1077,55 +1042,55 @@ void R_StretchColumnP()
 // invisibility effect, which shades the column and rearranges the ordering
 // the pixels to create distortion. Shading is performed using colormap 6.
 //
-void R_DrawFuzzColumnP()
+void R_DrawFuzzColumnP(drawcolumn_t& drawcolumn)
 {
 	// adjust the borders (prevent buffer over/under-reads)
-	if (dcol.yl <= 0)
-		dcol.yl = 1;
-	if (dcol.yh >= viewheight - 1)
-		dcol.yh = viewheight - 2;
+	if (drawcolumn.yl <= 0)
+		drawcolumn.yl = 1;
+	if (drawcolumn.yh >= viewheight - 1)
+		drawcolumn.yh = viewheight - 2;
 
-	R_FillColumnGeneric<palindex_t, PaletteFuzzyFunc>(FB_COLDEST_P, dcol);
-	fuzztable.incrementColumn();
+	R_FillColumnGeneric<palindex_t, PaletteFuzzyFunc>(FB_COLDEST_P, drawcolumn);
+	drawcolumn.fuzz->incrementColumn();
 }
 
 //
 // R_DrawTranslucentColumnP
 //
 // Renders a translucent column to the 8bpp palettized screen buffer from the
-// source buffer dcol.source and scaled by dcol.iscale. The amount of
-// translucency is controlled by dcol.translevel. Shading is performed using
-// dcol.colormap.
+// source buffer drawcolumn.source and scaled by drawcolumn.iscale. The amount of
+// translucency is controlled by drawcolumn.translevel. Shading is performed using
+// drawcolumn.colormap.
 //
-void R_DrawTranslucentColumnP()
+void R_DrawTranslucentColumnP(drawcolumn_t& drawcolumn)
 {
-	R_DrawColumnGeneric<palindex_t, PaletteTranslucentColormapFunc>(FB_COLDEST_P, dcol);
+	R_DrawColumnGeneric<palindex_t, PaletteTranslucentColormapFunc>(FB_COLDEST_P, drawcolumn);
 }
 
 //
 // R_DrawTranslatedColumnP
 //
 // Renders a column to the 8bpp palettized screen buffer with color-remapping
-// from the source buffer dcol.source and scaled by dcol.iscale. The translation
-// table is supplied by dcol.translation. Shading is performed using dcol.colormap.
+// from the source buffer drawcolumn.source and scaled by drawcolumn.iscale. The translation
+// table is supplied by drawcolumn.translation. Shading is performed using drawcolumn.colormap.
 //
-void R_DrawTranslatedColumnP()
+void R_DrawTranslatedColumnP(drawcolumn_t& drawcolumn)
 {
-	R_DrawColumnGeneric<palindex_t, PaletteTranslatedColormapFunc>(FB_COLDEST_P, dcol);
+	R_DrawColumnGeneric<palindex_t, PaletteTranslatedColormapFunc>(FB_COLDEST_P, drawcolumn);
 }
 
 //
 // R_DrawTlatedLucentColumnP
 //
 // Renders a translucent column to the 8bpp palettized screen buffer with
-// color-remapping from the source buffer dcol.source and scaled by dcol.iscale. 
-// The translation table is supplied by dcol.translation and the amount of
-// translucency is controlled by dcol.translevel. Shading is performed using
-// dcol.colormap.
+// color-remapping from the source buffer drawcolumn.source and scaled by drawcolumn.iscale. 
+// The translation table is supplied by drawcolumn.translation and the amount of
+// translucency is controlled by drawcolumn.translevel. Shading is performed using
+// drawcolumn.colormap.
 //
-void R_DrawTlatedLucentColumnP()
+void R_DrawTlatedLucentColumnP(drawcolumn_t& drawcolumn)
 {
-	R_DrawColumnGeneric<palindex_t, PaletteTranslatedTranslucentColormapFunc>(FB_COLDEST_P, dcol);
+	R_DrawColumnGeneric<palindex_t, PaletteTranslatedTranslucentColormapFunc>(FB_COLDEST_P, drawcolumn);
 }
 
 
@@ -1135,51 +1100,51 @@ void R_DrawTlatedLucentColumnP()
 //
 // ----------------------------------------------------------------------------
 
-#define FB_SPANDEST_P ((palindex_t*)dspan.destination + dspan.y * dspan.pitch_in_pixels + dspan.x1)
+#define FB_SPANDEST_P ((palindex_t*)drawspan.destination + drawspan.y * drawspan.pitch_in_pixels + drawspan.x1)
 
 //
 // R_FillSpanP
 //
 // Fills a span in the 8bpp palettized screen buffer with a solid color,
-// determined by dspan.color. Performs no shading.
+// determined by drawspan.color. Performs no shading.
 //
-void R_FillSpanP()
+void R_FillSpanP(drawspan_t& drawspan)
 {
-	R_FillSpanGeneric<palindex_t, PaletteFunc>(FB_SPANDEST_P, dspan);
+	R_FillSpanGeneric<palindex_t, PaletteFunc>(FB_SPANDEST_P, drawspan);
 }
 
 //
 // R_FillTranslucentSpanP
 //
 // Fills a span in the 8bpp palettized screen buffer with a solid color,
-// determined by dspan.color using translucency. Shading is performed 
-// using dspan.colormap.
+// determined by drawspan.color using translucency. Shading is performed 
+// using drawspan.colormap.
 //
-void R_FillTranslucentSpanP()
+void R_FillTranslucentSpanP(drawspan_t& drawspan)
 {
-	R_FillSpanGeneric<palindex_t, PaletteTranslucentColormapFunc>(FB_SPANDEST_P, dspan);
+	R_FillSpanGeneric<palindex_t, PaletteTranslucentColormapFunc>(FB_SPANDEST_P, drawspan);
 }
 
 //
 // R_DrawSpanP
 //
 // Renders a span for a level plane to the 8bpp palettized screen buffer from
-// the source buffer dspan.source. Shading is performed using dspan.colormap.
+// the source buffer drawspan.source. Shading is performed using drawspan.colormap.
 //
-void R_DrawSpanP()
+void R_DrawSpanP(drawspan_t& drawspan)
 {
-	R_DrawLevelSpanGeneric<palindex_t, PaletteColormapFunc>(FB_SPANDEST_P, dspan);
+	R_DrawLevelSpanGeneric<palindex_t, PaletteColormapFunc>(FB_SPANDEST_P, drawspan);
 }
 
 //
 // R_DrawSlopeSpanP
 //
 // Renders a span for a sloped plane to the 8bpp palettized screen buffer from
-// the source buffer dspan.source. Shading is performed using dspan.colormap.
+// the source buffer drawspan.source. Shading is performed using drawspan.colormap.
 //
-void R_DrawSlopeSpanP()
+void R_DrawSlopeSpanP(drawspan_t& drawspan)
 {
-	R_DrawSlopedSpanGeneric<palindex_t, PaletteSlopeColormapFunc>(FB_SPANDEST_P, dspan);
+	R_DrawSlopedSpanGeneric<palindex_t, PaletteSlopeColormapFunc>(FB_SPANDEST_P, drawspan);
 }
 
 
@@ -1198,7 +1163,7 @@ void R_DrawSlopeSpanP()
 // buffer.
 //
 // The functors are instantiated with a shaderef_t* parameter (typically
-// dcol.colormap or dspan.colormap) that will be used to shade the pixel.
+// drawcolumn.colormap or drawspan.colormap) that will be used to shade the pixel.
 //
 // ----------------------------------------------------------------------------
 
@@ -1234,14 +1199,19 @@ private:
 class DirectFuzzyFunc
 {
 public:
-	DirectFuzzyFunc(const drawcolumn_t& drawcolumn) { }
+	DirectFuzzyFunc(const drawcolumn_t& drawcolumn) :
+			fuzz(*drawcolumn.fuzz), pitch(drawcolumn.pitch_in_pixels) { }
 
 	forceinline void operator()(byte c, argb_t* dest) const
 	{
-		argb_t work = dest[fuzztable.getValue()];
+		argb_t work = dest[fuzz.getValue(pitch)];
 		*dest = work - ((work >> 2) & 0x3f3f3f);
-		fuzztable.incrementRow();
+		fuzz.incrementRow();
 	}
+
+private:
+	FuzzTable& fuzz;
+	int pitch;
 };
 
 class DirectTranslucentColormapFunc
@@ -1333,28 +1303,28 @@ private:
 //
 // ----------------------------------------------------------------------------
 
-#define FB_COLDEST_D ((argb_t*)dcol.destination + dcol.yl * dcol.pitch_in_pixels + dcol.x)
+#define FB_COLDEST_D ((argb_t*)drawcolumn.destination + drawcolumn.yl * drawcolumn.pitch_in_pixels + drawcolumn.x)
 
 //
 // R_FillColumnD
 //
 // Fills a column in the 32bpp ARGB8888 screen buffer with a solid color,
-// determined by dcol.color. Performs no shading.
+// determined by drawcolumn.color. Performs no shading.
 //
-void R_FillColumnD()
+void R_FillColumnD(drawcolumn_t& drawcolumn)
 {
-	R_FillColumnGeneric<argb_t, DirectFunc>(FB_COLDEST_D, dcol);
+	R_FillColumnGeneric<argb_t, DirectFunc>(FB_COLDEST_D, drawcolumn);
 }
 
 //
 // R_DrawColumnD
 //
 // Renders a column to the 32bpp ARGB8888 screen buffer from the source buffer
-// dcol.source and scaled by dcol.iscale. Shading is performed using dcol.colormap.
+// drawcolumn.source and scaled by drawcolumn.iscale. Shading is performed using drawcolumn.colormap.
 //
-void R_DrawColumnD()
+void R_DrawColumnD(drawcolumn_t& drawcolumn)
 {
-	R_DrawColumnGeneric<argb_t, DirectColormapFunc>(FB_COLDEST_D, dcol);
+	R_DrawColumnGeneric<argb_t, DirectColormapFunc>(FB_COLDEST_D, drawcolumn);
 }
 
 //
@@ -1364,55 +1334,80 @@ void R_DrawColumnD()
 // invisibility effect, which shades the column and rearranges the ordering
 // the pixels to create distortion. Shading is performed using colormap 6.
 //
-void R_DrawFuzzColumnD()
+void R_DrawFuzzColumnD(drawcolumn_t& drawcolumn)
 {
 	// adjust the borders (prevent buffer over/under-reads)
-	if (dcol.yl <= 0)
-		dcol.yl = 1;
-	if (dcol.yh >= viewheight - 1)
-		dcol.yh = viewheight - 2;
+	if (drawcolumn.yl <= 0)
+		drawcolumn.yl = 1;
+	if (drawcolumn.yh >= viewheight - 1)
+		drawcolumn.yh = viewheight - 2;
 
-	R_FillColumnGeneric<argb_t, DirectFuzzyFunc>(FB_COLDEST_D, dcol);
-	fuzztable.incrementColumn();
+	R_FillColumnGeneric<argb_t, DirectFuzzyFunc>(FB_COLDEST_D, drawcolumn);
+	drawcolumn.fuzz->incrementColumn();
 }
 
 //
 // R_DrawTranslucentColumnD
 //
 // Renders a translucent column to the 32bpp ARGB8888 screen buffer from the
-// source buffer dcol.source and scaled by dcol.iscale. The amount of
-// translucency is controlled by dcol.translevel. Shading is performed using
-// dcol.colormap.
+// source buffer drawcolumn.source and scaled by drawcolumn.iscale. The amount of
+// translucency is controlled by drawcolumn.translevel. Shading is performed using
+// drawcolumn.colormap.
 //
-void R_DrawTranslucentColumnD()
+void R_DrawTranslucentColumnD(drawcolumn_t& drawcolumn)
 {
-	R_DrawColumnGeneric<argb_t, DirectTranslucentColormapFunc>(FB_COLDEST_D, dcol);
+	R_DrawColumnGeneric<argb_t, DirectTranslucentColormapFunc>(FB_COLDEST_D, drawcolumn);
 }
 
 //
 // R_DrawTranslatedColumnD
 //
 // Renders a column to the 32bpp ARGB8888 screen buffer with color-remapping
-// from the source buffer dcol.source and scaled by dcol.iscale. The translation
-// table is supplied by dcol.translation. Shading is performed using dcol.colormap.
+// from the source buffer drawcolumn.source and scaled by drawcolumn.iscale. The translation
+// table is supplied by drawcolumn.translation. Shading is performed using drawcolumn.colormap.
 //
-void R_DrawTranslatedColumnD()
+void R_DrawTranslatedColumnD(drawcolumn_t& drawcolumn)
 {
-	R_DrawColumnGeneric<argb_t, DirectTranslatedColormapFunc>(FB_COLDEST_D, dcol);
+	R_DrawColumnGeneric<argb_t, DirectTranslatedColormapFunc>(FB_COLDEST_D, drawcolumn);
 }
 
 //
 // R_DrawTlatedLucentColumnD
 //
 // Renders a translucent column to the 32bpp ARGB8888 screen buffer with
-// color-remapping from the source buffer dcol.source and scaled by dcol.iscale. 
-// The translation table is supplied by dcol.translation and the amount of
-// translucency is controlled by dcol.translevel. Shading is performed using
-// dcol.colormap.
+// color-remapping from the source buffer drawcolumn.source and scaled by drawcolumn.iscale. 
+// The translation table is supplied by drawcolumn.translation and the amount of
+// translucency is controlled by drawcolumn.translevel. Shading is performed using
+// drawcolumn.colormap.
+//
+void R_DrawTlatedLucentColumnD(drawcolumn_t& drawcolumn)
+{
+	R_DrawColumnGeneric<argb_t, DirectTranslatedTranslucentColormapFunc>(FB_COLDEST_D, drawcolumn);
+}
+
+//
+// R_DrawColumnQuadD
 //
-void R_DrawTlatedLucentColumnD()
+// Renders four adjacent columns to the 32bpp ARGB8888 screen buffer, the
+// leftmost being columns[0]. The vectorized versions draw the rows shared by
+// all four columns together, four pixels at a time.
+//
+void R_DrawColumnQuadD_c(drawcolumn_t* columns)
 {
-	R_DrawColumnGeneric<argb_t, DirectTranslatedTranslucentColormapFunc>(FB_COLDEST_D, dcol);
+	for (int i = 0; i < 4; i++)
+		R_DrawColumnD(columns[i]);
+}
+
+//
+// R_DrawTranslucentColumnQuadD
+//
+// Renders four adjacent translucent columns to the 32bpp ARGB8888 screen
+// buffer, the leftmost being columns[0].
+//
+void R_DrawTranslucentColumnQuadD_c(drawcolumn_t* columns)
+{
+	for (int i = 0; i < 4; i++)
+		R_DrawTranslucentColumnD(columns[i]);
 }
 
 
@@ -1422,51 +1417,51 @@ void R_DrawTlatedLucentColumnD()
 //
 // ----------------------------------------------------------------------------
 
-#define FB_SPANDEST_D ((argb_t*)dspan.destination + dspan.y * dspan.pitch_in_pixels + dspan.x1)
+#define FB_SPANDEST_D ((argb_t*)drawspan.destination + drawspan.y * drawspan.pitch_in_pixels + drawspan.x1)
 
 //
 // R_FillSpanD
 //
 // Fills a span in the 32bpp ARGB8888 screen buffer with a solid color,
-// determined by dspan.color. Performs no shading.
+// determined by drawspan.color. Performs no shading.
 //
-void R_FillSpanD()
+void R_FillSpanD(drawspan_t& drawspan)
 {
-	R_FillSpanGeneric<argb_t, DirectFunc>(FB_SPANDEST_D, dspan);
+	R_FillSpanGeneric<argb_t, DirectFunc>(FB_SPANDEST_D, drawspan);
 }
 
 //
 // R_FillTranslucentSpanD
 //
 // Fills a span in the 32bpp ARGB8888 screen buffer with a solid color,
-// determined by dspan.color using translucency. Shading is performed 
-// using dspan.colormap.
+// determined by drawspan.color using translucency. Shading is performed 
+// using drawspan.colormap.
 //
-void R_FillTranslucentSpanD()
+void R_FillTranslucentSpanD(drawspan_t& drawspan)
 {
-	R_FillSpanGeneric<argb_t, DirectTranslucentColormapFunc>(FB_SPANDEST_D, dspan);
+	R_FillSpanGeneric<argb_t, DirectTranslucentColormapFunc>(FB_SPANDEST_D, drawspan);
 }
 
 //
 // R_DrawSpanD
 //
 // Renders a span for a level plane to the 32bpp ARGB8888 screen buffer from
-// the source buffer dspan.source. Shading is performed using dspan.colormap.
+// the source buffer drawspan.source. Shading is performed using drawspan.colormap.
 //
-void R_DrawSpanD_c()
+void R_DrawSpanD_c(drawspan_t& drawspan)
 {
-	R_DrawLevelSpanGeneric<argb_t, DirectColormapFunc>(FB_SPANDEST_D, dspan);
+	R_DrawLevelSpanGeneric<argb_t, DirectColormapFunc>(FB_SPANDEST_D, drawspan);
 }
 
 //
 // R_DrawSlopeSpanD
 //
 // Renders a span for a sloped plane to the 32bpp ARGB8888 screen buffer from
-// the source buffer dspan.source. Shading is performed using dspan.colormap.
+// the source buffer drawspan.source. Shading is performed using drawspan.colormap.
 //
-void R_DrawSlopeSpanD_c()
+void R_DrawSlopeSpanD_c(drawspan_t& drawspan)
 {
-	R_DrawSlopedSpanGeneric<argb_t, DirectSlopeColormapFunc>(FB_SPANDEST_D, dspan);
+	R_DrawSlopedSpanGeneric<argb_t, DirectSlopeColormapFunc>(FB_SPANDEST_D, drawspan);
 }
 
 
@@ -1605,7 +1600,9 @@ enum r_optimize_kind {
 	OPTIMIZE_NONE,
 	OPTIMIZE_SSE2,
 	OPTIMIZE_MMX,
-	OPTIMIZE_ALTIVEC
+	OPTIMIZE_ALTIVEC,
+	OPTIMIZE_AVX2,
+	OPTIMIZE_NEON
 };
 
 static r_optimize_kind optimize_kind = OPTIMIZE_NONE;
@@ -1618,6 +1615,8 @@ static const char *get_optimization_name(r_optimize_kind kind)
 		case OPTIMIZE_SSE2:    return "sse2";
 		case OPTIMIZE_MMX:     return "mmx";
 		case OPTIMIZE_ALTIVEC: return "altivec";
+		case OPTIMIZE_AVX2:    return "avx2";
+		case OPTIMIZE_NEON:    return "neon";
 		case OPTIMIZE_NONE:
 		default:
 			return "none";
@@ -1640,6 +1639,37 @@ static std::string get_optimization_name_list(const bool includeNone)
 	return str;
 }
 
+//
+// cpu_has_avx2
+//
+// SDL checks both CPUID and that the OS saves the AVX registers.
+//
+static bool cpu_has_avx2()
+{
+	#if defined(SDL20) && SDL_VERSION_ATLEAST(2, 0, 4)
+	return SDL_HasAVX2();
+	#else
+	return false;
+	#endif
+}
+
+//
+// cpu_has_neon
+//
+// NEON is always there on AArch64. On 32-bit ARM, SDL checks the HWCAP
+// bits the OS reports.
+//
+static bool cpu_has_neon()
+{
+	#if defined(__aarch64__) || defined(_M_ARM64)
+	return true;
+	#elif defined(SDL20) && SDL_VERSION_ATLEAST(2, 0, 6)
+	return SDL_HasNEON();
+	#else
+	return false;
+	#endif
+}
+
 static void print_optimizations()
 {
 	Printf(PRINT_HIGH, "r_optimize detected \"%s\"\n", get_optimization_name_list(false).c_str());
@@ -1664,10 +1694,18 @@ static bool detect_optimizations()
 	if (SDL_HasSSE2())
 		optimizations_available.push_back(OPTIMIZE_SSE2);
 	#endif
+	#ifdef HAVE_AVX2_DRAWERS
+	if (cpu_has_avx2())
+		optimizations_available.push_back(OPTIMIZE_AVX2);
+	#endif
 	#ifdef __ALTIVEC__
 	if (SDL_HasAltiVec())
 		optimizations_available.push_back(OPTIMIZE_ALTIVEC);
 	#endif
+	#ifdef HAVE_NEON_DRAWERS
+	if (cpu_has_neon())
+		optimizations_available.push_back(OPTIMIZE_NEON);
+	#endif
 
 	return true;
 }
@@ -1702,6 +1740,10 @@ CVAR_FUNC_IMPL(r_optimize)
 		optimize_kind = OPTIMIZE_MMX;
 	else if (stricmp(val, "altivec") == 0 && R_IsOptimizationAvailable(OPTIMIZE_ALTIVEC))
 		optimize_kind = OPTIMIZE_ALTIVEC;
+	else if (stricmp(val, "avx2") == 0 && R_IsOptimizationAvailable(OPTIMIZE_AVX2))
+		optimize_kind = OPTIMIZE_AVX2;
+	else if (stricmp(val, "neon") == 0 && R_IsOptimizationAvailable(OPTIMIZE_NEON))
+		optimize_kind = OPTIMIZE_NEON;
 	else if (stricmp(val, "detect") == 0)
 		// Default to the most preferred:
 		optimize_kind = optimizations_available.back();
@@ -1732,6 +1774,68 @@ CVAR_FUNC_IMPL(r_optimize)
 }
 
 
+//
+// r_optimizebench
+//
+// Draws the current view a number of times with each of the optimizations
+// r_optimize can use on this CPU and prints how fast each one was.
+//
+BEGIN_COMMAND(r_optimizebench)
+{
+	if (gamestate != GS_LEVEL || !I_VideoInitialized())
+	{
+		Printf(PRINT_HIGH, "r_optimizebench: must be in a level\n");
+		return;
+	}
+
+	// the 8bpp drawers are the same for every optimization
+	if (R_GetRenderingSurface()->getBitsPerPixel() != 32)
+	{
+		Printf(PRINT_HIGH, "r_optimizebench: only the 32bpp drawers are optimized, set vid_32bpp 1\n");
+		return;
+	}
+
+	const int frames = argc > 1 ? clamp(atoi(argv[1]), 1, 10000) : 100;
+
+	if (detect_optimizations())
+		print_optimizations();
+
+	const r_optimize_kind previous_kind = optimize_kind;
+	const double pixels = double(viewwidth) * double(viewheight) * frames;
+
+	Printf(PRINT_HIGH, "Drawing %d frames at %dx%d with each optimization:\n",
+			frames, viewwidth, viewheight);
+
+	I_BeginUpdate();
+
+	for (size_t i = 0; i < optimizations_available.size(); i++)
+	{
+		optimize_kind = optimizations_available[i];
+		R_InitVectorizedDrawers();
+		R_InitColumnDrawers();
+
+		// draw once first so textures are cached and threads are started
+		R_RenderPlayerView(&displayplayer());
+
+		const dtime_t start = I_GetTime();
+		for (int frame = 0; frame < frames; frame++)
+			R_RenderPlayerView(&displayplayer());
+		const double seconds = double(I_GetTime() - start) / 1e9;
+
+		Printf(PRINT_HIGH, "%8s: %8.3f ms/frame %10.1f Mpix/s\n",
+				get_optimization_name(optimize_kind), seconds * 1000.0 / frames,
+				seconds > 0.0 ? pixels / seconds / 1e6 : 0.0);
+	}
+
+	I_FinishUpdate();
+
+	optimize_kind = previous_kind;
+	R_InitVectorizedDrawers();
+	R_InitColumnDrawers();
+}
+END_COMMAND(r_optimizebench)
+
+
 //
 // R_InitVectorizedDrawers
 //
@@ -1744,6 +1848,8 @@ void R_InitVectorizedDrawers()
 		// [SL] set defaults to non-vectorized drawers
 		R_DrawSpanD				= R_DrawSpanD_c;
 		R_DrawSlopeSpanD		= R_DrawSlopeSpanD_c;
+		R_DrawColumnQuadD		= R_DrawColumnQuadD_c;
+		R_DrawTranslucentColumnQuadD = R_DrawTranslucentColumnQuadD_c;
 		r_dimpatchD             = r_dimpatchD_c;
 	}
 	#ifdef __SSE2__
@@ -1751,6 +1857,8 @@ void R_InitVectorizedDrawers()
 	{
 		R_DrawSpanD				= R_DrawSpanD_SSE2;
 		R_DrawSlopeSpanD		= R_DrawSlopeSpanD_SSE2;
+		R_DrawColumnQuadD		= R_DrawColumnQuadD_SSE2;
+		R_DrawTranslucentColumnQuadD = R_DrawTranslucentColumnQuadD_SSE2;
 		r_dimpatchD             = r_dimpatchD_SSE2;
 	}
 	#endif
@@ -1759,6 +1867,8 @@ void R_InitVectorizedDrawers()
 	{
 		R_DrawSpanD				= R_DrawSpanD_c;		// TODO
 		R_DrawSlopeSpanD		= R_DrawSlopeSpanD_c;	// TODO
+		R_DrawColumnQuadD		= R_DrawColumnQuadD_c;
+		R_DrawTranslucentColumnQuadD = R_DrawTranslucentColumnQuadD_c;
 		r_dimpatchD             = r_dimpatchD_MMX;
 	}
 	#endif
@@ -1767,19 +1877,45 @@ void R_InitVectorizedDrawers()
 	{
 		R_DrawSpanD				= R_DrawSpanD_c;		// TODO
 		R_DrawSlopeSpanD		= R_DrawSlopeSpanD_c;	// TODO
+		R_DrawColumnQuadD		= R_DrawColumnQuadD_c;
+		R_DrawTranslucentColumnQuadD = R_DrawTranslucentColumnQuadD_c;
 		r_dimpatchD             = r_dimpatchD_ALTIVEC;
 	}
 	#endif
+	#ifdef HAVE_AVX2_DRAWERS
+	else if (optimize_kind == OPTIMIZE_AVX2)
+	{
+		R_DrawSpanD				= R_DrawSpanD_AVX2;
+		R_DrawSlopeSpanD		= R_DrawSlopeSpanD_AVX2;
+		R_DrawColumnQuadD		= R_DrawColumnQuadD_SSE2;	// one row is 128 bits
+		R_DrawTranslucentColumnQuadD = R_DrawTranslucentColumnQuadD_AVX2;
+		r_dimpatchD             = r_dimpatchD_AVX2;
+	}
+	#endif
+	#ifdef HAVE_NEON_DRAWERS
+	else if (optimize_kind == OPTIMIZE_NEON)
+	{
+		R_DrawSpanD				= R_DrawSpanD_NEON;
+		R_DrawSlopeSpanD		= R_DrawSlopeSpanD_NEON;
+		R_DrawColumnQuadD		= R_DrawColumnQuadD_NEON;
+		R_DrawTranslucentColumnQuadD = R_DrawTranslucentColumnQuadD_NEON;
+		r_dimpatchD             = r_dimpatchD_NEON;
+	}
+	#endif
 
 	// Check that all pointers are definitely assigned!
 	assert(R_DrawSpanD != NULL);
 	assert(R_DrawSlopeSpanD != NULL);
+	assert(R_DrawColumnQuadD != NULL);
+	assert(R_DrawTranslucentColumnQuadD != NULL);
 	assert(r_dimpatchD != NULL);
 }
 
 // [RH] Initialize the column drawer pointers
 void R_InitColumnDrawers ()
 {
+	dcol.fuzz = &fuzztable;
+
 	if (!I_VideoInitialized())
 		return;
 
@@ -0,0 +1,447 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// $Id$
+//
+// Copyright (C) 2006-2020 by The Odamex Team.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//	Drawing the view on several threads.
+//
+//	The BSP walk, clipping, visplanes and sprite sorting all stay on the
+//	main thread.  Only the column and span drawers are deferred: while the
+//	queue is active, R_DispatchColumn and R_DispatchSpan record the drawer
+//	and a copy of its state.  When the queue is flushed, the view is split
+//	into vertical slices and every thread replays the whole queue in order,
+//	drawing only the columns in its slice and clipping the spans to it.
+//	Since no two slices share a pixel, the threads never need to lock, and
+//	each slice is drawn in the same order as it would be on one thread.
+//
+//	If r_quadcolumns is set, runs of four adjacent columns queued one after
+//	the other with the same drawer are handed to its quad version while
+//	replaying.  The queue is used with a single thread too then.
+//
+//-----------------------------------------------------------------------------
+
+
+#include "odamex.h"
+
+#include <vector>
+
+#include "i_sdl.h"
+#include "r_local.h"
+
+EXTERN_CVAR(r_threads)
+EXTERN_CVAR(r_quadcolumns)
+
+bool drawqueue_active = false;
+
+// Whether R_DrawSlice may hand four columns at once to a quad drawer.
+static bool drawqueue_quad = false;
+
+struct QueuedColumn
+{
+	void			(*func)(drawcolumn_t&);
+	drawcolumn_t	state;
+	int				source;		// offset into sourcedata, or -1
+};
+
+struct QueuedSpan
+{
+	void			(*func)(drawspan_t&);
+	drawspan_t		state;
+	int				lighting;	// offset into lightingdata, or -1
+};
+
+static std::vector<QueuedColumn> queuedcolumns;
+static std::vector<QueuedSpan> queuedspans;
+
+// The order the columns and spans were queued in.  A column is stored as its
+// index in queuedcolumns and a span as the complement of its index.
+static std::vector<int> queueorder;
+
+// Copies of data that does not outlive the call to the drawer, such as the
+// temporary post R_BlastSolidSegColumn builds and the lighting of a sloped
+// span.  They are referred to by offset since the vectors may grow.
+static std::vector<byte> sourcedata;
+static std::vector<shaderef_t> lightingdata;
+
+static const int MAX_DRAW_THREADS = 16;
+
+struct DrawSlice
+{
+	SDL_Thread*		thread;
+	SDL_sem*		start;
+	SDL_sem*		done;
+	bool			quit;
+
+	int				x1;			// first column of the slice
+	int				x2;			// one past the last column of the slice
+
+	FuzzTable		fuzz;
+};
+
+// Slice 0 is drawn by the main thread, the others each have a thread.
+static DrawSlice drawslices[MAX_DRAW_THREADS];
+static int numdrawslices = 1;
+
+// The slice count last asked of R_StartDrawThreads.  If not every thread
+// could be started, numdrawslices stays below it and the queue keeps using
+// the threads it got instead of retrying each frame.
+static int wanteddrawslices = 1;
+
+
+//
+// R_QueueColumn
+//
+void R_QueueColumn(void (*func)(drawcolumn_t&), const drawcolumn_t& drawcolumn, int tempsource)
+{
+	QueuedColumn column;
+	column.func = func;
+	column.state = drawcolumn;
+	column.source = -1;
+
+	if (tempsource > 0)
+	{
+		column.source = sourcedata.size();
+		sourcedata.insert(sourcedata.end(), drawcolumn.source, drawcolumn.source + tempsource);
+	}
+
+	queueorder.push_back(queuedcolumns.size());
+	queuedcolumns.push_back(column);
+}
+
+
+//
+// R_QueueSpan
+//
+void R_QueueSpan(void (*func)(drawspan_t&), const drawspan_t& drawspan, bool slope)
+{
+	QueuedSpan span;
+	span.func = func;
+	span.state = drawspan;
+	span.lighting = -1;
+
+	if (slope)
+	{
+		span.lighting = lightingdata.size();
+		lightingdata.insert(lightingdata.end(), drawspan.slopelighting,
+							drawspan.slopelighting + (drawspan.x2 - drawspan.x1 + 1));
+	}
+
+	queueorder.push_back(~(int)queuedspans.size());
+	queuedspans.push_back(span);
+}
+
+
+//
+// R_DrawSliceSpan
+//
+// Draws the part of a queued span that falls within the slice.
+//
+static void R_DrawSliceSpan(const DrawSlice& slice, const QueuedSpan& queued)
+{
+	const drawspan_t& orig = queued.state;
+
+	const int x1 = MAX(orig.x1, slice.x1);
+	const int x2 = MIN(orig.x2, slice.x2 - 1);
+	if (x1 > x2)
+		return;
+
+	drawspan_t span = orig;
+	const int skip = x1 - orig.x1;
+
+	span.x1 = x1;
+	span.x2 = x2;
+
+	if (skip > 0)
+	{
+		span.xfrac += skip * span.xstep;
+		span.yfrac += skip * span.ystep;
+		span.iu += skip * span.iustep;
+		span.iv += skip * span.ivstep;
+		span.id += skip * span.idstep;
+	}
+
+	if (queued.lighting >= 0)
+		span.slopelighting = &lightingdata[queued.lighting + skip];
+
+	queued.func(span);
+}
+
+
+//
+// R_GetSliceColumn
+//
+// Returns the state of a queued column as the slice's drawer needs it.
+//
+static inline drawcolumn_t R_GetSliceColumn(DrawSlice& slice, const QueuedColumn& queued)
+{
+	drawcolumn_t column = queued.state;
+	column.fuzz = &slice.fuzz;
+	if (queued.source >= 0)
+		column.source = &sourcedata[queued.source];
+
+	return column;
+}
+
+
+//
+// R_GetQuadColumnFunc
+//
+// Returns the drawer for four columns at once matching func, or NULL if
+// there is none.
+//
+static void (*R_GetQuadColumnFunc(void (*func)(drawcolumn_t&)))(drawcolumn_t*)
+{
+	if (func == R_DrawColumnD)
+		return R_DrawColumnQuadD;
+	if (func == R_DrawTranslucentColumnD)
+		return R_DrawTranslucentColumnQuadD;
+	return NULL;
+}
+
+
+//
+// R_DrawSliceQuad
+//
+// Draws the column queued at position first in queueorder together with the
+// three after it if they are the next three columns to its right and use the
+// same drawer.  Returns false if they can not be drawn together.
+//
+static bool R_DrawSliceQuad(DrawSlice& slice, size_t first)
+{
+	if (!drawqueue_quad || first + 3 >= queueorder.size())
+		return false;
+
+	const QueuedColumn& queued = queuedcolumns[queueorder[first]];
+	if (queued.state.x + 3 >= slice.x2)
+		return false;
+
+	void (*quadfunc)(drawcolumn_t*) = R_GetQuadColumnFunc(queued.func);
+	if (quadfunc == NULL)
+		return false;
+
+	for (int i = 1; i < 4; i++)
+	{
+		const int index = queueorder[first + i];
+		if (index < 0)
+			return false;
+
+		const QueuedColumn& next = queuedcolumns[index];
+		if (next.func != queued.func || next.state.x != queued.state.x + i)
+			return false;
+	}
+
+	drawcolumn_t columns[4];
+	for (int i = 0; i < 4; i++)
+		columns[i] = R_GetSliceColumn(slice, queuedcolumns[queueorder[first + i]]);
+
+	quadfunc(columns);
+	return true;
+}
+
+
+//
+// R_DrawSlice
+//
+// Replays the whole queue, drawing only what falls within the slice.
+//
+static void R_DrawSlice(DrawSlice& slice)
+{
+	for (size_t i = 0; i < queueorder.size(); i++)
+	{
+		const int index = queueorder[i];
+
+		if (index < 0)
+		{
+			R_DrawSliceSpan(slice, queuedspans[~index]);
+			continue;
+		}
+
+		const QueuedColumn& queued = queuedcolumns[index];
+		if (queued.state.x < slice.x1 || queued.state.x >= slice.x2)
+			continue;
+
+		if (R_DrawSliceQuad(slice, i))
+		{
+			i += 3;
+			continue;
+		}
+
+		drawcolumn_t column = R_GetSliceColumn(slice, queued);
+		queued.func(column);
+	}
+}
+
+
+//
+// R_DrawThread
+//
+static int R_DrawThread(void* data)
+{
+	DrawSlice* slice = (DrawSlice*)data;
+
+	while (true)
+	{
+		SDL_SemWait(slice->start);
+		if (slice->quit)
+			break;
+
+		R_DrawSlice(*slice);
+		SDL_SemPost(slice->done);
+	}
+
+	return 0;
+}
+
+
+//
+// R_StopDrawThreads
+//
+static void R_StopDrawThreads()
+{
+	for (int i = 1; i < numdrawslices; i++)
+	{
+		DrawSlice& slice = drawslices[i];
+
+		slice.quit = true;
+		SDL_SemPost(slice.start);
+		SDL_WaitThread(slice.thread, NULL);
+
+		SDL_DestroySemaphore(slice.start);
+		SDL_DestroySemaphore(slice.done);
+		slice.thread = NULL;
+	}
+
+	numdrawslices = 1;
+}
+
+
+//
+// R_StartDrawThreads
+//
+// Starts a thread for every slice but the first.  If a thread can not be
+// started, the view is drawn with the slices that could.
+//
+static void R_StartDrawThreads(int count)
+{
+	for (numdrawslices = 1; numdrawslices < count; numdrawslices++)
+	{
+		DrawSlice& slice = drawslices[numdrawslices];
+
+		slice.quit = false;
+		slice.start = SDL_CreateSemaphore(0);
+		slice.done = SDL_CreateSemaphore(0);
+
+		#ifdef SDL20
+		slice.thread = SDL_CreateThread(R_DrawThread, "R_DrawThread", &slice);
+		#else
+		slice.thread = SDL_CreateThread(R_DrawThread, &slice);
+		#endif
+
+		if (slice.thread == NULL)
+		{
+			Printf(PRINT_HIGH, "R_StartDrawThreads: could not start a drawing thread: %s\n",
+					SDL_GetError());
+			SDL_DestroySemaphore(slice.start);
+			SDL_DestroySemaphore(slice.done);
+			break;
+		}
+	}
+}
+
+
+//
+// R_BeginDrawQueue
+//
+// Called before the view is drawn.  If r_threads asks for more than one
+// thread, or r_quadcolumns for columns drawn four at a time, the drawers are
+// queued until R_EndDrawQueue.
+//
+void R_BeginDrawQueue()
+{
+	int count = clamp(r_threads.asInt(), 1, MAX_DRAW_THREADS);
+
+	// no point in slices narrower than a few columns
+	count = MIN(count, MAX(viewwidth / 16, 1));
+
+	if (count != wanteddrawslices)
+	{
+		R_StopDrawThreads();
+		R_StartDrawThreads(count);
+		wanteddrawslices = count;
+	}
+
+	for (int i = 0; i < numdrawslices; i++)
+	{
+		drawslices[i].x1 = viewwidth * i / numdrawslices;
+		drawslices[i].x2 = viewwidth * (i + 1) / numdrawslices;
+	}
+
+	drawqueue_quad = r_quadcolumns && R_DrawColumn == R_DrawColumnD &&
+					 R_DrawColumnQuadD != R_DrawColumnQuadD_c;
+
+	drawqueue_active = numdrawslices > 1 || drawqueue_quad;
+}
+
+
+//
+// R_FlushDrawQueue
+//
+// Draws everything queued so far and empties the queue.  Anything that
+// writes to the screen without going through the queue while it is active
+// has to flush it first.
+//
+void R_FlushDrawQueue()
+{
+	if (!drawqueue_active || queueorder.empty())
+		return;
+
+	for (int i = 1; i < numdrawslices; i++)
+		SDL_SemPost(drawslices[i].start);
+
+	R_DrawSlice(drawslices[0]);
+
+	for (int i = 1; i < numdrawslices; i++)
+		SDL_SemWait(drawslices[i].done);
+
+	queuedcolumns.clear();
+	queuedspans.clear();
+	queueorder.clear();
+	sourcedata.clear();
+	lightingdata.clear();
+}
+
+
+//
+// R_EndDrawQueue
+//
+void R_EndDrawQueue()
+{
+	R_FlushDrawQueue();
+	drawqueue_active = false;
+}
+
+
+//
+// R_ShutdownDrawQueue
+//
+void R_ShutdownDrawQueue()
+{
+	R_EndDrawQueue();
+	R_StopDrawThreads();
+	wanteddrawslices = 1;
+}
+
+VERSION_CONTROL (r_drawqueue_cpp, "$Id$")
@@ -0,0 +1,490 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// $Id$
+//
+// Copyright (C) 2006-2020 by The Odamex Team.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//	Direct rendering (32-bit) functions for AVX2 optimization.
+//
+//	Every function using AVX2 is marked with AVX2_TARGET, since this file
+//	is not built with AVX2 enabled for the whole file.
+//
+//-----------------------------------------------------------------------------
+
+
+#include "odamex.h"
+
+#include "i_sdl.h"
+#include "r_intrin.h"
+
+#ifdef HAVE_AVX2_DRAWERS
+
+#include <assert.h>
+#include <immintrin.h>
+
+#include "i_system.h"
+#include "r_defs.h"
+#include "r_draw.h"
+#include "r_main.h"
+#include "i_video.h"
+
+//
+// R_GetBytesUntilAligned
+//
+static inline uintptr_t R_GetBytesUntilAligned(void* data, uintptr_t alignment)
+{
+	uintptr_t mask = alignment - 1;
+	return (alignment - ((uintptr_t)data & mask)) & mask;
+}
+
+//
+// R_GatherTexels_AVX2
+//
+// Reads the eight bytes of source at spots.  The gather can only read 32-bit
+// values, so it reads the aligned 32-bit value holding each byte and shifts
+// the byte out of it.  That way the gather never reads past the end of a
+// flat.
+//
+static forceinline AVX2_TARGET __m256i R_GatherTexels_AVX2(const byte* source, const __m256i spots)
+{
+	const __m256i three = _mm256_set1_epi32(3);
+
+	const __m256i words = _mm256_i32gather_epi32((const int*)source, _mm256_andnot_si256(three, spots), 1);
+	const __m256i shifts = _mm256_slli_epi32(_mm256_and_si256(spots, three), 3);
+
+	return _mm256_and_si256(_mm256_srlv_epi32(words, shifts), _mm256_set1_epi32(0xFF));
+}
+
+
+AVX2_TARGET void R_DrawSpanD_AVX2(drawspan_t& drawspan)
+{
+#ifdef RANGECHECK
+	if (drawspan.x2 < drawspan.x1 || drawspan.x1 < 0 || drawspan.x2 >= viewwidth ||
+		drawspan.y >= viewheight || drawspan.y < 0)
+	{
+		Printf(PRINT_HIGH, "R_DrawLevelSpan: %i to %i at %i", drawspan.x1, drawspan.x2, drawspan.y);
+		return;
+	}
+#endif
+
+	const int width = drawspan.x2 - drawspan.x1 + 1;
+
+	// TODO: store flats in column-major format and swap u and v
+	dsfixed_t ufrac = drawspan.yfrac;
+	dsfixed_t vfrac = drawspan.xfrac;
+	dsfixed_t ustep = drawspan.ystep;
+	dsfixed_t vstep = drawspan.xstep;
+
+	const byte* source = drawspan.source;
+	argb_t* dest = (argb_t*)drawspan.destination + drawspan.y * drawspan.pitch_in_pixels + drawspan.x1;
+
+	shaderef_t colormap = drawspan.colormap;
+
+	const int texture_width_bits = 6, texture_height_bits = 6;
+
+	const unsigned int umask = ((1 << texture_width_bits) - 1) << texture_height_bits;
+	const unsigned int vmask = (1 << texture_height_bits) - 1;
+	// TODO: don't shift the values of ufrac and vfrac by 10 in R_MapLevelPlane
+	const int ushift = FRACBITS - texture_height_bits + 10;
+	const int vshift = FRACBITS + 10;
+
+	int align = R_GetBytesUntilAligned(dest, 32) / sizeof(argb_t);
+	if (align > width)
+		align = width;
+
+	int batches = (width - align) / 8;
+	int remainder = (width - align) & 7;
+
+	// Blit until we align ourselves with a 32-byte offset for AVX2:
+	while (align--)
+	{
+		const unsigned int spot = ((ufrac >> ushift) & umask) | ((vfrac >> vshift) & vmask);
+		*dest = colormap.shade(source[spot]);
+		dest++;
+
+		ufrac += ustep;
+		vfrac += vstep;
+	}
+
+	const __m256i mumask = _mm256_set1_epi32(umask);
+	const __m256i mvmask = _mm256_set1_epi32(vmask);
+
+	__m256i mufrac = _mm256_setr_epi32(
+			ufrac+ustep*0, ufrac+ustep*1, ufrac+ustep*2, ufrac+ustep*3,
+			ufrac+ustep*4, ufrac+ustep*5, ufrac+ustep*6, ufrac+ustep*7);
+	const __m256i mufracinc = _mm256_set1_epi32(ustep*8);
+	__m256i mvfrac = _mm256_setr_epi32(
+			vfrac+vstep*0, vfrac+vstep*1, vfrac+vstep*2, vfrac+vstep*3,
+			vfrac+vstep*4, vfrac+vstep*5, vfrac+vstep*6, vfrac+vstep*7);
+	const __m256i mvfracinc = _mm256_set1_epi32(vstep*8);
+
+	ufrac += ustep * 8 * batches;
+	vfrac += vstep * 8 * batches;
+
+	while (batches--)
+	{
+		const __m256i u = _mm256_and_si256(_mm256_srli_epi32(mufrac, ushift), mumask);
+		const __m256i v = _mm256_and_si256(_mm256_srli_epi32(mvfrac, vshift), mvmask);
+
+		// look up the texels, then shade all eight with a second gather
+		const __m256i texels = R_GatherTexels_AVX2(source, _mm256_or_si256(u, v));
+		const __m256i finalColors = _mm256_i32gather_epi32((const int*)colormap.m_shademap, texels, 4);
+
+		_mm256_store_si256((__m256i*)dest, finalColors);
+
+		dest += 8;
+
+		mufrac = _mm256_add_epi32(mufrac, mufracinc);
+		mvfrac = _mm256_add_epi32(mvfrac, mvfracinc);
+	}
+
+	// blit the remaining 0 - 7 pixels
+	while (remainder--)
+	{
+		const unsigned int spot = ((ufrac >> ushift) & umask) | ((vfrac >> vshift) & vmask);
+		*dest = colormap.shade(source[spot]);
+		dest++;
+
+		ufrac += ustep;
+		vfrac += vstep;
+	}
+}
+
+AVX2_TARGET void R_DrawSlopeSpanD_AVX2(drawspan_t& drawspan)
+{
+	int count = drawspan.x2 - drawspan.x1 + 1;
+	if (count <= 0)
+		return;
+
+#ifdef RANGECHECK
+	if (drawspan.x2 < drawspan.x1
+		|| drawspan.x1 < 0
+		|| drawspan.x2 >= I_GetSurfaceWidth()
+		|| drawspan.y >= I_GetSurfaceHeight())
+	{
+		I_Error ("R_DrawSlopeSpan: %i to %i at %i",
+				 drawspan.x1, drawspan.x2, drawspan.y);
+	}
+#endif
+
+	float iu = drawspan.iu, iv = drawspan.iv;
+	float ius = drawspan.iustep, ivs = drawspan.ivstep;
+	float id = drawspan.id, ids = drawspan.idstep;
+
+	// framebuffer
+	argb_t* dest = (argb_t*)drawspan.destination + drawspan.y * drawspan.pitch_in_pixels + drawspan.x1;
+
+	// texture data
+	byte *src = (byte *)drawspan.source;
+
+	int ltindex = 0;		// index into the lighting table
+
+	const __m256i steps = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+	const __m256i umask = _mm256_set1_epi32(63);
+	const __m256i vmask = _mm256_set1_epi32(0xFC0);
+
+	// Blit the bulk in batches of SPANJUMP columns:
+	while (count >= SPANJUMP)
+	{
+		const float mulstart = 65536.0f / id;
+		id += ids * SPANJUMP;
+		const float mulend = 65536.0f / id;
+
+		const float ustart = iu * mulstart;
+		const float vstart = iv * mulstart;
+
+		fixed_t ufrac = (fixed_t)ustart;
+		fixed_t vfrac = (fixed_t)vstart;
+
+		iu += ius * SPANJUMP;
+		iv += ivs * SPANJUMP;
+
+		const float uend = iu * mulend;
+		const float vend = iv * mulend;
+
+		fixed_t ustep = (fixed_t)((uend - ustart) * INTERPSTEP);
+		fixed_t vstep = (fixed_t)((vend - vstart) * INTERPSTEP);
+
+		// Blit SPANJUMP columns in batches of 8.  Each column has its own
+		// lighting, so only the texture lookup is done with a gather.
+		for (int i = 0; i < SPANJUMP; i += 8)
+		{
+			const __m256i mufrac = _mm256_add_epi32(_mm256_set1_epi32(ufrac),
+					_mm256_mullo_epi32(steps, _mm256_set1_epi32(ustep)));
+			const __m256i mvfrac = _mm256_add_epi32(_mm256_set1_epi32(vfrac),
+					_mm256_mullo_epi32(steps, _mm256_set1_epi32(vstep)));
+
+			const __m256i spots = _mm256_or_si256(
+					_mm256_and_si256(_mm256_srli_epi32(mvfrac, 10), vmask),
+					_mm256_and_si256(_mm256_srli_epi32(mufrac, 16), umask));
+
+			int texels[8];
+			_mm256_storeu_si256((__m256i*)texels, R_GatherTexels_AVX2(src, spots));
+
+			const shaderef_t* colormap = &drawspan.slopelighting[ltindex];
+			const __m256i finalColors = _mm256_setr_epi32(
+					colormap[0].shade(texels[0]), colormap[1].shade(texels[1]),
+					colormap[2].shade(texels[2]), colormap[3].shade(texels[3]),
+					colormap[4].shade(texels[4]), colormap[5].shade(texels[5]),
+					colormap[6].shade(texels[6]), colormap[7].shade(texels[7]));
+
+			_mm256_storeu_si256((__m256i*)dest, finalColors);
+
+			dest += 8;
+			ltindex += 8;
+
+			ufrac += ustep * 8;
+			vfrac += vstep * 8;
+		}
+
+		count -= SPANJUMP;
+	}
+
+	// Remainder:
+	assert(count < SPANJUMP);
+	if (count > 0)
+	{
+		const float mulstart = 65536.0f / id;
+		id += ids * count;
+		const float mulend = 65536.0f / id;
+
+		const float ustart = iu * mulstart;
+		const float vstart = iv * mulstart;
+
+		fixed_t ufrac = (fixed_t)ustart;
+		fixed_t vfrac = (fixed_t)vstart;
+
+		iu += ius * count;
+		iv += ivs * count;
+
+		const float uend = iu * mulend;
+		const float vend = iv * mulend;
+
+		fixed_t ustep = (fixed_t)((uend - ustart) / count);
+		fixed_t vstep = (fixed_t)((vend - vstart) / count);
+
+		int incount = count;
+		while (incount--)
+		{
+			const shaderef_t &colormap = drawspan.slopelighting[ltindex++];
+			*dest = colormap.shade(src[((vfrac >> 10) & 0xFC0) | ((ufrac >> 16) & 63)]);
+			dest++;
+			ufrac += ustep;
+			vfrac += vstep;
+		}
+	}
+}
+
+
+//
+// R_DrawTranslucentColumnQuadD_AVX2
+//
+// Draws four adjacent translucent columns, two rows at a time.  See
+// R_DrawColumnQuadGeneric_SSE2 for how the columns are split up.
+//
+AVX2_TARGET void R_DrawTranslucentColumnQuadD_AVX2(drawcolumn_t* columns)
+{
+	int yl = columns[0].yl, yh = columns[0].yh;
+	bool pow2 = true;
+
+	for (int i = 0; i < 4; i++)
+	{
+		yl = MAX(yl, columns[i].yl);
+		yh = MIN(yh, columns[i].yh);
+
+		const int texheight = columns[i].textureheight;
+		if (texheight & (texheight - 1))
+			pow2 = false;
+	}
+
+	if (!pow2 || yh - yl < 4)
+	{
+		for (int i = 0; i < 4; i++)
+			R_DrawTranslucentColumnD(columns[i]);
+		return;
+	}
+
+	const palindex_t* source[4];
+	const shaderef_t* colormap[4];
+	fixed_t frac[4], fracstep[4];
+	int mask[4];
+	int fga[4], bga[4];
+
+	for (int i = 0; i < 4; i++)
+	{
+		const drawcolumn_t& column = columns[i];
+		const unsigned int skip = yl - column.yl;
+
+		if (column.yl < yl)
+		{
+			drawcolumn_t top = column;
+			top.yh = yl - 1;
+			R_DrawTranslucentColumnD(top);
+		}
+
+		if (column.yh > yh)
+		{
+			drawcolumn_t bottom = column;
+			bottom.yl = yh + 1;
+			bottom.texturefrac = (fixed_t)((unsigned int)column.texturefrac +
+					(unsigned int)(yh + 1 - column.yl) * (unsigned int)column.iscale);
+			R_DrawTranslucentColumnD(bottom);
+		}
+
+		source[i] = column.source;
+		colormap[i] = &column.colormap;
+		frac[i] = (fixed_t)((unsigned int)column.texturefrac + skip * (unsigned int)column.iscale);
+		fracstep[i] = column.iscale;
+		mask[i] = (column.textureheight >> FRACBITS) - 1;
+
+		// same alpha as DirectTranslucentColormapFunc
+		fga[i] = (column.translevel & ~0x03FF) >> 8;
+		fga[i] = fga[i] > 255 ? 255 : fga[i];
+		bga[i] = 255 - fga[i];
+	}
+
+	// both 128-bit lanes hold a row of the four columns
+	const __m256i fgalpha_lo = _mm256_setr_epi16(
+			fga[0], fga[0], fga[0], fga[0], fga[1], fga[1], fga[1], fga[1],
+			fga[0], fga[0], fga[0], fga[0], fga[1], fga[1], fga[1], fga[1]);
+	const __m256i fgalpha_hi = _mm256_setr_epi16(
+			fga[2], fga[2], fga[2], fga[2], fga[3], fga[3], fga[3], fga[3],
+			fga[2], fga[2], fga[2], fga[2], fga[3], fga[3], fga[3], fga[3]);
+	const __m256i bgalpha_lo = _mm256_setr_epi16(
+			bga[0], bga[0], bga[0], bga[0], bga[1], bga[1], bga[1], bga[1],
+			bga[0], bga[0], bga[0], bga[0], bga[1], bga[1], bga[1], bga[1]);
+	const __m256i bgalpha_hi = _mm256_setr_epi16(
+			bga[2], bga[2], bga[2], bga[2], bga[3], bga[3], bga[3], bga[3],
+			bga[2], bga[2], bga[2], bga[2], bga[3], bga[3], bga[3], bga[3]);
+	const __m256i opaque = _mm256_set1_epi32(argb_t(255, 0, 0, 0));
+
+	const int pitch = columns[0].pitch_in_pixels;
+	argb_t* dest = (argb_t*)columns[0].destination + yl * pitch + columns[0].x;
+
+	int count = yh - yl + 1;
+	while (count > 0)
+	{
+		// With one row left, the second lane repeats it and is not stored.
+		const int nextrow = count > 1 ? pitch : 0;
+
+		argb_t colors[8];
+		for (int i = 0; i < 4; i++)
+		{
+			colors[i] = colormap[i]->shade(source[i][(frac[i] >> FRACBITS) & mask[i]]);
+			frac[i] += fracstep[i];
+			colors[i + 4] = colormap[i]->shade(source[i][(frac[i] >> FRACBITS) & mask[i]]);
+			frac[i] += fracstep[i];
+		}
+
+		const __m256i fg = _mm256_loadu_si256((__m256i*)colors);
+		const __m256i bg = _mm256_inserti128_si256(
+				_mm256_castsi128_si256(_mm_loadu_si128((__m128i*)dest)),
+				_mm_loadu_si128((__m128i*)(dest + nextrow)), 1);
+
+		// (bg * bga + fg * fga) >> 8 for each channel, as alphablend2a
+		__m256i lower = _mm256_add_epi16(
+				_mm256_mullo_epi16(_mm256_unpacklo_epi8(bg, _mm256_setzero_si256()), bgalpha_lo),
+				_mm256_mullo_epi16(_mm256_unpacklo_epi8(fg, _mm256_setzero_si256()), fgalpha_lo));
+		__m256i upper = _mm256_add_epi16(
+				_mm256_mullo_epi16(_mm256_unpackhi_epi8(bg, _mm256_setzero_si256()), bgalpha_hi),
+				_mm256_mullo_epi16(_mm256_unpackhi_epi8(fg, _mm256_setzero_si256()), fgalpha_hi));
+
+		lower = _mm256_srli_epi16(lower, 8);
+		upper = _mm256_srli_epi16(upper, 8);
+
+		const __m256i result = _mm256_or_si256(_mm256_packus_epi16(lower, upper), opaque);
+
+		_mm_storeu_si128((__m128i*)dest, _mm256_castsi256_si128(result));
+		if (count > 1)
+			_mm_storeu_si128((__m128i*)(dest + pitch), _mm256_extracti128_si256(result, 1));
+
+		dest += pitch * 2;
+		count -= 2;
+	}
+}
+
+
+AVX2_TARGET void r_dimpatchD_AVX2(IWindowSurface* surface, argb_t color, int alpha, int x1, int y1, int w, int h)
+{
+	int surface_pitch_pixels = surface->getPitchInPixels();
+	int line_inc = surface_pitch_pixels - w;
+
+	// AVX2 temporaries:
+	const __m256i vec_color			= _mm256_unpacklo_epi8(_mm256_set1_epi32(color), _mm256_setzero_si256());
+	const __m256i vec_alphacolor	= _mm256_mullo_epi16(vec_color, _mm256_set1_epi16(alpha));
+	const __m256i vec_invalpha		= _mm256_set1_epi16(256 - alpha);
+
+	argb_t* dest = (argb_t*)surface->getBuffer() + y1 * surface_pitch_pixels + x1;
+
+	for (int rowcount = h; rowcount > 0; --rowcount)
+	{
+		// Calculate how many pixels of each row need to be drawn before dest is
+		// aligned to a 256-bit boundary.
+		int align = R_GetBytesUntilAligned(dest, 256/8) / sizeof(argb_t);
+		if (align > w)
+			align = w;
+
+		const int batch_size = 16;
+		int batches = (w - align) / batch_size;
+		int remainder = (w - align) & (batch_size - 1);
+
+		// align the destination buffer to 256-bit boundary
+		while (align--)
+		{
+			*dest = alphablend1a(*dest, color, alpha);
+			dest++;
+		}
+
+		// AVX2 optimize the bulk in batches of 16 pixels:
+		while (batches--)
+		{
+			const __m256i vec_input0 = _mm256_load_si256((__m256i*)(dest + 0));
+			const __m256i vec_input1 = _mm256_load_si256((__m256i*)(dest + 8));
+
+			// Widen each color channel to 16-bits for the multiplication.
+			// The unpacks work within each 128-bit lane, as does the pack
+			// afterwards, so the pixels end up back where they were.
+			__m256i vec_lower0 = _mm256_unpacklo_epi8(vec_input0, _mm256_setzero_si256());
+			__m256i vec_upper0 = _mm256_unpackhi_epi8(vec_input0, _mm256_setzero_si256());
+			__m256i vec_lower1 = _mm256_unpacklo_epi8(vec_input1, _mm256_setzero_si256());
+			__m256i vec_upper1 = _mm256_unpackhi_epi8(vec_input1, _mm256_setzero_si256());
+
+			// ((input * invAlpha) + (color * Alpha)) >> 8
+			vec_lower0 = _mm256_srli_epi16(_mm256_add_epi16(_mm256_mullo_epi16(vec_lower0, vec_invalpha), vec_alphacolor), 8);
+			vec_upper0 = _mm256_srli_epi16(_mm256_add_epi16(_mm256_mullo_epi16(vec_upper0, vec_invalpha), vec_alphacolor), 8);
+			vec_lower1 = _mm256_srli_epi16(_mm256_add_epi16(_mm256_mullo_epi16(vec_lower1, vec_invalpha), vec_alphacolor), 8);
+			vec_upper1 = _mm256_srli_epi16(_mm256_add_epi16(_mm256_mullo_epi16(vec_upper1, vec_invalpha), vec_alphacolor), 8);
+
+			_mm256_store_si256((__m256i*)(dest + 0), _mm256_packus_epi16(vec_lower0, vec_upper0));
+			_mm256_store_si256((__m256i*)(dest + 8), _mm256_packus_epi16(vec_lower1, vec_upper1));
+
+			dest += batch_size;
+		}
+
+		// Pick up the remainder:
+		while (remainder--)
+		{
+			*dest = alphablend1a(*dest, color, alpha);
+			dest++;
+		}
+
+		dest += line_inc;
+	}
+}
+
+
+VERSION_CONTROL (r_drawt_avx2_cpp, "$Id$")
+
+#endif
@@ -0,0 +1,461 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// $Id$
+//
+// Copyright (C) 2006-2020 by The Odamex Team.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//	Direct rendering (32-bit) functions for ARM NEON optimization.
+//
+//-----------------------------------------------------------------------------
+
+
+#include "odamex.h"
+
+#include "i_sdl.h"
+#include "r_intrin.h"
+
+#ifdef HAVE_NEON_DRAWERS
+
+#include <assert.h>
+
+#include "i_system.h"
+#include "r_defs.h"
+#include "r_draw.h"
+#include "r_main.h"
+#include "i_video.h"
+
+// Direct rendering (32-bit) functions for NEON optimization:
+
+void R_DrawSpanD_NEON(drawspan_t& drawspan)
+{
+#ifdef RANGECHECK
+	if (drawspan.x2 < drawspan.x1 || drawspan.x1 < 0 || drawspan.x2 >= viewwidth ||
+		drawspan.y >= viewheight || drawspan.y < 0)
+	{
+		Printf(PRINT_HIGH, "R_DrawLevelSpan: %i to %i at %i", drawspan.x1, drawspan.x2, drawspan.y);
+		return;
+	}
+#endif
+
+	const int width = drawspan.x2 - drawspan.x1 + 1;
+
+	// TODO: store flats in column-major format and swap u and v
+	dsfixed_t ufrac = drawspan.yfrac;
+	dsfixed_t vfrac = drawspan.xfrac;
+	dsfixed_t ustep = drawspan.ystep;
+	dsfixed_t vstep = drawspan.xstep;
+
+	const byte* source = drawspan.source;
+	argb_t* dest = (argb_t*)drawspan.destination + drawspan.y * drawspan.pitch_in_pixels + drawspan.x1;
+
+	shaderef_t colormap = drawspan.colormap;
+
+	const int texture_width_bits = 6, texture_height_bits = 6;
+
+	const unsigned int umask = ((1 << texture_width_bits) - 1) << texture_height_bits;
+	const unsigned int vmask = (1 << texture_height_bits) - 1;
+	// TODO: don't shift the values of ufrac and vfrac by 10 in R_MapLevelPlane
+	// The shifts are constants, as the NEON shift intrinsics require.
+	const int ushift = FRACBITS - texture_height_bits + 10;
+	const int vshift = FRACBITS + 10;
+
+	int batches = width / 4;
+	int remainder = width & 3;
+
+	const uint32x4_t mumask = vdupq_n_u32(umask);
+	const uint32x4_t mvmask = vdupq_n_u32(vmask);
+
+	const uint32_t ufracs[4] = { ufrac, ufrac + ustep, ufrac + ustep*2, ufrac + ustep*3 };
+	const uint32_t vfracs[4] = { vfrac, vfrac + vstep, vfrac + vstep*2, vfrac + vstep*3 };
+
+	uint32x4_t mufrac = vld1q_u32(ufracs);
+	uint32x4_t mvfrac = vld1q_u32(vfracs);
+	const uint32x4_t mufracinc = vdupq_n_u32(ustep*4);
+	const uint32x4_t mvfracinc = vdupq_n_u32(vstep*4);
+
+	ufrac += ustep * 4 * batches;
+	vfrac += vstep * 4 * batches;
+
+	while (batches--)
+	{
+		const uint32x4_t u = vandq_u32(vshrq_n_u32(mufrac, ushift), mumask);
+		const uint32x4_t v = vandq_u32(vshrq_n_u32(mvfrac, vshift), mvmask);
+		const uint32x4_t spots = vorrq_u32(u, v);
+
+		const uint32_t colors[4] = {
+			colormap.shade(source[vgetq_lane_u32(spots, 0)]),
+			colormap.shade(source[vgetq_lane_u32(spots, 1)]),
+			colormap.shade(source[vgetq_lane_u32(spots, 2)]),
+			colormap.shade(source[vgetq_lane_u32(spots, 3)])
+		};
+
+		vst1q_u32((uint32_t*)dest, vld1q_u32(colors));
+
+		dest += 4;
+
+		mufrac = vaddq_u32(mufrac, mufracinc);
+		mvfrac = vaddq_u32(mvfrac, mvfracinc);
+	}
+
+	// blit the remaining 0 - 3 pixels
+	while (remainder--)
+	{
+		const unsigned int spot = ((ufrac >> ushift) & umask) | ((vfrac >> vshift) & vmask);
+		*dest = colormap.shade(source[spot]);
+		dest++;
+
+		ufrac += ustep;
+		vfrac += vstep;
+	}
+}
+
+void R_DrawSlopeSpanD_NEON(drawspan_t& drawspan)
+{
+	int count = drawspan.x2 - drawspan.x1 + 1;
+	if (count <= 0)
+		return;
+
+#ifdef RANGECHECK
+	if (drawspan.x2 < drawspan.x1
+		|| drawspan.x1 < 0
+		|| drawspan.x2 >= I_GetSurfaceWidth()
+		|| drawspan.y >= I_GetSurfaceHeight())
+	{
+		I_Error ("R_DrawSlopeSpan: %i to %i at %i",
+				 drawspan.x1, drawspan.x2, drawspan.y);
+	}
+#endif
+
+	float iu = drawspan.iu, iv = drawspan.iv;
+	float ius = drawspan.iustep, ivs = drawspan.ivstep;
+	float id = drawspan.id, ids = drawspan.idstep;
+
+	// framebuffer
+	argb_t* dest = (argb_t*)drawspan.destination + drawspan.y * drawspan.pitch_in_pixels + drawspan.x1;
+
+	// texture data
+	byte *src = (byte *)drawspan.source;
+
+	int ltindex = 0;		// index into the lighting table
+
+	const uint32_t steps[4] = { 0, 1, 2, 3 };
+	const uint32x4_t msteps = vld1q_u32(steps);
+	const uint32x4_t umask = vdupq_n_u32(63);
+	const uint32x4_t vmask = vdupq_n_u32(0xFC0);
+
+	// Blit the bulk in batches of SPANJUMP columns:
+	while (count >= SPANJUMP)
+	{
+		const float mulstart = 65536.0f / id;
+		id += ids * SPANJUMP;
+		const float mulend = 65536.0f / id;
+
+		const float ustart = iu * mulstart;
+		const float vstart = iv * mulstart;
+
+		fixed_t ufrac = (fixed_t)ustart;
+		fixed_t vfrac = (fixed_t)vstart;
+
+		iu += ius * SPANJUMP;
+		iv += ivs * SPANJUMP;
+
+		const float uend = iu * mulend;
+		const float vend = iv * mulend;
+
+		fixed_t ustep = (fixed_t)((uend - ustart) * INTERPSTEP);
+		fixed_t vstep = (fixed_t)((vend - vstart) * INTERPSTEP);
+
+		// Blit SPANJUMP columns in batches of 4:
+		for (int i = 0; i < SPANJUMP; i += 4)
+		{
+			const uint32x4_t mufrac = vmlaq_n_u32(vdupq_n_u32(ufrac), msteps, ustep);
+			const uint32x4_t mvfrac = vmlaq_n_u32(vdupq_n_u32(vfrac), msteps, vstep);
+
+			const uint32x4_t spots = vorrq_u32(
+					vandq_u32(vshrq_n_u32(mvfrac, 10), vmask),
+					vandq_u32(vshrq_n_u32(mufrac, 16), umask));
+
+			const shaderef_t* colormap = &drawspan.slopelighting[ltindex];
+			const uint32_t colors[4] = {
+				colormap[0].shade(src[vgetq_lane_u32(spots, 0)]),
+				colormap[1].shade(src[vgetq_lane_u32(spots, 1)]),
+				colormap[2].shade(src[vgetq_lane_u32(spots, 2)]),
+				colormap[3].shade(src[vgetq_lane_u32(spots, 3)])
+			};
+
+			vst1q_u32((uint32_t*)dest, vld1q_u32(colors));
+
+			dest += 4;
+			ltindex += 4;
+
+			ufrac += ustep * 4;
+			vfrac += vstep * 4;
+		}
+
+		count -= SPANJUMP;
+	}
+
+	// Remainder:
+	assert(count < SPANJUMP);
+	if (count > 0)
+	{
+		const float mulstart = 65536.0f / id;
+		id += ids * count;
+		const float mulend = 65536.0f / id;
+
+		const float ustart = iu * mulstart;
+		const float vstart = iv * mulstart;
+
+		fixed_t ufrac = (fixed_t)ustart;
+		fixed_t vfrac = (fixed_t)vstart;
+
+		iu += ius * count;
+		iv += ivs * count;
+
+		const float uend = iu * mulend;
+		const float vend = iv * mulend;
+
+		fixed_t ustep = (fixed_t)((uend - ustart) / count);
+		fixed_t vstep = (fixed_t)((vend - vstart) / count);
+
+		int incount = count;
+		while (incount--)
+		{
+			const shaderef_t &colormap = drawspan.slopelighting[ltindex++];
+			*dest = colormap.shade(src[((vfrac >> 10) & 0xFC0) | ((ufrac >> 16) & 63)]);
+			dest++;
+			ufrac += ustep;
+			vfrac += vstep;
+		}
+	}
+}
+
+
+//
+// R_ColumnFracAt
+//
+// Returns the texture position of the column at row y.
+//
+static inline fixed_t R_ColumnFracAt(const drawcolumn_t& column, int y)
+{
+	return (fixed_t)((unsigned int)column.texturefrac + (unsigned int)(y - column.yl) * (unsigned int)column.iscale);
+}
+
+//
+// Functors that write four shaded pixels to the screen.
+//
+class QuadColormapFunc_NEON
+{
+public:
+	QuadColormapFunc_NEON(const drawcolumn_t* columns) { }
+
+	forceinline void operator()(const uint32x4_t fg, argb_t* dest) const
+	{
+		vst1q_u32((uint32_t*)dest, fg);
+	}
+};
+
+class QuadTranslucentColormapFunc_NEON
+{
+public:
+	QuadTranslucentColormapFunc_NEON(const drawcolumn_t* columns)
+	{
+		// same alpha as DirectTranslucentColormapFunc, but one for each column
+		uint8_t fga[16], bga[16];
+		for (int i = 0; i < 4; i++)
+		{
+			int alpha = (columns[i].translevel & ~0x03FF) >> 8;
+			alpha = alpha > 255 ? 255 : alpha;
+
+			for (int j = 0; j < 4; j++)
+			{
+				fga[i * 4 + j] = alpha;
+				bga[i * 4 + j] = 255 - alpha;
+			}
+		}
+
+		fgalpha = vld1q_u8(fga);
+		bgalpha = vld1q_u8(bga);
+		opaque = vdupq_n_u32(argb_t(255, 0, 0, 0));
+	}
+
+	forceinline void operator()(const uint32x4_t fg, argb_t* dest) const
+	{
+		const uint8x16_t bg = vld1q_u8((uint8_t*)dest);
+		const uint8x16_t fg8 = vreinterpretq_u8_u32(fg);
+
+		// (bg * bga + fg * fga) >> 8 for each channel, as alphablend2a
+		uint16x8_t lower = vmull_u8(vget_low_u8(bg), vget_low_u8(bgalpha));
+		lower = vmlal_u8(lower, vget_low_u8(fg8), vget_low_u8(fgalpha));
+		uint16x8_t upper = vmull_u8(vget_high_u8(bg), vget_high_u8(bgalpha));
+		upper = vmlal_u8(upper, vget_high_u8(fg8), vget_high_u8(fgalpha));
+
+		const uint8x16_t result = vcombine_u8(vshrn_n_u16(lower, 8), vshrn_n_u16(upper, 8));
+
+		vst1q_u32((uint32_t*)dest, vorrq_u32(vreinterpretq_u32_u8(result), opaque));
+	}
+
+private:
+	uint8x16_t fgalpha, bgalpha;
+	uint32x4_t opaque;
+};
+
+//
+// R_DrawColumnQuadGeneric_NEON
+//
+// Draws four adjacent columns. The rows above and below the ones shared by all
+// four columns are drawn a column at a time with drawfunc. The shared rows are
+// drawn four pixels at a time, so that each row takes a single store.
+//
+template<typename BLENDFUNC>
+static forceinline void R_DrawColumnQuadGeneric_NEON(drawcolumn_t* columns, void (*drawfunc)(drawcolumn_t&))
+{
+	int yl = columns[0].yl, yh = columns[0].yh;
+	bool pow2 = true;
+
+	for (int i = 0; i < 4; i++)
+	{
+		yl = MAX(yl, columns[i].yl);
+		yh = MIN(yh, columns[i].yh);
+
+		const int texheight = columns[i].textureheight;
+		if (texheight & (texheight - 1))
+			pow2 = false;
+	}
+
+	// [SL] Textures whose heights are not a power-of-2 need to wrap around
+	// one row at a time, so leave them to the regular drawer.
+	if (!pow2 || yh - yl < 4)
+	{
+		for (int i = 0; i < 4; i++)
+			drawfunc(columns[i]);
+		return;
+	}
+
+	const palindex_t* source[4];
+	const shaderef_t* colormap[4];
+	fixed_t frac[4], fracstep[4];
+	int mask[4];
+
+	for (int i = 0; i < 4; i++)
+	{
+		const drawcolumn_t& column = columns[i];
+
+		if (column.yl < yl)
+		{
+			drawcolumn_t top = column;
+			top.yh = yl - 1;
+			drawfunc(top);
+		}
+
+		if (column.yh > yh)
+		{
+			drawcolumn_t bottom = column;
+			bottom.yl = yh + 1;
+			bottom.texturefrac = R_ColumnFracAt(column, yh + 1);
+			drawfunc(bottom);
+		}
+
+		source[i] = column.source;
+		colormap[i] = &column.colormap;
+		frac[i] = R_ColumnFracAt(column, yl);
+		fracstep[i] = column.iscale;
+		mask[i] = (column.textureheight >> FRACBITS) - 1;
+	}
+
+	const int pitch = columns[0].pitch_in_pixels;
+	argb_t* dest = (argb_t*)columns[0].destination + yl * pitch + columns[0].x;
+
+	BLENDFUNC blendfunc(columns);
+
+	for (int count = yh - yl + 1; count > 0; count--)
+	{
+		const uint32_t colors[4] = {
+			colormap[0]->shade(source[0][(frac[0] >> FRACBITS) & mask[0]]),
+			colormap[1]->shade(source[1][(frac[1] >> FRACBITS) & mask[1]]),
+			colormap[2]->shade(source[2][(frac[2] >> FRACBITS) & mask[2]]),
+			colormap[3]->shade(source[3][(frac[3] >> FRACBITS) & mask[3]])
+		};
+
+		blendfunc(vld1q_u32(colors), dest);
+		dest += pitch;
+
+		frac[0] += fracstep[0];
+		frac[1] += fracstep[1];
+		frac[2] += fracstep[2];
+		frac[3] += fracstep[3];
+	}
+}
+
+void R_DrawColumnQuadD_NEON(drawcolumn_t* columns)
+{
+	R_DrawColumnQuadGeneric_NEON<QuadColormapFunc_NEON>(columns, R_DrawColumnD);
+}
+
+void R_DrawTranslucentColumnQuadD_NEON(drawcolumn_t* columns)
+{
+	R_DrawColumnQuadGeneric_NEON<QuadTranslucentColormapFunc_NEON>(columns, R_DrawTranslucentColumnD);
+}
+
+
+void r_dimpatchD_NEON(IWindowSurface* surface, argb_t color, int alpha, int x1, int y1, int w, int h)
+{
+	int surface_pitch_pixels = surface->getPitchInPixels();
+	int line_inc = surface_pitch_pixels - w;
+
+	// NEON temporaries, the same as in r_dimpatchD_SSE2:
+	const uint16x8_t vec_color		= vmovl_u8(vreinterpret_u8_u32(vdup_n_u32(color)));
+	const uint16x8_t vec_alphacolor	= vmulq_n_u16(vec_color, alpha);
+	const uint16x8_t vec_invalpha	= vdupq_n_u16(256 - alpha);
+
+	argb_t* dest = (argb_t*)surface->getBuffer() + y1 * surface_pitch_pixels + x1;
+
+	for (int rowcount = h; rowcount > 0; --rowcount)
+	{
+		const int batch_size = 4;
+		int batches = w / batch_size;
+		int remainder = w & (batch_size - 1);
+
+		// NEON optimize the bulk in batches of 4 pixels:
+		while (batches--)
+		{
+			const uint8x16_t vec_input = vld1q_u8((uint8_t*)dest);
+
+			// ((input * invAlpha) + (color * Alpha)) >> 8
+			uint16x8_t vec_lower = vmovl_u8(vget_low_u8(vec_input));
+			uint16x8_t vec_upper = vmovl_u8(vget_high_u8(vec_input));
+			vec_lower = vmlaq_u16(vec_alphacolor, vec_lower, vec_invalpha);
+			vec_upper = vmlaq_u16(vec_alphacolor, vec_upper, vec_invalpha);
+
+			vst1q_u8((uint8_t*)dest, vcombine_u8(vshrn_n_u16(vec_lower, 8), vshrn_n_u16(vec_upper, 8)));
+
+			dest += batch_size;
+		}
+
+		// Pick up the remainder:
+		while (remainder--)
+		{
+			*dest = alphablend1a(*dest, color, alpha);
+			dest++;
+		}
+
+		dest += line_inc;
+	}
+}
+
+
+VERSION_CONTROL (r_drawt_neon_cpp, "$Id$")
+
+#endif
@@ -55,29 +55,29 @@ static inline uintptr_t R_GetBytesUntilAligned(void* data, uintptr_t alignment)
 }
 
 
-void R_DrawSpanD_SSE2 (void)
+void R_DrawSpanD_SSE2 (drawspan_t& drawspan)
 {
 #ifdef RANGECHECK
-	if (dspan.x2 < dspan.x1 || dspan.x1 < 0 || dspan.x2 >= viewwidth ||
-		dspan.y >= viewheight || dspan.y < 0)
+	if (drawspan.x2 < drawspan.x1 || drawspan.x1 < 0 || drawspan.x2 >= viewwidth ||
+		drawspan.y >= viewheight || drawspan.y < 0)
 	{
-		Printf(PRINT_HIGH, "R_DrawLevelSpan: %i to %i at %i", dspan.x1, dspan.x2, dspan.y);
+		Printf(PRINT_HIGH, "R_DrawLevelSpan: %i to %i at %i", drawspan.x1, drawspan.x2, drawspan.y);
 		return;
 	}
 #endif
 
-	const int width = dspan.x2 - dspan.x1 + 1;
+	const int width = drawspan.x2 - drawspan.x1 + 1;
 
 	// TODO: store flats in column-major format and swap u and v
-	dsfixed_t ufrac = dspan.yfrac;
-	dsfixed_t vfrac = dspan.xfrac;
-	dsfixed_t ustep = dspan.ystep;
-	dsfixed_t vstep = dspan.xstep;
+	dsfixed_t ufrac = drawspan.yfrac;
+	dsfixed_t vfrac = drawspan.xfrac;
+	dsfixed_t ustep = drawspan.ystep;
+	dsfixed_t vstep = drawspan.xstep;
 
-	const byte* source = dspan.source;
-	argb_t* dest = (argb_t*)dspan.destination + dspan.y * dspan.pitch_in_pixels + dspan.x1;
+	const byte* source = drawspan.source;
+	argb_t* dest = (argb_t*)drawspan.destination + drawspan.y * drawspan.pitch_in_pixels + drawspan.x1;
 
-	shaderef_t colormap = dspan.colormap;
+	shaderef_t colormap = drawspan.colormap;
 	
 	const int texture_width_bits = 6, texture_height_bits = 6;
 
@@ -175,32 +175,32 @@ void R_DrawSpanD_SSE2 (void)
 	}
 }
 
-void R_DrawSlopeSpanD_SSE2 (void)
+void R_DrawSlopeSpanD_SSE2 (drawspan_t& drawspan)
 {
-	int count = dspan.x2 - dspan.x1 + 1;
+	int count = drawspan.x2 - drawspan.x1 + 1;
 	if (count <= 0)
 		return;
 
 #ifdef RANGECHECK 
-	if (dspan.x2 < dspan.x1
-		|| dspan.x1 < 0
-		|| dspan.x2 >= I_GetSurfaceWidth()
-		|| dspan.y >= I_GetSurfaceHeight())
+	if (drawspan.x2 < drawspan.x1
+		|| drawspan.x1 < 0
+		|| drawspan.x2 >= I_GetSurfaceWidth()
+		|| drawspan.y >= I_GetSurfaceHeight())
 	{
 		I_Error ("R_DrawSlopeSpan: %i to %i at %i",
-				 dspan.x1, dspan.x2, dspan.y);
+				 drawspan.x1, drawspan.x2, drawspan.y);
 	}
 #endif
 
-	float iu = dspan.iu, iv = dspan.iv;
-	float ius = dspan.iustep, ivs = dspan.ivstep;
-	float id = dspan.id, ids = dspan.idstep;
+	float iu = drawspan.iu, iv = drawspan.iv;
+	float ius = drawspan.iustep, ivs = drawspan.ivstep;
+	float id = drawspan.id, ids = drawspan.idstep;
 	
 	// framebuffer	
-	argb_t* dest = (argb_t*)dspan.destination + dspan.y * dspan.pitch_in_pixels + dspan.x1;
+	argb_t* dest = (argb_t*)drawspan.destination + drawspan.y * drawspan.pitch_in_pixels + drawspan.x1;
 	
 	// texture data
-	byte *src = (byte *)dspan.source;
+	byte *src = (byte *)drawspan.source;
 
 	int ltindex = 0;		// index into the lighting table
 
@@ -231,7 +231,7 @@ void R_DrawSlopeSpanD_SSE2 (void)
 		// Blit up to the first 16-byte aligned position:
 		while ((((size_t)dest) & 15) && (incount > 0))
 		{
-			const shaderef_t &colormap = dspan.slopelighting[ltindex++];
+			const shaderef_t &colormap = drawspan.slopelighting[ltindex++];
 			*dest = colormap.shade(src[((vfrac >> 10) & 0xFC0) | ((ufrac >> 16) & 63)]);
 			dest++;
 			ufrac += ustep;
@@ -252,10 +252,10 @@ void R_DrawSlopeSpanD_SSE2 (void)
 					const int spot3 = (((vfrac+vstep*3) >> 10) & 0xFC0) | (((ufrac+ustep*3) >> 16) & 63);
 
 					const __m128i finalColors = _mm_setr_epi32(
-						dspan.slopelighting[ltindex+0].shade(src[spot0]),
-						dspan.slopelighting[ltindex+1].shade(src[spot1]),
-						dspan.slopelighting[ltindex+2].shade(src[spot2]),
-						dspan.slopelighting[ltindex+3].shade(src[spot3])
+						drawspan.slopelighting[ltindex+0].shade(src[spot0]),
+						drawspan.slopelighting[ltindex+1].shade(src[spot1]),
+						drawspan.slopelighting[ltindex+2].shade(src[spot2]),
+						drawspan.slopelighting[ltindex+3].shade(src[spot3])
 					);
 					_mm_store_si128((__m128i *)dest, finalColors);
 
@@ -272,7 +272,7 @@ void R_DrawSlopeSpanD_SSE2 (void)
 		{
 			while(incount--)
 			{
-				const shaderef_t &colormap = dspan.slopelighting[ltindex++];
+				const shaderef_t &colormap = drawspan.slopelighting[ltindex++];
 				const int spot = ((vfrac >> 10) & 0xFC0) | ((ufrac >> 16) & 63);
 				*dest = colormap.shade(src[spot]);
 				dest++;
@@ -311,7 +311,7 @@ void R_DrawSlopeSpanD_SSE2 (void)
 		int incount = count;
 		while (incount--)
 		{
-			const shaderef_t &colormap = dspan.slopelighting[ltindex++];
+			const shaderef_t &colormap = drawspan.slopelighting[ltindex++];
 			*dest = colormap.shade(src[((vfrac >> 10) & 0xFC0) | ((ufrac >> 16) & 63)]);
 			dest++;
 			ufrac += ustep;
@@ -321,6 +321,172 @@ void R_DrawSlopeSpanD_SSE2 (void)
 }
 
 
+//
+// R_ColumnFracAt
+//
+// Returns the texture position of the column at row y.
+//
+static inline fixed_t R_ColumnFracAt(const drawcolumn_t& column, int y)
+{
+	return (fixed_t)((unsigned int)column.texturefrac + (unsigned int)(y - column.yl) * (unsigned int)column.iscale);
+}
+
+//
+// Functors that write four shaded pixels to the screen.
+//
+class QuadColormapFunc_SSE2
+{
+public:
+	QuadColormapFunc_SSE2(const drawcolumn_t* columns) { }
+
+	forceinline void operator()(const __m128i fg, argb_t* dest) const
+	{
+		_mm_storeu_si128((__m128i*)dest, fg);
+	}
+};
+
+class QuadTranslucentColormapFunc_SSE2
+{
+public:
+	QuadTranslucentColormapFunc_SSE2(const drawcolumn_t* columns)
+	{
+		// same alpha as DirectTranslucentColormapFunc, but one for each column
+		int fga[4], bga[4];
+		for (int i = 0; i < 4; i++)
+		{
+			fga[i] = (columns[i].translevel & ~0x03FF) >> 8;
+			fga[i] = fga[i] > 255 ? 255 : fga[i];
+			bga[i] = 255 - fga[i];
+		}
+
+		fgalpha_lo = _mm_setr_epi16(fga[0], fga[0], fga[0], fga[0], fga[1], fga[1], fga[1], fga[1]);
+		fgalpha_hi = _mm_setr_epi16(fga[2], fga[2], fga[2], fga[2], fga[3], fga[3], fga[3], fga[3]);
+		bgalpha_lo = _mm_setr_epi16(bga[0], bga[0], bga[0], bga[0], bga[1], bga[1], bga[1], bga[1]);
+		bgalpha_hi = _mm_setr_epi16(bga[2], bga[2], bga[2], bga[2], bga[3], bga[3], bga[3], bga[3]);
+		opaque = _mm_set1_epi32(argb_t(255, 0, 0, 0));
+	}
+
+	forceinline void operator()(const __m128i fg, argb_t* dest) const
+	{
+		const __m128i bg = _mm_loadu_si128((__m128i*)dest);
+
+		// (bg * bga + fg * fga) >> 8 for each channel, as alphablend2a
+		__m128i lower = _mm_add_epi16(
+				_mm_mullo_epi16(_mm_unpacklo_epi8(bg, _mm_setzero_si128()), bgalpha_lo),
+				_mm_mullo_epi16(_mm_unpacklo_epi8(fg, _mm_setzero_si128()), fgalpha_lo));
+		__m128i upper = _mm_add_epi16(
+				_mm_mullo_epi16(_mm_unpackhi_epi8(bg, _mm_setzero_si128()), bgalpha_hi),
+				_mm_mullo_epi16(_mm_unpackhi_epi8(fg, _mm_setzero_si128()), fgalpha_hi));
+
+		lower = _mm_srli_epi16(lower, 8);
+		upper = _mm_srli_epi16(upper, 8);
+
+		_mm_storeu_si128((__m128i*)dest, _mm_or_si128(_mm_packus_epi16(lower, upper), opaque));
+	}
+
+private:
+	__m128i fgalpha_lo, fgalpha_hi;
+	__m128i bgalpha_lo, bgalpha_hi;
+	__m128i opaque;
+};
+
+//
+// R_DrawColumnQuadGeneric_SSE2
+//
+// Draws four adjacent columns. The rows above and below the ones shared by all
+// four columns are drawn a column at a time with drawfunc. The shared rows are
+// drawn four pixels at a time, so that each row takes a single store.
+//
+template<typename BLENDFUNC>
+static forceinline void R_DrawColumnQuadGeneric_SSE2(drawcolumn_t* columns, void (*drawfunc)(drawcolumn_t&))
+{
+	int yl = columns[0].yl, yh = columns[0].yh;
+	bool pow2 = true;
+
+	for (int i = 0; i < 4; i++)
+	{
+		yl = MAX(yl, columns[i].yl);
+		yh = MIN(yh, columns[i].yh);
+
+		const int texheight = columns[i].textureheight;
+		if (texheight & (texheight - 1))
+			pow2 = false;
+	}
+
+	// [SL] Textures whose heights are not a power-of-2 need to wrap around
+	// one row at a time, so leave them to the regular drawer.
+	if (!pow2 || yh - yl < 4)
+	{
+		for (int i = 0; i < 4; i++)
+			drawfunc(columns[i]);
+		return;
+	}
+
+	const palindex_t* source[4];
+	const shaderef_t* colormap[4];
+	fixed_t frac[4], fracstep[4];
+	int mask[4];
+
+	for (int i = 0; i < 4; i++)
+	{
+		const drawcolumn_t& column = columns[i];
+
+		if (column.yl < yl)
+		{
+			drawcolumn_t top = column;
+			top.yh = yl - 1;
+			drawfunc(top);
+		}
+
+		if (column.yh > yh)
+		{
+			drawcolumn_t bottom = column;
+			bottom.yl = yh + 1;
+			bottom.texturefrac = R_ColumnFracAt(column, yh + 1);
+			drawfunc(bottom);
+		}
+
+		source[i] = column.source;
+		colormap[i] = &column.colormap;
+		frac[i] = R_ColumnFracAt(column, yl);
+		fracstep[i] = column.iscale;
+		mask[i] = (column.textureheight >> FRACBITS) - 1;
+	}
+
+	const int pitch = columns[0].pitch_in_pixels;
+	argb_t* dest = (argb_t*)columns[0].destination + yl * pitch + columns[0].x;
+
+	BLENDFUNC blendfunc(columns);
+
+	for (int count = yh - yl + 1; count > 0; count--)
+	{
+		const __m128i fg = _mm_setr_epi32(
+				colormap[0]->shade(source[0][(frac[0] >> FRACBITS) & mask[0]]),
+				colormap[1]->shade(source[1][(frac[1] >> FRACBITS) & mask[1]]),
+				colormap[2]->shade(source[2][(frac[2] >> FRACBITS) & mask[2]]),
+				colormap[3]->shade(source[3][(frac[3] >> FRACBITS) & mask[3]]));
+
+		blendfunc(fg, dest);
+		dest += pitch;
+
+		frac[0] += fracstep[0];
+		frac[1] += fracstep[1];
+		frac[2] += fracstep[2];
+		frac[3] += fracstep[3];
+	}
+}
+
+void R_DrawColumnQuadD_SSE2(drawcolumn_t* columns)
+{
+	R_DrawColumnQuadGeneric_SSE2<QuadColormapFunc_SSE2>(columns, R_DrawColumnD);
+}
+
+void R_DrawTranslucentColumnQuadD_SSE2(drawcolumn_t* columns)
+{
+	R_DrawColumnQuadGeneric_SSE2<QuadTranslucentColormapFunc_SSE2>(columns, R_DrawTranslucentColumnD);
+}
+
+
 void r_dimpatchD_SSE2(IWindowSurface* surface, argb_t color, int alpha, int x1, int y1, int w, int h)
 {
 	int surface_pitch_pixels = surface->getPitchInPixels();
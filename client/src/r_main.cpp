@@ -37,6 +37,7 @@
 #include "v_video.h"
 #include "stats.h"
 #include "z_zone.h"
+#include "i_system.h"
 #include "i_video.h"
 #include "m_vectors.h"
 #include "am_map.h"
@@ -138,9 +139,9 @@ static argb_t sector_blend_color(0, 255, 255, 255);
 // [SL] Current color blending values (including palette effects)
 fargb_t blend_color(0.0f, 255.0f, 255.0f, 255.0f);
 
-void (*colfunc) (void);
-void (*spanfunc) (void);
-void (*spanslopefunc) (void);
+void (*colfunc) (drawcolumn_t&);
+void (*spanfunc) (drawspan_t&);
+void (*spanslopefunc) (drawspan_t&);
 
 // [AM] Number of fineangles in a default 90 degree FOV at a 4:3 resolution.
 int FieldOfView = 2048;
@@ -148,6 +149,9 @@ int CorrectFieldOfView = 2048;
 
 fixed_t			render_lerp_amount;
 
+bool			r_timephases = false;
+dtime_t			r_phasetime[NUMRENDERPHASES];
+
 static void R_InitViewWindow();
 
 IWindowSurface* screenblocks_surface;
@@ -509,6 +513,9 @@ static inline void R_DrawPixel(int x, int y, byte color)
 //
 void R_DrawLine(const v3fixed_t* inpt1, const v3fixed_t* inpt2, byte color)
 {
+	// the line is drawn straight to the screen, after what was queued
+	R_FlushDrawQueue();
+
 	// convert from world-space to camera-space
 	v3fixed_t pt1, pt2;
 	R_RotatePoint(inpt1->x - viewx, inpt1->y - viewy, ANG90 - viewangle, pt1.x, pt1.y);
@@ -642,6 +649,7 @@ void R_Init()
 //
 void STACK_ARGS R_Shutdown()
 {
+    R_ShutdownDrawQueue();
     R_FreeTranslationTables();
     I_FreeSurface(screenblocks_surface);
     I_FreeSurface(scaled_screenblocks_surface);
@@ -1049,6 +1057,16 @@ void R_RenderPlayerView(player_t* player)
 
 	R_BeginInterpolation(render_lerp_amount);
 
+	R_BeginDrawQueue();
+
+	dtime_t phasestart = 0;
+	if (r_timephases)
+	{
+		for (int i = 0; i < NUMRENDERPHASES; i++)
+			r_phasetime[i] = 0;
+		phasestart = I_GetTime();
+	}
+
 	// [RH] Setup particles for this frame
 	R_FindParticleSubsectors();
 
@@ -1064,10 +1082,37 @@ void R_RenderPlayerView(player_t* player)
 	else
 		R_RenderBSPNode(numnodes - 1);	// The head node is the last node output.
 
+	if (r_timephases)
+	{
+		// R_StoreWallRange has added up the time spent on wall columns
+		dtime_t now = I_GetTime();
+		r_phasetime[RPHASE_BSP] = now - phasestart - r_phasetime[RPHASE_WALLS];
+		phasestart = now;
+
+		// the queue holds nothing but the wall columns at this point
+		R_FlushDrawQueue();
+		now = I_GetTime();
+		r_phasetime[RPHASE_WALLS] += now - phasestart;
+		phasestart = now;
+	}
+
 	R_DrawPlanes();
 
+	if (r_timephases)
+	{
+		R_FlushDrawQueue();
+		const dtime_t now = I_GetTime();
+		r_phasetime[RPHASE_PLANES] = now - phasestart;
+		phasestart = now;
+	}
+
 	R_DrawMasked();
 
+	R_EndDrawQueue();
+
+	if (r_timephases)
+		r_phasetime[RPHASE_MASKED] = I_GetTime() - phasestart;
+
 	// NOTE(jsd): Full-screen status color blending:
 	int blend_alpha = int(blend_color.geta() * 255.0f);
 	if (surface->getBitsPerPixel() == 32 && blend_alpha > 0)
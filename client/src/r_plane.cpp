@@ -21,6 +21,10 @@
 //	while maintaining a per column clipping list only.
 //	Moreover, the sky areas have to be determined.
 //
+//	The planes are drawn sorted by flat, and the planes R_CheckPlane split
+//	from the same one are drawn together so that a span of one that starts
+//	where a span of another ends on the same row is drawn as one span.
+//
 //		MAXVISPLANES is no longer a limit on the number of visplanes,
 //		but a limit on the number of hash slots; larger numbers mean
 //		better performance usually but after a point they are wasted,
@@ -35,6 +39,8 @@
 
 #include <stdlib.h>
 #include <math.h>
+#include <algorithm>
+#include <vector>
 
 #include "z_zone.h"
 #include "w_wad.h"
@@ -67,6 +73,12 @@ visplane_t 				*floorplane;
 visplane_t 				*ceilingplane;
 visplane_t				*skyplane;
 
+// the group given to the next plane R_FindPlane creates
+static int				nextplanegroup;
+
+// the planes with a flat, in the order they are drawn
+static std::vector<visplane_t*> drawplanes;
+
 // killough -- hash function for visplanes
 // Empirically verified to be fairly uniform:
 
@@ -89,6 +101,16 @@ int						*ceilingclipinitial;
 //
 int 					*spanstart;
 
+//
+// The span of the plane group being drawn that has not been drawn yet on
+// each row, from pendingx1 to pendingx2, or none if pendingx2 is -1.
+// pendingrows lists the rows that have one.
+//
+static int				*pendingx1;
+static int				*pendingx2;
+static int				*pendingrows;
+static int				numpendingrows;
+
 //
 // texture mapping
 //
@@ -110,6 +132,9 @@ static fixed_t			pl_xstepscale, pl_ystepscale;
 v3float_t				a, b, c;
 float					ixscale, iyscale;
 
+// light levels for each pixel of a sloped span
+static shaderef_t		slopelighting[MAXWIDTH];
+
 //
 // R_InitPlanes
 // Only at game startup.
@@ -156,12 +181,12 @@ void R_MapSlopedPlane(int y, int x1, int x2)
 	if (fixedlightlev)
 	{
 		for (int i = 0; i < len; i++)
-			dspan.slopelighting[i] = basecolormap.with(fixedlightlev);
+			slopelighting[i] = basecolormap.with(fixedlightlev);
 	}
 	else if (fixedcolormap.isValid())
 	{
 		for (int i = 0; i < len; i++)
-			dspan.slopelighting[i] = fixedcolormap;
+			slopelighting[i] = fixedcolormap;
 	}
 	else
 	{
@@ -178,11 +203,11 @@ void R_MapSlopedPlane(int y, int x1, int x2)
 			index -= (foggy ? 0 : extralight << 2);
 			
 			if (index < 0)
-				dspan.slopelighting[i] = basecolormap;
+				slopelighting[i] = basecolormap;
 			else if (index >= NUMCOLORMAPS)
-				dspan.slopelighting[i] = basecolormap.with((NUMCOLORMAPS - 1));
+				slopelighting[i] = basecolormap.with((NUMCOLORMAPS - 1));
 			else
-				dspan.slopelighting[i] = basecolormap.with(index);
+				slopelighting[i] = basecolormap.with(index);
 			
 			map += step;
 		}
@@ -191,8 +216,9 @@ void R_MapSlopedPlane(int y, int x1, int x2)
    	dspan.y = y;
 	dspan.x1 = x1;
 	dspan.x2 = x2;
+	dspan.slopelighting = slopelighting;
 
-	spanslopefunc();
+	R_DispatchSpan(spanslopefunc, dspan, true);
 }
 
 
@@ -246,7 +272,57 @@ void R_MapLevelPlane(int y, int x1, int x2)
 	dspan.x1 = x1;
 	dspan.x2 = x2;
 
-	spanfunc();
+	R_DispatchSpan(spanfunc, dspan);
+}
+
+//
+// R_MergeLevelSpan
+//
+// Holds on to a span of a level plane until it can not be joined with the
+// next span on its row.  The texture coordinates of a level plane only
+// depend on the position on the screen, so the joined span draws exactly
+// what the two spans would have.
+//
+static void R_MergeLevelSpan(int y, int x1, int x2)
+{
+	if (pendingx2[y] < 0)
+	{
+		pendingrows[numpendingrows++] = y;
+	}
+	else if (pendingx2[y] + 1 == x1)
+	{
+		pendingx2[y] = x2;
+		return;
+	}
+	else if (x2 + 1 == pendingx1[y])
+	{
+		pendingx1[y] = x1;
+		return;
+	}
+	else
+	{
+		R_MapLevelPlane(y, pendingx1[y], pendingx2[y]);
+	}
+
+	pendingx1[y] = x1;
+	pendingx2[y] = x2;
+}
+
+//
+// R_FlushLevelSpans
+//
+// Draws the spans R_MergeLevelSpan is holding on to.
+//
+static void R_FlushLevelSpans()
+{
+	for (int i = 0; i < numpendingrows; i++)
+	{
+		const int y = pendingrows[i];
+		R_MapLevelPlane(y, pendingx1[y], pendingx2[y]);
+		pendingx2[y] = -1;
+	}
+
+	numpendingrows = 0;
 }
 
 //
@@ -262,6 +338,8 @@ void R_ClearPlanes (void)
 	for (int i = 0; i < MAXVISPLANES; i++)	// new code -- killough
 		for (*freehead = visplanes[i], visplanes[i] = NULL; *freehead; )
 			freehead = &(*freehead)->next;
+
+	nextplanegroup = 0;
 }
 
 //
@@ -286,6 +364,19 @@ static visplane_t *new_visplane(unsigned hash)
 	return check;
 }
 
+//
+// R_ClearPlaneColumns
+//
+// Marks the columns x1 through x2 of a plane as having nothing to draw.
+// Only the columns between minx and maxx are ever looked at, so a plane's
+// columns are cleared as it grows rather than all at once.
+//
+static inline void R_ClearPlaneColumns(visplane_t* pl, int x1, int x2)
+{
+	if (x1 <= x2)
+		memcpy(pl->top + x1, viewheightarray + x1, (x2 - x1 + 1) * sizeof(*pl->top));
+}
+
 
 //
 // R_FindPlane
@@ -329,11 +420,10 @@ visplane_t *R_FindPlane (plane_t secplane, int picnum, int lightlevel,
 	check->yscale = yscale;
 	check->angle = angle;
 	check->colormap = basecolormap;		// [RH] Save colormap
+	check->group = nextplanegroup++;
 	check->minx = viewwidth;			// Was SCREENWIDTH -- killough 11/98
 	check->maxx = -1;
 
-	memcpy(check->top, viewheightarray, viewwidth * sizeof(*check->top));
-
 	return check;
 }
 
@@ -376,6 +466,16 @@ visplane_t* R_CheckPlane(visplane_t* pl, int start, int stop)
 	if (x > intrh)
 	{
 		// use the same visplane
+		if (pl->minx > pl->maxx)
+		{
+			R_ClearPlaneColumns(pl, start, stop);
+		}
+		else
+		{
+			R_ClearPlaneColumns(pl, unionl, pl->minx - 1);
+			R_ClearPlaneColumns(pl, pl->maxx + 1, unionh);
+		}
+
 		pl->minx = unionl;
 		pl->maxx = unionh;
 	}
@@ -394,10 +494,11 @@ visplane_t* R_CheckPlane(visplane_t* pl, int start, int stop)
 		new_pl->yscale = pl->yscale;
 		new_pl->angle = pl->angle;
 		new_pl->colormap = pl->colormap;	// [RH] Copy colormap
+		new_pl->group = pl->group;
 		pl = new_pl;
 		pl->minx = start;
 		pl->maxx = stop;
-		memcpy(pl->top, viewheightarray, viewwidth * sizeof(*pl->top));
+		R_ClearPlaneColumns(pl, start, stop);
 	}
 	return pl;
 }
@@ -579,9 +680,77 @@ void R_DrawLevelPlane(visplane_t *pl)
 	int light = clamp((pl->lightlevel >> LIGHTSEGSHIFT) + (foggy ? 0 : extralight), 0, LIGHTLEVELS - 1);
 	planezlight = zlight[light];
 
-	R_MakeSpans(pl, R_MapLevelPlane);
+	R_MakeSpans(pl, R_MergeLevelSpan);
+}
+
+
+//
+// R_PlaneDrawOrder
+//
+// Sorts the planes by flat, keeping the planes of a group together.
+//
+static bool R_PlaneDrawOrder(const visplane_t* a, const visplane_t* b)
+{
+	if (a->picnum != b->picnum)
+		return a->picnum < b->picnum;
+	return a->group < b->group;
 }
 
+//
+// R_CacheFlat
+//
+// Sets dspan.source to the flat to draw for picnum, warping it if needed.
+// The caller changes its tag to PU_CACHE when done with it.
+//
+static void R_CacheFlat(int picnum)
+{
+	int useflatnum = flattranslation[picnum < numflats ? picnum : 0];
+
+	dspan.source = (byte *)W_CacheLumpNum (firstflat + useflatnum, PU_STATIC);
+
+	// [RH] warp a flat if desired
+	if (flatwarp[useflatnum])
+	{
+		if (warpedflats[useflatnum] && flatwarpedwhen[useflatnum] == level.time)
+		{
+			Z_ChangeTag(dspan.source, PU_CACHE);
+			dspan.source = warpedflats[useflatnum];
+			Z_ChangeTag(dspan.source, PU_STATIC);
+		}
+		else
+		{
+			if (!warpedflats[useflatnum])
+				warpedflats[useflatnum] = (byte*)Z_Malloc(64*64, PU_STATIC, &warpedflats[useflatnum]);
+
+			static byte buffer[64];
+			int timebase = level.time*23;
+
+			flatwarpedwhen[useflatnum] = level.time;
+			byte *warped = warpedflats[useflatnum];
+
+			for (int x = 63; x >= 0; x--)
+			{
+				int yt, yf = (finesine[(timebase + ((x+17) << 7))&FINEMASK]>>13) & 63;
+				byte *source = dspan.source + x;
+				byte *dest = warped + x;
+				for (yt = 64; yt; yt--, yf = (yf+1)&63, dest += 64)
+					*dest = *(source + (yf << 6));
+			}
+			timebase = level.time*32;
+			for (int y = 63; y >= 0; y--)
+			{
+				int xt, xf = (finesine[(timebase + (y << 7))&FINEMASK]>>13) & 63;
+				byte *source = warped + (y << 6);
+				byte *dest = buffer;
+				for (xt = 64; xt; xt--, xf = (xf+1) & 63)
+					*dest++ = *(source+xf);
+				memcpy (warped + (y << 6), buffer, 64);
+			}
+			Z_ChangeTag (dspan.source, PU_CACHE);
+			dspan.source = warped;
+		}
+	}
+}
 
 //
 // R_DrawPlanes
@@ -590,87 +759,55 @@ void R_DrawLevelPlane(visplane_t *pl)
 //
 void R_DrawPlanes (void)
 {
-	visplane_t *pl;
-	int i;
-
 	R_ResetDrawFuncs();
 
 	dspan.color = 3;
-	
-	for (i = 0; i < MAXVISPLANES; i++)
+
+	drawplanes.clear();
+
+	for (int i = 0; i < MAXVISPLANES; i++)
 	{
-		for (pl = visplanes[i]; pl; pl = pl->next)
+		for (visplane_t* pl = visplanes[i]; pl; pl = pl->next)
 		{
 			if (pl->minx > pl->maxx)
 				continue;
 
 			// sky flat
 			if (pl->picnum == skyflatnum || pl->picnum & PL_SKYFLAT)
-			{
 				R_RenderSkyRange(pl);
-			}
 			else
-			{
-				// regular flat
-				int useflatnum = flattranslation[pl->picnum < numflats ? pl->picnum : 0];
-
-				dspan.color += 4;	// [RH] color if r_drawflat is 1
-				dspan.source = (byte *)W_CacheLumpNum (firstflat + useflatnum, PU_STATIC);
-										   
-				// [RH] warp a flat if desired
-				if (flatwarp[useflatnum])
-				{
-					if (warpedflats[useflatnum] && flatwarpedwhen[useflatnum] == level.time)
-					{
-						Z_ChangeTag(dspan.source, PU_CACHE);
-						dspan.source = warpedflats[useflatnum];
-						Z_ChangeTag(dspan.source, PU_STATIC);
-					}
-					else
-					{
-						if (!warpedflats[useflatnum])
-							warpedflats[useflatnum] = (byte*)Z_Malloc(64*64, PU_STATIC, &warpedflats[useflatnum]);
-
-						static byte buffer[64];
-						int timebase = level.time*23;
-
-						flatwarpedwhen[useflatnum] = level.time;
-						byte *warped = warpedflats[useflatnum];
-
-						for (int x = 63; x >= 0; x--)
-						{
-							int yt, yf = (finesine[(timebase + ((x+17) << 7))&FINEMASK]>>13) & 63;
-							byte *source = dspan.source + x;
-							byte *dest = warped + x;
-							for (yt = 64; yt; yt--, yf = (yf+1)&63, dest += 64)
-								*dest = *(source + (yf << 6));
-						}
-						timebase = level.time*32;
-						for (int y = 63; y >= 0; y--)
-						{
-							int xt, xf = (finesine[(timebase + (y << 7))&FINEMASK]>>13) & 63;
-							byte *source = warped + (y << 6);
-							byte *dest = buffer;
-							for (xt = 64; xt; xt--, xf = (xf+1) & 63)
-								*dest++ = *(source+xf);
-							memcpy (warped + (y << 6), buffer, 64);
-						}
-						Z_ChangeTag (dspan.source, PU_CACHE);
-						dspan.source = warped;
-					}
-				}
-				
-				pl->top[pl->maxx+1] = viewheight;
-				pl->top[pl->minx-1] = viewheight;
-
-				if (P_IsPlaneLevel(&pl->secplane))
-					R_DrawLevelPlane(pl);
-				else
-					R_DrawSlopedPlane(pl);
-					
-				Z_ChangeTag (dspan.source, PU_CACHE);
-			}
+				drawplanes.push_back(pl);
+		}
+	}
+
+	std::sort(drawplanes.begin(), drawplanes.end(), R_PlaneDrawOrder);
+
+	for (size_t first = 0, last; first < drawplanes.size(); first = last)
+	{
+		const int group = drawplanes[first]->group;
+		for (last = first + 1; last < drawplanes.size() && drawplanes[last]->group == group; last++)
+			;
+
+		// regular flat
+		dspan.color += 4;	// [RH] color if r_drawflat is 1
+		R_CacheFlat(drawplanes[first]->picnum);
+
+		for (size_t i = first; i < last; i++)
+		{
+			visplane_t* pl = drawplanes[i];
+
+			pl->top[pl->maxx+1] = viewheight;
+			pl->top[pl->minx-1] = viewheight;
+
+			if (P_IsPlaneLevel(&pl->secplane))
+				R_DrawLevelPlane(pl);
+			else
+				R_DrawSlopedPlane(pl);
 		}
+
+		R_FlushLevelSpans();
+
+		Z_ChangeTag (dspan.source, PU_CACHE);
 	}
 }
 
@@ -687,6 +824,9 @@ bool R_PlaneInitData(IWindowSurface* surface)
 	delete[] floorclipinitial;
 	delete[] ceilingclipinitial;
 	delete[] spanstart;
+	delete[] pendingx1;
+	delete[] pendingx2;
+	delete[] pendingrows;
 	delete[] yslope;
 
 	floorclip = new int[surface_width];
@@ -703,6 +843,14 @@ bool R_PlaneInitData(IWindowSurface* surface)
 	spanstart = new int[surface_height];
 	yslope = new fixed_t[surface_height];
 
+	pendingx1 = new int[surface_height];
+	pendingx2 = new int[surface_height];
+	pendingrows = new int[surface_height];
+	numpendingrows = 0;
+
+	for (int i = 0; i < surface_height; i++)
+		pendingx2[i] = -1;
+
 	// Free all visplanes and let them be re-allocated as needed.
 	visplane_t* pl = freetail;
 
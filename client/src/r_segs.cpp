@@ -183,7 +183,7 @@ static void R_FillWallHeightArray(
 //
 // R_BlastMaskedSegColumn
 //
-static inline void R_BlastMaskedSegColumn(void (*drawfunc)())
+static inline void R_BlastMaskedSegColumn(void (*drawfunc)(drawcolumn_t&))
 {
 	tallpost_t* post = dcol.post;
 
@@ -225,7 +225,7 @@ static inline void R_BlastMaskedSegColumn(void (*drawfunc)())
 			dcol.source = post->data();
 
 			if (dcol.yl >= 0 && dcol.yh < viewheight && dcol.yl <= dcol.yh)
-				drawfunc();
+				R_DispatchColumn(drawfunc, dcol);
 
 			post = post->next();
 		}
@@ -239,11 +239,13 @@ static inline void R_BlastMaskedSegColumn(void (*drawfunc)())
 //
 // R_BlastSolidSegColumn
 //
-static inline void R_BlastSolidSegColumn(void (*drawfunc)())
+static inline void R_BlastSolidSegColumn(void (*drawfunc)(drawcolumn_t&))
 {
 	if (wallscalex[dcol.x] <= 0)
 		return;
 
+	int tempsource = 0;
+
 	if (dcol.post->length != dcol.textureheight >> FRACBITS)
 	{
 		int count = dcol.textureheight >> FRACBITS;
@@ -287,6 +289,7 @@ static inline void R_BlastSolidSegColumn(void (*drawfunc)())
 		destpost->next()->writeend();
 
 		dcol.post = destpost;
+		tempsource = count;
 	}
 
 	dcol.iscale = 0xffffffffu / unsigned(wallscalex[dcol.x]);
@@ -295,7 +298,7 @@ static inline void R_BlastSolidSegColumn(void (*drawfunc)())
 	dcol.texturefrac = dcol.texturemid + FixedMul((dcol.yl - centery + 1) << FRACBITS, dcol.iscale);
 
 	if (dcol.yl <= dcol.yh)
-		drawfunc();
+		R_DispatchColumn(drawfunc, dcol, tempsource);
 }
 
 inline void SolidColumnBlaster()
@@ -1112,7 +1115,16 @@ void R_StoreWallRange(int start, int stop)
 
 	didsolidcol = false;
 
-	R_RenderSolidSegRange(start, stop);
+	if (r_timephases)
+	{
+		const dtime_t wallstart = I_GetTime();
+		R_RenderSolidSegRange(start, stop);
+		r_phasetime[RPHASE_WALLS] += I_GetTime() - wallstart;
+	}
+	else
+	{
+		R_RenderSolidSegRange(start, stop);
+	}
 
 	// [SL] save full clipping info for masked midtextures
 	// cph - if a column was made solid by this wall, we _must_ save full clipping info
@@ -135,7 +135,7 @@ int*			mceilingclip;
 fixed_t 		spryscale;
 fixed_t 		sprtopscreen;
 
-void R_BlastSpriteColumn(void (*drawfunc)())
+void R_BlastSpriteColumn(void (*drawfunc)(drawcolumn_t&))
 {
 	tallpost_t* post = dcol.post;
 
@@ -172,7 +172,7 @@ void R_BlastSpriteColumn(void (*drawfunc)())
 		dcol.source = post->data();
 
 		if (dcol.yl >= 0 && dcol.yh < viewheight && dcol.yl <= dcol.yh)
-			drawfunc();
+			R_DispatchColumn(drawfunc, dcol);
 
 		post = post->next();
 	}
@@ -1197,7 +1197,7 @@ void R_DrawParticle(vissprite_t* vis)
 	dspan.color = vis->startfrac;
 
 	for (dspan.y = y1; dspan.y <= y2; dspan.y++)
-		R_FillTranslucentSpan();
+		R_DispatchSpan(R_FillTranslucentSpan, dspan);
 }
 
 VERSION_CONTROL (r_things_cpp, "$Id$")
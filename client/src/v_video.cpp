@@ -133,6 +133,8 @@ static IVideoMode V_GetRequestedVideoMode()
 {
 	int surface_bpp = vid_32bpp ? 32 : 8;
 	EWindowMode window_mode = (EWindowMode)vid_fullscreen.asInt();
+	if (I_IsHeadless())
+		window_mode = WINDOW_Windowed;	// there is no window to make full screen
 	bool vsync = (vid_vsync != 0.0f);
 	const std::string stretch_mode(vid_filter);
 
@@ -323,6 +323,14 @@ struct baseline_t
 	static const uint32_t MOMY = BIT(10);
 	static const uint32_t MOMZ = BIT(11);
 
+	// Tracked updates carry a tag from 1 to MAX_TAG so a later update can be
+	// sent relative to a state the client acknowledged.  Clients remember the
+	// last HISTORY tracked states of each actor, and the server sends a full
+	// update against the spawn baseline every KEYFRAME updates.
+	static const uint32_t MAX_TAG = 127;
+	static const uint32_t HISTORY = 8;
+	static const uint32_t KEYFRAME = 16;
+
 	baseline_t()
 	    : angle(0), targetid(0), tracerid(0), movecount(0), movedir(0), rndindex(0)
 	{
@@ -349,6 +357,17 @@ struct baseline_t
 	}
 };
 
+// Where an actor's touching_sectorlist was last worked out, so
+// P_CreateSecNodeList can keep it while the actor only moves a little.
+struct secnodecache_t
+{
+	fixed_t			x, y;
+	fixed_t			radius;
+	fixed_t			margin;			// moves shorter than this keep the list
+	struct sector_s	*sector;
+	unsigned int	polychanges;	// polychangecount when worked out
+};
+
 // Map Object definition.
 class AActor : public DThinker
 {
@@ -524,6 +543,7 @@ public:
 
 	// a linked list of sectors where this object appears
 	struct msecnode_s	*touching_sectorlist;				// phares 3/14/98
+	secnodecache_t		secnodecache;
 
 	short           deadtic;        // tics after player's death
 	int             oldframe;
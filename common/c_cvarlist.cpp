@@ -388,6 +388,20 @@ CVAR_RANGE_FUNC_DECL(sv_splashfactor, "1.0", "Rocket explosion thrust effect?",
 					CVARTYPE_FLOAT, CVAR_ARCHIVE | CVAR_SERVERINFO | CVAR_NOENABLEDISABLE,
 					0.01f, 100.0f)
 
+CVAR_RANGE(			sv_sightmatrix, "0", "Work out which sectors can never see each other on maps without a REJECT " \
+					"table when the level is loaded\n" \
+					"// 0 - Off\n" \
+					"// 1 - Skip sight checks between those sectors\n" \
+					"// 2 - Run every sight check and report sector pairs that were wrongly left out",
+					CVARTYPE_BYTE, CVAR_SERVERARCHIVE | CVAR_SERVERINFO | CVAR_LATCH | CVAR_NOENABLEDISABLE,
+					0.0f, 2.0f)
+
+CVAR_RANGE(			sv_aithreads, "0", "Work out the sight checks monsters are about to make before each tic\n" \
+					"// 0 - Off, all monster logic runs on the main thread\n" \
+					"// 1 or more - Number of extra threads the server uses for them, the client works them out on " \
+					"the main thread so demos can check the answers",
+					CVARTYPE_INT, CVAR_SERVERARCHIVE | CVAR_NOENABLEDISABLE, 0.0f, 16.0f)
+
 CVAR(               cl_waddownloaddir, "", "Set custom WAD download directory",
 					CVARTYPE_STRING, CVAR_CLIENTARCHIVE | CVAR_NOENABLEDISABLE)
 
@@ -404,6 +418,12 @@ CVAR(				developer, "0", "Debugging mode",
 CVAR(debug_disconnect, "0", "Show source file:line where a disconnect happens",
      CVARTYPE_BOOL, CVAR_CLIENTARCHIVE)
 
+CVAR(debug_zone, "0",
+     "Allocate zone memory block by block on the system heap and track it in a map, "
+     "so memory debuggers like valgrind can check it.  Only affects allocations made "
+     "after it is set.",
+     CVARTYPE_BOOL, CVAR_NULL)
+
 CVAR_FUNC_DECL(		language, "auto", "Language to use for ingame strings",
 					CVARTYPE_STRING, CVAR_ARCHIVE | CVAR_NOENABLEDISABLE)
 
@@ -39,9 +39,10 @@
 void COM_PushToast(const toast_t& toast)
 {
 #if defined(SERVER_APP)
+	const EncodedSVC msg(SVC_Toast(toast));
 	for (Players::iterator it = ::players.begin(); it != ::players.end(); ++it)
 	{
-		MSG_WriteSVC(&it->client.reliablebuf, SVC_Toast(toast));
+		MSG_WriteSVC(&it->client.reliablebuf, msg);
 	}
 #else
 	hud::PushToast(toast);
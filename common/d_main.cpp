@@ -49,6 +49,7 @@
 #include "m_fileio.h"
 #include "c_console.h"
 #include "i_system.h"
+#include "i_net.h"
 #include "g_game.h"
 #include "g_spawninv.h"
 #include "r_main.h"
@@ -1106,7 +1107,11 @@ void STACK_ARGS D_ClearTaskSchedulers()
 // be called as often as possible. After each iteration through the loop,
 // the program yields briefly to the operating system.
 //
-void D_RunTics(void (*sim_func)(), void(*display_func)())
+// If a network function is given, the program instead waits on the network
+// socket until the next scheduled task and calls the function as soon as a
+// packet arrives, so packets don't wait for the next tic to be read.
+//
+void D_RunTics(void (*sim_func)(), void(*display_func)(), void (*net_func)())
 {
 	D_InitTaskSchedulers(sim_func, display_func);
 
@@ -1135,6 +1140,16 @@ void D_RunTics(void (*sim_func)(), void(*display_func)())
 	dtime_t display_wake_time = display_scheduler->getNextTime();
 	dtime_t wake_time = std::min<dtime_t>(simulation_wake_time, display_wake_time);
 
+	if (net_func)
+	{
+		for (dtime_t now = I_GetTime(); wake_time > now; now = I_GetTime())
+		{
+			if (NET_WaitForPacket(wake_time - now))
+				net_func();
+		}
+		return;
+	}
+
 	const dtime_t max_sleep_amount = 1000LL * 1000LL;	// 1ms
 
 	// Sleep in 1ms increments until the next scheduled task
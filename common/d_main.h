@@ -66,7 +66,7 @@ extern OWantFiles missingfiles;
 extern bool capfps;
 extern float maxfps;
 void STACK_ARGS D_ClearTaskSchedulers();
-void D_RunTics(void (*sim_func)(), void(*display_func)());
+void D_RunTics(void (*sim_func)(), void(*display_func)(), void (*net_func)() = NULL);
 
 void D_AddWadCommandLineFiles(OWantFiles& out);
 void D_AddDehCommandLineFiles(OWantFiles& out);
@@ -24,6 +24,7 @@
 #pragma once
 
 #include <list>
+#include <map>
 #include <queue>
 
 #include <time.h>
@@ -269,23 +270,46 @@ public:
 	// denis - client structure is here now for a 1:1
 	struct client_t
 	{
+		// Where the reliable part of a recent packet is kept in
+		// oldpacketdata, in case it has to be resent.
 		struct oldPacket_t
 		{
 			int		sequence;
-			buf_t	data;
+			size_t	offset;
+			size_t	size;
 
-			oldPacket_t() : sequence(-1)
-			{
-				data.resize(0);
-			}
+			oldPacket_t() : sequence(-1), offset(0), size(0) { }
+		};
 
-			oldPacket_t(const oldPacket_t& other)
-			{
-				sequence = other.sequence;
-				data = other.data;
-			}
+		// Actor updates that are sent relative to a state the client
+		// acknowledged instead of the spawn baseline.
+		struct mobjDelta_t
+		{
+			unsigned int sent;  // count of the last tracked update sent
+			unsigned int acked; // count of the newest acknowledged update
+			unsigned int floor; // updates at or below this count are stale
+			baseline_t ackedstate;
+
+			mobjDelta_t() : sent(0), acked(0), floor(0) { }
 		};
 
+		struct mobjSent_t
+		{
+			uint32_t netid;
+			unsigned int count;
+			baseline_t state;
+		};
+
+		struct sentMobjs_t
+		{
+			int sequence;
+			std::vector<mobjSent_t> mobjs;
+
+			sentMobjs_t() : sequence(-1) { }
+		};
+
+		typedef std::map<uint32_t, mobjDelta_t> MobjDeltas;
+
 		netadr_t    address;
 
 		buf_t       netbuf;
@@ -297,6 +321,8 @@ public:
 
 		// for reliable protocol
 		oldPacket_t oldpackets[256];
+		std::vector<byte> oldpacketdata; // ring that grows with reliable traffic
+		size_t      oldpackethead;
 
 		int         sequence;
 		int         last_sequence;
@@ -315,6 +341,12 @@ public:
 		bool		displaydisconnect; // display disconnect message when disconnecting
 
 		huffman_server	compressor;	// denis - adaptive huffman compression
+		byte		compression;	// packetCompression_e used for this client
+		byte		features;		// CLF_* the client can handle
+
+		MobjDeltas  mobjdeltas;
+		std::vector<mobjSent_t> pendingmobjs; // tracked updates in netbuf
+		sentMobjs_t sentmobjs[256];           // tracked updates per packet
 
 		class download_t
 		{
@@ -333,11 +365,7 @@ public:
 			memset(&address, 0, sizeof(netadr_t));
 			version = 0;
 			packedversion = 0;
-			for (size_t i = 0; i < ARRAY_LENGTH(oldpackets); i++)
-			{
-				oldpackets[i].sequence = -1;
-				oldpackets[i].data.resize(MAX_UDP_PACKET);
-			}
+			oldpackethead = 0;
 			sequence = 0;
 			last_sequence = 0;
 			packetnum = 0;
@@ -355,6 +383,8 @@ public:
 			digest = "";
 			allow_rcon = false;
 			displaydisconnect = true;
+			compression = PACKETCOMP_MINILZO;
+			features = 0;
 		/*
 		huffman_server	compressor;	// denis - adaptive huffman compression*/
 		}
@@ -364,6 +394,8 @@ public:
 			reliablebuf(other.reliablebuf),
 			version(other.version),
 			packedversion(other.packedversion),
+			oldpacketdata(other.oldpacketdata),
+			oldpackethead(other.oldpackethead),
 			sequence(other.sequence),
 			last_sequence(other.last_sequence),
 			packetnum(other.packetnum),
@@ -377,12 +409,20 @@ public:
 			allow_rcon(false),
 			displaydisconnect(true),
 			compressor(other.compressor),
+			compression(other.compression),
+			features(other.features),
+			mobjdeltas(other.mobjdeltas),
+			pendingmobjs(other.pendingmobjs),
 			download(other.download)
 		{
 			for (size_t i = 0; i < ARRAY_LENGTH(oldpackets); i++)
 			{
 				oldpackets[i] = other.oldpackets[i];
 			}
+			for (size_t i = 0; i < ARRAY_LENGTH(sentmobjs); i++)
+			{
+				sentmobjs[i] = other.sentmobjs[i];
+			}
 		}
 	} client;
 
@@ -34,6 +34,7 @@ EXTERN_CVAR(co_boomphys)			// [ML] Roll-up of various compat options
 IMPLEMENT_SERIAL (DSectorEffect, DThinker)
 
 DSectorEffect::DSectorEffect ()
+	: DThinker (STAT_SECTOREFFECT)
 {
 	m_Sector = NULL;
 }
@@ -58,6 +59,7 @@ void DSectorEffect::Destroy ()
 }
 
 DSectorEffect::DSectorEffect (sector_t *sector)
+	: DThinker (STAT_SECTOREFFECT)
 {
 	m_Sector = sector;
 }
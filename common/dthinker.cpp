@@ -26,16 +26,125 @@
 
 #include "odamex.h"
 
+#include <algorithm>
 
 #include "dthinker.h"
 #include "z_zone.h"
 #include "stats.h"
 #include "p_local.h"
+#include "c_dispatch.h"
+#include "i_system.h"
+
+EXTERN_CVAR(debug_zone)
+
+extern unsigned char rndindex, prndindex;
+extern FILE* recorddemo_fp;
 
 IMPLEMENT_SERIAL (DThinker, DObject)
 
+//
+// ThinkerPool
+//
+// Thinkers are allocated from slabs of same-sized objects, so spawning or
+// destroying an actor is a freelist push or pop, and thinkers of one size end
+// up next to each other in memory.  The slabs are PU_LEVSPEC zone memory that
+// goes away with the level, which the pool notices through a sentinel block
+// whose owner pointer the zone clears.
+//
+// If debug_zone is set when a level starts, the thinkers of that level are
+// allocated from the zone one by one instead.
+//
+class ThinkerPool
+{
+	static const size_t ALIGNMENT = 16;
+	static const size_t MAX_POOLED_SIZE = 2048;
+	static const size_t NUM_CLASSES = MAX_POOLED_SIZE / ALIGNMENT;
+	static const size_t SLAB_OBJECTS = 64;
+
+	struct FreeObject
+	{
+		FreeObject* next;
+	};
+
+	FreeObject* m_free[NUM_CLASSES];
+	void* m_sentinel;
+	bool m_direct;
+
+	void reset()
+	{
+		for (size_t i = 0; i < NUM_CLASSES; i++)
+			m_free[i] = NULL;
+
+		m_direct = debug_zone;
+		Z_Malloc(1, PU_LEVSPEC, &m_sentinel);
+	}
+
+	void refill(const size_t sizeclass)
+	{
+		const size_t objsize = (sizeclass + 1) * ALIGNMENT;
+		byte* slab = static_cast<byte*>(Z_Malloc(objsize * SLAB_OBJECTS, PU_LEVSPEC, 0));
+
+		// Push backwards so objects are handed out in address order.
+		for (size_t i = SLAB_OBJECTS; i-- > 0;)
+		{
+			FreeObject* obj = reinterpret_cast<FreeObject*>(slab + i * objsize);
+			obj->next = m_free[sizeclass];
+			m_free[sizeclass] = obj;
+		}
+	}
+
+	bool pooled(const size_t size) const
+	{
+		return !m_direct && size <= MAX_POOLED_SIZE;
+	}
+
+  public:
+	ThinkerPool() : m_sentinel(NULL), m_direct(false)
+	{
+		for (size_t i = 0; i < NUM_CLASSES; i++)
+			m_free[i] = NULL;
+	}
+
+	void* alloc(const size_t size)
+	{
+		if (m_sentinel == NULL)
+			reset();
+
+		if (!pooled(size))
+			return Z_Malloc(size, PU_LEVSPEC, 0);
+
+		const size_t sizeclass = (size + ALIGNMENT - 1) / ALIGNMENT - 1;
+		if (m_free[sizeclass] == NULL)
+			refill(sizeclass);
+
+		FreeObject* obj = m_free[sizeclass];
+		m_free[sizeclass] = obj->next;
+		return obj;
+	}
+
+	void free(void* mem, const size_t size)
+	{
+		// Thinkers outliving the level were freed along with it.
+		if (mem == NULL || m_sentinel == NULL)
+			return;
+
+		if (!pooled(size))
+		{
+			Z_Free(mem);
+			return;
+		}
+
+		const size_t sizeclass = (size + ALIGNMENT - 1) / ALIGNMENT - 1;
+		FreeObject* obj = static_cast<FreeObject*>(mem);
+		obj->next = m_free[sizeclass];
+		m_free[sizeclass] = obj;
+	}
+} g_thinkerpool;
+
 DThinker *DThinker::FirstThinker = NULL;
 DThinker *DThinker::LastThinker = NULL;
+DThinker *DThinker::FirstStatThinker[NUM_STATS];
+DThinker *DThinker::LastStatThinker[NUM_STATS];
 
 std::vector<DThinker *> LingerDestroy;
 
@@ -85,7 +194,7 @@ void DThinker::SerializeAll (FArchive &arc, bool hubLoad)
 	}
 }
 
-DThinker::DThinker ()
+DThinker::DThinker (thinkerStat_e stat)
 {
 	// Add a new thinker at the end of the list.
 	m_Prev = LastThinker;
@@ -95,6 +204,17 @@ DThinker::DThinker ()
 	if (!FirstThinker)
 		FirstThinker = this;
 	LastThinker = this;
+
+	// And at the end of the list of its category.
+	m_Stat = stat;
+	m_StatPrev = LastStatThinker[stat];
+	m_StatNext = NULL;
+	if (LastStatThinker[stat])
+		LastStatThinker[stat]->m_StatNext = this;
+	if (!FirstStatThinker[stat])
+		FirstStatThinker[stat] = this;
+	LastStatThinker[stat] = this;
+
 	refCount = 0;
 	destroyed = false;
 }
@@ -110,6 +230,8 @@ void DThinker::Orphan()
 {
 	m_Next = NULL;
 	m_Prev = NULL;
+	m_StatNext = NULL;
+	m_StatPrev = NULL;
 	refCount = 0;
 }
 
@@ -127,6 +249,15 @@ void DThinker::Destroy ()
 		m_Next->m_Prev = m_Prev;
 	if (m_Prev)
 		m_Prev->m_Next = m_Next;
+
+	if (FirstStatThinker[m_Stat] == this)
+		FirstStatThinker[m_Stat] = m_StatNext;
+	if (LastStatThinker[m_Stat] == this)
+		LastStatThinker[m_Stat] = m_StatPrev;
+	if (m_StatNext)
+		m_StatNext->m_StatPrev = m_StatPrev;
+	if (m_StatPrev)
+		m_StatPrev->m_StatNext = m_StatNext;
 	
 	destroyed = true;
 		
@@ -151,6 +282,23 @@ void DThinker::Destroy ()
 	}
 }
 
+//
+// StatForType
+//
+// Returns the category every thinker of the given type is in, or NUM_STATS
+// if the type can be in more than one.
+//
+int DThinker::StatForType (const TypeInfo *type)
+{
+	if (type->IsDescendantOf (RUNTIME_CLASS (AActor)))
+		return STAT_ACTOR;
+	if (type->IsDescendantOf (RUNTIME_CLASS (DSectorEffect)))
+		return STAT_SECTOREFFECT;
+	if (type != RUNTIME_CLASS (DThinker) && type->IsDescendantOf (RUNTIME_CLASS (DThinker)))
+		return STAT_DEFAULT;
+	return NUM_STATS;
+}
+
 bool DThinker::WasDestroyed ()
 {
 	return destroyed;
@@ -260,14 +408,14 @@ void DThinker::RunThinkers ()
 
 void *DThinker::operator new (size_t size)
 {
-	return Z_Malloc (size, PU_LEVSPEC, 0);
+	return ::g_thinkerpool.alloc (size);
 }
 
 // Deallocation is lazy -- it will not actually be freed
 // until its thinking turn comes up.
-void DThinker::operator delete (void *mem)
+void DThinker::operator delete (void *mem, size_t size)
 {
-	Z_Free (mem);
+	::g_thinkerpool.free (mem, size);
 }
 
 bool P_ThinkerIsPlayerType(DThinker* thinker)
@@ -279,4 +427,78 @@ bool P_ThinkerIsPlayerType(DThinker* thinker)
 	       static_cast<AActor*>(thinker)->type == MT_PLAYER;
 }
 
+//
+// thinkerbench
+//
+// Allocates and frees a number of actor-sized blocks, first from the thinker
+// pool and then from the heap, and prints the time per block.  Then spawns
+// and destroys as many rockets and prints the time per rocket.  The pool
+// keeps the slabs it grew until the level ends, and the rockets roll the
+// random numbers, so this is only allowed in a single player game that is
+// not a demo, and the random indices are put back afterwards.
+//
+BEGIN_COMMAND (thinkerbench)
+{
+	if (gamestate != GS_LEVEL)
+	{
+		Printf (PRINT_HIGH, "thinkerbench: Must be in a level.\n");
+		return;
+	}
+
+	if (multiplayer || demoplayback || recorddemo_fp != NULL)
+	{
+		Printf (PRINT_HIGH, "thinkerbench: Only available in a single player game.\n");
+		return;
+	}
+
+	size_t count = 100000;
+	if (argc > 1)
+		count = clamp (atoi (argv[1]), 1, 1000000);
+
+	const size_t size = sizeof(AActor);
+	std::vector<void*> blocks (count);
+
+	for (int pass = 0; pass < 2; pass++)
+	{
+		const bool pooled = pass == 0;
+
+		const dtime_t start = I_GetTime ();
+		for (size_t i = 0; i < count; i++)
+			blocks[i] = pooled ? ::g_thinkerpool.alloc (size) : malloc (size);
+		for (size_t i = 0; i < count; i++)
+		{
+			if (pooled)
+				::g_thinkerpool.free (blocks[i], size);
+			else
+				::free (blocks[i]);
+		}
+		const dtime_t elapsed = I_GetTime () - start;
+
+		Printf (PRINT_HIGH, "%s: %" PRIuSIZE " blocks of %" PRIuSIZE " bytes, %.1f ns per alloc and free\n",
+		        pooled ? "pooled" : "heap", count, size,
+		        static_cast<double>(elapsed) / count);
+	}
+
+	// Spawning rolls the random numbers, which must not change the game.
+	const unsigned char oldrndindex = ::rndindex;
+	const unsigned char oldprndindex = ::prndindex;
+
+	std::vector<AActor*> mobjs (count);
+
+	const dtime_t start = I_GetTime ();
+	for (size_t i = 0; i < count; i++)
+		mobjs[i] = new AActor (0, 0, 0, MT_ROCKET);
+	for (size_t i = 0; i < count; i++)
+		mobjs[i]->Destroy ();
+	DObject::EndFrame ();
+	const dtime_t elapsed = I_GetTime () - start;
+
+	::rndindex = oldrndindex;
+	::prndindex = oldprndindex;
+
+	Printf (PRINT_HIGH, "spawn: %" PRIuSIZE " rockets, %.1f ns per spawn and destroy\n",
+	        count, static_cast<double>(elapsed) / count);
+}
+END_COMMAND (thinkerbench)
+
 VERSION_CONTROL (dthinker_cpp, "$Id$")
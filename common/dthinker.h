@@ -51,24 +51,40 @@ typedef actionf_t  think_t;
 
 class FThinkerIterator;
 
+// Besides the list of all thinkers, every thinker is also kept in the list
+// of its category, so iterating over one type only looks at that category.
+enum thinkerStat_e
+{
+	STAT_DEFAULT,      // Anything not listed below
+	STAT_ACTOR,        // AActor
+	STAT_SECTOREFFECT, // DSectorEffect, so sector movers and lights
+	NUM_STATS
+};
+
 // Doubly linked list of thinkers
 class DThinker : public DObject
 {
 	DECLARE_SERIAL (DThinker, DObject)
 
 public:
-	DThinker ();
+	DThinker (thinkerStat_e stat = STAT_DEFAULT);
 	void Orphan();
 	virtual void Destroy ();
 	virtual ~DThinker ();
 	virtual void RunThink () {}
 
 	void *operator new (size_t size);
-	void operator delete (void *block);
+	void operator delete (void *block, size_t size);
 
 	// Both the head and tail of the thinker list.
 	static DThinker *FirstThinker;
 	static DThinker *LastThinker;
+
+	// Head and tail of the list of each category, in thinker list order.
+	static DThinker *FirstStatThinker[NUM_STATS];
+	static DThinker *LastStatThinker[NUM_STATS];
+	static int StatForType (const TypeInfo *type);
+
 	static void RunThinkers ();
 	static void DestroyAllThinkers ();
 	static void DestroyMostThinkers ();
@@ -80,6 +96,8 @@ public:
 
 private:
 	DThinker *m_Next, *m_Prev;
+	DThinker *m_StatNext, *m_StatPrev;
+	thinkerStat_e m_Stat;
 	bool destroyed;
 
 	friend class FThinkerIterator;
@@ -90,26 +108,36 @@ class FThinkerIterator
 private:
 	TypeInfo *m_ParentType;
 	DThinker *m_CurrThinker;
+	int m_Stat; // Category to walk, NUM_STATS to walk every thinker.
+
+	DThinker *First () const
+	{
+		if (m_Stat == NUM_STATS)
+			return DThinker::FirstThinker;
+		return DThinker::FirstStatThinker[m_Stat];
+	}
 
 public:
 	FThinkerIterator (TypeInfo *type)
 	{
 		m_ParentType = type;
-		m_CurrThinker = DThinker::FirstThinker;
+		m_Stat = DThinker::StatForType (type);
+		m_CurrThinker = First ();
 	}
 	DThinker *Next ()
 	{
 		while (m_CurrThinker)
 		{
-			if (m_CurrThinker->IsKindOf (m_ParentType))
-			{
-				DThinker *res = m_CurrThinker;
+			DThinker *res = m_CurrThinker;
+			if (m_Stat == NUM_STATS)
 				m_CurrThinker = m_CurrThinker->m_Next;
+			else
+				m_CurrThinker = m_CurrThinker->m_StatNext;
+
+			if (res->IsKindOf (m_ParentType))
 				return res;
-			}
-			m_CurrThinker = m_CurrThinker->m_Next;
 		}
-		m_CurrThinker = DThinker::FirstThinker;
+		m_CurrThinker = First ();
 		return NULL;
 	}
 };
@@ -51,6 +51,7 @@ void G_PlayDemo(char* name);
 void G_DoPlayDemo(bool justStreamInput = false);
 void G_TimeDemo(const char* name);
 void G_TestDemo(const char* name);
+void G_RenderBenchDemo(const char* name);
 BOOL G_CheckDemoStatus(void);
 void G_CleanupDemo();
 
@@ -529,12 +529,7 @@ static void GiveWins(player_t& player, int wins)
 		return;
 
 	// Send information about the new round wins to all players.
-	for (Players::iterator it = ::players.begin(); it != ::players.end(); ++it)
-	{
-		if (!it->ingame())
-			continue;
-		MSG_WriteSVC(&it->client.netbuf, SVC_PlayerMembers(player, SVC_PM_SCORE));
-	}
+	MSG_BroadcastSVC(CLBUF_NET, SVC_PlayerMembers(player, SVC_PM_SCORE));
 }
 
 static void GiveTeamWins(team_t team, int wins)
@@ -549,12 +544,7 @@ static void GiveTeamWins(team_t team, int wins)
 		return;
 
 	// Send information about the new team round wins to all players.
-	for (Players::iterator it = ::players.begin(); it != ::players.end(); ++it)
-	{
-		if (!it->ingame())
-			continue;
-		MSG_WriteSVC(&it->client.netbuf, SVC_TeamMembers(team));
-	}
+	MSG_BroadcastSVC(CLBUF_NET, SVC_TeamMembers(team));
 }
 
 /**
@@ -582,38 +582,46 @@ void huffman_server::packet_acked(unsigned int id)
 // Huffman Client
 //
 
-void huffman_client::ack_sent(unsigned char *in_data, size_t len)
+void huffman_client::packet_tracked(unsigned int id, unsigned char codec_id, unsigned char *in_data, size_t len)
 {
-	// update the codec only one ack at a time
-	if(awaiting_ackack)
+	// the server only ever tracks a later packet than the last one
+	if(pending_codec >= 0 && id < pending_id)
 		return;
-	
-	tmpcodec = active_codec ? alpha : beta;
+
+	// the server builds its next codec the same way
+	tmpcodec = codec_id ? alpha : beta;
 	tmpcodec.extend(in_data, len);
 
-	awaiting_ackack = true;
+	pending_codec = codec_id ? 0 : 1;
+	pending_id = id;
 }
 
-huffman &huffman_client::codec_for_received(unsigned char id)
+huffman *huffman_client::codec_for_received(unsigned int id, unsigned char codec_id)
 {
-	// if got a shiny new packet with a different codec
-	// and was expecting there to be one
-	if(awaiting_ackack && (id ? 1 : 0) != active_codec)
+	codec_id = codec_id ? 1 : 0;
+
+	// the server switched codecs after it saw the ack of the tracked packet,
+	// so only packets sent after that one use the new codec
+	if(pending_codec == codec_id && id > pending_id)
 	{
-		// swap the codecs
-		active_codec = !active_codec;
-		huffman &update = active_codec ? alpha : beta;
+		huffman &update = codec_id ? alpha : beta;
 		update = tmpcodec;
-		awaiting_ackack = false;
+		installed_id[codec_id] = pending_id;
+		pending_codec = -1;
 	}
-	
-	return id ? alpha : beta;
+
+	// a late packet compressed with the codec this slot held before
+	if(id < installed_id[codec_id])
+		return NULL;
+
+	return codec_id ? &alpha : &beta;
 }
 
 void huffman_client::reset()
 {
-	active_codec = 0;
-	awaiting_ackack = false;
+	pending_codec = -1;
+	pending_id = 0;
+	installed_id[0] = installed_id[1] = 0;
 	alpha.reset();
 	beta.reset();
 }
@@ -22,6 +22,8 @@
 //		* For each packet, the client sends an ACK
 //		* For each ACK the server gets back, both client and server have a 
 //			copy of the packet
+//		* The server marks the one packet at a time it builds the next tree
+//			from, and switches to that tree once the packet is ACK'ed
 //		* Statistically over time, packets contain similar data 
 //
 //  Therefore:
@@ -106,6 +108,14 @@ public:
 	{
 		memcpy(sym, other.sym, sizeof(sym));
 	} 
+
+	huffman &operator=(const huffman &other)
+	{
+		memcpy(sym, other.sym, sizeof(sym));
+		total_count = other.total_count;
+		fresh_histogram = true;
+		return *this;
+	}
 };
 
 #define HUFFMAN_RENEGOTIATE_DELAY	256
@@ -147,23 +157,34 @@ public:
 class huffman_client
 {
 	huffman alpha, beta, tmpcodec;
-	bool active_codec;
 
-	bool awaiting_ackack;
+	// codec that tmpcodec replaces once the server starts using it, -1 if none
+	int pending_codec;
+	unsigned int pending_id;
+
+	// packet the codec in each slot was built from
+	unsigned int installed_id[2];
 
 public:
 
 	void reset();
 
-	void ack_sent(unsigned char *in_data, size_t len);
-	huffman &codec_for_received(unsigned char id);
+	// Extend the next codec with a packet the server marked for tracking
+	void packet_tracked(unsigned int id, unsigned char codec_id, unsigned char *in_data, size_t len);
+
+	// Codec a received packet was compressed with, NULL if the packet is
+	// older than the codec in its slot
+	huffman *codec_for_received(unsigned int id, unsigned char codec_id);
 
 	huffman_client() { reset(); }
 	huffman_client(const huffman_client &other) :
 		alpha(other.alpha),
 		beta(other.beta),
 		tmpcodec(other.tmpcodec),
-		active_codec(other.active_codec),
-		awaiting_ackack(other.awaiting_ackack)
-	{}
+		pending_codec(other.pending_codec),
+		pending_id(other.pending_id)
+	{
+		installed_id[0] = other.installed_id[0];
+		installed_id[1] = other.installed_id[1];
+	}
 };
@@ -74,6 +74,14 @@ typedef int SOCKET;
 #define SETSOCKOPTCAST(x) ((const void *)(x))
 #endif
 
+// Linux can move many datagrams in and out of the kernel in one syscall,
+// and wait on the socket with a nanosecond timeout.
+#if defined(__linux__) && !defined(GEKKO)
+#define ODA_HAVE_MMSG
+#define ODA_HAVE_PPOLL
+#include <poll.h>
+#endif
+
 #include <google/protobuf/message.h>
 
 
@@ -92,6 +100,10 @@ typedef int SOCKET;
 
 #include "minilzo.h"
 
+#include <zlib.h>
+
+#include "server.pb.h"
+
 #ifdef ODA_HAVE_MINIUPNP
 #include "miniupnpc/miniwget.h"
 #include "miniupnpc/miniupnpc.h"
@@ -105,11 +117,6 @@ netadr_t    	net_from;   // address of who sent the packet
 buf_t       net_message(MAX_UDP_PACKET);
 extern bool	simulated_connection;
 
-// buffer for compression/decompression
-// can't be static to a function because some
-// of the functions
-buf_t compressed, decompressed;
-lzo_byte wrkmem[LZO1X_1_MEM_COMPRESS];
 
 EXTERN_CVAR(port)
 
@@ -439,6 +446,154 @@ bool NET_CompareAdr (netadr_t a, netadr_t b)
 typedef int socklen_t;
 #endif
 
+#ifdef ODA_HAVE_MMSG
+
+static const unsigned int NET_BATCH_SIZE = 64;
+
+//
+// netBatch_t
+//
+// A set of datagrams that is handed to recvmmsg or sendmmsg in one go.
+//
+struct netBatch_t
+{
+	buf_t				bufs[NET_BATCH_SIZE];
+	struct sockaddr_in	addrs[NET_BATCH_SIZE];
+	struct iovec		iovs[NET_BATCH_SIZE];
+	struct mmsghdr		msgs[NET_BATCH_SIZE];
+	unsigned int		count;	// datagrams in the batch
+	unsigned int		next;	// next datagram to hand out, receive only
+
+	netBatch_t() : count(0), next(0)
+	{
+	}
+
+	void prepare(unsigned int i, size_t len)
+	{
+		if (bufs[i].maxsize() < MAX_UDP_PACKET)
+			bufs[i].resize(MAX_UDP_PACKET);
+
+		iovs[i].iov_base = bufs[i].ptr();
+		iovs[i].iov_len = len;
+
+		memset(&msgs[i], 0, sizeof(msgs[i]));
+		msgs[i].msg_hdr.msg_name = &addrs[i];
+		msgs[i].msg_hdr.msg_namelen = sizeof(addrs[i]);
+		msgs[i].msg_hdr.msg_iov = &iovs[i];
+		msgs[i].msg_hdr.msg_iovlen = 1;
+	}
+};
+
+static netBatch_t recv_batch;
+static netBatch_t send_batch;
+static int send_batch_depth = 0;
+
+//
+// NET_FillRecvBatch
+//
+// Drains up to NET_BATCH_SIZE waiting datagrams from the socket.
+//
+static bool NET_FillRecvBatch()
+{
+	recv_batch.count = 0;
+	recv_batch.next = 0;
+
+	for (unsigned int i = 0; i < NET_BATCH_SIZE; i++)
+		recv_batch.prepare(i, MAX_UDP_PACKET);
+
+	int ret = recvmmsg(inet_socket, recv_batch.msgs, NET_BATCH_SIZE, 0, NULL);
+
+	if (ret == -1)
+	{
+		if (errno == EWOULDBLOCK)
+			return false;
+		if (errno == ECONNREFUSED)
+			return false;
+
+		Printf (PRINT_HIGH, "NET_GetPacket: %s\n", strerror(errno));
+		return false;
+	}
+
+	recv_batch.count = ret;
+	return ret > 0;
+}
+
+int NET_GetPacket (void)
+{
+	if (recv_batch.next == recv_batch.count && !NET_FillRecvBatch())
+		return false;
+
+	unsigned int i = recv_batch.next++;
+	int ret = recv_batch.msgs[i].msg_len;
+
+	net_message.clear();
+	memcpy(net_message.ptr(), recv_batch.bufs[i].ptr(), ret);
+	net_message.setcursize(ret);
+	SockadrToNetadr (&recv_batch.addrs[i], &net_from);
+
+	return ret;
+}
+
+//
+// NET_FlushSendBatch
+//
+// Hands every queued datagram to the kernel.  A datagram that fails is
+// reported and skipped, like a failed sendto.
+//
+static void NET_FlushSendBatch()
+{
+	unsigned int sent = 0;
+
+	while (sent < send_batch.count)
+	{
+		int ret = sendmmsg(inet_socket, send_batch.msgs + sent, send_batch.count - sent, 0);
+
+		if (ret == -1)
+		{
+			if (errno != EWOULDBLOCK && errno != ECONNREFUSED)
+				Printf (PRINT_HIGH, "NET_SendPacket: %s\n", strerror(errno));
+
+			// Drop the datagram the kernel refused and carry on.
+			sent++;
+			continue;
+		}
+
+		sent += ret;
+	}
+
+	send_batch.count = 0;
+}
+
+//
+// NET_BeginSendBatch
+//
+// Packets sent until the matching NET_EndSendBatch are queued and handed to
+// the kernel together.  Only call this from the main thread.
+//
+void NET_BeginSendBatch()
+{
+	send_batch_depth++;
+}
+
+//
+// NET_EndSendBatch
+//
+void NET_EndSendBatch()
+{
+	if (send_batch_depth > 0 && --send_batch_depth == 0)
+		NET_FlushSendBatch();
+}
+
+#else
+
+void NET_BeginSendBatch()
+{
+}
+
+void NET_EndSendBatch()
+{
+}
+
 int NET_GetPacket (void)
 {
 	int				  ret;
@@ -485,6 +640,8 @@ int NET_GetPacket (void)
 	return ret;
 }
 
+#endif // ODA_HAVE_MMSG
+
 int NET_SendPacket (buf_t &buf, netadr_t &to)
 {
 	int				   ret;
@@ -498,6 +655,24 @@ int NET_SendPacket (buf_t &buf, netadr_t &to)
 		return 0;
 	}
 
+#ifdef ODA_HAVE_MMSG
+	if (send_batch_depth > 0)
+	{
+		if (send_batch.count == NET_BATCH_SIZE)
+			NET_FlushSendBatch();
+
+		unsigned int i = send_batch.count++;
+		send_batch.prepare(i, buf.size());
+		memcpy(send_batch.bufs[i].ptr(), buf.ptr(), buf.size());
+		NetadrToSockadr (&to, &send_batch.addrs[i]);
+
+		ret = buf.size();
+		buf.clear();
+
+		return ret;
+	}
+#endif
+
 	NetadrToSockadr (&to, &addr);
 
 #ifdef GEKKO
@@ -636,7 +811,7 @@ void MSG_WriteSVC(buf_t* b, const google::protobuf::Message& msg)
 
 	// Do we actaully have room for this upcoming message?
 	const size_t MAX_HEADER_SIZE = 4; // header + 3 bytes for varint size.
-	if (b->cursize + MAX_HEADER_SIZE + msg.ByteSize() >= MAX_UDP_SIZE)
+	if (b->cursize + MAX_HEADER_SIZE + buffer.size() >= MAX_UDP_SIZE)
 		SV_SendPackets();
 
 	svc_t header = SVC_ResolveDescriptor(msg.GetDescriptor());
@@ -661,28 +836,90 @@ void MSG_WriteSVC(buf_t* b, const google::protobuf::Message& msg)
 }
 
 /**
- * @brief Broadcast message to all players.
- * 
- * @param buf Type of buffer to broadcast in, per player.
- * @param msg Message to broadcast to all players.
- * @param skip If passed, skip this player id.
+ * @brief Write an unsigned varint to a byte array.
+ *
+ * @param out Array with room for at least 10 bytes.
+ * @param v Value to write.
+ * @return Number of bytes written.
  */
-void MSG_BroadcastSVC(const clientBuf_e buf, const google::protobuf::Message& msg,
-                      const int skipPlayer)
+static size_t EncodeVarint(byte* out, uint64_t v)
 {
-	if (simulated_connection)
-		return;
+	size_t len = 0;
+	for (;;)
+	{
+		byte b = v & 0x7F;
+		v >>= 7;
+		if (v == 0)
+		{
+			out[len++] = b;
+			return len;
+		}
+		out[len++] = b | 0x80;
+	}
+}
 
-	static std::string buffer;
-	if (!msg.SerializeToString(&buffer))
+/**
+ * @brief Serialize a message into its complete wire format.
+ *
+ * @param msg Message to encode.
+ */
+EncodedSVC::EncodedSVC(const google::protobuf::Message& msg) : m_header(svc_noop)
+{
+	svc_t header = SVC_ResolveDescriptor(msg.GetDescriptor());
+	if (header == svc_noop)
 	{
-		Printf(
-		    PRINT_WARNING,
-		    "WARNING: Could not serialize message \"%s\".  This is most likely a bug.\n",
-		    msg.GetDescriptor()->full_name().c_str());
+		Printf(PRINT_WARNING,
+		       "WARNING: Could not find svc header for message \"%s\".  This is most "
+		       "likely a bug.\n",
+		       msg.GetDescriptor()->full_name().c_str());
 		return;
 	}
 
+	const int payload = msg.ByteSize();
+
+	// Header byte and the varint size are written in front of the payload,
+	// so the whole message can be copied into a buffer in one go.
+	byte prefix[6];
+	size_t prefixlen = 0;
+	prefix[prefixlen++] = header;
+	prefixlen += EncodeVarint(prefix + prefixlen, payload);
+
+	m_data.resize(prefixlen + payload);
+	memcpy(&m_data[0], prefix, prefixlen);
+	if (payload > 0)
+	{
+		msg.SerializeWithCachedSizesToArray(
+		    reinterpret_cast<google::protobuf::uint8*>(&m_data[prefixlen]));
+	}
+
+	m_header = header;
+}
+
+/**
+ * @brief Write a previously encoded message to a buffer.
+ *
+ * @param b Buffer to write to.
+ * @param enc Encoded message to write.
+ */
+void MSG_WriteSVC(buf_t* b, const EncodedSVC& enc)
+{
+	if (simulated_connection || !enc.valid())
+		return;
+
+	// Do we actaully have room for this upcoming message?
+	if (b->cursize + enc.size() >= MAX_UDP_SIZE)
+		SV_SendPackets();
+
+	b->WriteChunk(enc.data(), enc.size());
+}
+
+/**
+ * @brief Serialize a message that is missing its tic.
+ *
+ * @param msg Message to encode, with a tic of 0.
+ */
+EncodedTicSVC::EncodedTicSVC(const google::protobuf::Message& msg) : m_header(svc_noop)
+{
 	svc_t header = SVC_ResolveDescriptor(msg.GetDescriptor());
 	if (header == svc_noop)
 	{
@@ -693,6 +930,87 @@ void MSG_BroadcastSVC(const clientBuf_e buf, const google::protobuf::Message& ms
 		return;
 	}
 
+	if (!msg.SerializeToString(&m_payload))
+	{
+		Printf(
+		    PRINT_WARNING,
+		    "WARNING: Could not serialize message \"%s\".  This is most likely a bug.\n",
+		    msg.GetDescriptor()->full_name().c_str());
+		return;
+	}
+
+	m_header = header;
+}
+
+/**
+ * @brief Write a message encoded without its tic to a buffer, with the
+ *        given tic put in front of the payload.
+ *
+ * @param b Buffer to write to.
+ * @param enc Encoded message to write.
+ * @param tic Tic of this copy of the message.
+ */
+void MSG_WriteSVC(buf_t* b, const EncodedTicSVC& enc, const int tic)
+{
+	if (simulated_connection || !enc.valid())
+		return;
+
+	// Field 1 as a varint.  An int32 is sign-extended to 64 bits on the
+	// wire, and a tic of 0 is left out like protobuf itself does.
+	byte field[11];
+	size_t fieldlen = 0;
+	if (tic != 0)
+	{
+		field[fieldlen++] = (1 << 3) | 0;
+		fieldlen += EncodeVarint(field + fieldlen, static_cast<uint64_t>(static_cast<int64_t>(tic)));
+	}
+
+	const size_t size = fieldlen + enc.payload().size();
+
+	byte prefix[6];
+	size_t prefixlen = 0;
+	prefix[prefixlen++] = enc.header();
+	prefixlen += EncodeVarint(prefix + prefixlen, size);
+
+	// Do we actaully have room for this upcoming message?
+	if (b->cursize + prefixlen + size >= MAX_UDP_SIZE)
+		SV_SendPackets();
+
+	b->WriteChunk(reinterpret_cast<const char*>(prefix), prefixlen);
+	if (fieldlen > 0)
+		b->WriteChunk(reinterpret_cast<const char*>(field), fieldlen);
+	b->WriteChunk(enc.payload().data(), enc.payload().size());
+}
+
+/**
+ * @brief Broadcast message to all players.
+ * 
+ * @param buf Type of buffer to broadcast in, per player.
+ * @param msg Message to broadcast to all players.
+ * @param skip If passed, skip this player id.
+ */
+void MSG_BroadcastSVC(const clientBuf_e buf, const google::protobuf::Message& msg,
+                      const int skipPlayer)
+{
+	if (simulated_connection)
+		return;
+
+	MSG_BroadcastSVC(buf, EncodedSVC(msg), skipPlayer);
+}
+
+/**
+ * @brief Broadcast an encoded message to all players.
+ *
+ * @param buf Type of buffer to broadcast in, per player.
+ * @param enc Encoded message to broadcast to all players.
+ * @param skip If passed, skip this player id.
+ */
+void MSG_BroadcastSVC(const clientBuf_e buf, const EncodedSVC& enc,
+                      const int skipPlayer)
+{
+	if (simulated_connection || !enc.valid())
+		return;
+
 	for (Players::iterator it = ::players.begin(); it != ::players.end(); ++it)
 	{
 		if (!it->ingame())
@@ -703,15 +1021,7 @@ void MSG_BroadcastSVC(const clientBuf_e buf, const google::protobuf::Message& ms
 
 		// Select the correct buffer.
 		buf_t* b = buf == CLBUF_RELIABLE ? &it->client.reliablebuf : &it->client.netbuf;
-
-		// Do we actaully have room for this upcoming message?
-		const size_t MAX_HEADER_SIZE = 4; // header + 3 bytes for varint size.
-		if (b->cursize + MAX_HEADER_SIZE + msg.ByteSize() >= MAX_UDP_SIZE)
-			SV_SendPackets();
-
-		b->WriteByte(header);
-		b->WriteUnVarint(buffer.size());
-		b->WriteChunk(buffer.data(), buffer.size());
+		MSG_WriteSVC(b, enc);
 	}
 }
 
@@ -854,20 +1164,35 @@ size_t MSG_SetOffset (const size_t &offset, const buf_t::seek_loc_t &loc)
 // size above which packets get compressed (empirical), does not apply to adaptive compression
 #define MINILZO_COMPRESS_MINPACKETSIZE	0xFF
 
+// deflate gets most of its gains on small packets out of the dictionary
+#define DEFLATE_COMPRESS_MINPACKETSIZE	16
+
 //
 // MSG_DecompressMinilzo
 //
 bool MSG_DecompressMinilzo ()
 {
+	return MSG_DecompressMinilzo(net_message);
+}
+
+//
+// MSG_DecompressMinilzo
+//
+// Decompresses the unread part of a buffer back onto the buffer.
+//
+bool MSG_DecompressMinilzo (buf_t &buf)
+{
+	static buf_t decompressed;
+
 	// decompress back onto the receive buffer
-	size_t left = MSG_BytesLeft();
+	size_t left = buf.BytesLeftToRead();
 
-	if(decompressed.maxsize() < net_message.maxsize())
-		decompressed.resize(net_message.maxsize());
+	if(decompressed.maxsize() < buf.maxsize())
+		decompressed.resize(buf.maxsize());
 
-	lzo_uint newlen = net_message.maxsize();
+	lzo_uint newlen = buf.maxsize();
 
-	unsigned int r = lzo1x_decompress_safe (net_message.ptr() + net_message.BytesRead(), left, decompressed.ptr(), &newlen, NULL);
+	unsigned int r = lzo1x_decompress_safe (buf.ptr() + buf.BytesRead(), left, decompressed.ptr(), &newlen, NULL);
 
 	if(r != LZO_E_OK)
 	{
@@ -875,18 +1200,61 @@ bool MSG_DecompressMinilzo ()
 		return false;
 	}
 
-	net_message.clear();
-	memcpy(net_message.ptr(), decompressed.ptr(), newlen);
+	buf.clear();
+	memcpy(buf.ptr(), decompressed.ptr(), newlen);
 
-	net_message.cursize = newlen;
+	buf.cursize = newlen;
 
 	return true;
 }
 
+// deflate settings, a small window keeps resetting the stream for every
+// packet cheap
+#define DEFLATE_WINDOW_BITS	12
+#define DEFLATE_MEM_LEVEL	5
+
+CompressScratch::CompressScratch() : wrkmem(LZO1X_1_MEM_COMPRESS), zstream(NULL)
+{
+}
+
+CompressScratch::CompressScratch(const CompressScratch &other) :
+	compressed(other.compressed), wrkmem(other.wrkmem), zstream(NULL)
+{
+}
+
+CompressScratch::~CompressScratch()
+{
+	if (zstream)
+	{
+		deflateEnd(zstream);
+		delete zstream;
+	}
+}
+
+CompressScratch& CompressScratch::operator=(const CompressScratch &other)
+{
+	// streams are never shared
+	compressed = other.compressed;
+	wrkmem = other.wrkmem;
+	return *this;
+}
+
 //
 // MSG_CompressMinilzo
 //
 bool MSG_CompressMinilzo (buf_t &buf, size_t start_offset, size_t write_gap)
+{
+	static CompressScratch scratch;
+	return MSG_CompressMinilzo(buf, start_offset, write_gap, scratch);
+}
+
+//
+// MSG_CompressMinilzo
+//
+// Compresses with the given scratch memory, so packets can be compressed on
+// several threads at once.
+//
+bool MSG_CompressMinilzo (buf_t &buf, size_t start_offset, size_t write_gap, CompressScratch &scratch)
 {
 	if(buf.size() < MINILZO_COMPRESS_MINPACKETSIZE)
 		return false;
@@ -894,6 +1262,7 @@ bool MSG_CompressMinilzo (buf_t &buf, size_t start_offset, size_t write_gap)
 	lzo_uint outlen = OUT_LEN(buf.maxsize() - start_offset - write_gap);
 	size_t total_len = outlen + start_offset + write_gap;
 
+	buf_t& compressed = scratch.compressed;
 	if(compressed.maxsize() < total_len)
 		compressed.resize(total_len);
 
@@ -901,7 +1270,7 @@ bool MSG_CompressMinilzo (buf_t &buf, size_t start_offset, size_t write_gap)
 							  buf.size() - start_offset,
 							  compressed.ptr() + start_offset + write_gap,
 							  &outlen,
-							  wrkmem);
+							  &scratch.wrkmem[0]);
 
 	// worth the effort?
 	if(r != LZO_E_OK || outlen >= (buf.size() - start_offset - write_gap))
@@ -920,23 +1289,35 @@ bool MSG_CompressMinilzo (buf_t &buf, size_t start_offset, size_t write_gap)
 //
 bool MSG_DecompressAdaptive (huffman &huff)
 {
+	return MSG_DecompressAdaptive(huff, net_message);
+}
+
+//
+// MSG_DecompressAdaptive
+//
+// Decompresses the unread part of a buffer back onto the buffer.
+//
+bool MSG_DecompressAdaptive (huffman &huff, buf_t &buf)
+{
+	static buf_t decompressed;
+
 	// decompress back onto the receive buffer
-	size_t left = MSG_BytesLeft();
+	size_t left = buf.BytesLeftToRead();
 
-	if(decompressed.maxsize() < net_message.maxsize())
-		decompressed.resize(net_message.maxsize());
+	if(decompressed.maxsize() < buf.maxsize())
+		decompressed.resize(buf.maxsize());
 
-	size_t newlen = net_message.maxsize();
+	size_t newlen = buf.maxsize();
 
-	bool r = huff.decompress (net_message.ptr() + net_message.BytesRead(), left, decompressed.ptr(), newlen);
+	bool r = huff.decompress (buf.ptr() + buf.BytesRead(), left, decompressed.ptr(), newlen);
 
 	if(!r)
 		return false;
 
-	net_message.clear();
-	memcpy(net_message.ptr(), decompressed.ptr(), newlen);
+	buf.clear();
+	memcpy(buf.ptr(), decompressed.ptr(), newlen);
 
-	net_message.cursize = newlen;
+	buf.cursize = newlen;
 
 	return true;
 }
@@ -944,11 +1325,12 @@ bool MSG_DecompressAdaptive (huffman &huff)
 //
 // MSG_CompressAdaptive
 //
-bool MSG_CompressAdaptive (huffman &huff, buf_t &buf, size_t start_offset, size_t write_gap)
+bool MSG_CompressAdaptive (huffman &huff, buf_t &buf, size_t start_offset, size_t write_gap, CompressScratch &scratch)
 {
 	size_t outlen = OUT_LEN(buf.maxsize() - start_offset - write_gap);
 	size_t total_len = outlen + start_offset + write_gap;
 
+	buf_t& compressed = scratch.compressed;
 	if(compressed.maxsize() < total_len)
 		compressed.resize(total_len);
 
@@ -969,6 +1351,269 @@ bool MSG_CompressAdaptive (huffman &huff, buf_t &buf, size_t start_offset, size_
 	return true;
 }
 
+/**
+ * @brief Append the wire format of a message to the deflate dictionary.
+ */
+static void AddDictionaryMessage(std::string& dict, const google::protobuf::Message& msg)
+{
+	EncodedSVC enc(msg);
+	if (enc.valid())
+		dict.append(enc.data(), enc.size());
+}
+
+static void SetDictionaryActor(odaproto::Actor* actor, uint32_t netid)
+{
+	actor->set_netid(netid);
+	actor->mutable_pos()->set_x(1056 << FRACBITS);
+	actor->mutable_pos()->set_y(-3616 * FRACUNIT);
+	actor->mutable_pos()->set_z(0);
+	actor->set_angle(ANG90);
+	actor->mutable_mom()->set_x(FRACUNIT);
+	actor->mutable_mom()->set_y(-FRACUNIT);
+	actor->mutable_mom()->set_z(0);
+	actor->set_statenum(S_PLAY_RUN1);
+	actor->set_tics(4);
+	actor->set_movedir(0);
+	actor->set_movecount(8);
+	actor->set_targetid(1);
+	actor->set_reactiontime(8);
+	actor->set_rndindex(100);
+}
+
+static std::string deflatedictionary;
+
+//
+// BuildDeflateDictionary
+//
+// A preset dictionary for deflate, made out of the messages that fill most
+// packets during a game.  It is built from the same protobuf definitions on
+// both sides, so it never has to be sent.  The most common messages come
+// last, as deflate codes matches closer to the data more cheaply.
+//
+// Built once by InitNetCommon, before any packet is compressed on a worker
+// thread, and only read after that.
+//
+static void BuildDeflateDictionary ()
+{
+	std::string& dict = deflatedictionary;
+	dict.clear();
+
+	{
+		odaproto::svc::LevelLocals msg;
+		msg.set_flags(SVC_LL_TIME);
+		msg.set_time(TICRATE * 60);
+		AddDictionaryMessage(dict, msg);
+	}
+	{
+		odaproto::svc::UpdatePing msg;
+		msg.set_pid(1);
+		msg.set_ping(50);
+		AddDictionaryMessage(dict, msg);
+	}
+	{
+		odaproto::svc::PlayerMembers msg;
+		msg.set_pid(1);
+		msg.set_flags(SVC_MSG_ALL);
+		msg.set_lives(-1);
+		msg.set_fragcount(1);
+		msg.set_deathcount(1);
+		AddDictionaryMessage(dict, msg);
+	}
+	{
+		odaproto::svc::PlaySound msg;
+		msg.set_netid(2);
+		msg.set_channel(2);
+		msg.set_sfxid(1);
+		msg.set_volume(1.0f);
+		msg.set_attenuation(1);
+		AddDictionaryMessage(dict, msg);
+	}
+	{
+		odaproto::svc::MovingSector msg;
+		msg.set_sector(10);
+		msg.set_ceiling_height(128 << FRACBITS);
+		msg.set_floor_height(0);
+		AddDictionaryMessage(dict, msg);
+	}
+	{
+		odaproto::svc::DamagePlayer msg;
+		msg.set_netid(1);
+		msg.set_health_damage(10);
+		msg.set_inflictorid(2);
+		msg.mutable_player()->set_health(90);
+		msg.mutable_player()->set_armorpoints(0);
+		AddDictionaryMessage(dict, msg);
+	}
+	{
+		odaproto::svc::SpawnMobj msg;
+		SetDictionaryActor(msg.mutable_baseline(), 2);
+		msg.set_baseline_flags(0xFF);
+		msg.set_target_netid(1);
+		AddDictionaryMessage(dict, msg);
+	}
+	{
+		odaproto::svc::RemoveMobj msg;
+		msg.set_netid(2);
+		AddDictionaryMessage(dict, msg);
+	}
+	{
+		odaproto::svc::MovePlayer msg;
+		msg.set_tic(1000);
+		msg.set_frame(1);
+		msg.mutable_player()->set_playerid(1);
+		msg.mutable_player()->set_viewz(41 << FRACBITS);
+		SetDictionaryActor(msg.mutable_actor(), 1);
+		AddDictionaryMessage(dict, msg);
+	}
+	{
+		odaproto::svc::UpdateMobj msg;
+		msg.set_flags(0x0F);
+		SetDictionaryActor(msg.mutable_actor(), 2);
+		msg.set_tag(2);
+		msg.set_basetag(1);
+		AddDictionaryMessage(dict, msg);
+	}
+}
+
+//
+// MSG_DeflateDictionary
+//
+const std::string& MSG_DeflateDictionary ()
+{
+	return deflatedictionary;
+}
+
+/**
+ * @brief Get a deflate stream ready for the next packet.
+ */
+static bool ResetDeflate(CompressScratch& scratch)
+{
+	if (scratch.zstream == NULL)
+	{
+		scratch.zstream = new z_stream;
+		memset(scratch.zstream, 0, sizeof(z_stream));
+		if (deflateInit2(scratch.zstream, Z_DEFAULT_COMPRESSION, Z_DEFLATED,
+		                 -DEFLATE_WINDOW_BITS, DEFLATE_MEM_LEVEL,
+		                 Z_DEFAULT_STRATEGY) != Z_OK)
+		{
+			delete scratch.zstream;
+			scratch.zstream = NULL;
+			return false;
+		}
+	}
+	else if (deflateReset(scratch.zstream) != Z_OK)
+	{
+		return false;
+	}
+
+	const std::string& dict = MSG_DeflateDictionary();
+	return deflateSetDictionary(scratch.zstream,
+	                            reinterpret_cast<const Bytef*>(dict.data()),
+	                            dict.size()) == Z_OK;
+}
+
+//
+// MSG_DecompressDeflate
+//
+bool MSG_DecompressDeflate ()
+{
+	return MSG_DecompressDeflate(net_message);
+}
+
+//
+// MSG_DecompressDeflate
+//
+// Decompresses the unread part of a buffer back onto the buffer.
+//
+bool MSG_DecompressDeflate (buf_t &buf)
+{
+	static buf_t decompressed;
+	static z_stream stream;
+	static bool initialized = false;
+
+	if (!initialized)
+	{
+		memset(&stream, 0, sizeof(stream));
+		if (inflateInit2(&stream, -DEFLATE_WINDOW_BITS) != Z_OK)
+			return false;
+		initialized = true;
+	}
+	else if (inflateReset(&stream) != Z_OK)
+	{
+		return false;
+	}
+
+	// raw streams take their dictionary up front
+	const std::string& dict = MSG_DeflateDictionary();
+	if (inflateSetDictionary(&stream, reinterpret_cast<const Bytef*>(dict.data()),
+	                         dict.size()) != Z_OK)
+		return false;
+
+	if(decompressed.maxsize() < buf.maxsize())
+		decompressed.resize(buf.maxsize());
+
+	stream.next_in = buf.ptr() + buf.BytesRead();
+	stream.avail_in = buf.BytesLeftToRead();
+	stream.next_out = decompressed.ptr();
+	stream.avail_out = decompressed.maxsize();
+
+	int r = inflate(&stream, Z_FINISH);
+	if (r != Z_STREAM_END)
+	{
+		Printf(PRINT_HIGH, "Error: deflate packet decompression failed with error %d\n", r);
+		return false;
+	}
+
+	size_t newlen = stream.total_out;
+
+	buf.clear();
+	memcpy(buf.ptr(), decompressed.ptr(), newlen);
+
+	buf.cursize = newlen;
+
+	return true;
+}
+
+//
+// MSG_CompressDeflate
+//
+bool MSG_CompressDeflate (buf_t &buf, size_t start_offset, size_t write_gap, CompressScratch &scratch)
+{
+	if(buf.size() - start_offset < DEFLATE_COMPRESS_MINPACKETSIZE)
+		return false;
+
+	if (!ResetDeflate(scratch))
+		return false;
+
+	size_t inlen = buf.size() - start_offset;
+	size_t outlen = deflateBound(scratch.zstream, inlen);
+	size_t total_len = outlen + start_offset + write_gap;
+
+	buf_t& compressed = scratch.compressed;
+	if(compressed.maxsize() < total_len)
+		compressed.resize(total_len);
+
+	z_stream* stream = scratch.zstream;
+	stream->next_in = buf.ptr() + start_offset;
+	stream->avail_in = inlen;
+	stream->next_out = compressed.ptr() + start_offset + write_gap;
+	stream->avail_out = outlen;
+
+	int r = deflate(stream, Z_FINISH);
+	outlen = stream->total_out;
+
+	// worth the effort?
+	if(r != Z_STREAM_END || outlen >= (buf.size() - start_offset - write_gap))
+		return false;
+
+	memcpy(compressed.ptr(), buf.ptr(), start_offset);
+
+	SZ_Clear(&buf);
+	MSG_WriteChunk(&buf, compressed.ptr(), outlen + start_offset + write_gap);
+
+	return true;
+}
+
 int MSG_ReadShort (void)
 {
     return net_message.ReadShort();
@@ -1209,6 +1854,8 @@ void InitNetCommon(void)
 	// enter message information into message info structs
 	InitNetMessageFormats();
 
+	BuildDeflateDictionary();
+
    SZ_Clear(&net_message);
 }
 
@@ -1219,13 +1866,49 @@ void InitNetCommon(void)
 //
 bool NetWaitOrTimeout(size_t ms)
 {
-	struct timeval timeout = {0, int(1000*ms) + 1};
+	return NET_WaitForPacket(1000LL * 1000LL * ms);
+}
+
+//
+// NET_WaitForPacket
+//
+// Sleeps until a packet can be read or the timeout in nanoseconds runs out.
+// Returns true as soon as a packet is waiting.
+//
+bool NET_WaitForPacket(dtime_t timeout)
+{
+#ifdef ODA_HAVE_MMSG
+	// Datagrams already drained from the socket won't wake the wait.
+	if (recv_batch.next < recv_batch.count)
+		return true;
+#endif
+
+	const dtime_t second = 1000LL * 1000LL * 1000LL;
+
+#ifdef ODA_HAVE_PPOLL
+	struct pollfd pfd;
+	pfd.fd = inet_socket;
+	pfd.events = POLLIN;
+	pfd.revents = 0;
+
+	struct timespec ts;
+	ts.tv_sec = timeout / second;
+	ts.tv_nsec = timeout % second;
+
+	int ret = ppoll(&pfd, 1, &ts, NULL);
+#else
+	// select only goes down to microseconds, round up so we don't spin
+	struct timeval tv;
+	tv.tv_sec = timeout / second;
+	tv.tv_usec = (timeout % second + 999) / 1000;
+
 	fd_set fds;
 
 	FD_ZERO(&fds);
 	FD_SET(inet_socket, &fds);
 
-	int ret = select(inet_socket + 1, &fds, NULL, NULL, &timeout);
+	int ret = select(inet_socket + 1, &fds, NULL, NULL, &tv);
+#endif
 
 	if(ret == 1)
 		return true;
@@ -1236,8 +1919,8 @@ bool NetWaitOrTimeout(size_t ms)
 			Printf(PRINT_HIGH, "select returned SOCKET_ERROR: %d\n", WSAGetLastError());
 	#else
 		// handle -1
-		if(ret == -1 && ret != EINTR)
-			Printf(PRINT_HIGH, "select returned -1: %s\n", strerror(errno));
+		if(ret == -1 && errno != EINTR)
+			Printf(PRINT_HIGH, "waiting for packets failed: %s\n", strerror(errno));
 	#endif
 
 	return false;
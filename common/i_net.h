@@ -59,10 +59,54 @@ enum clientBuf_e
  */
 #define SVF_COMPRESSED BIT(0)
 
+/**
+ * @brief Packet is compressed with adaptive huffman.
+ */
+#define SVF_HUFFMAN BIT(1)
+
+/**
+ * @brief Which of the two adaptive huffman codecs the packet uses.
+ */
+#define SVF_HUFFMAN_CODEC BIT(2)
+
+/**
+ * @brief The next adaptive huffman codec is built from this packet.
+ */
+#define SVF_HUFFMAN_TRACK BIT(3)
+
+/**
+ * @brief Packet is compressed with deflate and the shared dictionary.
+ */
+#define SVF_DEFLATE BIT(4)
+
 /**
  * @brief Unused flags - if any of these are set, we have a problem.
  */
-#define SVF_UNUSED_MASK BIT_MASK(1, 7)
+#define SVF_UNUSED_MASK BIT_MASK(5, 7)
+
+/**
+ * @brief Ways a server can compress the packets it sends to a client.
+ *
+ * Clients send the methods they understand and the one they prefer when
+ * they connect.  The order is the order of preference when falling back.
+ */
+enum packetCompression_e
+{
+	PACKETCOMP_NONE,
+	PACKETCOMP_MINILZO,
+	PACKETCOMP_HUFFMAN,
+	PACKETCOMP_DEFLATE,
+	NUM_PACKETCOMP
+};
+
+/**
+ * @brief Client reads actor updates relative to a state it acknowledged
+ *        (svc::UpdateMobj basetag).
+ *
+ * Clients send a mask of these after the packet compression methods when
+ * they connect.  Older clients send nothing and get none of them.
+ */
+#define CLF_MOBJDELTAS BIT(0)
 
 /**
  * @brief svc_*: Transmit all possible data.
@@ -736,12 +780,15 @@ void CloseNetwork (void);
 void InitNetCommon(void);
 void I_SetPort(netadr_t &addr, int port);
 bool NetWaitOrTimeout(size_t ms);
+bool NET_WaitForPacket(dtime_t timeout);
 
 char *NET_AdrToString (netadr_t a);
 bool NET_StringToAdr (const char *s, netadr_t *a);
 bool NET_CompareAdr (netadr_t a, netadr_t b);
 int  NET_GetPacket (void);
 int NET_SendPacket (buf_t &buf, netadr_t &to);
+void NET_BeginSendBatch();
+void NET_EndSendBatch();
 std::string NET_GetLocalAddress (void);
 
 void SZ_Clear (buf_t *buf);
@@ -760,9 +807,83 @@ void MSG_WriteFloat(buf_t *b, float);
 void MSG_WriteString (buf_t *b, const char *s);
 void MSG_WriteHexString(buf_t *b, const char *s);
 void MSG_WriteChunk (buf_t *b, const void *p, unsigned l);
+/**
+ * @brief A server message that has already been serialized to its wire
+ *        format - header byte, varint size and payload.
+ *
+ * @detail Encode a message once with this when the same message is going
+ *         to more than one client, then append it to every client buffer
+ *         with MSG_WriteSVC.  Each append is a single copy of the bytes.
+ */
+class EncodedSVC
+{
+	std::string m_data;
+	svc_t m_header;
+
+  public:
+	explicit EncodedSVC(const google::protobuf::Message& msg);
+
+	bool valid() const
+	{
+		return m_header != svc_noop;
+	}
+
+	svc_t header() const
+	{
+		return m_header;
+	}
+
+	const char* data() const
+	{
+		return m_data.data();
+	}
+
+	size_t size() const
+	{
+		return m_data.size();
+	}
+};
+
+/**
+ * @brief A server message serialized without its tic, for messages that
+ *        only differ per client by the tic they carry.
+ *
+ * @detail The message must have its int32 tic as field 1 and be built with
+ *         a tic of 0, which leaves the field out of the payload.  MSG_WriteSVC
+ *         writes the recipient's tic in front of the payload and copies the
+ *         rest, so the message is serialized once for every client.
+ */
+class EncodedTicSVC
+{
+	std::string m_payload;
+	svc_t m_header;
+
+  public:
+	explicit EncodedTicSVC(const google::protobuf::Message& msg);
+
+	bool valid() const
+	{
+		return m_header != svc_noop;
+	}
+
+	svc_t header() const
+	{
+		return m_header;
+	}
+
+	const std::string& payload() const
+	{
+		return m_payload;
+	}
+};
+
 void MSG_WriteSVC(buf_t* b, const google::protobuf::Message& msg);
+void MSG_WriteSVC(buf_t* b, const EncodedSVC& enc);
+void MSG_WriteSVC(buf_t* b, const EncodedTicSVC& enc, const int tic);
 void MSG_BroadcastSVC(const clientBuf_e buf, const google::protobuf::Message& msg,
                       const int skipPlayer = -1);
+void MSG_BroadcastSVC(const clientBuf_e buf, const EncodedSVC& enc,
+                      const int skipPlayer = -1);
 
 int MSG_BytesLeft(void);
 int MSG_NextByte (void);
@@ -791,8 +912,34 @@ bool MSG_ReadProto(MSG& msg)
 
 size_t MSG_SetOffset (const size_t &offset, const buf_t::seek_loc_t &loc);
 
+struct z_stream_s;
+
+/**
+ * @brief Scratch memory for compressing packets.  Every thread that
+ *        compresses packets needs its own.
+ */
+struct CompressScratch
+{
+	buf_t compressed;
+	std::vector<unsigned char> wrkmem;
+	z_stream_s* zstream;
+
+	CompressScratch();
+	CompressScratch(const CompressScratch& other);
+	~CompressScratch();
+	CompressScratch& operator=(const CompressScratch& other);
+};
+
 bool MSG_DecompressMinilzo ();
+bool MSG_DecompressMinilzo (buf_t &buf);
 bool MSG_CompressMinilzo (buf_t &buf, size_t start_offset, size_t write_gap);
+bool MSG_CompressMinilzo (buf_t &buf, size_t start_offset, size_t write_gap, CompressScratch &scratch);
 
 bool MSG_DecompressAdaptive (huffman &huff);
-bool MSG_CompressAdaptive (huffman &huff, buf_t &buf, size_t start_offset, size_t write_gap);
+bool MSG_DecompressAdaptive (huffman &huff, buf_t &buf);
+bool MSG_CompressAdaptive (huffman &huff, buf_t &buf, size_t start_offset, size_t write_gap, CompressScratch &scratch);
+
+bool MSG_DecompressDeflate ();
+bool MSG_DecompressDeflate (buf_t &buf);
+bool MSG_CompressDeflate (buf_t &buf, size_t start_offset, size_t write_gap, CompressScratch &scratch);
+const std::string& MSG_DeflateDictionary ();
@@ -1050,6 +1050,54 @@ void A_Chase (AActor *actor)
 }
 
 
+//
+// P_GatherSightQueries
+//
+// Queue the sight checks that A_Look and A_Chase are likely to make this
+// tic, so they can be worked out ahead of time.  Only monsters entering
+// one of those states on this tic are looked at.  Guessing wrong costs a
+// wasted check, never a different outcome.
+//
+void P_GatherSightQueries()
+{
+	P_ClearSightQueries();
+
+	// Only the vanilla sight check can be worked out ahead of time.
+	if (co_zdoomphys || map_format.getZDoom())
+		return;
+
+	TThinkerIterator<AActor> iterator;
+	AActor* actor;
+
+	while ((actor = iterator.Next()))
+	{
+		if (actor->tics != 1 || actor->player || !actor->subsector || !actor->state ||
+		    (actor->flags2 & MF2_DORMANT))
+			continue;
+
+		actionf_p1 action = states[actor->state->nextstate].action;
+		if (action != A_Look && action != A_Chase)
+			continue;
+
+		AActor* target = actor->target;
+		if (action == A_Look)
+			target = actor->subsector->sector->soundtarget;
+
+		if (target && target->health > 0)
+		{
+			P_AddSightQuery(actor, target);
+			if (action == A_Chase)
+				continue;
+		}
+
+		for (Players::iterator it = players.begin(); it != players.end(); ++it)
+		{
+			if (it->ingame() && !it->spectator && it->mo)
+				P_AddSightQuery(actor, it->mo);
+		}
+	}
+}
+
 //
 // A_FaceTarget
 //
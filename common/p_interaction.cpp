@@ -96,13 +96,7 @@ void SV_ShareKeys(card_t card, player_t& player);
 static void PersistPlayerDamage(player_t& p)
 {
 	// Send this information to everybody.
-	for (Players::iterator it = ::players.begin(); it != ::players.end(); ++it)
-	{
-		if (!it->ingame())
-			continue;
-
-		MSG_WriteSVC(&it->client.netbuf, SVC_PlayerMembers(p, SVC_PM_DAMAGE));
-	}
+	MSG_BroadcastSVC(CLBUF_NET, SVC_PlayerMembers(p, SVC_PM_DAMAGE));
 }
 
 static void PersistPlayerScore(player_t& p, const bool lives, const bool score)
@@ -123,13 +117,7 @@ static void PersistPlayerScore(player_t& p, const bool lives, const bool score)
 		flags |= SVC_PM_SCORE;
 
 	// Send this information to everybody.
-	for (Players::iterator it = ::players.begin(); it != ::players.end(); ++it)
-	{
-		if (!it->ingame())
-			continue;
-
-		MSG_WriteSVC(&it->client.netbuf, SVC_PlayerMembers(p, flags));
-	}
+	MSG_BroadcastSVC(CLBUF_NET, SVC_PlayerMembers(p, flags));
 }
 
 static void PersistTeamScore(team_t team)
@@ -139,12 +127,7 @@ static void PersistTeamScore(team_t team)
 		return;
 
 	// Send this information to everybody.
-	for (Players::iterator it = ::players.begin(); it != ::players.end(); ++it)
-	{
-		if (!it->ingame())
-			continue;
-		MSG_WriteSVC(&it->client.netbuf, SVC_TeamMembers(team));
-	}
+	MSG_BroadcastSVC(CLBUF_NET, SVC_TeamMembers(team));
 }
 
 //
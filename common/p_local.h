@@ -174,9 +174,7 @@ typedef struct
 
 #define MAXINTERCEPTS	128
 
-extern TArray<intercept_t> intercepts;
-
-typedef BOOL (*traverser_t) (intercept_t *in);
+typedef BOOL (*traverser_t) (intercept_t *in, const divline_t& trace);
 
 subsector_t* P_PointInSubsector(fixed_t x, fixed_t y);
 fixed_t P_AproxDistance (fixed_t dx, fixed_t dy);
@@ -200,24 +198,12 @@ extern fixed_t			lowfloor;
 
 void P_LineOpening (const line_t *linedef, fixed_t x, fixed_t y, fixed_t refx=MINFIXED, fixed_t refy=0);
 
-BOOL P_BlockLinesIterator (int x, int y, BOOL(*func)(line_t*) );
-BOOL P_BlockThingsIterator (int x, int y, BOOL(*func)(AActor*), AActor *start=NULL);
+// The blockmap iterators and P_PathTraverse are in p_maputl.h.
 
 #define PT_ADDLINES 	1
 #define PT_ADDTHINGS	2
 #define PT_EARLYOUT 	4
 
-extern divline_t		trace;
-
-BOOL
-P_PathTraverse
-( fixed_t		x1,
-  fixed_t		y1,
-  fixed_t		x2,
-  fixed_t		y2,
-  int			flags,
-  BOOL		(*trav) (intercept_t *));
-
 // [ML] 2/1/10: Break out P_PointToAngle from R_PointToAngle2 (from EE)
 angle_t P_PointToAngle(fixed_t xo, fixed_t yo, fixed_t x, fixed_t y);
 
@@ -272,6 +258,7 @@ fixed_t P_HighestHeightOfFloor(sector_t *sector);
 bool P_IsPlaneLevel(const plane_t *plane);
 bool P_IdenticalPlanes(const plane_t *pl1, const plane_t *pl2);
 void P_InvertPlane(plane_t *plane);
+extern unsigned int planechangecount;
 void P_ChangeCeilingHeight(sector_t *sector, fixed_t amount);
 void P_ChangeFloorHeight(sector_t *sector, fixed_t amount);
 void P_SetCeilingHeight(sector_t *sector, fixed_t value);
@@ -285,6 +272,15 @@ v3fixed_t P_LinePlaneIntersection(const plane_t *plane, const v3fixed_t &lineorg
 
 
 bool P_CheckSightEdges(const AActor* t1, const AActor* t2, float radius_boost);
+
+// Sight checks worked out ahead of time, see p_sight.cpp
+void P_ClearSightQueries();
+void P_AddSightQuery(const AActor* t1, const AActor* t2);
+size_t P_PrepareSightQueries();
+void P_RunSightQuery(size_t index);
+void P_StartSightQueries();
+void P_GatherSightQueries();
+void P_PrepareMonsterSight();	// in sv_game.cpp and cl_game.cpp
 bool P_SpecialIsWeapon(AActor* special);
 
 bool	P_ChangeSector (sector_t* sector, int crunch);
@@ -322,6 +318,28 @@ extern fixed_t			bmaporgx;
 extern fixed_t			bmaporgy;		// origin of block map
 extern AActor** 		blocklinks; 	// for thing chains
 
+// The blockmap line lists packed in groups of four, next to the bounding
+// boxes of their lines, so a box can be checked against a group at once.
+struct blockgroup_t
+{
+	fixed_t			left[4];
+	fixed_t			right[4];
+	fixed_t			bottom[4];
+	fixed_t			top[4];
+	int				line[4];
+};
+
+struct blockcell_t
+{
+	int				first;		// first group in blockgroups
+	int				count;		// entries in the list, -1 if not packed
+};
+
+extern blockcell_t*		blockcells;		// NULL until P_PackBlockMap
+extern blockgroup_t*	blockgroups;
+
+void P_PackBlockMap();
+
 extern std::set<short>	movable_sectors;
 
 
@@ -481,6 +499,7 @@ enum
 extern polyobj_t *polyobjs; // list of all poly-objects on the level
 extern int po_NumPolyobjs;
 extern polyspawns_t *polyspawns;	// [RH] list of polyobject things to spawn
+extern unsigned int polychangecount;	// bumped whenever a polyobject moves
 
 
 BOOL PO_MovePolyobj (int num, int x, int y);
@@ -493,6 +512,11 @@ bool P_IsFriendlyThing(AActor* actor, AActor* friendshiptest);
 bool P_IsTeamMate(AActor* actor, AActor* player);
 
 
+//
+// P_MAPUTL
+//
+#include "p_maputl.h"
+
 //
 // P_SPEC
 //
@@ -25,6 +25,8 @@
 
 #include "odamex.h"
 
+#include <algorithm>
+
 #include "m_alloc.h"
 #include "m_bbox.h"
 #include "m_random.h"
@@ -56,11 +58,6 @@ bool P_ShouldClipPlayer(AActor* projectile, AActor* player);
 EXTERN_CVAR(sv_unblockplayers)
 
 fixed_t 		tmbbox[4];
-static AActor  *tmthing;
-static int 		tmflags;
-static fixed_t	tmx;
-static fixed_t	tmy;
-static fixed_t	tmz;	// [RH] Needed for third dimension of teleporters
 static int		pe_x;	// Pain Elemental position for Lost Soul checks	// phares
 static int		pe_y;	// Pain Elemental position for Lost Soul checks	// phares
 static int		ls_x;	// Lost Soul position for Lost Soul checks		// phares
@@ -89,6 +86,64 @@ std::vector<line_t*> spechit;
 AActor *onmobj; // generic global onmobj...used for landing on pods/players
 AActor *BlockingMobj;
 
+// State of a single position check: P_CheckPosition, P_TeleportMove,
+// P_TestMobjZ or P_ApplyTorque.  Their PIT_* callbacks work on this rather
+// than on globals, so a check started from one of their side effects (a
+// pickup, a damage callback, a telefrag) cannot clobber the one that is
+// running.  The results the rest of the game reads are copied to the
+// globals above when the check is done.
+//
+// This differs from vanilla, where a nested check overwrote the tm*
+// globals in the middle of the outer one, which then carried on with the
+// inner thing's box and floor.  Now the outer check keeps its own state and
+// only the published globals change, once the nested check returns.
+struct checkposition_t
+{
+	AActor		*thing;
+	int			flags;
+	fixed_t		x;
+	fixed_t		y;
+	fixed_t		z;		// [RH] Needed for third dimension of teleporters
+	fixed_t		bbox[4];
+
+	fixed_t		floorz;
+	fixed_t		ceilingz;
+	fixed_t		dropoffz;
+	sector_t	*floorsector;
+	line_t		*ceilingline;
+	line_t		*blockingline;
+	AActor		*blockingmobj;
+	std::vector<line_t*> spechit;
+
+	// For checks that only look at things or lines around the position.
+	checkposition_t(AActor *mo, fixed_t nx, fixed_t ny) :
+		thing(mo), flags(mo->flags), x(nx), y(ny), z(mo->z),
+		floorz(0), ceilingz(0), dropoffz(0), floorsector(NULL),
+		ceilingline(NULL), blockingline(NULL), blockingmobj(NULL)
+	{
+		setbox();
+	}
+
+	// The base floor / ceiling is from the subsector that contains the point.
+	// Any contacted lines the step closer together will adjust them.
+	checkposition_t(AActor *mo, fixed_t nx, fixed_t ny, sector_t *sec) :
+		thing(mo), flags(mo->flags), x(nx), y(ny), z(mo->z),
+		floorz(P_FloorHeight(nx, ny, sec)), ceilingz(P_CeilingHeight(nx, ny, sec)),
+		floorsector(sec), ceilingline(NULL), blockingline(NULL), blockingmobj(NULL)
+	{
+		dropoffz = floorz;
+		setbox();
+	}
+
+	void setbox()
+	{
+		bbox[BOXTOP] = y + thing->radius;
+		bbox[BOXBOTTOM] = y - thing->radius;
+		bbox[BOXRIGHT] = x + thing->radius;
+		bbox[BOXLEFT] = x - thing->radius;
+	}
+};
+
 // Temporary holder for thing_sectorlist threads
 msecnode_t* sector_list = NULL;		// phares 3/16/98
 
@@ -115,9 +170,7 @@ CVAR_FUNC_IMPL (sv_gravity)
 //
 // PIT_StompThing
 //
-static BOOL StompAlwaysFrags;
-
-BOOL PIT_StompThing (AActor *thing)
+static BOOL PIT_StompThing (checkposition_t &tm, bool alwaysfrags, AActor *thing)
 {
 	fixed_t blockdist;
 
@@ -128,20 +181,20 @@ BOOL PIT_StompThing (AActor *thing)
 	if (thing->player && thing->player->spectator)
 		return true;
 
-	if (tmthing->player && tmthing->player->spectator)
+	if (tm.thing->player && tm.thing->player->spectator)
 		return true;
 
 	// Unblocked players shouldn't telefrag friendlies.  Thanks Amateur Spammer!
-	if (tmthing->player && thing->player && sv_unblockplayers)
+	if (tm.thing->player && thing->player && sv_unblockplayers)
 		return true;
 
 	// don't clip against self
-	if (thing == tmthing)
+	if (thing == tm.thing)
 		return true;
 
-	blockdist = thing->radius + tmthing->radius;
+	blockdist = thing->radius + tm.thing->radius;
 
-	if (abs(thing->x - tmx) >= blockdist || abs(thing->y - tmy) >= blockdist)
+	if (abs(thing->x - tm.x) >= blockdist || abs(thing->y - tm.y) >= blockdist)
 	{
 		// didn't hit it
 		return true;
@@ -150,26 +203,34 @@ BOOL PIT_StompThing (AActor *thing)
 	if (P_AllowPassover())
 	{
 		// [RH] Z-Check
-		if (tmz > thing->z + thing->height)
+		if (tm.z > thing->z + thing->height)
 			return true;        // overhead
-		if (tmz + tmthing->height < thing->z)
+		if (tm.z + tm.thing->height < thing->z)
 			return true;        // underneath
 	}
 
 	// monsters don't stomp things except on boss level
-	if (StompAlwaysFrags)
+	if (alwaysfrags)
 	{
 		// [AM] Surprise, avatars telefrag players who try to telefrag it!
 		//      Not your lucky day, I suppose.
-		if (thing->type == MT_AVATAR && tmthing->player)
-			P_DamageMobj(tmthing, thing, thing, 10000, MOD_TELEFRAG);
+		if (thing->type == MT_AVATAR && tm.thing->player)
+			P_DamageMobj(tm.thing, thing, thing, 10000, MOD_TELEFRAG);
 		else
-			P_DamageMobj(thing, tmthing, tmthing, 10000, MOD_TELEFRAG);
+			P_DamageMobj(thing, tm.thing, tm.thing, 10000, MOD_TELEFRAG);
 		return true;
 	}
 	return false;
 }
 
+struct StompThing
+{
+	checkposition_t &tm;
+	bool alwaysfrags;
+	StompThing(checkposition_t &ctx, bool frags) : tm(ctx), alwaysfrags(frags) {}
+	BOOL operator() (AActor *thing) const { return PIT_StompThing(tm, alwaysfrags, thing); }
+};
+
 
 //
 // P_TeleportMove
@@ -189,55 +250,43 @@ BOOL P_TeleportMove (AActor *thing, fixed_t x, fixed_t y, fixed_t z, BOOL telefr
 	int 				bx;
 	int 				by;
 
-	subsector_t*		newsubsec;
+	subsector_t*		newsubsec = P_PointInSubsector (x,y);
 
 	// kill anything occupying the position
-	tmthing = thing;
-
-	tmx = x;
-	tmy = y;
-	tmz = z;
-
-	tmbbox[BOXTOP] = y + tmthing->radius;
-	tmbbox[BOXBOTTOM] = y - tmthing->radius;
-	tmbbox[BOXRIGHT] = x + tmthing->radius;
-	tmbbox[BOXLEFT] = x - tmthing->radius;
-
-	newsubsec = P_PointInSubsector (x,y);
+	checkposition_t tm(thing, x, y, newsubsec->sector);
+	tm.z = z;
+
+	// Published before the stomping, as it always was, for whatever a
+	// telefrag side effect reads.  The move itself uses tm below.
+	tmfloorz = tmdropoffz = tm.floorz;
+	tmceilingz = tm.ceilingz;
+	tmfloorsector = tm.floorsector;
 	ceilingline = NULL;
 
-	// The base floor/ceiling is from the subsector
-	// that contains the point.
-	// Any contacted lines the step closer together
-	// will adjust them.
-	tmfloorz = tmdropoffz = P_FloorHeight(x, y, newsubsec->sector);
-	tmceilingz = P_CeilingHeight(x, y, newsubsec->sector);
-	tmfloorsector = newsubsec->sector;
-
 	validcount++;
 	spechit.clear();
 
-	StompAlwaysFrags = tmthing->player || tmthing->type == MT_AVATAR ||
+	bool alwaysfrags = thing->player || thing->type == MT_AVATAR ||
 	                   (level.flags & LEVEL_MONSTERSTELEFRAG) || telefrag;
 
 	// stomp on any things contacted
-	xl = (tmbbox[BOXLEFT] - bmaporgx - MAXRADIUS)>>MAPBLOCKSHIFT;
-	xh = (tmbbox[BOXRIGHT] - bmaporgx + MAXRADIUS)>>MAPBLOCKSHIFT;
-	yl = (tmbbox[BOXBOTTOM] - bmaporgy - MAXRADIUS)>>MAPBLOCKSHIFT;
-	yh = (tmbbox[BOXTOP] - bmaporgy + MAXRADIUS)>>MAPBLOCKSHIFT;
+	xl = (tm.bbox[BOXLEFT] - bmaporgx - MAXRADIUS)>>MAPBLOCKSHIFT;
+	xh = (tm.bbox[BOXRIGHT] - bmaporgx + MAXRADIUS)>>MAPBLOCKSHIFT;
+	yl = (tm.bbox[BOXBOTTOM] - bmaporgy - MAXRADIUS)>>MAPBLOCKSHIFT;
+	yh = (tm.bbox[BOXTOP] - bmaporgy + MAXRADIUS)>>MAPBLOCKSHIFT;
 
 	for (bx=xl ; bx<=xh ; bx++)
 		for (by=yl ; by<=yh ; by++)
-			if (!P_BlockThingsIterator(bx,by,PIT_StompThing))
+			if (!P_BlockThingsIterator(bx,by,StompThing(tm, alwaysfrags)))
 				return false;
 
 	// the move is ok,
 	// so link the thing into its new position
 	thing->SetOrigin (x, y, z);
-	thing->floorz = tmfloorz;
-	thing->ceilingz = tmceilingz;
-	thing->dropoffz = tmfloorz;
-	thing->floorsector = tmfloorsector;
+	thing->floorz = tm.floorz;
+	thing->ceilingz = tm.ceilingz;
+	thing->dropoffz = tm.floorz;
+	thing->floorsector = tm.floorsector;
 
 	return true;
 }
@@ -373,19 +422,19 @@ BOOL PIT_CrossLine (line_t* ld)
 
 //
 // PIT_CheckLine
-// Adjusts tmfloorz and tmceilingz as lines are contacted
+// Adjusts tm.floorz and tm.ceilingz as lines are contacted
 //
 
 static // killough 3/26/98: make static
-BOOL PIT_CheckLine (line_t *ld)
+BOOL PIT_CheckLine (checkposition_t &tm, line_t *ld)
 {
-	if (tmbbox[BOXRIGHT] <= ld->bbox[BOXLEFT]
-		|| tmbbox[BOXLEFT] >= ld->bbox[BOXRIGHT]
-		|| tmbbox[BOXTOP] <= ld->bbox[BOXBOTTOM]
-		|| tmbbox[BOXBOTTOM] >= ld->bbox[BOXTOP] )
+	if (tm.bbox[BOXRIGHT] <= ld->bbox[BOXLEFT]
+		|| tm.bbox[BOXLEFT] >= ld->bbox[BOXRIGHT]
+		|| tm.bbox[BOXTOP] <= ld->bbox[BOXBOTTOM]
+		|| tm.bbox[BOXBOTTOM] >= ld->bbox[BOXTOP] )
 		return true;
 
-	if (P_BoxOnLineSide (tmbbox, ld) != -1)
+	if (P_BoxOnLineSide (tm.bbox, ld) != -1)
 		return true;
 
 
@@ -402,34 +451,34 @@ BOOL PIT_CheckLine (line_t *ld)
 
 	if (!ld->backsector)
 	{ // One sided line
-		BlockingLine = ld;
-		CheckForPushSpecial(ld, 0, tmthing);
+		tm.blockingline = ld;
+		CheckForPushSpecial(ld, 0, tm.thing);
 		return false;
 	}
 
-    if (!(tmthing->flags & (MF_MISSILE | MF_BOUNCES)) || (ld->flags & ML_BLOCKEVERYTHING))
+    if (!(tm.thing->flags & (MF_MISSILE | MF_BOUNCES)) || (ld->flags & ML_BLOCKEVERYTHING))
     {
 		if ((ld->flags &
 		     (ML_BLOCKING | ML_BLOCKEVERYTHING)) || // explicitly blocking everything
-		    (!tmthing->player && tmthing->type != MT_AVATAR && (ld->flags & ML_BLOCKMONSTERS)) || // block monsters only
-		    (!tmthing->player && tmthing->type != MT_AVATAR && (ld->flags & ML_BLOCKLANDMONSTERS) &&
-		     !(tmthing->flags & MF_FLOAT)) || // [Blair] Block land monsters.
-		    (tmthing->player &&
+		    (!tm.thing->player && tm.thing->type != MT_AVATAR && (ld->flags & ML_BLOCKMONSTERS)) || // block monsters only
+		    (!tm.thing->player && tm.thing->type != MT_AVATAR && (ld->flags & ML_BLOCKLANDMONSTERS) &&
+		     !(tm.thing->flags & MF_FLOAT)) || // [Blair] Block land monsters.
+		    (tm.thing->player &&
 		     (ld->flags & ML_BLOCKPLAYERS))) // [Blair] Block players only
 		{
-			CheckForPushSpecial(ld, 0, tmthing);
+			CheckForPushSpecial(ld, 0, tm.thing);
 			return false;
 		}		
     }
 
 	// [RH] Steep sectors count as dropoffs (unless already in one)
-	if (!(tmthing->flags & MF_DROPOFF) &&
-		!(tmthing->flags & (MF_NOGRAVITY|MF_NOCLIP)))
+	if (!(tm.thing->flags & MF_DROPOFF) &&
+		!(tm.thing->flags & (MF_NOGRAVITY|MF_NOCLIP)))
 	{
 		if (ld->frontsector->floorplane.c < STEEPSLOPE ||
 			ld->backsector->floorplane.c < STEEPSLOPE)
 		{
-			const msecnode_t *node = tmthing->touching_sectorlist;
+			const msecnode_t *node = tm.thing->touching_sectorlist;
 			bool allow = false;
 			int count = 0;
 			while (node != NULL)
@@ -456,7 +505,7 @@ BOOL PIT_CheckLine (line_t *ld)
 		P_IsPlaneLevel(&ld->frontsector->ceilingplane) &&
 		P_IsPlaneLevel(&ld->backsector->ceilingplane))
 	{
-		P_LineOpening(ld, tmx, tmy, tmx, tmy);
+		P_LineOpening(ld, tm.x, tm.y, tm.x, tm.y);
 	}
 	else
 	{
@@ -464,47 +513,47 @@ BOOL PIT_CheckLine (line_t *ld)
 		// that to calculate openings
 		double dx = FIXED2DOUBLE(ld->dx);
 		double dy = FIXED2DOUBLE(ld->dy);
-		double r =	(FIXED2DOUBLE(tmx - ld->v1->x) * dx +
-					 FIXED2DOUBLE(tmy - ld->v1->y) * dy) /
+		double r =	(FIXED2DOUBLE(tm.x - ld->v1->x) * dx +
+					 FIXED2DOUBLE(tm.y - ld->v1->y) * dy) /
 					(dx * dx + dy * dy);
 
 		if (r <= 0.0)
 		{
-			P_LineOpening (ld, ld->v1->x, ld->v1->y, tmx, tmy);
+			P_LineOpening (ld, ld->v1->x, ld->v1->y, tm.x, tm.y);
 		}
 		else if (r >= 1.0)
 		{
-			P_LineOpening (ld, ld->v2->x, ld->v2->y, tmthing->x, tmthing->y);
+			P_LineOpening (ld, ld->v2->x, ld->v2->y, tm.thing->x, tm.thing->y);
 		}
 		else
 		{
 			fixed_t sx = ld->v1->x + r * ld->dx;
 			fixed_t sy = ld->v1->y + r * ld->dy;
-			P_LineOpening (ld, sx, sy, tmx, tmy);
+			P_LineOpening (ld, sx, sy, tm.x, tm.y);
 		}
 	}
 
 	// adjust floor / ceiling heights
-	if (opentop < tmceilingz)
+	if (opentop < tm.ceilingz)
 	{
-		tmceilingz = opentop;
-		ceilingline = ld;
-		BlockingLine = ld;
+		tm.ceilingz = opentop;
+		tm.ceilingline = ld;
+		tm.blockingline = ld;
 	}
 
-	if (openbottom > tmfloorz)
+	if (openbottom > tm.floorz)
 	{
-		tmfloorz = openbottom;
-		tmfloorsector = openbottomsec;
-		BlockingLine = ld;
+		tm.floorz = openbottom;
+		tm.floorsector = openbottomsec;
+		tm.blockingline = ld;
 	}
 
-	if (lowfloor < tmdropoffz)
-		tmdropoffz = lowfloor;
+	if (lowfloor < tm.dropoffz)
+		tm.dropoffz = lowfloor;
 
 	// if contacted a special line, add it to the list
 	if (ld->special)
-		spechit.push_back(ld);
+		tm.spechit.push_back(ld);
 
 	return true;
 }
@@ -563,12 +612,12 @@ static bool P_ProjectileImmune(AActor* target, AActor* source)
 	                mobjinfo[source->type].projectile_group));
 }
 
-static BOOL PIT_CheckThing (AActor *thing)
+static BOOL PIT_CheckThing (checkposition_t &tm, AActor *thing)
 {
 	bool solid = thing->flags & MF_SOLID;
 
 	// don't clip against self
-	if (thing == tmthing)
+	if (thing == tm.thing)
 		return true;
 
 	if (!(thing->flags & (MF_SOLID|MF_SPECIAL|MF_SHOOTABLE)) )
@@ -576,39 +625,39 @@ static BOOL PIT_CheckThing (AActor *thing)
 
 	// GhostlyDeath -- Spectators go through everything!
 	if ((thing->player && thing->player->spectator) ||
-		(tmthing->player && tmthing->player->spectator))
+		(tm.thing->player && tm.thing->player->spectator))
 		return true;
 
-	if (tmthing->player && thing->player && sv_unblockplayers)
+	if (tm.thing->player && thing->player && sv_unblockplayers)
 		return true;
 
-	fixed_t blockdist = thing->radius + tmthing->radius;
-	if (abs(thing->x - tmx) >= blockdist || abs(thing->y - tmy) >= blockdist)
+	fixed_t blockdist = thing->radius + tm.thing->radius;
+	if (abs(thing->x - tm.x) >= blockdist || abs(thing->y - tm.y) >= blockdist)
 	{
 		// didn't hit thing
 		return true;
 	}
 
 	if (P_AllowPassover())
-		BlockingMobj = thing;
+		tm.blockingmobj = thing;
 
-	if (P_AllowPassover() && (tmthing->flags2 & MF2_PASSMOBJ))
+	if (P_AllowPassover() && (tm.thing->flags2 & MF2_PASSMOBJ))
 	{
 		// check if a mobj passed over/under another object
-		if (tmthing->z >= thing->z + thing->height || tmthing->z + tmthing->height <= thing->z)
+		if (tm.thing->z >= thing->z + thing->height || tm.thing->z + tm.thing->height <= thing->z)
 			return true;
 	}
 
 	// check for skulls slamming into things
-	if (tmthing->flags & MF_SKULLFLY)
+	if (tm.thing->flags & MF_SKULLFLY)
 	{
-		int damage = ((P_Random(tmthing)%8)+1) * tmthing->info->damage;
-		P_DamageMobj (thing, tmthing, tmthing, damage, MOD_HIT);
-		tmthing->flags &= ~MF_SKULLFLY;
-		tmthing->momx = tmthing->momy = tmthing->momz = 0;
-		P_SetMobjState (tmthing, tmthing->info->spawnstate);
+		int damage = ((P_Random(tm.thing)%8)+1) * tm.thing->info->damage;
+		P_DamageMobj (thing, tm.thing, tm.thing, damage, MOD_HIT);
+		tm.thing->flags &= ~MF_SKULLFLY;
+		tm.thing->momx = tm.thing->momy = tm.thing->momz = 0;
+		P_SetMobjState (tm.thing, tm.thing->info->spawnstate);
 		if (P_AllowPassover())
-			BlockingMobj = NULL;
+			tm.blockingmobj = NULL;
 		return false;			// stop moving
 	}
 
@@ -616,19 +665,19 @@ static BOOL PIT_CheckThing (AActor *thing)
 	// [Blair] This emulates hexen behavior, where rockets can push
 	// dead/stationary things marked bouncy.
 	// Out of place in Doom, should fix.
-	if (tmthing->flags & MF_MISSILE || (tmthing->flags & MF_BOUNCES 
-		&& !(tmthing->flags & MF_SOLID)))
+	if (tm.thing->flags & MF_MISSILE || (tm.thing->flags & MF_BOUNCES 
+		&& !(tm.thing->flags & MF_SOLID)))
 	{
 		// see if it went over / under
-		if (tmthing->z > thing->z + thing->height)
+		if (tm.thing->z > thing->z + thing->height)
 			return true;				// overhead
-		if (tmthing->z+tmthing->height < thing->z)
+		if (tm.thing->z+tm.thing->height < thing->z)
 			return true;				// underneath
 
-		if (tmthing->target && P_ProjectileImmune(thing, tmthing->target))
+		if (tm.thing->target && P_ProjectileImmune(thing, tm.thing->target))
 		{
 			// Don't hit same species as originator.
-			if (thing == tmthing->target)
+			if (thing == tm.thing->target)
 				return true;
 
 			// [RH] DeHackEd infighting is here.
@@ -640,36 +689,36 @@ static BOOL PIT_CheckThing (AActor *thing)
 			return !solid;		// didn't do any damage
 
 		// Don't clip the projectile unless it's not a teammate.
-		if (!P_ShouldClipPlayer(tmthing, thing))
+		if (!P_ShouldClipPlayer(tm.thing, thing))
 			return true;
 
-		if (tmthing->flags2 & MF2_RIP)
+		if (tm.thing->flags2 & MF2_RIP)
 		{
-			int damage = ((P_Random() & 3) + 2) * tmthing->info->damage;
+			int damage = ((P_Random() & 3) + 2) * tm.thing->info->damage;
 			if (!(thing->flags & MF_NOBLOOD))
-				P_SpawnBlood(tmthing->x, tmthing->y, tmthing->z, damage);
-			if (tmthing->info->ripsound)
-				S_Sound(tmthing, CHAN_VOICE, tmthing->info->ripsound, 1, ATTN_NORM);
+				P_SpawnBlood(tm.thing->x, tm.thing->y, tm.thing->z, damage);
+			if (tm.thing->info->ripsound)
+				S_Sound(tm.thing, CHAN_VOICE, tm.thing->info->ripsound, 1, ATTN_NORM);
 
-			P_DamageMobj(thing, tmthing, tmthing->target, damage, MOD_UNKNOWN);
-			if (thing->flags2 & MF2_PUSHABLE && !(tmthing->flags2 & MF2_CANNOTPUSH))
+			P_DamageMobj(thing, tm.thing, tm.thing->target, damage, MOD_UNKNOWN);
+			if (thing->flags2 & MF2_PUSHABLE && !(tm.thing->flags2 & MF2_CANNOTPUSH))
 			{ // Push thing
-				thing->momx += tmthing->momx >> 2;
-				thing->momy += tmthing->momy >> 2;
+				thing->momx += tm.thing->momx >> 2;
+				thing->momy += tm.thing->momy >> 2;
 			}
 
 			return true;
 		}
 
 		// damage / explode
-		if (tmthing->info->damage)
+		if (tm.thing->info->damage)
 		{
-			int damage = ((P_Random(tmthing)%8)+1) * tmthing->info->damage;
+			int damage = ((P_Random(tm.thing)%8)+1) * tm.thing->info->damage;
 			{
 				// [RH] figure out the means of death
 				int mod;
 
-				switch (tmthing->type) {
+				switch (tm.thing->type) {
 					case MT_ROCKET:
 						mod = MOD_ROCKET;
 						break;
@@ -682,7 +731,7 @@ static BOOL PIT_CheckThing (AActor *thing)
 					// [AM] Monster fireballs get a special MOD.
 				  // Unless they're from players
 					default:
-							if ((tmthing->target && tmthing->target->player) || !tmthing->target)
+							if ((tm.thing->target && tm.thing->target->player) || !tm.thing->target)
 							{
 						        mod = MOD_UNKNOWN;
 							}
@@ -692,7 +741,7 @@ static BOOL PIT_CheckThing (AActor *thing)
 							}
 						break;
 				}
-				P_DamageMobj (thing, tmthing, tmthing->target, damage, mod);
+				P_DamageMobj (thing, tm.thing, tm.thing->target, damage, mod);
 			}
 		}
 
@@ -700,25 +749,25 @@ static BOOL PIT_CheckThing (AActor *thing)
 	}
 
 	// check for special pickup
-	if (thing->flags & MF_SPECIAL && tmthing->flags & MF_PICKUP)
+	if (thing->flags & MF_SPECIAL && tm.thing->flags & MF_PICKUP)
 	{
 		// [SL] Work-around the additional height added to players
 		// in P_CheckPosition. Don't let players grab items above
 		// their real height!
 
-		fixed_t max_z = tmthing->z + tmthing->height;
+		fixed_t max_z = tm.thing->z + tm.thing->height;
 
-		if (tmthing->player)
+		if (tm.thing->player)
 			max_z -= 24 * FRACUNIT;
 
 		if (!P_AllowPassover() || thing->z < max_z)
-			P_TouchSpecialThing (thing, tmthing);	// can remove thing
+			P_TouchSpecialThing (thing, tm.thing);	// can remove thing
 
 		return !solid;
 	}
 
 	// killough 3/16/98: Allow non-solid moving objects to move through solid
-	// ones, by allowing the moving thing (tmthing) to move if it's non-solid,
+	// ones, by allowing the moving thing (tm.thing) to move if it's non-solid,
 	// despite another solid thing being in the way.
 	// killough 4/11/98: Treat no-clipping things as not blocking
 	// ...but not in demo_compatibility mode
@@ -733,7 +782,7 @@ static BOOL PIT_CheckThing (AActor *thing)
 		return !(thing->flags & MF_SOLID);
 	else
 		return !((thing->flags & MF_SOLID && !(thing->flags & MF_NOCLIP)) &&
-		         (tmthing->flags & MF_SOLID || (demoplayback || !co_boomphys)));
+		         (tm.thing->flags & MF_SOLID || (demoplayback || !co_boomphys)));
 }
 
 // This routine checks for Lost Souls trying to be spawned		// phares
@@ -789,7 +838,7 @@ BOOL Check_Sides(AActor* actor, int x, int y)
 //
 //---------------------------------------------------------------------------
 
-BOOL PIT_CheckOnmobjZ (AActor *thing)
+static BOOL PIT_CheckOnmobjZ (checkposition_t &tm, AActor *thing)
 {
 	if (!(thing->flags & MF_SOLID))
 		return true;
@@ -799,31 +848,38 @@ BOOL PIT_CheckOnmobjZ (AActor *thing)
 		return true;
 
 	// Don't clip against self
-	if (thing == tmthing)
+	if (thing == tm.thing)
 		return true;
 
 	// Don't clip against a player
-	if (tmthing->player && thing->player && sv_unblockplayers)
+	if (tm.thing->player && thing->player && sv_unblockplayers)
 		return true;
 
 	// over / under thing
-	if (tmthing->z > thing->z + thing->height)
+	if (tm.thing->z > thing->z + thing->height)
 		return true;
-	else if (tmthing->z + tmthing->height <= thing->z)
+	else if (tm.thing->z + tm.thing->height <= thing->z)
 		return true;
 
 	// Don't clip the projectile unless it's not a teammate.
-	if (tmthing->flags & MF_MISSILE && !P_ShouldClipPlayer(tmthing, thing))
+	if (tm.thing->flags & MF_MISSILE && !P_ShouldClipPlayer(tm.thing, thing))
 		return true;
 
-	fixed_t blockdist = thing->radius+tmthing->radius;
-	if (abs(thing->x - tmx) >= blockdist || abs(thing->y - tmy) >= blockdist)
+	fixed_t blockdist = thing->radius+tm.thing->radius;
+	if (abs(thing->x - tm.x) >= blockdist || abs(thing->y - tm.y) >= blockdist)
 		return true;		// Didn't hit thing
 
-	onmobj = thing;
+	tm.blockingmobj = thing;
 	return false;
 }
 
+struct CheckOnmobjZ
+{
+	checkposition_t &tm;
+	CheckOnmobjZ(checkposition_t &ctx) : tm(ctx) {}
+	BOOL operator() (AActor *thing) const { return PIT_CheckOnmobjZ(tm, thing); }
+};
+
 //
 // MOVEMENT CLIPPING
 //
@@ -853,6 +909,22 @@ BOOL P_TestMobjLocation (AActor *mobj)
 	return false;
 }
 
+// Function objects for the blockmap iterators, so the callbacks can be
+// inlined into them.  Both carry the check they belong to.
+struct CheckThing
+{
+	checkposition_t &tm;
+	CheckThing(checkposition_t &ctx) : tm(ctx) {}
+	BOOL operator() (AActor *thing) const { return PIT_CheckThing(tm, thing); }
+};
+
+struct CheckLine
+{
+	checkposition_t &tm;
+	CheckLine(checkposition_t &ctx) : tm(ctx) {}
+	BOOL operator() (line_t *ld) const { return PIT_CheckLine(tm, ld); }
+};
+
 //
 // P_CheckPosition
 // This is purely informative, nothing is modified
@@ -876,37 +948,16 @@ BOOL P_TestMobjLocation (AActor *mobj)
 //	numspeciallines
 //  AActor *BlockingMobj = pointer to thing that blocked position (NULL if not
 //   blocked, or blocked by a line).
-bool P_CheckPosition (AActor *thing, fixed_t x, fixed_t y)
+static bool P_CheckPositionIn (checkposition_t &tm)
 {
+	AActor *thing = tm.thing;
 	AActor *thingblocker = NULL;
 	fixed_t realheight = thing->height;
 	bool spectator = thing->player && thing->player->spectator;
-	subsector_t *subsec = P_PointInSubsector(x,y);
-	// NOTE(jsd): NULL check here fixes crash while awaiting download in an active game.
-	if (subsec == NULL)
-		return false;
-	sector_t *newsec = subsec->sector;
-
-	tmbbox[BOXTOP] = y + thing->radius;
-	tmbbox[BOXBOTTOM] = y - thing->radius;
-	tmbbox[BOXRIGHT] = x + thing->radius;
-	tmbbox[BOXLEFT] = x - thing->radius;
-
-	// The base floor / ceiling is from the subsector that contains the point.
-	// Any contacted lines the step closer together will adjust them.
-	tmfloorz = tmdropoffz = P_FloorHeight(x, y, newsec);
-	tmceilingz = P_CeilingHeight(x, y, newsec);
-	tmfloorsector = newsec;
-	tmthing = thing;
-	tmflags = thing->flags;
-	tmx = x;
-	tmy = y;
-	ceilingline = BlockingLine = NULL;
 
 	validcount++;
-	spechit.clear();
 
-	if (tmflags & MF_NOCLIP && !(tmflags & MF_SKULLFLY))
+	if (tm.flags & MF_NOCLIP && !(tm.flags & MF_SKULLFLY))
 		return true;
 
 	// Check things first, possibly picking things up.
@@ -914,12 +965,12 @@ bool P_CheckPosition (AActor *thing, fixed_t x, fixed_t y)
 	// because DActors are grouped into mapblocks
 	// based on their origin point, and can overlap
 	// into adjacent blocks by up to MAXRADIUS units.
-	int xl = (tmbbox[BOXLEFT] - bmaporgx - MAXRADIUS)>>MAPBLOCKSHIFT;
-	int xh = (tmbbox[BOXRIGHT] - bmaporgx + MAXRADIUS)>>MAPBLOCKSHIFT;
-	int yl = (tmbbox[BOXBOTTOM] - bmaporgy - MAXRADIUS)>>MAPBLOCKSHIFT;
-	int yh = (tmbbox[BOXTOP] - bmaporgy + MAXRADIUS)>>MAPBLOCKSHIFT;
+	int xl = (tm.bbox[BOXLEFT] - bmaporgx - MAXRADIUS)>>MAPBLOCKSHIFT;
+	int xh = (tm.bbox[BOXRIGHT] - bmaporgx + MAXRADIUS)>>MAPBLOCKSHIFT;
+	int yl = (tm.bbox[BOXBOTTOM] - bmaporgy - MAXRADIUS)>>MAPBLOCKSHIFT;
+	int yh = (tm.bbox[BOXTOP] - bmaporgy + MAXRADIUS)>>MAPBLOCKSHIFT;
 
-	BlockingMobj = NULL;
+	tm.blockingmobj = NULL;
 
 	if (P_AllowPassover() && !spectator)
 	{
@@ -933,27 +984,27 @@ bool P_CheckPosition (AActor *thing, fixed_t x, fixed_t y)
 				AActor *robin = NULL;
 				do
 				{
-					if (!P_BlockThingsIterator (bx, by, PIT_CheckThing, robin))
+					if (!P_BlockThingsIterator (bx, by, CheckThing(tm), robin))
 					{ // [RH] If a thing can be stepped up on, we need to continue checking
 					  // other things in the blocks and see if we hit something that is
 					  // definitely blocking. Otherwise, we need to check the lines, or we
 					  // could end up stuck inside a wall.
-						if (BlockingMobj == NULL)
+						if (tm.blockingmobj == NULL)
 						{ // Thing slammed into something; don't let it move now.
 							thing->height = realheight;
 							return false;
 						}
-						else if (!BlockingMobj->player && thing->player &&
-							BlockingMobj->z + BlockingMobj->height - thing->z <= 24*FRACUNIT)
+						else if (!tm.blockingmobj->player && thing->player &&
+							tm.blockingmobj->z + tm.blockingmobj->height - thing->z <= 24*FRACUNIT)
 						{
-							if (thingblocker == NULL ||	BlockingMobj->z > thingblocker->z)
-								thingblocker = BlockingMobj;
+							if (thingblocker == NULL ||	tm.blockingmobj->z > thingblocker->z)
+								thingblocker = tm.blockingmobj;
 
-							robin = BlockingMobj->bmapnode.Next(bx, by);
-							BlockingMobj = NULL;
+							robin = tm.blockingmobj->bmapnode.Next(bx, by);
+							tm.blockingmobj = NULL;
 						}
 						else if (thing->player &&
-							thing->z + thing->height - BlockingMobj->z <= 24*FRACUNIT)
+							thing->z + thing->height - tm.blockingmobj->z <= 24*FRACUNIT)
 						{
 							if (thingblocker)
 							{ // There is something to step up on. Return this thing as
@@ -963,8 +1014,8 @@ bool P_CheckPosition (AActor *thing, fixed_t x, fixed_t y)
 							}
 							// Nothing is blocking us, but this actor potentially could
 							// if there is something else to step on.
-							robin = BlockingMobj->bmapnode.Next(bx, by);
-							BlockingMobj = NULL;
+							robin = tm.blockingmobj->bmapnode.Next(bx, by);
+							tm.blockingmobj = NULL;
 						}
 						else
 						{ // Definitely blocking
@@ -980,11 +1031,11 @@ bool P_CheckPosition (AActor *thing, fixed_t x, fixed_t y)
 			}
 		}
 
-		BlockingMobj = NULL;
+		tm.blockingmobj = NULL;
 		thing->height = realheight;
-		if (tmflags & MF_NOCLIP)
-			return (BlockingMobj = thingblocker) == NULL;
-		if (tmceilingz - tmfloorz < thing->height)
+		if (tm.flags & MF_NOCLIP)
+			return (tm.blockingmobj = thingblocker) == NULL;
+		if (tm.ceilingz - tm.floorz < thing->height)
 			return false;
 	}
 	else
@@ -992,30 +1043,55 @@ bool P_CheckPosition (AActor *thing, fixed_t x, fixed_t y)
 		// vanilla Doom's check for blocking things
 		for (int bx=xl ; bx<=xh ; bx++)
 			for (int by=yl ; by<=yh ; by++)
-				if (!P_BlockThingsIterator(bx,by,PIT_CheckThing))
+				if (!P_BlockThingsIterator(bx,by,CheckThing(tm)))
 					return false;
 
-		if (tmflags & MF_NOCLIP)
+		if (tm.flags & MF_NOCLIP)
 			return true;
 	}
 
 	// check lines
-	xl = (tmbbox[BOXLEFT] - bmaporgx)>>MAPBLOCKSHIFT;
-	xh = (tmbbox[BOXRIGHT] - bmaporgx)>>MAPBLOCKSHIFT;
-	yl = (tmbbox[BOXBOTTOM] - bmaporgy)>>MAPBLOCKSHIFT;
-	yh = (tmbbox[BOXTOP] - bmaporgy)>>MAPBLOCKSHIFT;
+	xl = (tm.bbox[BOXLEFT] - bmaporgx)>>MAPBLOCKSHIFT;
+	xh = (tm.bbox[BOXRIGHT] - bmaporgx)>>MAPBLOCKSHIFT;
+	yl = (tm.bbox[BOXBOTTOM] - bmaporgy)>>MAPBLOCKSHIFT;
+	yh = (tm.bbox[BOXTOP] - bmaporgy)>>MAPBLOCKSHIFT;
 
 	for (int bx=xl ; bx<=xh ; bx++)
 		for (int by=yl ; by<=yh ; by++)
-			if (!P_BlockLinesIterator (bx,by,PIT_CheckLine))
+			if (!P_BlockLinesIterator (bx,by,tm.bbox,CheckLine(tm)))
 				return false;
 
 	if (P_AllowPassover())
-		return (BlockingMobj = thingblocker) == NULL;
+		return (tm.blockingmobj = thingblocker) == NULL;
 
 	return true;
 }
 
+bool P_CheckPosition (AActor *thing, fixed_t x, fixed_t y)
+{
+	subsector_t *subsec = P_PointInSubsector(x,y);
+	// NOTE(jsd): NULL check here fixes crash while awaiting download in an active game.
+	if (subsec == NULL)
+		return false;
+
+	// The base floor / ceiling is from the subsector that contains the point.
+	// Any contacted lines the step closer together will adjust them.
+	checkposition_t tm(thing, x, y, subsec->sector);
+	bool ok = P_CheckPositionIn(tm);
+
+	// Publish the results for the callers that still read the globals.
+	tmfloorz = tm.floorz;
+	tmceilingz = tm.ceilingz;
+	tmdropoffz = tm.dropoffz;
+	tmfloorsector = tm.floorsector;
+	ceilingline = tm.ceilingline;
+	BlockingLine = tm.blockingline;
+	BlockingMobj = tm.blockingmobj;
+	spechit.assign(tm.spechit.begin(), tm.spechit.end());
+
+	return ok;
+}
+
 
 //
 // P_CheckOnmobj(AActor *thing)
@@ -1038,7 +1114,6 @@ AActor *P_CheckOnmobj (AActor *thing)
 bool P_TestMobjZ (AActor *actor)
 {
 	int	xl,xh,yl,yh,bx,by;
-	fixed_t x, y;
 
 	if (actor->flags & MF_NOCLIP)
 		return true;
@@ -1046,28 +1121,24 @@ bool P_TestMobjZ (AActor *actor)
 	if (!(actor->flags & MF_SOLID))
 		return true;
 
-	tmx = x = actor->x;
-	tmy = y = actor->y;
-	tmthing = actor;
-
-	tmbbox[BOXTOP] = y + actor->radius;
-	tmbbox[BOXBOTTOM] = y - actor->radius;
-	tmbbox[BOXRIGHT] = x + actor->radius;
-	tmbbox[BOXLEFT] = x - actor->radius;
+	checkposition_t tm(actor, actor->x, actor->y);
 //
 // the bounding box is extended by MAXRADIUS because actors are grouped
 // into mapblocks based on their origin point, and can overlap into adjacent
 // blocks by up to MAXRADIUS units
 //
-	xl = (tmbbox[BOXLEFT] - bmaporgx - MAXRADIUS)>>MAPBLOCKSHIFT;
-	xh = (tmbbox[BOXRIGHT] - bmaporgx + MAXRADIUS)>>MAPBLOCKSHIFT;
-	yl = (tmbbox[BOXBOTTOM] - bmaporgy - MAXRADIUS)>>MAPBLOCKSHIFT;
-	yh = (tmbbox[BOXTOP] - bmaporgy + MAXRADIUS)>>MAPBLOCKSHIFT;
+	xl = (tm.bbox[BOXLEFT] - bmaporgx - MAXRADIUS)>>MAPBLOCKSHIFT;
+	xh = (tm.bbox[BOXRIGHT] - bmaporgx + MAXRADIUS)>>MAPBLOCKSHIFT;
+	yl = (tm.bbox[BOXBOTTOM] - bmaporgy - MAXRADIUS)>>MAPBLOCKSHIFT;
+	yh = (tm.bbox[BOXTOP] - bmaporgy + MAXRADIUS)>>MAPBLOCKSHIFT;
 
 	for (bx = xl; bx <= xh; bx++)
 		for (by = yl; by <= yh; by++)
-			if (!P_BlockThingsIterator (bx, by, PIT_CheckOnmobjZ))
+			if (!P_BlockThingsIterator (bx, by, CheckOnmobjZ(tm)))
+			{
+				onmobj = tm.blockingmobj;
 				return false;
+			}
 
 	return true;
 }
@@ -1162,7 +1233,7 @@ BOOL P_TryMove (AActor *thing, fixed_t x, fixed_t y,
 			return false;
 		}
 
-		if (!P_AllowPassover() || !(tmthing->flags2 & MF2_PASSMOBJ))
+		if (!P_AllowPassover() || !(thing->flags2 & MF2_PASSMOBJ))
 			return false;
 	}
 
@@ -1319,16 +1390,16 @@ BOOL P_TryMove (AActor *thing, fixed_t x, fixed_t y,
 // so balancing is possible.
 //
 
-static BOOL PIT_ApplyTorque (line_t *ld)
+static BOOL PIT_ApplyTorque (checkposition_t &tm, line_t *ld)
 {
 	if (ld->backsector &&		// If thing touches two-sided pivot linedef
-		tmbbox[BOXRIGHT]  > ld->bbox[BOXLEFT]  &&
-		tmbbox[BOXLEFT]   < ld->bbox[BOXRIGHT] &&
-		tmbbox[BOXTOP]    > ld->bbox[BOXBOTTOM] &&
-		tmbbox[BOXBOTTOM] < ld->bbox[BOXTOP] &&
-		P_BoxOnLineSide(tmbbox, ld) == -1)
+		tm.bbox[BOXRIGHT]  > ld->bbox[BOXLEFT]  &&
+		tm.bbox[BOXLEFT]   < ld->bbox[BOXRIGHT] &&
+		tm.bbox[BOXTOP]    > ld->bbox[BOXBOTTOM] &&
+		tm.bbox[BOXBOTTOM] < ld->bbox[BOXTOP] &&
+		P_BoxOnLineSide(tm.bbox, ld) == -1)
 	{
-		AActor *mo = tmthing;
+		AActor *mo = tm.thing;
 
 		fixed_t dist =								// lever arm
 	  + (ld->dx >> FRACBITS) * (mo->y >> FRACBITS)
@@ -1388,6 +1459,13 @@ static BOOL PIT_ApplyTorque (line_t *ld)
 	return true;
 }
 
+struct ApplyTorque
+{
+	checkposition_t &tm;
+	ApplyTorque(checkposition_t &ctx) : tm(ctx) {}
+	BOOL operator() (line_t *ld) const { return PIT_ApplyTorque(tm, ld); }
+};
+
 //
 // killough 9/12/98
 //
@@ -1396,23 +1474,19 @@ static BOOL PIT_ApplyTorque (line_t *ld)
 
 void P_ApplyTorque (AActor *mo)
 {
-	int xl = ((tmbbox[BOXLEFT] =
-			mo->x - mo->radius) - bmaporgx) >> MAPBLOCKSHIFT;
-	int xh = ((tmbbox[BOXRIGHT] =
-			mo->x + mo->radius) - bmaporgx) >> MAPBLOCKSHIFT;
-	int yl = ((tmbbox[BOXBOTTOM] =
-			mo->y - mo->radius) - bmaporgy) >> MAPBLOCKSHIFT;
-	int yh = ((tmbbox[BOXTOP] =
-			mo->y + mo->radius) - bmaporgy) >> MAPBLOCKSHIFT;
+	checkposition_t tm(mo, mo->x, mo->y);
+	int xl = (tm.bbox[BOXLEFT] - bmaporgx) >> MAPBLOCKSHIFT;
+	int xh = (tm.bbox[BOXRIGHT] - bmaporgx) >> MAPBLOCKSHIFT;
+	int yl = (tm.bbox[BOXBOTTOM] - bmaporgy) >> MAPBLOCKSHIFT;
+	int yh = (tm.bbox[BOXTOP] - bmaporgy) >> MAPBLOCKSHIFT;
 	int bx,by;
 	int flags = mo->oflags;	//Remember the current state, for gear-change
 
-	tmthing = mo;
 	++validcount; // prevents checking same line twice
 
 	for (bx = xl ; bx <= xh ; bx++)
 		for (by = yl ; by <= yh ; by++)
-			P_BlockLinesIterator(bx, by, PIT_ApplyTorque);
+			P_BlockLinesIterator(bx, by, tm.bbox, ApplyTorque(tm));
 
 	// If any momentum, mark object as 'falling' using engine-internal flags
 	if (mo->momx | mo->momy)
@@ -1706,7 +1780,7 @@ void P_HitSlideLine (line_t* ld)
 //
 // PTR_SlideTraverse
 //
-BOOL PTR_SlideTraverse (intercept_t* in)
+BOOL PTR_SlideTraverse (intercept_t* in, const divline_t& trace)
 {
 	line_t* 	li;
 
@@ -1914,7 +1988,7 @@ static fixed_t	bottomslope;
 // PTR_AimTraverse
 // Sets linetaget and aimslope when a target is aimed at.
 //
-BOOL PTR_AimTraverse (intercept_t* in)
+BOOL PTR_AimTraverse (intercept_t* in, const divline_t& trace)
 {
 	line_t* 			li;
 	AActor* 			th;
@@ -2019,7 +2093,7 @@ BOOL PTR_AimTraverse (intercept_t* in)
 // hits a line or the floor/ceiling. Returns true if the intercept should continue
 // because it did not hit a solid line.
 //
-bool P_ShootLine(intercept_t* in)
+bool P_ShootLine(intercept_t* in, const divline_t& trace)
 {
 	bool precise = (co_fixweaponimpacts != 0);
 	line_t* li = in->d.line;
@@ -2148,7 +2222,7 @@ bool P_ShootLine(intercept_t* in)
 //
 // PTR_ShootTraverse
 //
-BOOL PTR_ShootTraverse (intercept_t* in)
+BOOL PTR_ShootTraverse (intercept_t* in, const divline_t& trace)
 {
 	fixed_t x, y, z;
 	fixed_t frac;
@@ -2156,7 +2230,7 @@ BOOL PTR_ShootTraverse (intercept_t* in)
 	fixed_t thingtopslope, thingbottomslope;
 
 	if (in->isaline)
-		return P_ShootLine(in);
+		return P_ShootLine(in, trace);
 
 	// shoot a thing
 	th = in->d.thing;
@@ -2413,7 +2487,7 @@ static struct SRailHit {
 } *RailHits;
 static v3double_t RailEnd;
 
-BOOL PTR_RailTraverse (intercept_t *in)
+BOOL PTR_RailTraverse (intercept_t* in, const divline_t& trace)
 {
 	fixed_t 			x;
 	fixed_t 			y;
@@ -2623,7 +2697,7 @@ void P_RailAttack (AActor *source, int damage, int offset)
 fixed_t CameraX, CameraY, CameraZ;
 #define CAMERA_DIST	0x1000	// Minimum distance between camera and walls
 
-BOOL PTR_CameraTraverse (intercept_t* in)
+BOOL PTR_CameraTraverse (intercept_t* in, const divline_t& trace)
 {
 	fixed_t z;
 	fixed_t frac;
@@ -2737,7 +2811,7 @@ void P_AimCamera (AActor *t1)
 AActor *usething;
 bool foundline;
 
-BOOL PTR_UseTraverse (intercept_t *in)
+BOOL PTR_UseTraverse (intercept_t* in, const divline_t& trace)
 {
 	if (!in->isaline)
 		I_Error ("PTR_UseTraverse: non-line intercept\n");
@@ -2804,7 +2878,7 @@ BOOL PTR_UseTraverse (intercept_t *in)
 // by Lee Killough
 //
 
-BOOL PTR_NoWayTraverse (intercept_t *in)
+BOOL PTR_NoWayTraverse (intercept_t* in, const divline_t& trace)
 {
 	if (!in->isaline)
 		I_Error ("PTR_NoWayTraverse: non-line intercept\n");
@@ -3411,6 +3485,51 @@ void P_DelSeclist (msecnode_t *node)
 }
 
 
+//
+// P_SecnodeMargin
+//
+// How far a box can move in either axis before a test comparing one of its
+// coordinates with a fixed value changes its result.
+//
+static int64_t P_SecnodeMargin (fixed_t a, fixed_t b)
+{
+	return a > b ? int64_t(a) - b : int64_t(b) - a + 1;
+}
+
+//
+// P_SecnodeSideMargin
+//
+// The same for the side of a sloped line a corner of the box is on, as
+// worked out by P_PointOnLineSide.  Returns 0 if rounding makes the side
+// too close to call.
+//
+static int64_t P_SecnodeSideMargin (fixed_t x, fixed_t y, const line_t *ld)
+{
+	if (co_zdoomphys)
+	{
+		const int64_t e = int64_t(y - ld->v1->y) * ld->dx + int64_t(ld->v1->x - x) * ld->dy;
+		const int64_t k = (ld->dx < 0 ? -int64_t(ld->dx) : ld->dx) +
+		                  (ld->dy < 0 ? -int64_t(ld->dy) : ld->dy);
+
+		return e >= 0 ? e / k + 1 : (-e - 1) / k + 1;
+	}
+
+	// FixedMul rounds both products down, so the side is only certain
+	// while they are at least FRACUNIT apart or in order.
+	const int64_t a = ld->dy >> FRACBITS;
+	const int64_t b = ld->dx >> FRACBITS;
+	const int64_t d = a * (x - ld->v1->x) - b * (y - ld->v1->y);
+	const int64_t k = (a < 0 ? -a : a) + (b < 0 ? -b : b);
+
+	if (k == 0)
+		return MAXINT;
+	if (d <= 0)
+		return -d / k + 1;
+	if (d >= FRACUNIT)
+		return (d - FRACUNIT) / k + 1;
+	return 0;
+}
+
 // phares 3/14/98
 //
 // PIT_GetSectors
@@ -3418,45 +3537,103 @@ void P_DelSeclist (msecnode_t *node)
 // cross through it. You have already decided that the object is allowed
 // at this location, so don't bother with checking impassable or
 // blocking lines.
+//
+// Also lowers margin to how far the box can move before the line would
+// give a different answer.
 
-BOOL PIT_GetSectors (line_t *ld)
+struct PIT_GetSectors
 {
-	if (tmbbox[BOXRIGHT]	  <= ld->bbox[BOXLEFT]	 ||
-			tmbbox[BOXLEFT]   >= ld->bbox[BOXRIGHT]  ||
-			tmbbox[BOXTOP]	  <= ld->bbox[BOXBOTTOM] ||
-			tmbbox[BOXBOTTOM] >= ld->bbox[BOXTOP])
-		return true;
+	AActor* thing;
+	fixed_t bbox[4];
+	int64_t* margin;
 
-	if (P_BoxOnLineSide (tmbbox, ld) != -1)
-		return true;
+	BOOL operator() (line_t *ld) const
+	{
+		const int64_t right = P_SecnodeMargin(bbox[BOXRIGHT], ld->bbox[BOXLEFT]);
+		const int64_t left = P_SecnodeMargin(ld->bbox[BOXRIGHT], bbox[BOXLEFT]);
+		const int64_t top = P_SecnodeMargin(bbox[BOXTOP], ld->bbox[BOXBOTTOM]);
+		const int64_t bottom = P_SecnodeMargin(ld->bbox[BOXTOP], bbox[BOXBOTTOM]);
+
+		if (bbox[BOXRIGHT]	  <= ld->bbox[BOXLEFT]	 ||
+				bbox[BOXLEFT]   >= ld->bbox[BOXRIGHT]  ||
+				bbox[BOXTOP]	  <= ld->bbox[BOXBOTTOM] ||
+				bbox[BOXBOTTOM] >= ld->bbox[BOXTOP])
+		{
+			// Stays outside while any of the failed tests still fails.
+			int64_t out = 0;
+			if (bbox[BOXRIGHT] <= ld->bbox[BOXLEFT])
+				out = std::max(out, right);
+			if (bbox[BOXLEFT] >= ld->bbox[BOXRIGHT])
+				out = std::max(out, left);
+			if (bbox[BOXTOP] <= ld->bbox[BOXBOTTOM])
+				out = std::max(out, top);
+			if (bbox[BOXBOTTOM] >= ld->bbox[BOXTOP])
+				out = std::max(out, bottom);
+
+			*margin = std::min(*margin, out);
+			return true;
+		}
 
-	// This line crosses through the object.
+		*margin = std::min(*margin, std::min(std::min(right, left), std::min(top, bottom)));
 
-	// Collect the sector(s) from the line and add to the
-	// sector_list you're examining. If the Thing ends up being
-	// allowed to move to this position, then the sector_list
-	// will be attached to the Thing's AActor at touching_sectorlist.
+		switch (ld->slopetype)
+		{
+		  case ST_HORIZONTAL:
+			*margin = std::min(*margin, P_SecnodeMargin(bbox[BOXTOP], ld->v1->y));
+			*margin = std::min(*margin, P_SecnodeMargin(bbox[BOXBOTTOM], ld->v1->y));
+			break;
+
+		  case ST_VERTICAL:
+			*margin = std::min(*margin, P_SecnodeMargin(ld->v1->x, bbox[BOXRIGHT]));
+			*margin = std::min(*margin, P_SecnodeMargin(ld->v1->x, bbox[BOXLEFT]));
+			break;
+
+		  case ST_POSITIVE:
+			*margin = std::min(*margin, P_SecnodeSideMargin(bbox[BOXLEFT], bbox[BOXTOP], ld));
+			*margin = std::min(*margin, P_SecnodeSideMargin(bbox[BOXRIGHT], bbox[BOXBOTTOM], ld));
+			break;
+
+		  case ST_NEGATIVE:
+			*margin = std::min(*margin, P_SecnodeSideMargin(bbox[BOXRIGHT], bbox[BOXTOP], ld));
+			*margin = std::min(*margin, P_SecnodeSideMargin(bbox[BOXLEFT], bbox[BOXBOTTOM], ld));
+			break;
+		}
 
-	sector_list = P_AddSecnode (ld->frontsector,tmthing,sector_list);
+		if (P_BoxOnLineSide (bbox, ld) != -1)
+			return true;
 
-	// Don't assume all lines are 2-sided, since some Things
-	// like MT_TFOG are allowed regardless of whether their radius takes
-	// them beyond an impassable linedef.
+		// This line crosses through the object.
 
-	// killough 3/27/98, 4/4/98:
-	// Use sidedefs instead of 2s flag to determine two-sidedness.
+		// Collect the sector(s) from the line and add to the
+		// sector_list you're examining. If the Thing ends up being
+		// allowed to move to this position, then the sector_list
+		// will be attached to the Thing's AActor at touching_sectorlist.
 
-	if (ld->backsector)
-		sector_list = P_AddSecnode(ld->backsector, tmthing, sector_list);
+		sector_list = P_AddSecnode (ld->frontsector,thing,sector_list);
 
-	return true;
-}
+		// Don't assume all lines are 2-sided, since some Things
+		// like MT_TFOG are allowed regardless of whether their radius takes
+		// them beyond an impassable linedef.
+
+		// killough 3/27/98, 4/4/98:
+		// Use sidedefs instead of 2s flag to determine two-sidedness.
+
+		if (ld->backsector)
+			sector_list = P_AddSecnode(ld->backsector, thing, sector_list);
+
+		return true;
+	}
+};
 
 
 // phares 3/14/98
 //
 // P_CreateSecNodeList alters/creates the sector_list that shows what sectors
 // the object resides in.
+//
+// The list only changes when the thing crosses a line or enters other
+// blocks, so while it moves less than the margin worked out last time
+// and stays in the same blocks, sector_list is kept as it is.
 
 void P_CreateSecNodeList (AActor *thing, fixed_t x, fixed_t y)
 {
@@ -3467,6 +3644,29 @@ void P_CreateSecNodeList (AActor *thing, fixed_t x, fixed_t y)
 	int bx;
 	int by;
 	msecnode_t *node;
+	secnodecache_t &cache = thing->secnodecache;
+
+	xl = (x - thing->radius - bmaporgx)>>MAPBLOCKSHIFT;
+	xh = (x + thing->radius - bmaporgx)>>MAPBLOCKSHIFT;
+	yl = (y - thing->radius - bmaporgy)>>MAPBLOCKSHIFT;
+	yh = (y + thing->radius - bmaporgy)>>MAPBLOCKSHIFT;
+
+	const int64_t movex = int64_t(x) - cache.x;
+	const int64_t movey = int64_t(y) - cache.y;
+
+	if (sector_list && cache.margin > 0 &&
+		cache.radius == thing->radius &&
+		cache.sector == thing->subsector->sector &&
+		cache.polychanges == polychangecount &&
+		movex < cache.margin && -movex < cache.margin &&
+		movey < cache.margin && -movey < cache.margin &&
+		xl == (cache.x - cache.radius - bmaporgx)>>MAPBLOCKSHIFT &&
+		xh == (cache.x + cache.radius - bmaporgx)>>MAPBLOCKSHIFT &&
+		yl == (cache.y - cache.radius - bmaporgy)>>MAPBLOCKSHIFT &&
+		yh == (cache.y + cache.radius - bmaporgy)>>MAPBLOCKSHIFT)
+	{
+		return;
+	}
 
 	// First, clear out the existing m_thing fields. As each node is
 	// added or verified as needed, m_thing will be set properly. When
@@ -3482,30 +3682,25 @@ void P_CreateSecNodeList (AActor *thing, fixed_t x, fixed_t y)
 
 	// denis - we may have been called from another P_BlockLinesIterator
 	// e.g. when a telefrag results in an item drop.
-	// so we need to back up tmthing and then restore it
-	AActor *last_tmthing = tmthing;
-	int last_tmx = tmx, last_tmy = tmy;
-	int last_tmbbox[4] = {tmbbox[0], tmbbox[1], tmbbox[2], tmbbox[3]};
+	// so keep our own thing and box instead of sharing the caller's
+	int64_t margin = MAXINT;
 
-	tmthing = thing;
-	tmx = x;
-	tmy = y;
+	PIT_GetSectors getsectors;
+	getsectors.thing = thing;
+	getsectors.margin = &margin;
 
-	tmbbox[BOXTOP]	  = y + tmthing->radius;
-	tmbbox[BOXBOTTOM] = y - tmthing->radius;
-	tmbbox[BOXRIGHT]  = x + tmthing->radius;
-	tmbbox[BOXLEFT]   = x - tmthing->radius;
+	getsectors.bbox[BOXTOP]	  = y + thing->radius;
+	getsectors.bbox[BOXBOTTOM] = y - thing->radius;
+	getsectors.bbox[BOXRIGHT]  = x + thing->radius;
+	getsectors.bbox[BOXLEFT]   = x - thing->radius;
 
 	validcount++; // used to make sure we only process a line once
 
-	xl = (tmbbox[BOXLEFT] - bmaporgx)>>MAPBLOCKSHIFT;
-	xh = (tmbbox[BOXRIGHT] - bmaporgx)>>MAPBLOCKSHIFT;
-	yl = (tmbbox[BOXBOTTOM] - bmaporgy)>>MAPBLOCKSHIFT;
-	yh = (tmbbox[BOXTOP] - bmaporgy)>>MAPBLOCKSHIFT;
-
+	// Every line of the blocks counts towards the margin, not only the
+	// ones overlapping the box.
 	for (bx=xl ; bx<=xh ; bx++)
 		for (by=yl ; by<=yh ; by++)
-			P_BlockLinesIterator (bx,by,PIT_GetSectors);
+			P_BlockLinesIterator (bx,by,getsectors);
 
 	// Add the sector of the (x,y) point to sector_list.
 
@@ -3527,13 +3722,12 @@ void P_CreateSecNodeList (AActor *thing, fixed_t x, fixed_t y)
 			node = node->m_tnext;
 	}
 
-	// denis - restore tmthing
-	tmthing = last_tmthing;
-	tmx = last_tmx; tmy = last_tmy;
-	tmbbox[0] = last_tmbbox[0];
-	tmbbox[1] = last_tmbbox[1];
-	tmbbox[2] = last_tmbbox[2];
-	tmbbox[3] = last_tmbbox[3];
+	cache.x = x;
+	cache.y = y;
+	cache.radius = thing->radius;
+	cache.margin = (fixed_t)margin;
+	cache.sector = thing->subsector->sector;
+	cache.polychanges = polychangecount;
 }
 
 //
@@ -3749,11 +3943,17 @@ bool P_IdenticalPlanes(const plane_t *pl1, const plane_t *pl2)
 		(pl1->a == pl2->a && pl1->b == pl2->b && pl1->c == pl2->c && pl1->d == pl2->d);
 }
 
+// Bumped whenever a floor or ceiling moves, so sight checks worked out
+// ahead of time can tell if they still hold.
+unsigned int planechangecount;
+
 void P_ChangeCeilingHeight(sector_t *sector, fixed_t amount)
 {
 	if (!sector)
 		return;
 
+	planechangecount++;
+
 	plane_t *plane = &sector->ceilingplane;
 	plane->d -= FixedMul(amount, plane->c);
 
@@ -3767,6 +3967,8 @@ void P_ChangeFloorHeight(sector_t *sector, fixed_t amount)
 	if (!sector)
 		return;
 
+	planechangecount++;
+
 	plane_t *plane = &sector->floorplane;
 	plane->d -= FixedMul(amount, plane->c);
 
@@ -35,7 +35,6 @@
 // State.
 #include "r_state.h"
 
-EXTERN_CVAR (co_blockmapfix)
 EXTERN_CVAR (co_zdoomphys)
 
 //
@@ -633,113 +632,10 @@ void AActor::SetOrigin (fixed_t ix, fixed_t iy, fixed_t iz)
 //
 
 
-//
-// P_BlockLinesIterator
-// The validcount flags are used to avoid checking lines
-// that are marked in multiple mapblocks,
-// so increment validcount before the first call
-// to P_BlockLinesIterator, then make one or more calls
-// to it.
-//
-extern polyblock_t **PolyBlockMap;
-
-BOOL P_BlockLinesIterator (int x, int y, BOOL(*func)(line_t*))
-{
-	if (x<0 || y<0 || x>=bmapwidth || y>=bmapheight)
-		return true;
-
-	int offset = *(blockmap + (bmapwidth*y + x));
-	int *list = blockmaplump + offset;
-	
-	/* [RH] Polyobj stuff from Hexen --> */
-	polyblock_t *polyLink;
-
-	offset = y*bmapwidth + x;
-	if (PolyBlockMap)
-	{
-		polyLink = PolyBlockMap[offset];
-		
-		while (polyLink)
-		{
-			if (polyLink->polyobj && polyLink->polyobj->validcount != validcount)
-			{
-				int i;
-				seg_t **tempSeg = polyLink->polyobj->segs;
-				polyLink->polyobj->validcount = validcount;
-
-				for (i = polyLink->polyobj->numsegs; i; i--, tempSeg++)
-				{
-					if ((*tempSeg)->linedef->validcount != validcount)
-					{
-						(*tempSeg)->linedef->validcount = validcount;
-						if (!func ((*tempSeg)->linedef))
-							return false;
-					}
-				}
-			}
-			polyLink = polyLink->next;
-		}
-	}
-	/* <-- Polyobj stuff from Hexen */	
-
-	// [RH] Get past starting 0 (from BOOM)
-	// denis - not so fast, this breaks doom1.wad 1.9 demo1
-	// [SL] The first entry in each block list appears to have been intended to
-	// be used for a special purpose but instead contains garbage (most often
-	// referencing linedef 0). Using this first entry (as vanilla Doom does) can
-	// cause hitscan weapons to erroneously hit the first linedef entry regardless
-	// of where that linedef is located in relation to the block.
-	if (co_blockmapfix)
-		++list;
-
-	for (; *list != -1; list++)
-	{
-		line_t *ld = &lines[*list];
-
-		if (ld->validcount != validcount) {
-			ld->validcount = validcount;
-
-			if ( !func(ld) )
-				return false;
-		}
-	}
-
-	return true;		// everything was checked
-}
-
-
-//
-// P_BlockThingsIterator
-//
-BOOL P_BlockThingsIterator (int x, int y, BOOL(*func)(AActor*), AActor *actor)
-{
-	if (x<0 || y<0 || x>=bmapwidth || y>=bmapheight)
-		return true;
-	else
- 	{
-		AActor *mobj = (actor != NULL ? actor : blocklinks[y*bmapwidth+x]);
-		while (mobj)
- 		{
- 			if (!func (mobj))
- 				return false;
-
-			mobj = mobj->bmapnode.Next(x, y);
-		}
-	}
-	return true;
-}
-
-
-
 //
 // INTERCEPT ROUTINES
 //
-// denis - make intercepts array resizeable
-TArray<intercept_t> intercepts;
-
-divline_t		trace;
-BOOL 			earlyout;
-int 			ptflags;
+pathtrace_t		pathtrace;
 
 //
 // PIT_AddLineIntercepts.
@@ -751,171 +647,153 @@ int 			ptflags;
 // are on opposite sides of the trace.
 // Returns true if earlyout and a solid line hit.
 //
-BOOL PIT_AddLineIntercepts (line_t *ld)
+struct PIT_AddLineIntercepts
 {
-	int 				s1;
-	int 				s2;
-	fixed_t 			frac;
-	divline_t			dl;
-
-	// avoid precision problems with two routines
-	if ( trace.dx > FRACUNIT*16
-		 || trace.dy > FRACUNIT*16
-		 || trace.dx < -FRACUNIT*16
-		 || trace.dy < -FRACUNIT*16)
+	pathtrace_t& pt;
+
+	PIT_AddLineIntercepts(pathtrace_t& pt) : pt(pt)
 	{
-		s1 = P_PointOnDivlineSide (ld->v1->x, ld->v1->y, &trace);
-		s2 = P_PointOnDivlineSide (ld->v2->x, ld->v2->y, &trace);
 	}
-	else
+
+	BOOL operator() (line_t *ld) const
 	{
-		s1 = P_PointOnLineSide (trace.x, trace.y, ld);
-		s2 = P_PointOnLineSide (trace.x+trace.dx, trace.y+trace.dy, ld);
-	}
+		const divline_t&	trace = pt.trace;
+		int 				s1;
+		int 				s2;
+		fixed_t 			frac;
+		divline_t			dl;
+
+		// avoid precision problems with two routines
+		if ( trace.dx > FRACUNIT*16
+			 || trace.dy > FRACUNIT*16
+			 || trace.dx < -FRACUNIT*16
+			 || trace.dy < -FRACUNIT*16)
+		{
+			s1 = P_PointOnDivlineSide (ld->v1->x, ld->v1->y, &trace);
+			s2 = P_PointOnDivlineSide (ld->v2->x, ld->v2->y, &trace);
+		}
+		else
+		{
+			s1 = P_PointOnLineSide (trace.x, trace.y, ld);
+			s2 = P_PointOnLineSide (trace.x+trace.dx, trace.y+trace.dy, ld);
+		}
 
-	if (s1 == s2)
-		return true;	// line isn't crossed
+		if (s1 == s2)
+			return true;	// line isn't crossed
 
-	// hit the line
-	P_MakeDivline (ld, &dl);
-	frac = P_InterceptVector (&trace, &dl);
+		// hit the line
+		P_MakeDivline (ld, &dl);
+		frac = P_InterceptVector (&trace, &dl);
 
-	if (frac < 0)
-		return true;	// behind source
+		if (frac < 0)
+			return true;	// behind source
 
-	// try to early out the check
-	if (earlyout
-		&& frac < FRACUNIT
-		&& !ld->backsector)
-	{
-		return false;	// stop checking
-	}
+		// try to early out the check
+		if (pt.earlyout
+			&& frac < FRACUNIT
+			&& !ld->backsector)
+		{
+			return false;	// stop checking
+		}
 
 
-	intercept_t intercept;
-	intercept.frac = frac;
-	intercept.isaline = true;
-	intercept.d.line = ld;
-	intercepts.Push(intercept);
+		intercept_t intercept;
+		intercept.frac = frac;
+		intercept.isaline = true;
+		intercept.d.line = ld;
+		pt.intercepts.Push(intercept);
 
-	return true;		// continue
-}
+		return true;		// continue
+	}
+};
 
 
 
 //
 // PIT_AddThingIntercepts
 //
-BOOL PIT_AddThingIntercepts (AActor* thing)
+struct PIT_AddThingIntercepts
 {
-	fixed_t 		x1;
-	fixed_t 		y1;
-	fixed_t 		x2;
-	fixed_t 		y2;
+	pathtrace_t& pt;
 
-	int 			s1;
-	int 			s2;
-
-	BOOL 			tracepositive;
-
-	divline_t		dl;
-
-	fixed_t 		frac;
-
-	tracepositive = (trace.dx ^ trace.dy)>0;
-
-	// check a corner to corner crossection for hit
-	if (tracepositive)
+	PIT_AddThingIntercepts(pathtrace_t& pt) : pt(pt)
 	{
-		x1 = thing->x - thing->radius;
-		y1 = thing->y + thing->radius;
-
-		x2 = thing->x + thing->radius;
-		y2 = thing->y - thing->radius;
-	}
-	else
-	{
-		x1 = thing->x - thing->radius;
-		y1 = thing->y - thing->radius;
-
-		x2 = thing->x + thing->radius;
-		y2 = thing->y + thing->radius;
 	}
 
-	s1 = P_PointOnDivlineSide (x1, y1, &trace);
-	s2 = P_PointOnDivlineSide (x2, y2, &trace);
-
-	if (s1 == s2)
-		return true;			// line isn't crossed
+	BOOL operator() (AActor* thing) const
+	{
+		const divline_t&	trace = pt.trace;
 
-	dl.x = x1;
-	dl.y = y1;
-	dl.dx = x2-x1;
-	dl.dy = y2-y1;
+		fixed_t 		x1;
+		fixed_t 		y1;
+		fixed_t 		x2;
+		fixed_t 		y2;
 
-	frac = P_InterceptVector (&trace, &dl);
+		int 			s1;
+		int 			s2;
 
-	if (frac < 0)
-		return true;			// behind source
+		BOOL 			tracepositive;
 
-	intercept_t intercept;
-	intercept.frac = frac;
-	intercept.isaline = false;
-	intercept.d.thing = thing;
-	intercepts.Push(intercept);
+		divline_t		dl;
 
-	return true;				// keep going
-}
+		fixed_t 		frac;
 
+		tracepositive = (trace.dx ^ trace.dy)>0;
 
-//
-// P_TraverseIntercepts
-// Returns true if the traverser function returns true
-// for all lines.
-//
-BOOL P_TraverseIntercepts (traverser_t func, fixed_t maxfrac)
-{
-	size_t 				count = intercepts.Size();
-	fixed_t 			dist;
-	size_t		scan;
-	intercept_t*		in = 0;
+		// check a corner to corner crossection for hit
+		if (tracepositive)
+		{
+			x1 = thing->x - thing->radius;
+			y1 = thing->y + thing->radius;
 
-	while (count--)
-	{
-		dist = MAXINT;
-		for (scan = 0 ; scan < intercepts.Size(); scan++)
+			x2 = thing->x + thing->radius;
+			y2 = thing->y - thing->radius;
+		}
+		else
 		{
-			if (intercepts[scan].frac < dist)
-			{
-				dist = intercepts[scan].frac;
-				in = &intercepts[scan];
-			}
+			x1 = thing->x - thing->radius;
+			y1 = thing->y - thing->radius;
+
+			x2 = thing->x + thing->radius;
+			y2 = thing->y + thing->radius;
 		}
 
-		if (dist > maxfrac)
-			return true;		// checked everything in range
+		s1 = P_PointOnDivlineSide (x1, y1, &trace);
+		s2 = P_PointOnDivlineSide (x2, y2, &trace);
 
+		if (s1 == s2)
+			return true;			// line isn't crossed
 
-		if ( !func (in) )
-			return false;		// don't bother going farther
+		dl.x = x1;
+		dl.y = y1;
+		dl.dx = x2-x1;
+		dl.dy = y2-y1;
 
-		in->frac = MAXINT;
-	}
+		frac = P_InterceptVector (&trace, &dl);
 
-	return true;				// everything was traversed
-}
+		if (frac < 0)
+			return true;			// behind source
 
+		intercept_t intercept;
+		intercept.frac = frac;
+		intercept.isaline = false;
+		intercept.d.thing = thing;
+		pt.intercepts.Push(intercept);
+
+		return true;				// keep going
+	}
+};
 
 
 
 //
-// P_PathTraverse
-// Traces a line from x1,y1 to x2,y2,
-// calling the traverser function for each.
-// Returns true if the traverser function returns true
-// for all lines.
+// P_AddIntercepts
+// Sets up the trace from x1,y1 to x2,y2 and
+// collects everything it crosses for
+// P_TraverseIntercepts.
+// Returns false if earlyout and a solid line hit.
 //
-BOOL P_PathTraverse (fixed_t x1, fixed_t y1, fixed_t x2, fixed_t y2, int flags, BOOL (*trav) (intercept_t *))
+BOOL P_AddIntercepts (pathtrace_t& pt, fixed_t x1, fixed_t y1, fixed_t x2, fixed_t y2, int flags)
 {
 	fixed_t 	xt1;
 	fixed_t 	yt1;
@@ -938,11 +816,11 @@ BOOL P_PathTraverse (fixed_t x1, fixed_t y1, fixed_t x2, fixed_t y2, int flags,
 
 	int 		count;
 
-	earlyout = flags & PT_EARLYOUT;
+	pt.earlyout = flags & PT_EARLYOUT;
 
 	validcount++;
 
-	intercepts.Clear();
+	pt.intercepts.Clear();
 
 	if ( ((x1-bmaporgx)&(MAPBLOCKSIZE-1)) == 0)
 		x1 += FRACUNIT; // don't side exactly on a line
@@ -950,10 +828,10 @@ BOOL P_PathTraverse (fixed_t x1, fixed_t y1, fixed_t x2, fixed_t y2, int flags,
 	if ( ((y1-bmaporgy)&(MAPBLOCKSIZE-1)) == 0)
 		y1 += FRACUNIT; // don't side exactly on a line
 
-	trace.x = x1;
-	trace.y = y1;
-	trace.dx = x2 - x1;
-	trace.dy = y2 - y1;
+	pt.trace.x = x1;
+	pt.trace.y = y1;
+	pt.trace.dx = x2 - x1;
+	pt.trace.dy = y2 - y1;
 
 	x1 -= bmaporgx;
 	y1 -= bmaporgy;
@@ -1017,13 +895,13 @@ BOOL P_PathTraverse (fixed_t x1, fixed_t y1, fixed_t x2, fixed_t y2, int flags,
 	{
 		if (flags & PT_ADDLINES)
 		{
-			if (!P_BlockLinesIterator (mapx, mapy,PIT_AddLineIntercepts))
+			if (!P_BlockLinesIterator (mapx, mapy, PIT_AddLineIntercepts(pt)))
 				return false;	// early out
 		}
 
 		if (flags & PT_ADDTHINGS)
 		{
-			if (!P_BlockThingsIterator (mapx, mapy,PIT_AddThingIntercepts))
+			if (!P_BlockThingsIterator (mapx, mapy, PIT_AddThingIntercepts(pt)))
 				return false;	// early out
 		}
 
@@ -1044,8 +922,8 @@ BOOL P_PathTraverse (fixed_t x1, fixed_t y1, fixed_t x2, fixed_t y2, int flags,
 		}
 
 	}
-	// go through the sorted list
-	return P_TraverseIntercepts ( trav, FRACUNIT );
+
+	return true;
 }
 
 //
@@ -0,0 +1,332 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// $Id$
+//
+// Copyright (C) 1993-1996 by id Software, Inc.
+// Copyright (C) 2006-2020 by The Odamex Team.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//	Blockmap iterators and path traversal.
+//
+//	The iterators take any callable, so passing a function object lets
+//	the compiler inline the callback into the loop.  Passing a plain
+//	function pointer works as before.
+//
+//-----------------------------------------------------------------------------
+
+#pragma once
+
+#include "c_cvars.h"
+#include "m_bbox.h"
+#include "r_intrin.h"
+
+EXTERN_CVAR (co_blockmapfix)
+
+extern polyblock_t **PolyBlockMap;
+
+//
+// P_BlockGroupOverlaps
+//
+// Returns a mask with bit n set if the box of line n of the group overlaps
+// the given box.  Boxes that only touch don't overlap.
+//
+inline int P_BlockGroupOverlaps (const blockgroup_t* group, const fixed_t* bbox)
+{
+#if defined(__SSE2__)
+	const __m128i left = _mm_loadu_si128((const __m128i*)group->left);
+	const __m128i right = _mm_loadu_si128((const __m128i*)group->right);
+	const __m128i bottom = _mm_loadu_si128((const __m128i*)group->bottom);
+	const __m128i top = _mm_loadu_si128((const __m128i*)group->top);
+
+	__m128i mask = _mm_cmpgt_epi32(_mm_set1_epi32(bbox[BOXRIGHT]), left);
+	mask = _mm_and_si128(mask, _mm_cmpgt_epi32(right, _mm_set1_epi32(bbox[BOXLEFT])));
+	mask = _mm_and_si128(mask, _mm_cmpgt_epi32(_mm_set1_epi32(bbox[BOXTOP]), bottom));
+	mask = _mm_and_si128(mask, _mm_cmpgt_epi32(top, _mm_set1_epi32(bbox[BOXBOTTOM])));
+
+	return _mm_movemask_ps(_mm_castsi128_ps(mask));
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+	uint32x4_t mask = vcgtq_s32(vdupq_n_s32(bbox[BOXRIGHT]), vld1q_s32(group->left));
+	mask = vandq_u32(mask, vcgtq_s32(vld1q_s32(group->right), vdupq_n_s32(bbox[BOXLEFT])));
+	mask = vandq_u32(mask, vcgtq_s32(vdupq_n_s32(bbox[BOXTOP]), vld1q_s32(group->bottom)));
+	mask = vandq_u32(mask, vcgtq_s32(vld1q_s32(group->top), vdupq_n_s32(bbox[BOXBOTTOM])));
+
+	static const uint32_t bits[4] = { 1, 2, 4, 8 };
+	const uint32x4_t lanes = vandq_u32(mask, vld1q_u32(bits));
+	const uint32x2_t sum = vadd_u32(vget_low_u32(lanes), vget_high_u32(lanes));
+
+	return vget_lane_u32(vpadd_u32(sum, sum), 0);
+#else
+	int mask = 0;
+
+	for (int i = 0; i < 4; i++)
+	{
+		if (bbox[BOXRIGHT] > group->left[i] && group->right[i] > bbox[BOXLEFT] &&
+			bbox[BOXTOP] > group->bottom[i] && group->top[i] > bbox[BOXBOTTOM])
+			mask |= 1 << i;
+	}
+
+	return mask;
+#endif
+}
+
+//
+// P_BlockPolyLinesIterator
+//
+// [RH] Polyobj stuff from Hexen
+//
+template <class Func>
+BOOL P_BlockPolyLinesIterator (int offset, Func func)
+{
+	polyblock_t *polyLink = PolyBlockMap[offset];
+
+	while (polyLink)
+	{
+		if (polyLink->polyobj && polyLink->polyobj->validcount != validcount)
+		{
+			int i;
+			seg_t **tempSeg = polyLink->polyobj->segs;
+			polyLink->polyobj->validcount = validcount;
+
+			for (i = polyLink->polyobj->numsegs; i; i--, tempSeg++)
+			{
+				if ((*tempSeg)->linedef->validcount != validcount)
+				{
+					(*tempSeg)->linedef->validcount = validcount;
+					if (!func ((*tempSeg)->linedef))
+						return false;
+				}
+			}
+		}
+		polyLink = polyLink->next;
+	}
+
+	return true;
+}
+
+//
+// P_BlockLinesIterator
+// The validcount flags are used to avoid checking lines
+// that are marked in multiple mapblocks,
+// so increment validcount before the first call
+// to P_BlockLinesIterator, then make one or more calls
+// to it.
+//
+template <class Func>
+BOOL P_BlockLinesIterator (int x, int y, Func func)
+{
+	if (x<0 || y<0 || x>=bmapwidth || y>=bmapheight)
+		return true;
+
+	const int offset = y*bmapwidth + x;
+
+	if (PolyBlockMap && !P_BlockPolyLinesIterator(offset, func))
+		return false;
+
+	// [RH] Get past starting 0 (from BOOM)
+	// denis - not so fast, this breaks doom1.wad 1.9 demo1
+	// [SL] The first entry in each block list appears to have been intended to
+	// be used for a special purpose but instead contains garbage (most often
+	// referencing linedef 0). Using this first entry (as vanilla Doom does) can
+	// cause hitscan weapons to erroneously hit the first linedef entry regardless
+	// of where that linedef is located in relation to the block.
+	const int first = co_blockmapfix ? 1 : 0;
+
+	if (blockcells && blockcells[offset].count >= 0)
+	{
+		// The packed copy of the list, see P_PackBlockMap.
+		const blockgroup_t* groups = blockgroups + blockcells[offset].first;
+		const int count = blockcells[offset].count;
+
+		for (int i = first; i < count; i++)
+		{
+			line_t *ld = &lines[groups[i >> 2].line[i & 3]];
+
+			if (ld->validcount != validcount) {
+				ld->validcount = validcount;
+
+				if ( !func(ld) )
+					return false;
+			}
+		}
+
+		return true;
+	}
+
+	const int *list = blockmaplump + blockmap[offset] + first;
+
+	for (; *list != -1; list++)
+	{
+		line_t *ld = &lines[*list];
+
+		if (ld->validcount != validcount) {
+			ld->validcount = validcount;
+
+			if ( !func(ld) )
+				return false;
+		}
+	}
+
+	return true;		// everything was checked
+}
+
+//
+// P_BlockLinesIterator
+//
+// As above, but func is only called for lines whose bounding box overlaps
+// bbox.  The lines are checked against the box four at a time, so func must
+// reject lines outside of bbox itself and do nothing else for them.  The
+// lines skipped are still marked with validcount like the others.
+//
+template <class Func>
+BOOL P_BlockLinesIterator (int x, int y, const fixed_t* bbox, Func func)
+{
+	if (x<0 || y<0 || x>=bmapwidth || y>=bmapheight)
+		return true;
+
+	const int offset = y*bmapwidth + x;
+
+	if (!blockcells || blockcells[offset].count < 0)
+		return P_BlockLinesIterator(x, y, func);
+
+	if (PolyBlockMap && !P_BlockPolyLinesIterator(offset, func))
+		return false;
+
+	const blockgroup_t* group = blockgroups + blockcells[offset].first;
+	const int count = blockcells[offset].count;
+
+	// [SL] See above for skipping the first entry.
+	int i = co_blockmapfix ? 1 : 0;
+
+	for (int base = 0; base < count; base += 4, group++)
+	{
+		const int mask = P_BlockGroupOverlaps(group, bbox);
+		const int last = count - base < 4 ? count - base : 4;
+
+		for (; i < last; i++)
+		{
+			line_t *ld = &lines[group->line[i]];
+
+			if (ld->validcount != validcount) {
+				ld->validcount = validcount;
+
+				if ((mask & (1 << i)) && !func(ld))
+					return false;
+			}
+		}
+
+		i = 0;
+	}
+
+	return true;		// everything was checked
+}
+
+//
+// P_BlockThingsIterator
+//
+template <class Func>
+BOOL P_BlockThingsIterator (int x, int y, Func func, AActor *actor = NULL)
+{
+	if (x<0 || y<0 || x>=bmapwidth || y>=bmapheight)
+		return true;
+	else
+ 	{
+		AActor *mobj = (actor != NULL ? actor : blocklinks[y*bmapwidth+x]);
+		while (mobj)
+ 		{
+ 			if (!func (mobj))
+ 				return false;
+
+			mobj = mobj->bmapnode.Next(x, y);
+		}
+	}
+	return true;
+}
+
+//
+// The state of one path traversal.  Each thread tracing paths at the same
+// time needs its own.
+//
+struct pathtrace_t
+{
+	divline_t				trace;
+	BOOL					earlyout;
+	TArray<intercept_t>		intercepts;		// denis - make intercepts array resizeable
+};
+
+// The path traversal used by the playsim.
+extern pathtrace_t		pathtrace;
+
+BOOL P_AddIntercepts (pathtrace_t& pt, fixed_t x1, fixed_t y1, fixed_t x2, fixed_t y2, int flags);
+
+//
+// P_TraverseIntercepts
+// Returns true if the traverser function returns true
+// for all lines.  The traverser is called with the
+// intercept and the trace it lies on.
+//
+template <class Trav>
+BOOL P_TraverseIntercepts (pathtrace_t& pt, Trav func, fixed_t maxfrac)
+{
+	size_t 				count = pt.intercepts.Size();
+	fixed_t 			dist;
+	size_t		scan;
+	intercept_t*		in = 0;
+
+	while (count--)
+	{
+		dist = MAXINT;
+		for (scan = 0 ; scan < pt.intercepts.Size(); scan++)
+		{
+			if (pt.intercepts[scan].frac < dist)
+			{
+				dist = pt.intercepts[scan].frac;
+				in = &pt.intercepts[scan];
+			}
+		}
+
+		if (dist > maxfrac)
+			return true;		// checked everything in range
+
+
+		if ( !func (in, pt.trace) )
+			return false;		// don't bother going farther
+
+		in->frac = MAXINT;
+	}
+
+	return true;				// everything was traversed
+}
+
+//
+// P_PathTraverse
+// Traces a line from x1,y1 to x2,y2,
+// calling the traverser function for each.
+// Returns true if the traverser function returns true
+// for all lines.
+//
+template <class Trav>
+BOOL P_PathTraverse (pathtrace_t& pt, fixed_t x1, fixed_t y1, fixed_t x2, fixed_t y2, int flags, Trav trav)
+{
+	if (!P_AddIntercepts(pt, x1, y1, x2, y2, flags))
+		return false;	// early out
+
+	// go through the sorted list
+	return P_TraverseIntercepts(pt, trav, FRACUNIT);
+}
+
+template <class Trav>
+BOOL P_PathTraverse (fixed_t x1, fixed_t y1, fixed_t x2, fixed_t y2, int flags, Trav trav)
+{
+	return P_PathTraverse(pathtrace, x1, y1, x2, y2, flags, trav);
+}
@@ -124,7 +124,7 @@ void MapThing::Serialize (FArchive &arc)
 }
 
 AActor::AActor()
-    : x(0), y(0), z(0), prevx(0), prevy(0), prevz(0), snext(NULL), sprev(NULL), angle(0),
+    : DThinker(STAT_ACTOR), x(0), y(0), z(0), prevx(0), prevy(0), prevz(0), snext(NULL), sprev(NULL), angle(0),
       prevangle(0), sprite(SPR_UNKN), frame(0), pitch(0), prevpitch(0), effects(0),
       subsector(NULL), floorz(0), ceilingz(0), dropoffz(0), floorsector(NULL), radius(0),
       height(0), momx(0), momy(0), momz(0), validcount(0), type(MT_UNKNOWNTHING),
@@ -132,7 +132,7 @@ AActor::AActor()
       flags3(0), oflags(0), special1(0), special2(0), health(0), movedir(0), movecount(0), visdir(0),
       reactiontime(0), threshold(0), player(NULL), lastlook(0), special(0), inext(NULL),
       iprev(NULL), translation(translationref_t()), translucency(0), waterlevel(0),
-      gear(0), onground(false), touching_sectorlist(NULL), deadtic(0), oldframe(0),
+      gear(0), onground(false), touching_sectorlist(NULL), secnodecache(), deadtic(0), oldframe(0),
       rndindex(0), netid(0), tid(0), bmapnode(this), baseline_set(false)
 {
 	memset(args, 0, sizeof(args));
@@ -141,7 +141,7 @@ AActor::AActor()
 }
 
 AActor::AActor(const AActor& other)
-    : x(other.x), y(other.y), z(other.z), prevx(other.prevx), prevy(other.prevy),
+    : DThinker(STAT_ACTOR), x(other.x), y(other.y), z(other.z), prevx(other.prevx), prevy(other.prevy),
       prevz(other.prevz), snext(other.snext), sprev(other.sprev), angle(other.angle),
       prevangle(other.prevangle), sprite(other.sprite), frame(other.frame),
       pitch(other.pitch), prevpitch(other.prevpitch), effects(other.effects),
@@ -157,7 +157,7 @@ AActor::AActor(const AActor& other)
       player(other.player), lastlook(other.lastlook), special(other.special),
       inext(other.inext), iprev(other.iprev), translation(other.translation),
       translucency(other.translucency), waterlevel(other.waterlevel), gear(other.gear),
-      onground(other.onground), touching_sectorlist(other.touching_sectorlist),
+      onground(other.onground), touching_sectorlist(other.touching_sectorlist), secnodecache(),
       deadtic(other.deadtic), oldframe(other.oldframe), rndindex(other.rndindex),
       netid(other.netid), tid(other.tid), bmapnode(other.bmapnode), baseline_set(false)
 {
@@ -242,7 +242,7 @@ AActor &AActor::operator= (const AActor &other)
 //
 
 AActor::AActor(fixed_t ix, fixed_t iy, fixed_t iz, mobjtype_t itype)
-    : x(0), y(0), z(0), prevx(0), prevy(0), prevz(0), snext(NULL), sprev(NULL), angle(0),
+    : DThinker(STAT_ACTOR), x(0), y(0), z(0), prevx(0), prevy(0), prevz(0), snext(NULL), sprev(NULL), angle(0),
       prevangle(0), sprite(SPR_UNKN), frame(0), pitch(0), prevpitch(0), effects(0),
       subsector(NULL), floorz(0), ceilingz(0), dropoffz(0), floorsector(NULL), radius(0),
       height(0), momx(0), momy(0), momz(0), validcount(0), type(MT_UNKNOWNTHING),
@@ -250,7 +250,7 @@ AActor::AActor(fixed_t ix, fixed_t iy, fixed_t iz, mobjtype_t itype)
       special1(0), special2(0), health(0), movedir(0), movecount(0), visdir(0),
       reactiontime(0), threshold(0), player(NULL), lastlook(0), special(0), inext(NULL),
       iprev(NULL), translation(translationref_t()), translucency(0), waterlevel(0),
-      gear(0), onground(false), touching_sectorlist(NULL), deadtic(0), oldframe(0),
+      gear(0), onground(false), touching_sectorlist(NULL), secnodecache(), deadtic(0), oldframe(0),
       rndindex(0), netid(0), tid(0), bmapnode(this), baseline_set(false)
 {
 	// Fly!!! fix it in P_RespawnSpecial
@@ -3189,59 +3189,83 @@ void P_SetMobjBaseline(AActor& mo)
 }
 
 /**
- * @brief Generate flags that lists which fields are different 
+ * @brief Capture the networked fields of an actor in the form of a baseline.
  */
-uint32_t P_GetMobjBaselineFlags(AActor& mo)
+baseline_t P_GetMobjBaselineState(AActor& mo)
+{
+	baseline_t state;
+
+	state.pos.x = mo.x;
+	state.pos.y = mo.y;
+	state.pos.z = mo.z;
+	state.mom.x = mo.momx;
+	state.mom.y = mo.momy;
+	state.mom.z = mo.momz;
+	state.angle = mo.angle;
+	state.targetid = mo.target ? mo.target->netid : 0;
+	state.tracerid = mo.tracer ? mo.tracer->netid : 0;
+	state.movecount = mo.movecount;
+	state.movedir = mo.movedir;
+	state.rndindex = mo.rndindex;
+
+	return state;
+}
+
+/**
+ * @brief Generate flags that lists which fields are different between two
+ *        states.
+ */
+uint32_t P_GetBaselineDeltaFlags(const baseline_t& from, const baseline_t& to)
 {
 	uint32_t flags = 0;
 
-	if (mo.baseline.pos.x != mo.x)
+	if (from.pos.x != to.pos.x)
 	{
 		flags |= baseline_t::POSX;
 	}
-	if (mo.baseline.pos.y != mo.y)
+	if (from.pos.y != to.pos.y)
 	{
 		flags |= baseline_t::POSY;
 	}
-	if (mo.baseline.pos.z != mo.z)
+	if (from.pos.z != to.pos.z)
 	{
 		flags |= baseline_t::POSZ;
 	}
 
-	if (mo.baseline.angle != mo.angle)
+	if (from.angle != to.angle)
 	{
 		flags |= baseline_t::ANGLE;
 	}
-	if (mo.baseline.movedir != mo.movedir)
+	if (from.movedir != to.movedir)
 	{
 		flags |= baseline_t::MOVEDIR;
 	}
-	if (mo.baseline.movecount != mo.movecount)
+	if (from.movecount != to.movecount)
 	{
 		flags |= baseline_t::MOVECOUNT;
 	}
-	if (mo.baseline.rndindex != mo.rndindex)
+	if (from.rndindex != to.rndindex)
 	{
 		flags |= baseline_t::RNDINDEX;
 	}
-	if (mo.baseline.targetid != (mo.target ? mo.target->netid : 0))
+	if (from.targetid != to.targetid)
 	{
 		flags |= baseline_t::TARGET;
 	}
-	if (mo.baseline.tracerid != (mo.tracer ? mo.tracer->netid : 0))
+	if (from.tracerid != to.tracerid)
 	{
 		flags |= baseline_t::TRACER;
 	}
 
-	if (mo.baseline.mom.x != mo.momx)
+	if (from.mom.x != to.mom.x)
 	{
 		flags |= baseline_t::MOMX;
 	}
-	if (mo.baseline.mom.y != mo.momy)
+	if (from.mom.y != to.mom.y)
 	{
 		flags |= baseline_t::MOMY;
 	}
-	if (mo.baseline.mom.z != mo.momz)
+	if (from.mom.z != to.mom.z)
 	{
 		flags |= baseline_t::MOMZ;
 	}
@@ -3249,6 +3273,14 @@ uint32_t P_GetMobjBaselineFlags(AActor& mo)
 	return flags;
 }
 
+/**
+ * @brief Generate flags that lists which fields are different 
+ */
+uint32_t P_GetMobjBaselineFlags(AActor& mo)
+{
+	return P_GetBaselineDeltaFlags(mo.baseline, P_GetMobjBaselineState(mo));
+}
+
 BEGIN_COMMAND(cheat_mobjs)
 {
 	if (argc < 2)
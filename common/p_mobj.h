@@ -147,6 +147,8 @@ size_t P_GetMapThingPlayerNumber(mapthing2_t* mthing);
 bool P_VisibleToPlayers(AActor *mo);
 void P_SetMobjBaseline(AActor& mo);
 uint32_t P_GetMobjBaselineFlags(AActor& mo);
+baseline_t P_GetMobjBaselineState(AActor& mo);
+uint32_t P_GetBaselineDeltaFlags(const baseline_t& from, const baseline_t& to);
 
 // [ML] From EE
 int P_ThingInfoHeight(mobjinfo_t *mi);
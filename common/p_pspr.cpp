@@ -666,7 +666,7 @@ void A_Punch(AActor* mo)
 
 	// [SL] 2011-07-12 - Move players and sectors back to their positions when
 	// this player hit the fire button clientside.
-	Unlag::getInstance().reconcile(player->id);
+	Unlag::getInstance().reconcile(player->id, 1 << 26, player->mo->info->meleerange + 1);
 
 	M_LogWDLEvent(WDL_EVENT_SSACCURACY, player, NULL, player->mo->angle / 4, MOD_FIST,
 	              0, GetMaxShotsForMod(MOD_FIST));
@@ -704,7 +704,7 @@ void A_Saw(AActor* mo)
 
 	// [SL] 2011-07-12 - Move players and sectors back to their positions when
 	// this player hit the fire button clientside.
-	Unlag::getInstance().reconcile(player->id);
+	Unlag::getInstance().reconcile(player->id, 1 << 26, player->mo->info->meleerange + 1);
 
 	M_LogWDLEvent(WDL_EVENT_SSACCURACY, player, NULL, player->mo->angle / 4, MOD_CHAINSAW,
 	              0, GetMaxShotsForMod(MOD_CHAINSAW));
@@ -1205,7 +1205,7 @@ void A_FireRailgun(AActor* mo)
 
 	// [SL] 2012-04-18 - Move players and sectors back to their positions when
 	// this player hit the fire button clientside.
-	Unlag::getInstance().reconcile(player->id);
+	Unlag::getInstance().reconcile(player->id, 0, 8192 * FRACUNIT);
 
 	M_LogWDLEvent(WDL_EVENT_SSACCURACY, player, NULL, player->mo->angle / 4, MOD_RAILGUN,
 	              0, GetMaxShotsForMod(MOD_RAILGUN));
@@ -1309,8 +1309,11 @@ void P_FireHitscan (player_t *player, size_t quantity, spreadtype_t spread)
 	// this player hit the fire button clientside.
 	// NOTE: Important to reconcile sectors and players BEFORE calculating
 	// bulletslope!
+	// The autoaim tracers and the pellets all stay within 1 << 26 of the
+	// player's angle, except for the super shotgun's pellets.
 	if (serverside)
-		Unlag::getInstance().reconcile(player->id);
+		Unlag::getInstance().reconcile(player->id,
+			spread == SPREAD_SUPERSHOTGUN ? 1 << 27 : 1 << 26, MISSILERANGE);
 
 	fixed_t bulletslope = P_BulletSlope(player->mo);
 
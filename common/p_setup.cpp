@@ -28,6 +28,8 @@
 #include <stdlib.h>
 #include <math.h>
 #include <set>
+#include <map>
+#include <algorithm>
 #include <zlib.h>
 
 #include "m_alloc.h"
@@ -51,6 +53,7 @@
 #include "p_setup.h"
 #include "p_hordespawn.h"
 #include "p_mapformat.h"
+#include "p_sightcache.h"
 
 void SV_PreservePlayer(player_t &player);
 void P_SpawnMapThing (mapthing2_t *mthing, int position);
@@ -118,6 +121,10 @@ int 			bmapheight; 	// size in mapblocks
 
 int				*blockmap;		// int for larger maps ([RH] Made int because BOOM does)
 int				*blockmaplump;	// offsets in blockmap are from here
+static int		blockmaplumpsize;	// entries in blockmaplump
+
+blockcell_t		*blockcells;	// packed blockmap, see P_PackBlockMap
+blockgroup_t	*blockgroups;
 
 fixed_t 		bmaporgx;		// origin of block map
 fixed_t 		bmaporgy;
@@ -1499,6 +1506,7 @@ void P_CreateBlockMap()
 
 	// Create the blockmap lump
 	blockmaplump = (int *)Z_Malloc(sizeof(*blockmaplump) * (4+NBlocks+linetotal), PU_LEVEL, 0);
+	blockmaplumpsize = 4+NBlocks+linetotal;
 
 	// blockmap header
 	//
@@ -1562,6 +1570,7 @@ void P_LoadBlockMap (int lump)
 		short *wadblockmaplump = (short *)W_CacheLumpNum (lump, PU_LEVEL);
 		int i;
 		blockmaplump = (int *)Z_Malloc(sizeof(*blockmaplump) * count, PU_LEVEL, 0);
+		blockmaplumpsize = count;
 
 		// killough 3/1/98: Expand wad blockmap into larger internal one,
 		// by treating all offsets except -1 as unsigned and zero-extending
@@ -1587,6 +1596,10 @@ void P_LoadBlockMap (int lump)
 	bmapwidth = blockmaplump[2];
 	bmapheight = blockmaplump[3];
 
+	// packed by P_PackBlockMap once polyobjects are in place
+	blockcells = NULL;
+	blockgroups = NULL;
+
 	// clear out mobj chains
 	count = sizeof(*blocklinks) * bmapwidth*bmapheight;
 	blocklinks = (AActor **)Z_Malloc (count, PU_LEVEL, 0);
@@ -1594,6 +1607,115 @@ void P_LoadBlockMap (int lump)
 	blockmap = blockmaplump+4;
 }
 
+//
+// P_PackBlockMap
+//
+// Copy the line list of every blockmap cell into groups of four, next to
+// the bounding boxes of the lines, for P_BlockLinesIterator.  Lines of
+// polyobjects move around, so they get a box that overlaps everything and
+// are left to the callback.  Lists that can't be walked safely are left
+// unpacked and use blockmaplump as before.
+//
+void P_PackBlockMap()
+{
+	const int numcells = bmapwidth * bmapheight;
+
+	std::vector<byte> polyline(numlines, 0);
+	for (int i = 0; i < po_NumPolyobjs; i++)
+		for (int j = 0; j < polyobjs[i].numsegs; j++)
+			polyline[polyobjs[i].segs[j]->linedef - lines] = 1;
+
+	blockcells = (blockcell_t *)Z_Malloc(sizeof(*blockcells) * numcells, PU_LEVEL, 0);
+
+	// Cells often share a list, so only pack each list once.
+	std::map<int, int> packed;
+	std::vector<blockgroup_t> groups;
+
+	for (int i = 0; i < numcells; i++)
+	{
+		const int offset = blockmap[i];
+
+		std::map<int, int>::const_iterator it = packed.find(offset);
+		if (it != packed.end())
+		{
+			blockcells[i] = blockcells[it->second];
+			continue;
+		}
+		packed[offset] = i;
+
+		blockcells[i].first = groups.size();
+		blockcells[i].count = -1;
+
+		// Every entry has to be a line and the list has to end inside
+		// the lump.  A list that starts with the end marker is left alone
+		// as well, since co_blockmapfix skips past it.
+		int count = 0;
+		for (int j = offset; ; j++)
+		{
+			if (j < 0 || j >= blockmaplumpsize)
+			{
+				count = -1;
+				break;
+			}
+			if (blockmaplump[j] == -1)
+				break;
+			if (blockmaplump[j] < 0 || blockmaplump[j] >= numlines)
+			{
+				count = -1;
+				break;
+			}
+			count++;
+		}
+
+		if (count <= 0)
+			continue;
+
+		for (int j = 0; j < count; j++)
+		{
+			if ((j & 3) == 0)
+			{
+				// Entries past the end of the list never overlap.
+				blockgroup_t group;
+				for (int k = 0; k < 4; k++)
+				{
+					group.left[k] = MAXINT;
+					group.right[k] = MININT;
+					group.bottom[k] = MAXINT;
+					group.top[k] = MININT;
+					group.line[k] = -1;
+				}
+				groups.push_back(group);
+			}
+
+			blockgroup_t& group = groups.back();
+			const int num = blockmaplump[offset + j];
+			const line_t* ld = &lines[num];
+
+			group.line[j & 3] = num;
+			if (polyline[num])
+			{
+				group.left[j & 3] = MININT;
+				group.right[j & 3] = MAXINT;
+				group.bottom[j & 3] = MININT;
+				group.top[j & 3] = MAXINT;
+			}
+			else
+			{
+				group.left[j & 3] = ld->bbox[BOXLEFT];
+				group.right[j & 3] = ld->bbox[BOXRIGHT];
+				group.bottom[j & 3] = ld->bbox[BOXBOTTOM];
+				group.top[j & 3] = ld->bbox[BOXTOP];
+			}
+		}
+
+		blockcells[i].count = count;
+	}
+
+	blockgroups = (blockgroup_t *)Z_Malloc(sizeof(*blockgroups) * std::max<size_t>(groups.size(), 1), PU_LEVEL, 0);
+	if (!groups.empty())
+		memcpy(blockgroups, &groups[0], sizeof(*blockgroups) * groups.size());
+}
+
 /*
 * @brief P_GenerateUniqueMapFingerPrint
 * 
@@ -1896,6 +2018,7 @@ void P_SetupLevel (const char *lumpname, int position)
 	shootthing = NULL;
 
 	DThinker::DestroyAllThinkers ();
+	P_ClearSightCache ();
 	Z_FreeTags (PU_LEVEL, PU_LEVELMAX);
 	g_ValidLevel = false;		// [AM] False until the level is loaded.
 	NormalLight.next = NULL;	// [RH] Z_FreeTags frees all the custom colormaps
@@ -1988,6 +2111,10 @@ void P_SetupLevel (const char *lumpname, int position)
 		P_TranslateTeleportThings(); // [RH] Assign teleport destination TIDs
 
     PO_Init ();
+	P_PackBlockMap ();
+
+	// Work out sight rejection for maps without a REJECT
+	P_BuildSightCache (lumpnum);
 
     if (serverside)
     {
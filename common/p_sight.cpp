@@ -32,6 +32,7 @@
 #include "m_random.h"
 #include "m_vectors.h"
 #include "p_mapformat.h"
+#include "p_sightcache.h"
 
 // State.
 #include "r_state.h"
@@ -43,13 +44,11 @@ fixed_t		sightzstart;		// eye z of looker
 fixed_t		topslope;
 fixed_t		bottomslope;		// slopes to top and bottom of target
 
-divline_t	strace;			// from t1 to t2
-fixed_t		t2x;
-fixed_t		t2y;
-
 int		sightcounts[2];
 int		sightcounts2[3];
 
+static pathtrace_t	sightpath;		// for P_SightPathTraverse
+
 EXTERN_CVAR (co_zdoomphys)
 
 /*
@@ -62,6 +61,7 @@ EXTERN_CVAR (co_zdoomphys)
 
 bool PTR_SightTraverse (intercept_t *in)
 {
+	const divline_t& trace = sightpath.trace;
 	line_t  *li;
 	fixed_t slope;
 
@@ -115,6 +115,8 @@ bool PTR_SightTraverse (intercept_t *in)
 
 bool P_SightBlockLinesIterator (int x, int y)
 {
+	const divline_t& trace = sightpath.trace;
+	TArray<intercept_t>& intercepts = sightpath.intercepts;
 	int offset;
 	int *list;
 	line_t *ld;
@@ -214,6 +216,8 @@ bool P_SightBlockLinesIterator (int x, int y)
 
 bool P_SightTraverseIntercepts ( void )
 {
+	const divline_t& trace = sightpath.trace;
+	TArray<intercept_t>& intercepts = sightpath.intercepts;
 	size_t  count = intercepts.Size();
 	fixed_t dist;
 	size_t	scan;
@@ -265,6 +269,7 @@ bool P_SightTraverseIntercepts ( void )
 
 bool P_SightPathTraverse (fixed_t x1, fixed_t y1, fixed_t x2, fixed_t y2)
 {
+	divline_t& trace = sightpath.trace;
 	fixed_t xt1,yt1,xt2,yt2;
 	fixed_t xstep,ystep;
 	fixed_t partial;
@@ -273,7 +278,7 @@ bool P_SightPathTraverse (fixed_t x1, fixed_t y1, fixed_t x2, fixed_t y2)
 	int count;
 
 	validcount++;
-	intercepts.Clear();
+	sightpath.intercepts.Clear();
 
 	if ( ((x1-bmaporgx)&(MAPBLOCKSIZE-1)) == 0)
 		x1 += FRACUNIT;							// don't side exactly on a line
@@ -413,6 +418,10 @@ bool P_CheckSightZDoom(const AActor *t1, const AActor *t2)
 		sightcounts2[0]++;
 		return false;			// can't possibly be connected
 	}
+	if (sightmatrix && sightmatrix[pnum>>3] & (1 << (pnum & 7))) {
+		sightcounts2[0]++;
+		return false;
+	}
 	//
 	// check precisely
 	//
@@ -446,7 +455,9 @@ bool P_CheckSightZDoom(const AActor *t1, const AActor *t2)
 	bottomslope = (t2->z) - sightzstart;
 	topslope = bottomslope + t2->height;
 
-	return P_SightPathTraverse (t1->x, t1->y, t2->x, t2->y);
+	const bool result = P_SightPathTraverse (t1->x, t1->y, t2->x, t2->y);
+	P_VerifySightMatrix(s1, s2, result);
+	return result;
 }
 
 /*
@@ -605,12 +616,28 @@ P_InterceptVector2
     return frac;
 }
 
+//
+// sighttrace_t
+// State of a single vanilla sight check, kept out of globals so that
+// several checks can run at the same time.
+//
+struct sighttrace_t
+{
+	divline_t	strace;			// from t1 to t2
+	fixed_t		t2x;
+	fixed_t		t2y;
+	fixed_t		sightzstart;	// eye z of looker
+	fixed_t		topslope;
+	fixed_t		bottomslope;	// slopes to top and bottom of target
+	bool		marklines;		// skip lines already checked using validcount
+};
+
 //
 // P_CrossSubsector
 // Returns true
 //  if strace crosses the given subsector successfully.
 //
-bool P_CrossSubsector (int num)
+static bool P_CrossSubsector (sighttrace_t& st, int num)
 {
     seg_t*		seg;
     line_t*		line;
@@ -646,15 +673,20 @@ bool P_CrossSubsector (int num)
 		line = seg->linedef;
 		
 		// allready checked other side?
-		if (line->validcount == validcount)
-			continue;
-		
-		line->validcount = validcount;
+		// Checking a line again gives the same answer, so checks that
+		// cannot touch validcount simply do.
+		if (st.marklines)
+		{
+			if (line->validcount == validcount)
+				continue;
+
+			line->validcount = validcount;
+		}
 		
 		v1 = line->v1;
 		v2 = line->v2;
-		s1 = P_DivlineSide (v1->x,v1->y, &strace);
-		s2 = P_DivlineSide (v2->x, v2->y, &strace);
+		s1 = P_DivlineSide (v1->x,v1->y, &st.strace);
+		s2 = P_DivlineSide (v2->x, v2->y, &st.strace);
 		
 		// line isn't crossed?
 		if (s1 == s2)
@@ -664,8 +696,8 @@ bool P_CrossSubsector (int num)
 		divl.y = v1->y;
 		divl.dx = v2->x - v1->x;
 		divl.dy = v2->y - v1->y;
-		s1 = P_DivlineSide (strace.x, strace.y, &divl);
-		s2 = P_DivlineSide (t2x, t2y, &divl);
+		s1 = P_DivlineSide (st.strace.x, st.strace.y, &divl);
+		s2 = P_DivlineSide (st.t2x, st.t2y, &divl);
 		
 		// line isn't crossed?
 		if (s1 == s2)
@@ -680,7 +712,7 @@ bool P_CrossSubsector (int num)
 		front = seg->frontsector;
 		back = seg->backsector;
 
-		frac = P_InterceptVector2 (&strace, &divl);
+		frac = P_InterceptVector2 (&st.strace, &divl);
 		
 		// no wall to block sight with?
 		fixed_t crossx = divl.x + FixedMul(frac, divl.dx);
@@ -713,19 +745,19 @@ bool P_CrossSubsector (int num)
 		
 		if (ff != bf)
 		{
-			slope = FixedDiv (openbottom - sightzstart , frac);
-			if (slope > bottomslope)
-				bottomslope = slope;
+			slope = FixedDiv (openbottom - st.sightzstart , frac);
+			if (slope > st.bottomslope)
+				st.bottomslope = slope;
 		}
 		
 		if (fc != bc)
 		{
-			slope = FixedDiv (opentop - sightzstart , frac);
-			if (slope < topslope)
-				topslope = slope;
+			slope = FixedDiv (opentop - st.sightzstart , frac);
+			if (slope < st.topslope)
+				st.topslope = slope;
 		}
 		
-		if (topslope <= bottomslope)
+		if (st.topslope <= st.bottomslope)
 			return false;		// stop				
     }
     // passed the subsector ok
@@ -739,7 +771,7 @@ bool P_CrossSubsector (int num)
 // Returns true
 //  if strace crosses the given node successfully.
 //
-bool P_CrossBSPNode (int bspnum)
+static bool P_CrossBSPNode (sighttrace_t& st, int bspnum)
 {
     node_t*	bsp;
     int		side;
@@ -747,62 +779,271 @@ bool P_CrossBSPNode (int bspnum)
     if (bspnum & NF_SUBSECTOR)
     {
 		if (bspnum == -1)
-			return P_CrossSubsector (0);
+			return P_CrossSubsector (st, 0);
 		else
-			return P_CrossSubsector (bspnum&(~NF_SUBSECTOR));
+			return P_CrossSubsector (st, bspnum&(~NF_SUBSECTOR));
     }
 	
     bsp = &nodes[bspnum];
     
     // decide which side the start point is on
-    side = P_DivlineSide (strace.x, strace.y, (divline_t *)bsp);
+    side = P_DivlineSide (st.strace.x, st.strace.y, (divline_t *)bsp);
     if (side == 2)
 		side = 0;	// an "on" should cross both sides
 	
     // cross the starting side
-    if (!P_CrossBSPNode (bsp->children[side]) )
+    if (!P_CrossBSPNode (st, bsp->children[side]) )
 		return false;
 	
     // the partition plane is crossed here
-    if (side == P_DivlineSide (t2x, t2y,(divline_t *)bsp))
+    if (side == P_DivlineSide (st.t2x, st.t2y,(divline_t *)bsp))
     {
 		// the line doesn't touch the other side
 		return true;
     }
     
     // cross the ending side		
-    return P_CrossBSPNode (bsp->children[side^1]);
+    return P_CrossBSPNode (st, bsp->children[side^1]);
 }
 
 
 //
-// P_CheckSight
-// Returns true
-//  if a straight line between t1 and t2 is unobstructed.
-// Uses REJECT.
+// P_SightRejected
+// Returns true if the REJECT table, or the one computed for maps
+// without a REJECT, says sec1 can't possibly see sec2.
 //
-bool P_CheckSightDoom(const AActor* t1, const AActor* t2)
+static bool P_SightRejected(const sector_t* sec1, const sector_t* sec2)
 {
-    int		s1;
-    int		s2;
     int		pnum;
     int		bytenum;
     int		bitnum;
 
-	if(!t1 || !t2 || !t1->subsector || !t2->subsector)
-		return false;
-    
-    // First check for trivial rejection.
-	
     // Determine subsector entries in REJECT table.
-    s1 = (t1->subsector->sector - sectors);
-    s2 = (t2->subsector->sector - sectors);
-    pnum = s1*numsectors + s2;
+    pnum = (sec1 - sectors)*numsectors + (sec2 - sectors);
     bytenum = pnum>>3;
     bitnum = 1 << (pnum&7);
-	
-    // Check in REJECT table.
+
     if (!rejectempty && rejectmatrix[bytenum]&bitnum)
+		return true;
+
+    if (sightmatrix && sightmatrix[bytenum]&bitnum)
+		return true;
+
+    return false;
+}
+
+//
+// P_TraceSightDoom
+// Look from eyes of t1 to any part of t2 through the BSP.
+// Only touches validcount if marklines is set.
+//
+static bool P_TraceSightDoom
+( fixed_t x1, fixed_t y1, fixed_t z1, fixed_t h1,
+  fixed_t x2, fixed_t y2, fixed_t z2, fixed_t h2, bool marklines )
+{
+    sighttrace_t st;
+
+    st.marklines = marklines;
+    if (marklines)
+		validcount++;
+
+    st.sightzstart = z1 + h1 - (h1>>2);
+    st.topslope = (z2+h2) - st.sightzstart;
+    st.bottomslope = (z2) - st.sightzstart;
+
+    st.strace.x = x1;
+    st.strace.y = y1;
+    st.t2x = x2;
+    st.t2y = y2;
+    st.strace.dx = x2 - x1;
+    st.strace.dy = y2 - y1;
+
+    // the head node is the last node output
+    return P_CrossBSPNode (st, numnodes-1);
+}
+
+//
+// Sight queries
+//
+// The server can work out the sight checks monsters are about to make
+// before a tic, spread over several threads.  An answer is only used if
+// neither actor nor any floor or ceiling has moved since, so it is always
+// the answer P_CheckSightDoom would have given.
+//
+struct sightquery_t
+{
+	const AActor*	t1;
+	const AActor*	t2;
+	fixed_t			pos[8];			// x, y, z and height of t1, then t2
+	unsigned int	planechanges;	// planechangecount when worked out
+	bool			result;
+};
+
+static std::vector<sightquery_t> sightqueries;
+static std::vector<int> sightqueryhash;	// index + 1 into sightqueries
+static bool sightqueriesready;
+
+static size_t P_SightQueryHash(const AActor* t1, const AActor* t2)
+{
+	size_t hash = ((size_t)t1 >> 4) * 2654435761u;
+	hash ^= ((size_t)t2 >> 4) + (hash >> 13);
+	return hash;
+}
+
+static void P_StoreSightQueryPosition(fixed_t* pos, const AActor* mo)
+{
+	pos[0] = mo->x;
+	pos[1] = mo->y;
+	pos[2] = mo->z;
+	pos[3] = mo->height;
+}
+
+//
+// P_FindSightQuery
+// Returns true and sets result if the sight check from t1 to t2 has
+// already been worked out and still holds.
+//
+static bool P_FindSightQuery(const AActor* t1, const AActor* t2, bool& result)
+{
+	if (!sightqueriesready)
+		return false;
+
+	const size_t mask = sightqueryhash.size() - 1;
+	for (size_t i = P_SightQueryHash(t1, t2) & mask; sightqueryhash[i]; i = (i + 1) & mask)
+	{
+		const sightquery_t& query = sightqueries[sightqueryhash[i] - 1];
+		if (query.t1 != t1 || query.t2 != t2)
+			continue;
+
+		fixed_t pos[8];
+		P_StoreSightQueryPosition(pos, t1);
+		P_StoreSightQueryPosition(pos + 4, t2);
+
+		if (query.planechanges != planechangecount ||
+		    memcmp(pos, query.pos, sizeof(pos)) != 0)
+			return false;
+
+		result = query.result;
+		return true;
+	}
+
+	return false;
+}
+
+//
+// P_ClearSightQueries
+// Forget every sight check worked out ahead of time.
+//
+void P_ClearSightQueries()
+{
+	sightqueries.clear();
+	sightqueriesready = false;
+}
+
+//
+// P_AddSightQuery
+// Queue a sight check from t1 to t2 to be worked out ahead of time.
+//
+void P_AddSightQuery(const AActor* t1, const AActor* t2)
+{
+	if (!t1 || !t2 || !t1->subsector || !t2->subsector)
+		return;
+
+	sightquery_t query;
+	query.t1 = t1;
+	query.t2 = t2;
+	sightqueries.push_back(query);
+}
+
+//
+// P_PrepareSightQueries
+// Drop duplicate queries and take a snapshot of everything the answers
+// depend on.  Returns the number of queries for P_RunSightQuery.
+//
+size_t P_PrepareSightQueries()
+{
+	size_t size = 16;
+	while (size < sightqueries.size() * 2)
+		size <<= 1;
+
+	sightqueryhash.assign(size, 0);
+
+	size_t count = 0;
+	for (size_t i = 0; i < sightqueries.size(); i++)
+	{
+		sightquery_t query = sightqueries[i];
+
+		size_t slot = P_SightQueryHash(query.t1, query.t2) & (size - 1);
+		while (sightqueryhash[slot])
+		{
+			const sightquery_t& other = sightqueries[sightqueryhash[slot] - 1];
+			if (other.t1 == query.t1 && other.t2 == query.t2)
+				break;
+			slot = (slot + 1) & (size - 1);
+		}
+
+		if (sightqueryhash[slot])
+			continue;
+
+		P_StoreSightQueryPosition(query.pos, query.t1);
+		P_StoreSightQueryPosition(query.pos + 4, query.t2);
+		query.planechanges = planechangecount;
+		query.result = false;
+
+		sightqueries[count] = query;
+		sightqueryhash[slot] = ++count;
+	}
+
+	sightqueries.resize(count);
+	return count;
+}
+
+//
+// P_RunSightQuery
+// Work out a queued sight check.  Nothing but the query itself is written,
+// so any number of these can run at once.
+//
+void P_RunSightQuery(size_t index)
+{
+	sightquery_t& query = sightqueries[index];
+	const fixed_t* pos = query.pos;
+
+	query.result =
+	    !P_SightRejected(query.t1->subsector->sector, query.t2->subsector->sector) &&
+	    P_TraceSightDoom(pos[0], pos[1], pos[2], pos[3], pos[4], pos[5], pos[6],
+	                     pos[7], false);
+}
+
+//
+// P_StartSightQueries
+// Let P_CheckSight use the answers of the queued sight checks.
+//
+void P_StartSightQueries()
+{
+	sightqueriesready = !sightqueries.empty();
+}
+
+//
+// P_CheckSight
+// Returns true
+//  if a straight line between t1 and t2 is unobstructed.
+// Uses REJECT.
+//
+bool P_CheckSightDoom(const AActor* t1, const AActor* t2)
+{
+	if(!t1 || !t2 || !t1->subsector || !t2->subsector)
+		return false;
+
+	// Worked out ahead of time?
+	bool result;
+	if (P_FindSightQuery(t1, t2, result))
+	{
+		P_VerifySightMatrix(t1->subsector->sector, t2->subsector->sector, result);
+		return result;
+	}
+
+    // First check for trivial rejection.
+    if (P_SightRejected(t1->subsector->sector, t2->subsector->sector))
     {
 		sightcounts[0]++;
 		
@@ -813,22 +1054,11 @@ bool P_CheckSightDoom(const AActor* t1, const AActor* t2)
     // An unobstructed LOS is possible.
     // Now look from eyes of t1 to any part of t2.
     sightcounts[1]++;
-	
-    validcount++;
-	
-    sightzstart = t1->z + t1->height - (t1->height>>2);
-    topslope = (t2->z+t2->height) - sightzstart;
-    bottomslope = (t2->z) - sightzstart;
-	
-    strace.x = t1->x;
-    strace.y = t1->y;
-    t2x = t2->x;
-    t2y = t2->y;
-    strace.dx = t2->x - t1->x;
-    strace.dy = t2->y - t1->y;
-	
-    // the head node is the last node output
-    return P_CrossBSPNode (numnodes-1);	
+
+    result = P_TraceSightDoom(t1->x, t1->y, t1->z, t1->height,
+                              t2->x, t2->y, t2->z, t2->height, true);
+    P_VerifySightMatrix(t1->subsector->sector, t2->subsector->sector, result);
+    return result;
 }
 
 //
@@ -841,23 +1071,9 @@ static bool P_CheckSightDoom
 ( fixed_t x1, fixed_t y1, fixed_t z1, fixed_t h1,
   fixed_t x2, fixed_t y2, fixed_t z2, fixed_t h2 )
 {
-    int		s1;
-    int		s2;
-    int		pnum;
-    int		bytenum;
-    int		bitnum;
-    
     // First check for trivial rejection.
-	
-    // Determine subsector entries in REJECT table.
-    s1 = (P_PointInSubsector(x1, y1)->sector - sectors);
-    s2 = (P_PointInSubsector(x2, y2)->sector - sectors);
-    pnum = s1*numsectors + s2;
-    bytenum = pnum>>3;
-    bitnum = 1 << (pnum&7);
-	
-    // Check in REJECT table.
-    if (!rejectempty && rejectmatrix[bytenum]&bitnum)
+    if (P_SightRejected(P_PointInSubsector(x1, y1)->sector,
+                        P_PointInSubsector(x2, y2)->sector))
     {
 		sightcounts[0]++;
 		
@@ -868,22 +1084,8 @@ static bool P_CheckSightDoom
     // An unobstructed LOS is possible.
     // Now look from eyes of t1 to any part of t2.
     sightcounts[1]++;
-	
-    validcount++;
-	
-    sightzstart = z1 + h1 - (h1>>2);
-    topslope = (z2+h2) - sightzstart;
-    bottomslope = (z2) - sightzstart;
-	
-    strace.x = x1;
-    strace.y = y1;
-    t2x = x2;
-    t2y = y2;
-    strace.dx = x2 - x1;
-    strace.dy = y2 - y1;
-	
-    // the head node is the last node output
-    return P_CrossBSPNode (numnodes-1);	
+
+    return P_TraceSightDoom(x1, y1, z1, h1, x2, y2, z2, h2, true);
 }
 
 bool P_CheckSight(const AActor* t1, const AActor* t2)
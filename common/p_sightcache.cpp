@@ -0,0 +1,664 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// $Id$
+//
+// Copyright (C) 2006-2020 by The Odamex Team.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//	Computed sector-to-sector sight rejection for maps without a REJECT.
+//
+//	Many maps are built without a REJECT table, or with one that is all
+//	zeros, so every sight check has to walk the BSP.  With sv_sightmatrix
+//	set, a conservative sector visibility matrix is worked out for those
+//	maps while the level is loaded, by flowing through the two-sided lines
+//	of the level, and saved to disk so the next load of the same map can
+//	skip the work.  The matrix is in place before the first tic whether it
+//	came from disk or not, so every peer and every demo playback sees the
+//	same sight results.
+//
+//	Heights are ignored, but the flow only follows two-sided lines and does
+//	not model every corner the BSP sight trace can slip past, so a map can
+//	in principle reject a pair that can see each other.  sv_sightmatrix 2
+//	runs every sight check as usual and reports such pairs instead.
+//
+//-----------------------------------------------------------------------------
+
+
+#include "odamex.h"
+
+#include "p_sightcache.h"
+
+#include <algorithm>
+#include <math.h>
+#include <stdio.h>
+#include <vector>
+
+#include "cmdlib.h"
+#include "g_level.h"
+#include "m_fileio.h"
+#include "p_local.h"
+#include "r_state.h"
+#include "w_wad.h"
+
+#include "win32inc.h"
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+EXTERN_CVAR(sv_sightmatrix)
+
+const byte* sightmatrix = NULL;
+
+namespace
+{
+
+// Map units every visibility test is widened by, so rounding in the fixed
+// point sight code can never see past a computed reject.
+const double SIGHT_EPSILON = 2.0;
+
+// Portals one sector may flow through before giving up and treating every
+// sector it is connected to as visible.
+const size_t SIGHT_MAX_WORK = 200000;
+
+const char SIGHT_CACHE_MAGIC[8] = {'O', 'D', 'A', 'P', 'V', 'S', '1', '\0'};
+
+struct SightPoint
+{
+	double x, y;
+};
+
+struct SightSeg
+{
+	SightPoint a, b;
+};
+
+// A two-sided line seen from one of its sides.  The sector it leads out of
+// is on the right of a -> b.
+struct SightPortal
+{
+	SightSeg seg;
+	int line;
+	int from;
+	int to;
+
+	bool operator<(const SightPortal& other) const
+	{
+		return from < other.from;
+	}
+};
+
+struct SightFrame
+{
+	int sector;
+	int line;
+	SightSeg pass;
+	int next;
+};
+
+struct SightJob
+{
+	// Copied from the level, so the worker never looks at level data.
+	int numsectors;
+	int numlines;
+	std::vector<SightPortal> portals;
+	std::vector<int> firstportal;
+	std::vector<int> region;
+	byte hash[16];
+	std::string path;
+
+	std::vector<byte> matrix;
+
+	SightJob() : numsectors(0), numlines(0)
+	{
+	}
+};
+
+// Matrix of the current level, and whether sight checks use it or only
+// check their results against it.
+std::vector<byte> g_matrix;
+bool g_verify = false;
+int g_falserejects = 0;
+
+//
+// Keep the part of s on the given side of the line through u and v, where
+// sign is 1 for the left side and -1 for the right.  Returns false if
+// nothing is left.
+//
+bool SIGHT_ClipToLine(SightSeg& s, const SightPoint& u, const SightPoint& v,
+                      double sign)
+{
+	const double dx = v.x - u.x;
+	const double dy = v.y - u.y;
+	const double len = sqrt(dx * dx + dy * dy);
+	if (len < 1e-6)
+		return true;
+
+	const double da =
+	    sign * (dx * (s.a.y - u.y) - dy * (s.a.x - u.x)) / len + SIGHT_EPSILON;
+	const double db =
+	    sign * (dx * (s.b.y - u.y) - dy * (s.b.x - u.x)) / len + SIGHT_EPSILON;
+
+	if (da < 0.0 && db < 0.0)
+		return false;
+	if (da >= 0.0 && db >= 0.0)
+		return true;
+
+	const double t = da / (da - db);
+	SightPoint mid;
+	mid.x = s.a.x + t * (s.b.x - s.a.x);
+	mid.y = s.a.y + t * (s.b.y - s.a.y);
+
+	if (da < 0.0)
+		s.a = mid;
+	else
+		s.b = mid;
+	return true;
+}
+
+double SIGHT_Side(const SightPoint& u, const SightPoint& v, const SightPoint& p)
+{
+	return (v.x - u.x) * (p.y - u.y) - (v.y - u.y) * (p.x - u.x);
+}
+
+//
+// Clip s to the lines that separate src from pass.  Any straight line that
+// crosses both src and pass ends up on the pass side of each of them.
+//
+bool SIGHT_ClipToSeparators(SightSeg& s, const SightSeg& src, const SightSeg& pass)
+{
+	const SightPoint* srcpts[2] = {&src.a, &src.b};
+	const SightPoint* passpts[2] = {&pass.a, &pass.b};
+
+	for (int i = 0; i < 2; i++)
+	{
+		for (int j = 0; j < 2; j++)
+		{
+			const SightPoint& u = *srcpts[i];
+			const SightPoint& v = *passpts[j];
+
+			const double ds = SIGHT_Side(u, v, *srcpts[i ^ 1]);
+			const double dp = SIGHT_Side(u, v, *passpts[j ^ 1]);
+			if (ds * dp >= 0.0)
+				continue;
+
+			if (!SIGHT_ClipToLine(s, u, v, dp > 0.0 ? 1.0 : -1.0))
+				return false;
+		}
+	}
+
+	return true;
+}
+
+//
+// Mark every sector that source might see through its portals.  Returns
+// false if the flow takes too long.
+//
+bool SIGHT_FlowSector(SightJob& job, int source, std::vector<byte>& visible,
+                      std::vector<byte>& onpath, std::vector<SightFrame>& stack)
+{
+	const std::vector<int>& first = job.firstportal;
+	size_t work = 0;
+
+	for (int p = first[source]; p < first[source + 1]; p++)
+	{
+		const SightPortal& src = job.portals[p];
+
+		visible[src.to] = 1;
+		onpath[src.line] = 1;
+
+		SightFrame base = {src.to, src.line, src.seg, first[src.to]};
+		stack.clear();
+		stack.push_back(base);
+
+		while (!stack.empty())
+		{
+			SightFrame& top = stack.back();
+			if (top.next == first[top.sector + 1])
+			{
+				onpath[top.line] = 0;
+				stack.pop_back();
+				continue;
+			}
+
+			const SightPortal& portal = job.portals[top.next++];
+			if (onpath[portal.line])
+				continue;
+
+			if (++work > SIGHT_MAX_WORK)
+			{
+				for (size_t i = 0; i < stack.size(); i++)
+					onpath[stack[i].line] = 0;
+				return false;
+			}
+
+			SightSeg seg = portal.seg;
+			if (!SIGHT_ClipToLine(seg, top.pass.a, top.pass.b, 1.0))
+				continue;
+
+			// Looking straight through the first portal, anything past it
+			// could be seen from somewhere in the source sector.
+			if (stack.size() > 1)
+			{
+				if (!SIGHT_ClipToLine(seg, src.seg.a, src.seg.b, 1.0))
+					continue;
+				if (!SIGHT_ClipToSeparators(seg, src.seg, top.pass))
+					continue;
+			}
+
+			visible[portal.to] = 1;
+			onpath[portal.line] = 1;
+
+			SightFrame frame = {portal.to, portal.line, seg, first[portal.to]};
+			stack.push_back(frame);
+		}
+	}
+
+	return true;
+}
+
+void SIGHT_WriteCache(const SightJob& job)
+{
+	std::string temp = job.path + ".tmp";
+
+	FILE* fh = fopen(temp.c_str(), "wb");
+	if (fh == NULL)
+		return;
+
+	byte count[4];
+	count[0] = job.numsectors & 0xFF;
+	count[1] = (job.numsectors >> 8) & 0xFF;
+	count[2] = (job.numsectors >> 16) & 0xFF;
+	count[3] = (job.numsectors >> 24) & 0xFF;
+
+	bool ok = fwrite(SIGHT_CACHE_MAGIC, sizeof(SIGHT_CACHE_MAGIC), 1, fh) == 1 &&
+	          fwrite(job.hash, sizeof(job.hash), 1, fh) == 1 &&
+	          fwrite(count, sizeof(count), 1, fh) == 1 &&
+	          fwrite(&job.matrix[0], job.matrix.size(), 1, fh) == 1;
+	ok = fclose(fh) == 0 && ok;
+
+	remove(job.path.c_str());
+	if (!ok || rename(temp.c_str(), job.path.c_str()) != 0)
+		remove(temp.c_str());
+}
+
+bool SIGHT_ReadCache(SightJob& job)
+{
+	FILE* fh = fopen(job.path.c_str(), "rb");
+	if (fh == NULL)
+		return false;
+
+	char magic[sizeof(SIGHT_CACHE_MAGIC)];
+	byte hash[sizeof(job.hash)];
+	byte count[4];
+
+	bool ok = fread(magic, sizeof(magic), 1, fh) == 1 &&
+	          fread(hash, sizeof(hash), 1, fh) == 1 &&
+	          fread(count, sizeof(count), 1, fh) == 1 &&
+	          memcmp(magic, SIGHT_CACHE_MAGIC, sizeof(magic)) == 0 &&
+	          memcmp(hash, job.hash, sizeof(hash)) == 0 &&
+	          (count[0] | (count[1] << 8) | (count[2] << 16) | (count[3] << 24)) ==
+	              job.numsectors;
+
+	if (ok)
+	{
+		job.matrix.resize(((size_t)job.numsectors * job.numsectors + 7) / 8);
+		ok = fread(&job.matrix[0], job.matrix.size(), 1, fh) == 1 &&
+		     fgetc(fh) == EOF;
+	}
+
+	fclose(fh);
+	return ok;
+}
+
+void SIGHT_Run(SightJob& job)
+{
+	const int numsectors = job.numsectors;
+	const size_t bits = (size_t)numsectors * numsectors;
+
+	std::vector<byte> seen((bits + 7) / 8, 0);
+	std::vector<byte> visible(numsectors);
+	std::vector<byte> onpath(job.numlines, 0);
+	std::vector<SightFrame> stack;
+
+	for (int s = 0; s < numsectors; s++)
+	{
+		std::fill(visible.begin(), visible.end(), 0);
+		visible[s] = 1;
+
+		if (!SIGHT_FlowSector(job, s, visible, onpath, stack))
+		{
+			for (int t = 0; t < numsectors; t++)
+				if (job.region[t] == job.region[s])
+					visible[t] = 1;
+		}
+
+		for (int t = 0; t < numsectors; t++)
+		{
+			if (visible[t])
+			{
+				const size_t a = (size_t)s * numsectors + t;
+				const size_t b = (size_t)t * numsectors + s;
+				seen[a >> 3] |= 1 << (a & 7);
+				seen[b >> 3] |= 1 << (b & 7);
+			}
+		}
+	}
+
+	// Sight is checked from either end, so a pair is only rejected if
+	// neither sector can see the other.
+	job.matrix.resize(seen.size());
+	for (size_t i = 0; i < seen.size(); i++)
+		job.matrix[i] = ~seen[i];
+	if (bits & 7)
+		job.matrix.back() &= (1 << (bits & 7)) - 1;
+
+	SIGHT_WriteCache(job);
+}
+
+//
+// A map's REJECT is only replaced if it is too short to use or holds
+// nothing but zeros.  Anything else may be there on purpose.
+//
+bool SIGHT_RejectIsEmpty(int maplumpnum)
+{
+	const size_t size = ((size_t)numsectors * numsectors + 7) / 8;
+	if (W_LumpLength(maplumpnum + ML_REJECT) < size || rejectmatrix == NULL)
+		return true;
+
+	for (size_t i = 0; i < size; i++)
+		if (rejectmatrix[i] != 0)
+			return false;
+
+	return true;
+}
+
+struct SightCorner
+{
+	int sector;
+	fixed_t x, y;
+
+	bool operator<(const SightCorner& other) const
+	{
+		if (sector != other.sector)
+			return sector < other.sector;
+		if (x != other.x)
+			return x < other.x;
+		return y < other.y;
+	}
+
+	bool operator==(const SightCorner& other) const
+	{
+		return sector == other.sector && x == other.x && y == other.y;
+	}
+};
+
+//
+// The flow assumes every sector is closed off by its lines.  A sector with
+// a gap can be seen through in ways it cannot follow, so every corner of
+// every sector has to be shared by an even number of its lines.
+//
+bool SIGHT_SectorsAreClosed(const std::vector<byte>& skipline)
+{
+	std::vector<SightCorner> corners;
+	corners.reserve(numlines * 4);
+
+	for (int i = 0; i < numlines; i++)
+	{
+		const line_t* line = &lines[i];
+		if (skipline[i] || line->frontsector == line->backsector)
+			continue;
+
+		for (int side = 0; side < 2; side++)
+		{
+			const sector_t* sec = side ? line->backsector : line->frontsector;
+			if (sec == NULL)
+				continue;
+
+			SightCorner c1 = {int(sec - sectors), line->v1->x, line->v1->y};
+			SightCorner c2 = {int(sec - sectors), line->v2->x, line->v2->y};
+			corners.push_back(c1);
+			corners.push_back(c2);
+		}
+	}
+
+	std::sort(corners.begin(), corners.end());
+
+	for (size_t i = 0; i < corners.size();)
+	{
+		size_t j = i + 1;
+		while (j < corners.size() && corners[j] == corners[i])
+			j++;
+		if ((j - i) & 1)
+			return false;
+		i = j;
+	}
+
+	return true;
+}
+
+int SIGHT_FindRegion(std::vector<int>& parent, int i)
+{
+	while (parent[i] != i)
+	{
+		parent[i] = parent[parent[i]];
+		i = parent[i];
+	}
+	return i;
+}
+
+void SIGHT_AddPortal(SightJob& job, int line, const vertex_t* a, const vertex_t* b,
+                     const sector_t* from, const sector_t* to)
+{
+	SightPortal portal;
+	portal.seg.a.x = FIXED2DOUBLE(a->x);
+	portal.seg.a.y = FIXED2DOUBLE(a->y);
+	portal.seg.b.x = FIXED2DOUBLE(b->x);
+	portal.seg.b.y = FIXED2DOUBLE(b->y);
+	portal.line = line;
+	portal.from = from - sectors;
+	portal.to = to - sectors;
+	job.portals.push_back(portal);
+}
+
+//
+// Copy the lines the flow needs out of the level.  Lines of polyobjects
+// are left out, since they move around and only ever block sight.
+//
+bool SIGHT_SetupJob(SightJob& job)
+{
+	std::vector<byte> skipline(numlines, 0);
+	for (int i = 0; i < po_NumPolyobjs; i++)
+		for (int j = 0; j < polyobjs[i].numsegs; j++)
+			skipline[polyobjs[i].segs[j]->linedef - lines] = 1;
+
+	if (!SIGHT_SectorsAreClosed(skipline))
+		return false;
+
+	job.numsectors = numsectors;
+	job.numlines = numlines;
+
+	std::vector<int> geometry;
+	geometry.reserve(numlines * 7 + 1);
+	geometry.push_back(numsectors);
+
+	std::vector<int> parent(numsectors);
+	for (int i = 0; i < numsectors; i++)
+		parent[i] = i;
+
+	for (int i = 0; i < numlines; i++)
+	{
+		const line_t* line = &lines[i];
+
+		geometry.push_back(line->v1->x);
+		geometry.push_back(line->v1->y);
+		geometry.push_back(line->v2->x);
+		geometry.push_back(line->v2->y);
+		geometry.push_back(line->frontsector ? line->frontsector - sectors : -1);
+		geometry.push_back(line->backsector ? line->backsector - sectors : -1);
+		geometry.push_back(skipline[i]);
+
+		if (skipline[i] || line->frontsector == NULL || line->backsector == NULL)
+			continue;
+
+		SIGHT_AddPortal(job, i, line->v1, line->v2, line->frontsector,
+		                line->backsector);
+		SIGHT_AddPortal(job, i, line->v2, line->v1, line->backsector,
+		                line->frontsector);
+
+		parent[SIGHT_FindRegion(parent, line->frontsector - sectors)] =
+		    SIGHT_FindRegion(parent, line->backsector - sectors);
+	}
+
+	std::stable_sort(job.portals.begin(), job.portals.end());
+
+	job.firstportal.resize(numsectors + 1);
+	size_t p = 0;
+	for (int i = 0; i <= numsectors; i++)
+	{
+		while (p < job.portals.size() && job.portals[p].from < i)
+			p++;
+		job.firstportal[i] = p;
+	}
+
+	job.region.resize(numsectors);
+	for (int i = 0; i < numsectors; i++)
+		job.region[i] = SIGHT_FindRegion(parent, i);
+
+	fhfprint_s hash = W_FarmHash128((const byte*)&geometry[0],
+	                                geometry.size() * sizeof(geometry[0]));
+	ArrayCopy(job.hash, hash.fingerprint);
+
+	return true;
+}
+
+std::string SIGHT_CachePath()
+{
+	std::string path = M_GetWriteDir();
+	if (!M_IsPathSep(*(path.end() - 1)))
+		path += PATHSEP;
+	path += "sightcache";
+
+#ifdef _WIN32
+	_mkdir(path.c_str());
+#else
+	mkdir(path.c_str(), S_IRUSR | S_IWUSR | S_IXUSR);
+#endif
+
+	path += PATHSEP;
+	for (size_t i = 0; i < ARRAY_LENGTH(::level.level_fingerprint); i++)
+	{
+		std::string hex;
+		StrFormat(hex, "%02x", ::level.level_fingerprint[i]);
+		path += hex;
+	}
+	path += ".pvs";
+
+	return path;
+}
+
+void SIGHT_Publish(SightJob& job, bool verify)
+{
+	g_matrix.swap(job.matrix);
+	g_verify = verify;
+	g_falserejects = 0;
+
+	// Only checked against, not used to skip sight checks.
+	sightmatrix = verify ? NULL : &g_matrix[0];
+}
+
+} // namespace
+
+//
+// P_ClearSightCache
+//
+// Drop the matrix of the current level.
+//
+void P_ClearSightCache()
+{
+	if (g_verify && g_falserejects > 0)
+	{
+		Printf(PRINT_WARNING, "sightmatrix: %d sector pairs were rejected but could see each other.\n",
+		       g_falserejects);
+	}
+
+	sightmatrix = NULL;
+	g_matrix.clear();
+	g_verify = false;
+	g_falserejects = 0;
+}
+
+//
+// P_BuildSightCache
+//
+// Load the sight matrix for the level that was just set up from disk, or
+// work it out now.  This happens before the level's first tic, so sight
+// checks never depend on how long the flow takes or on the cache file.
+//
+void P_BuildSightCache(int maplumpnum)
+{
+	P_ClearSightCache();
+
+	if (sv_sightmatrix.asInt() == 0)
+		return;
+
+	if (numsectors < 2 || !SIGHT_RejectIsEmpty(maplumpnum))
+		return;
+
+	SightJob job;
+	if (!SIGHT_SetupJob(job))
+	{
+		DPrintf("Level has unclosed sectors, not computing a sight matrix.\n");
+		return;
+	}
+
+	job.path = SIGHT_CachePath();
+	if (!SIGHT_ReadCache(job))
+	{
+		SIGHT_Run(job);
+		DPrintf("Sight matrix for %d sectors worked out.\n", numsectors);
+	}
+
+	SIGHT_Publish(job, sv_sightmatrix.asInt() == 2);
+}
+
+//
+// P_VerifySightMatrix
+//
+// With sv_sightmatrix 2, report a pair of sectors the matrix rejects even
+// though a full sight check found them in view.  Each pair is reported
+// once.
+//
+void P_VerifySightMatrix(const sector_t* sec1, const sector_t* sec2, bool seen)
+{
+	if (!seen || !g_verify || g_matrix.empty())
+		return;
+
+	const size_t s1 = sec1 - sectors;
+	const size_t s2 = sec2 - sectors;
+	const size_t a = s1 * numsectors + s2;
+	if (!(g_matrix[a >> 3] & (1 << (a & 7))))
+		return;
+
+	const size_t b = s2 * numsectors + s1;
+	g_matrix[a >> 3] &= ~(1 << (a & 7));
+	g_matrix[b >> 3] &= ~(1 << (b & 7));
+	g_falserejects++;
+
+	Printf(PRINT_WARNING, "sightmatrix: sector %" PRIuSIZE " can see sector %" PRIuSIZE " at tic %d\n",
+	       s1, s2, level.time);
+}
+
+VERSION_CONTROL (p_sightcache_cpp, "$Id$")
@@ -0,0 +1,35 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// $Id$
+//
+// Copyright (C) 2006-2020 by The Odamex Team.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//	Computed sector-to-sector sight rejection for maps without a REJECT.
+//
+//-----------------------------------------------------------------------------
+
+#pragma once
+
+struct sector_s;
+
+// A REJECT-style bit matrix computed for the current level, or NULL if
+// sv_sightmatrix is not 1 or the level has its own REJECT table.  A set bit
+// means the flow found no straight line between the two sectors, so the
+// sight traversal is skipped.
+extern const byte* sightmatrix;
+
+void P_ClearSightCache();
+void P_BuildSightCache(int maplumpnum);
+void P_VerifySightMatrix(const sector_s* sec1, const sector_s* sec2, bool seen);
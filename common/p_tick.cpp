@@ -30,6 +30,7 @@
 #include "c_console.h"
 #include "p_unlag.h"
 #include "p_horde.h"
+#include "stats.h"
 
 //
 // P_AtInterval
@@ -83,7 +84,15 @@ void P_Ticker (void)
 		P_AnimationTick(it->mo);
 	}
 
+	if (serverside)
+	{
+		BEGIN_STAT (MonsterSight);
+		P_PrepareMonsterSight ();
+		END_STAT (MonsterSight);
+	}
+
 	DThinker::RunThinkers ();
+	P_ClearSightQueries ();
 	
 	P_UpdateSpecials ();
 	P_RespawnSpecials ();
@@ -36,6 +36,9 @@
 
 #include "odamex.h"
 
+#include <math.h>
+
+#include "m_bbox.h"
 #include "m_vectors.h"
 #include "p_unlag.h"
 #include "p_local.h"
@@ -48,32 +51,25 @@ void SV_SendDestroyActor(AActor *mo);
 
 EXTERN_CVAR(sv_maxunlagtime)
 
+// Extra distance a shot is assumed to reach past its region, for the
+// railgun's sideways offset and the rounding of the traced lines.
+static const fixed_t SHOT_SLACK = 32*FRACUNIT;
+
 Unlag::SectorHistoryRecord::SectorHistoryRecord()
-	:	sector(NULL), history_size(0),
-		history_ceilingheight(), history_floorheight(),
-		backup_ceilingheight(0), backup_floorheight(0)
+	:	sector(NULL), backup_ceilingheight(0), backup_floorheight(0),
+		moved(false)
 {
 }
 
 Unlag::SectorHistoryRecord::SectorHistoryRecord(sector_t *sec)
-	: 	sector(sec), history_size(Unlag::MAX_HISTORY_TICS),
-		history_ceilingheight(), history_floorheight(),
-		backup_ceilingheight(0), backup_floorheight(0)
+	: 	sector(sec), backup_ceilingheight(0), backup_floorheight(0),
+		moved(false)
 {
 	if (!sector)
 		return;
 
-	fixed_t ceilingheight = P_CeilingHeight(sector);
-	fixed_t floorheight = P_FloorHeight(sector);
-
-	for (size_t i = 0; i < history_size; i++)
-	{
-		history_ceilingheight[i] = ceilingheight;
-		history_floorheight[i] = floorheight;
-	}
-
-	backup_ceilingheight = ceilingheight;
-	backup_floorheight = floorheight;
+	backup_ceilingheight = P_CeilingHeight(sector);
+	backup_floorheight = P_FloorHeight(sector);
 }
 
 //
@@ -138,12 +134,156 @@ void Unlag::moveSector(sector_t *sector, fixed_t ceilingheight,
 }
 
 
+//
+// Unlag::historyIndex
+//
+// Returns the row of the history arrays holding the positions recorded
+// on the given tic.
+//
+
+size_t Unlag::historyIndex(int tic)
+{
+	int index = tic % (int)Unlag::MAX_HISTORY_TICS;
+	return index < 0 ? index + Unlag::MAX_HISTORY_TICS : index;
+}
+
+
+//
+// Unlag::setShotRegion
+//
+// Works out the area the shots of 'shooter' can reach: everything within
+// 'range' of the shooter and no more than 'spread' to either side of the
+// direction the shooter faces.  A spread of ANG180 or more reaches
+// everything.
+//
+
+void Unlag::setShotRegion(byte shooter_id, angle_t spread, fixed_t range)
+{
+	AActor *mo = idplayer(shooter_id).mo;
+
+	shot.everything = (spread >= ANG180 || !mo);
+	if (shot.everything)
+		return;
+
+	shot.x = FIXED2DOUBLE(mo->x);
+	shot.y = FIXED2DOUBLE(mo->y);
+	shot.angle = mo->angle * (PI / ANG180);
+	shot.spread = spread * (PI / ANG180);
+	shot.range = FIXED2DOUBLE(range);
+
+	// bounding box of the circular sector swept by the shots
+	const double slack = FIXED2DOUBLE(SHOT_SLACK);
+	const double radius = shot.range + slack;
+	double box[4];
+	box[BOXLEFT] = box[BOXRIGHT] = shot.x;
+	box[BOXBOTTOM] = box[BOXTOP] = shot.y;
+
+	double edges[6];
+	int numedges = 0;
+	edges[numedges++] = shot.angle - shot.spread;
+	edges[numedges++] = shot.angle + shot.spread;
+	for (int i = 0; i < 4; i++)
+	{
+		if (angleOffset(i * PI / 2) <= shot.spread)
+			edges[numedges++] = i * PI / 2;
+	}
+
+	for (int i = 0; i < numedges; i++)
+	{
+		const double x = shot.x + radius * cos(edges[i]);
+		const double y = shot.y + radius * sin(edges[i]);
+		box[BOXLEFT] = MIN(box[BOXLEFT], x);
+		box[BOXRIGHT] = MAX(box[BOXRIGHT], x);
+		box[BOXBOTTOM] = MIN(box[BOXBOTTOM], y);
+		box[BOXTOP] = MAX(box[BOXTOP], y);
+	}
+
+	const double orgx = FIXED2DOUBLE(bmaporgx), orgy = FIXED2DOUBLE(bmaporgy);
+	shot.blockbox[BOXLEFT] = (int)floor((box[BOXLEFT] - slack - orgx) / MAPBLOCKUNITS);
+	shot.blockbox[BOXRIGHT] = (int)floor((box[BOXRIGHT] + slack - orgx) / MAPBLOCKUNITS);
+	shot.blockbox[BOXBOTTOM] = (int)floor((box[BOXBOTTOM] - slack - orgy) / MAPBLOCKUNITS);
+	shot.blockbox[BOXTOP] = (int)floor((box[BOXTOP] + slack - orgy) / MAPBLOCKUNITS);
+}
+
+
+//
+// Unlag::angleOffset
+//
+// Returns how far, in radians, the given angle is from the direction the
+// shooter faces.
+//
+
+double Unlag::angleOffset(double angle) const
+{
+	double offset = fmod(angle - shot.angle, 2 * PI);
+	if (offset > PI)
+		offset -= 2 * PI;
+	else if (offset < -PI)
+		offset += 2 * PI;
+	return fabs(offset);
+}
+
+
+//
+// Unlag::shotReaches
+//
+// Returns true if the shot being reconciled could hit a thing of the given
+// radius standing at x, y.
+//
+
+bool Unlag::shotReaches(fixed_t x, fixed_t y, fixed_t radius) const
+{
+	if (shot.everything)
+		return true;
+
+	// traces cross things along the diagonals of their bounding box
+	const double pad = FIXED2DOUBLE(radius) * 1.5 + FIXED2DOUBLE(SHOT_SLACK);
+	const double dx = FIXED2DOUBLE(x) - shot.x;
+	const double dy = FIXED2DOUBLE(y) - shot.y;
+	const double dist = sqrt(dx * dx + dy * dy);
+
+	if (dist <= pad)
+		return true;
+	if (dist > shot.range + pad)
+		return false;
+
+	// how far outside of the spread is the thing?
+	const double outside = angleOffset(atan2(dy, dx)) - shot.spread;
+	if (outside <= 0)
+		return true;
+	if (outside >= PI / 2)
+		return false;
+	return dist * sin(outside) <= pad;
+}
+
+
+//
+// Unlag::shotReaches
+//
+// Returns true if the shot being reconciled could cross one of the lines
+// of the given sector.
+//
+
+bool Unlag::shotReaches(const sector_t *sector) const
+{
+	if (shot.everything)
+		return true;
+
+	return !(sector->blockbox[BOXRIGHT] < shot.blockbox[BOXLEFT] ||
+			 sector->blockbox[BOXLEFT] > shot.blockbox[BOXRIGHT] ||
+			 sector->blockbox[BOXTOP] < shot.blockbox[BOXBOTTOM] ||
+			 sector->blockbox[BOXBOTTOM] > shot.blockbox[BOXTOP]);
+}
+
+
 //
 // Unlag::reconcilePlayerPositions
 //
 // Moves all of the players except 'shooter' to the position they were
 // at 'ticsago' tics before.  Players who were not alive at that time
 // have their MF_SHOOTABLE flag removed so they do not take damage.
+// Players the shot can reach neither where they are nor where they were
+// are left alone.
 //
 // If Unlag::reconcile is true, restore all player positions to their state
 // before reconciliation.  Restore the MF_SHOOTABLE flag if we changed it.
@@ -153,6 +293,11 @@ void Unlag::moveSector(sector_t *sector, fixed_t ceilingheight,
 
 void Unlag::reconcilePlayerPositions(byte shooter_id, size_t ticsago)
 {
+	const size_t cur = historyIndex(gametic - ticsago);
+	const fixed_t *row_x = history_x[cur];
+	const fixed_t *row_y = history_y[cur];
+	const fixed_t *row_z = history_z[cur];
+
 	for (size_t i=0; i<player_history.size(); i++)
 	{
 		player_t *player = player_history[i].player;
@@ -171,17 +316,29 @@ void Unlag::reconcilePlayerPositions(byte shooter_id, size_t ticsago)
 			player_history[i].backup_y = player->mo->y;
 			player_history[i].backup_z = player->mo->z;
 
-  			size_t cur = (gametic - ticsago) % Unlag::MAX_HISTORY_TICS;
+			dest_x = row_x[i];
+			dest_y = row_y[i];
+			dest_z = row_z[i];
+
+			const bool alive = player_history[i].history_size >= ticsago;
 
-			dest_x = player_history[i].history_x[cur];
-			dest_y = player_history[i].history_y[cur];
-			dest_z = player_history[i].history_z[cur];
+			player_history[i].moved =
+				shotReaches(player->mo->x, player->mo->y, player->mo->radius) ||
+				(alive && shotReaches(dest_x, dest_y, player->mo->radius));
+
+			if (!player_history[i].moved)
+			{
+				player_history[i].offset_x = 0;
+				player_history[i].offset_y = 0;
+				player_history[i].offset_z = 0;
+				continue;
+			}
 
 			player_history[i].offset_x = player_history[i].backup_x - dest_x;
 			player_history[i].offset_y = player_history[i].backup_y - dest_y;
 			player_history[i].offset_z = player_history[i].backup_z - dest_z;
 
-			if (player_history[i].history_size < ticsago)
+			if (!alive)
 			{
 				// make the player temporarily unshootable since this player
 				// was not alive when the shot was fired.  Kind of a hack.
@@ -200,6 +357,11 @@ void Unlag::reconcilePlayerPositions(byte shooter_id, size_t ticsago)
 		}
 		else
 		{   // we're moving the player back to proper position
+			if (!player_history[i].moved)
+				continue;
+
+			player_history[i].moved = false;
+
 			dest_x = player_history[i].backup_x;
 			dest_y = player_history[i].backup_y;
 			dest_z = player_history[i].backup_z;
@@ -221,8 +383,9 @@ void Unlag::reconcilePlayerPositions(byte shooter_id, size_t ticsago)
 //
 // Unlag::reconcileSectorPositions
 //
-// Moves the ceiling and floor of any sectors considered moveable
-// to the positions they were 'ticsago' tics before.
+// Moves the ceiling and floor of any sectors considered moveable, and
+// which the shot can reach, to the positions they were 'ticsago' tics
+// before.
 //
 // If 'reconciled' is true, restore the ceiling and floors to where they
 // were prior to reconciliation.
@@ -230,6 +393,14 @@ void Unlag::reconcilePlayerPositions(byte shooter_id, size_t ticsago)
 
 void Unlag::reconcileSectorPositions(size_t ticsago)
 {
+	// the last heights recorded are those of the previous tic
+	if (sector_history.empty())
+		return;
+
+	const size_t cur = historyIndex(gametic - 1 - ticsago) * sector_history_stride;
+	const fixed_t *row_ceilingheight = &history_ceilingheight[0] + cur;
+	const fixed_t *row_floorheight = &history_floorheight[0] + cur;
+
 	for (size_t i=0; i<sector_history.size(); i++)
 	{
 		sector_t *sector = sector_history[i].sector;
@@ -237,18 +408,25 @@ void Unlag::reconcileSectorPositions(size_t ticsago)
 		fixed_t dest_ceilingheight, dest_floorheight;
 		if (!reconciled)
 		{
+			sector_history[i].moved = shotReaches(sector);
+			if (!sector_history[i].moved)
+				continue;
+
 			// record the player's current position, which hasn't yet
 			// been saved to the history arrays
 			sector_history[i].backup_ceilingheight = P_CeilingHeight(sector);
 			sector_history[i].backup_floorheight = P_FloorHeight(sector);
 
-			size_t cur = (sector_history[i].history_size - 1 - ticsago)
-						  % Unlag::MAX_HISTORY_TICS;
-			dest_ceilingheight = sector_history[i].history_ceilingheight[cur];
-			dest_floorheight = sector_history[i].history_floorheight[cur];
+			dest_ceilingheight = row_ceilingheight[i];
+			dest_floorheight = row_floorheight[i];
 		}
 		else	// restore to original positions
 		{
+			if (!sector_history[i].moved)
+				continue;
+
+			sector_history[i].moved = false;
+
 			dest_ceilingheight = sector_history[i].backup_ceilingheight;
 			dest_floorheight = sector_history[i].backup_floorheight;
 		}
@@ -268,6 +446,9 @@ void Unlag::reset()
 {
 	player_history.clear();
 	sector_history.clear();
+	history_ceilingheight.clear();
+	history_floorheight.clear();
+	sector_history_stride = 0;
 	player_id_map.clear();
 }
 
@@ -284,6 +465,8 @@ void Unlag::recordPlayerPositions()
 	if (!Unlag::enabled())
 		return;
 
+	const size_t cur = historyIndex(gametic);
+
 	for (size_t i=0; i<player_history.size(); i++)
 	{
 		player_t *player = player_history[i].player;
@@ -293,10 +476,9 @@ void Unlag::recordPlayerPositions()
 		{
 			player_history[i].history_size++;
 
-			size_t cur = gametic % Unlag::MAX_HISTORY_TICS;
-			player_history[i].history_x[cur] = player->mo->x;
-			player_history[i].history_y[cur] = player->mo->y;
-			player_history[i].history_z[cur] = player->mo->z;
+			history_x[cur][i] = player->mo->x;
+			history_y[cur][i] = player->mo->y;
+			history_z[cur][i] = player->mo->z;
 
 			#ifdef _UNLAG_DEBUG_
 			DPrintf("Unlag (%03d): recording player %d position (%d, %d)\n",
@@ -325,14 +507,14 @@ void Unlag::recordSectorPositions()
 	if (!Unlag::enabled())
 		return;
 
+	const size_t cur = historyIndex(gametic) * sector_history_stride;
+
 	for (size_t i=0; i<sector_history.size(); i++)
 	{
 		sector_t *sector = sector_history[i].sector;
 
-		size_t cur = sector_history[i].history_size++
-					 % Unlag::MAX_HISTORY_TICS;
-		sector_history[i].history_ceilingheight[cur] = P_CeilingHeight(sector);
-		sector_history[i].history_floorheight[cur] = P_FloorHeight(sector);
+		history_ceilingheight[cur + i] = P_CeilingHeight(sector);
+		history_floorheight[cur + i] = P_FloorHeight(sector);
 	}
 }
 
@@ -377,6 +559,7 @@ void Unlag::registerPlayer(byte player_id)
 	player_history.back().player_id = player_id;
 	player_history.back().history_size = 0;
 	player_history.back().changed_flags = false;
+	player_history.back().moved = false;
 
 	refreshRegisteredPlayers();
 }
@@ -401,6 +584,15 @@ void Unlag::unregisterPlayer(byte player_id)
 	if (history_index >= player_history.size())
 		return;
 
+	// close the gap left in each row of the history
+	const size_t count = player_history.size() - history_index - 1;
+	for (size_t n = 0; n < Unlag::MAX_HISTORY_TICS; n++)
+	{
+		memmove(&history_x[n][history_index], &history_x[n][history_index + 1], count * sizeof(fixed_t));
+		memmove(&history_y[n][history_index], &history_y[n][history_index + 1], count * sizeof(fixed_t));
+		memmove(&history_z[n][history_index], &history_z[n][history_index + 1], count * sizeof(fixed_t));
+	}
+
 	player_history.erase(player_history.begin() + history_index);
 	refreshRegisteredPlayers();
 }
@@ -427,7 +619,36 @@ void Unlag::registerSector(sector_t *sector)
 			return;
 	}
 
+	const size_t count = sector_history.size();
+
+	// make room for another column in each row of the history
+	if (count == sector_history_stride)
+	{
+		const size_t stride = MAX(sector_history_stride * 2, (size_t)16);
+		std::vector<fixed_t> ceilingheight(Unlag::MAX_HISTORY_TICS * stride);
+		std::vector<fixed_t> floorheight(Unlag::MAX_HISTORY_TICS * stride);
+
+		for (size_t n = 0; n < Unlag::MAX_HISTORY_TICS; n++)
+		{
+			for (size_t i = 0; i < count; i++)
+			{
+				ceilingheight[n * stride + i] = history_ceilingheight[n * sector_history_stride + i];
+				floorheight[n * stride + i] = history_floorheight[n * sector_history_stride + i];
+			}
+		}
+
+		history_ceilingheight.swap(ceilingheight);
+		history_floorheight.swap(floorheight);
+		sector_history_stride = stride;
+	}
+
 	sector_history.push_back(SectorHistoryRecord(sector));
+
+	for (size_t n = 0; n < Unlag::MAX_HISTORY_TICS; n++)
+	{
+		history_ceilingheight[n * sector_history_stride + count] = sector_history.back().backup_ceilingheight;
+		history_floorheight[n * sector_history_stride + count] = sector_history.back().backup_floorheight;
+	}
 }
 
 
@@ -448,6 +669,16 @@ void Unlag::unregisterSector(sector_t *sector)
 		// note: comparing the pointers to the sector_t objects
 		if (sector_history[i].sector == sector)
 		{
+			// close the gap left in each row of the history
+			const size_t count = sector_history.size() - i - 1;
+			for (size_t n = 0; n < Unlag::MAX_HISTORY_TICS; n++)
+			{
+				fixed_t *ceilingheight = &history_ceilingheight[n * sector_history_stride];
+				fixed_t *floorheight = &history_floorheight[n * sector_history_stride];
+				memmove(ceilingheight + i, ceilingheight + i + 1, count * sizeof(fixed_t));
+				memmove(floorheight + i, floorheight + i + 1, count * sizeof(fixed_t));
+			}
+
 			sector_history.erase(sector_history.begin() + i);
 			return;
 		}
@@ -463,8 +694,12 @@ void Unlag::unregisterSector(sector_t *sector)
 // end.  This allows a client to aim directly at opponents with hitscan
 // weapons instead of leading them.
 //
+// Only the players and sectors the shooter's shots can reach are moved.
+// The shots must stay within 'range' of the shooter and within 'spread' to
+// either side of the direction the shooter faces.
+//
 
-void Unlag::reconcile(byte shooter_id)
+void Unlag::reconcile(byte shooter_id, angle_t spread, fixed_t range)
 {
 	if (!Unlag::enabled())
 		return;
@@ -502,6 +737,7 @@ void Unlag::reconcile(byte shooter_id)
 
 	if (lag > 0 && lag < Unlag::MAX_HISTORY_TICS)
 	{
+		setShotRegion(shooter_id, spread, range);
 		reconcileSectorPositions(lag);
 		reconcilePlayerPositions(shooter_id, lag);
 		reconciled = true;
@@ -640,10 +876,10 @@ void Unlag::debugReconciliation(byte shooter_id)
 			if (n > player_history[i].history_size)
 				break;
 
-			size_t cur = (gametic - n) % Unlag::MAX_HISTORY_TICS;
+			size_t cur = historyIndex(gametic - n);
 
-			fixed_t x = player_history[i].history_x[cur];
-			fixed_t y = player_history[i].history_y[cur];
+			fixed_t x = history_x[cur][i];
+			fixed_t y = history_y[cur][i];
 
 			angle_t angle = P_PointToAngle(shooter->mo->x,	shooter->mo->y, x, y);
 			angle_t deltaangle = 	angle - shooter->mo->angle < ANG180 ?
@@ -39,7 +39,8 @@ public:
 	~Unlag();
 	static Unlag& getInstance();  // returns the instantiated Unlag object
 	void reset();	  // called when starting a level
-	void reconcile(byte player_id);
+	void reconcile(byte player_id, angle_t spread = ANG180,
+				   fixed_t range = MAXINT);
 	void restore(byte player_id);
 	void recordPlayerPositions();
 	void recordSectorPositions();
@@ -63,9 +64,6 @@ private:
 		// EVERYTIME a player connects or disconnects.
 		player_t*	player;
 	
-		fixed_t		history_x[Unlag::MAX_HISTORY_TICS];
-		fixed_t		history_y[Unlag::MAX_HISTORY_TICS];
-		fixed_t		history_z[Unlag::MAX_HISTORY_TICS];
 		size_t		history_size;
 		
 		// current position. restore this position after reconciliation.
@@ -81,6 +79,9 @@ private:
 		bool		changed_flags;
 		int			backup_flags; 
 
+		// did we move the player during reconciliation?
+		bool		moved;
+
 		size_t		current_lag;
 	} PlayerHistoryRecord;
    
@@ -91,23 +92,46 @@ private:
 		SectorHistoryRecord(sector_t *sec);
 
 		sector_t*	sector;
-		size_t		history_size;
-		fixed_t		history_ceilingheight[Unlag::MAX_HISTORY_TICS];
-		fixed_t		history_floorheight[Unlag::MAX_HISTORY_TICS];
 
 		// current position. restore this position after reconciliation.
 		fixed_t		backup_ceilingheight;
 		fixed_t		backup_floorheight;
+
+		// did we move the sector during reconciliation?
+		bool		moved;
 	};
 
+	// The area a shot being reconciled can reach.  Players and sectors
+	// outside of it are left where they are.
+	typedef struct {
+		bool		everything;
+		double		x, y;
+		double		angle, spread, range;
+		int			blockbox[4];
+	} ShotRegion;
+
 	std::vector<PlayerHistoryRecord> player_history;
 	std::vector<SectorHistoryRecord> sector_history;
 	bool reconciled;	
+	ShotRegion shot;
+
+	// The history itself is kept a tic at a time, so that reconciling reads
+	// one contiguous row.  Row n holds the positions recorded on the tics
+	// where tic % MAX_HISTORY_TICS == n, one column per player_history
+	// entry.
+	fixed_t history_x[MAX_HISTORY_TICS][MAXPLAYERS];
+	fixed_t history_y[MAX_HISTORY_TICS][MAXPLAYERS];
+	fixed_t history_z[MAX_HISTORY_TICS][MAXPLAYERS];
+
+	// Same for sector heights, with rows of sector_history_stride columns.
+	std::vector<fixed_t> history_ceilingheight;
+	std::vector<fixed_t> history_floorheight;
+	size_t sector_history_stride;
     
     // stores an index into the player_history vector, keyed by player_id
 	std::map<byte, size_t> player_id_map;
 
-	Unlag() : reconciled(false) {}  // private contsructor (part of Singleton)
+	Unlag() : reconciled(false), sector_history_stride(0) {}  // private contsructor (part of Singleton)
 	Unlag(const Unlag &rhs);		// private copy constructor
 	Unlag& operator=(const Unlag &rhs);	//private assignment operator
 
@@ -116,6 +140,11 @@ private:
 					fixed_t ceilingheight, fixed_t floorheight);
 	void reconcilePlayerPositions(byte shooter_id, size_t ticsago);
 	void reconcileSectorPositions(size_t ticsago);
+	void setShotRegion(byte shooter_id, angle_t spread, fixed_t range);
+	double angleOffset(double angle) const;
+	bool shotReaches(fixed_t x, fixed_t y, fixed_t radius) const;
+	bool shotReaches(const sector_t *sector) const;
+	static size_t historyIndex(int tic);
 	void refreshRegisteredPlayers();
 
 	void debugReconciliation(byte shooter_id);
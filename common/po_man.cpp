@@ -72,6 +72,7 @@ polyblock_t **PolyBlockMap;
 polyobj_t *polyobjs; // list of all poly-objects on the level
 int po_NumPolyobjs;
 polyspawns_t *polyspawns; // [RH] Let P_SpawnMapThings() find our thingies for us
+unsigned int polychangecount;
 
 // PRIVATE DATA DEFINITIONS ------------------------------------------------
 
@@ -723,6 +724,8 @@ BOOL PO_MovePolyobj (int num, int x, int y)
 		I_Error ("PO_MovePolyobj: Invalid polyobj number: %d\n", num);
 	}
 
+	polychangecount++;
+
 	UnLinkPolyobj (po);
 	DoMovePolyobj (po, x, y);
 
@@ -832,6 +835,8 @@ BOOL PO_RotatePolyobj (int num, angle_t angle)
 	{
 		I_Error("PO_RotatePolyobj: Invalid polyobj number: %d\n", num);
 	}
+
+	polychangecount++;
 	an = (po->angle+angle)>>ANGLETOFINESHIFT;
 
 	UnLinkPolyobj(po);
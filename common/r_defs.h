@@ -768,6 +768,8 @@ struct visplane_s
 	fixed_t		xscale, yscale;		// [RH] Support flat scaling
 	angle_t		angle;				// [RH] Support flat rotation
 
+	int			group;				// shared by planes R_CheckPlane split
+
 	unsigned int *bottom;			// [RH] bottom and top arrays are dynamically
 	unsigned int pad;				//		allocated immediately after the
 	unsigned int top[3];			//		visplane.
@@ -26,6 +26,47 @@
 #include "r_intrin.h"
 #include "r_defs.h"
 
+// ============================================================================
+//
+// Fuzz Table
+//
+// Framebuffer postprocessing.
+// Creates a fuzzy image by copying pixels from adjacent ones to left and right.
+// Used with an all black colormap, this could create the SHADOW effect,
+// i.e. spectres and invisible players.
+//
+// ============================================================================
+
+class FuzzTable
+{
+public:
+	FuzzTable() : pos(0) { }
+
+	forceinline void incrementRow()
+	{
+		pos = (pos + 1) % FuzzTable::size;
+	}
+
+	forceinline void incrementColumn()
+	{
+		pos = (pos + 3) % FuzzTable::size;
+	}
+
+	forceinline int getValue(int pitch) const
+	{
+		// [SL] quickly convert the table value (-1 or 1) into (-pitch or pitch).
+		// [AM] Replaced with a multiply that returns accurate results.  Hopefully
+		//      we can find a way to improve upon an imul someday.
+		int value = table[pos];
+		return pitch * value;
+	}
+
+private:
+	static const size_t size = 64;
+	static const int table[FuzzTable::size];
+	int pos;
+};
+
 typedef struct 
 {
 	byte*				source;
@@ -51,6 +92,8 @@ typedef struct
 	translationref_t	translation;
 
 	palindex_t			color;				// for r_drawflat
+
+	FuzzTable*			fuzz;				// for R_DrawFuzzColumn
 } drawcolumn_t;
 
 extern "C" drawcolumn_t dcol;
@@ -82,7 +125,7 @@ typedef struct
 
 	fixed_t				translevel;
 
-	shaderef_t			slopelighting[MAXWIDTH];
+	const shaderef_t*	slopelighting;
 
 	palindex_t			color;
 } drawspan_t;
@@ -90,6 +133,49 @@ typedef struct
 extern "C" drawspan_t dspan;
 
 
+// Drawing the view on several threads.  While the view is being drawn, the
+// columns and spans are queued instead of drawn, and each thread then draws
+// the ones falling in its own vertical slice of the view.  See r_drawqueue.cpp.
+
+extern bool drawqueue_active;
+
+void R_BeginDrawQueue();
+void R_FlushDrawQueue();
+void R_EndDrawQueue();
+void R_ShutdownDrawQueue();
+
+void R_QueueColumn(void (*func)(drawcolumn_t&), const drawcolumn_t& drawcolumn, int tempsource);
+void R_QueueSpan(void (*func)(drawspan_t&), const drawspan_t& drawspan, bool slope);
+
+//
+// R_DispatchColumn
+//
+// Draws a column with func, or queues it if the view is drawn on several
+// threads.  If the column's source is a temporary buffer, tempsource is its
+// length so it can be queued along with the column.
+//
+inline void R_DispatchColumn(void (*func)(drawcolumn_t&), drawcolumn_t& drawcolumn, int tempsource = 0)
+{
+	if (drawqueue_active)
+		R_QueueColumn(func, drawcolumn, tempsource);
+	else
+		func(drawcolumn);
+}
+
+//
+// R_DispatchSpan
+//
+// Draws a span with func, or queues it if the view is drawn on several
+// threads.  slope is true if the span uses slopelighting.
+//
+inline void R_DispatchSpan(void (*func)(drawspan_t&), drawspan_t& drawspan, bool slope = false)
+{
+	if (drawqueue_active)
+		R_QueueSpan(func, drawspan, slope);
+	else
+		func(drawspan);
+}
+
 // [RH] Temporary buffer for column drawing
 
 void R_RenderColumnRange(int start, int stop, int* top, int* bottom,
@@ -99,60 +185,62 @@ void R_RenderColumnRange(int start, int stop, int* top, int* bottom,
 
 // The span blitting interface.
 // Hook in assembler or system specific BLT here.
-extern void (*R_DrawColumn)(void);
+extern void (*R_DrawColumn)(drawcolumn_t&);
 
 // The Spectre/Invisibility effect.
-extern void (*R_DrawFuzzColumn)(void);
+extern void (*R_DrawFuzzColumn)(drawcolumn_t&);
 
 // [RH] Draw translucent column;
-extern void (*R_DrawTranslucentColumn)(void);
+extern void (*R_DrawTranslucentColumn)(drawcolumn_t&);
 
 // Draw with color translation tables,
 //	for player sprite rendering,
 //	Green/Red/Blue/Indigo shirts.
-extern void (*R_DrawTranslatedColumn)(void);
+extern void (*R_DrawTranslatedColumn)(drawcolumn_t&);
 
-extern void (*R_DrawTlatedLucentColumn)(void);
+extern void (*R_DrawTlatedLucentColumn)(drawcolumn_t&);
 
 // Span blitting for rows, floor/ceiling.
 // No Sepctre effect needed.
-extern void (*R_DrawSpan)(void);
+extern void (*R_DrawSpan)(drawspan_t&);
 
-extern void (*R_DrawSlopeSpan)(void);
+extern void (*R_DrawSlopeSpan)(drawspan_t&);
 
-extern void (*R_FillColumn)(void);
-extern void (*R_FillSpan)(void);
-extern void (*R_FillTranslucentSpan)(void);
+extern void (*R_FillColumn)(drawcolumn_t&);
+extern void (*R_FillSpan)(drawspan_t&);
+extern void (*R_FillTranslucentSpan)(drawspan_t&);
 
 // [RH] Initialize the above function pointers
 void R_InitColumnDrawers ();
 
 void R_InitVectorizedDrawers();
 
-void	R_DrawColumnP (void);
-void	R_DrawFuzzColumnP (void);
-void	R_DrawTranslucentColumnP (void);
-void	R_DrawTranslatedColumnP (void);
-void	R_DrawSpanP (void);
-void	R_DrawSlopeSpanIdealP_C (void);
+void	R_DrawColumnP (drawcolumn_t& drawcolumn);
+void	R_DrawFuzzColumnP (drawcolumn_t& drawcolumn);
+void	R_DrawTranslucentColumnP (drawcolumn_t& drawcolumn);
+void	R_DrawTranslatedColumnP (drawcolumn_t& drawcolumn);
+void	R_DrawSpanP (drawspan_t& drawspan);
+void	R_DrawSlopeSpanIdealP_C (drawspan_t& drawspan);
 
-void	R_DrawColumnD (void);
-void	R_DrawFuzzColumnD (void);
-void	R_DrawTranslucentColumnD (void);
-void	R_DrawTranslatedColumnD (void);
+void	R_DrawColumnD (drawcolumn_t& drawcolumn);
+void	R_DrawFuzzColumnD (drawcolumn_t& drawcolumn);
+void	R_DrawTranslucentColumnD (drawcolumn_t& drawcolumn);
+void	R_DrawTranslatedColumnD (drawcolumn_t& drawcolumn);
 
-void	R_DrawTlatedLucentColumnP (void);
-void	R_StretchColumnP (void);
+void	R_DrawTlatedLucentColumnP (drawcolumn_t& drawcolumn);
+void	R_StretchColumnP (drawcolumn_t& drawcolumn);
 #define R_StretchColumn R_StretchColumnP
 
-void	R_BlankColumn (void);
-void	R_FillColumnP (void);
-void	R_BlankSpan (void);
-void	R_FillSpanP (void);
-void	R_FillSpanD (void);
+void	R_BlankColumn (drawcolumn_t& drawcolumn);
+void	R_FillColumnP (drawcolumn_t& drawcolumn);
+void	R_BlankSpan (drawspan_t& drawspan);
+void	R_FillSpanP (drawspan_t& drawspan);
+void	R_FillSpanD (drawspan_t& drawspan);
 
-void R_DrawSpanD_c(void);
-void R_DrawSlopeSpanD_c(void);
+void R_DrawSpanD_c(drawspan_t& drawspan);
+void R_DrawSlopeSpanD_c(drawspan_t& drawspan);
+void R_DrawColumnQuadD_c(drawcolumn_t* columns);
+void R_DrawTranslucentColumnQuadD_c(drawcolumn_t* columns);
 
 #define SPANJUMP 16
 #define INTERPSTEP (0.0625f)
@@ -162,26 +250,45 @@ class IWindowSurface;
 void r_dimpatchD_c(IWindowSurface* surface, argb_t color, int alpha, int x1, int y1, int w, int h);
 
 #ifdef __SSE2__
-void R_DrawSpanD_SSE2(void);
-void R_DrawSlopeSpanD_SSE2(void);
+void R_DrawSpanD_SSE2(drawspan_t& drawspan);
+void R_DrawSlopeSpanD_SSE2(drawspan_t& drawspan);
+void R_DrawColumnQuadD_SSE2(drawcolumn_t* columns);
+void R_DrawTranslucentColumnQuadD_SSE2(drawcolumn_t* columns);
 void r_dimpatchD_SSE2(IWindowSurface*, argb_t color, int alpha, int x1, int y1, int w, int h);
 #endif
 
+#ifdef HAVE_AVX2_DRAWERS
+void R_DrawSpanD_AVX2(drawspan_t& drawspan);
+void R_DrawSlopeSpanD_AVX2(drawspan_t& drawspan);
+void R_DrawTranslucentColumnQuadD_AVX2(drawcolumn_t* columns);
+void r_dimpatchD_AVX2(IWindowSurface*, argb_t color, int alpha, int x1, int y1, int w, int h);
+#endif
+
+#ifdef HAVE_NEON_DRAWERS
+void R_DrawSpanD_NEON(drawspan_t& drawspan);
+void R_DrawSlopeSpanD_NEON(drawspan_t& drawspan);
+void R_DrawColumnQuadD_NEON(drawcolumn_t* columns);
+void R_DrawTranslucentColumnQuadD_NEON(drawcolumn_t* columns);
+void r_dimpatchD_NEON(IWindowSurface*, argb_t color, int alpha, int x1, int y1, int w, int h);
+#endif
+
 #ifdef __MMX__
-void R_DrawSpanD_MMX(void);
-void R_DrawSlopeSpanD_MMX(void);
+void R_DrawSpanD_MMX(drawspan_t& drawspan);
+void R_DrawSlopeSpanD_MMX(drawspan_t& drawspan);
 void r_dimpatchD_MMX(IWindowSurface*, argb_t color, int alpha, int x1, int y1, int w, int h);
 #endif
 
 #ifdef __ALTIVEC__
-void R_DrawSpanD_ALTIVEC(void);
-void R_DrawSlopeSpanD_ALTIVEC(void);
+void R_DrawSpanD_ALTIVEC(drawspan_t& drawspan);
+void R_DrawSlopeSpanD_ALTIVEC(drawspan_t& drawspan);
 void r_dimpatchD_ALTIVEC(IWindowSurface*, argb_t color, int alpha, int x1, int y1, int w, int h);
 #endif
 
 // Vectorizable function pointers:
-extern void (*R_DrawSpanD)(void);
-extern void (*R_DrawSlopeSpanD)(void);
+extern void (*R_DrawSpanD)(drawspan_t&);
+extern void (*R_DrawSlopeSpanD)(drawspan_t&);
+extern void (*R_DrawColumnQuadD)(drawcolumn_t*);
+extern void (*R_DrawTranslucentColumnQuadD)(drawcolumn_t*);
 extern void (*r_dimpatchD)(IWindowSurface* surface, argb_t color, int alpha, int x1, int y1, int w, int h);
 
 extern byte bosstable[256];
@@ -56,3 +56,25 @@
 		#include <emmintrin.h>
 	#endif
 #endif
+
+/* The AVX2 drawers are built with a target attribute instead of -mavx2, so the
+   rest of the program still runs on CPUs without AVX2.  They are only used if
+   the CPU supports AVX2. */
+#if defined(__SSE2__)
+	#if defined(__clang__) || (defined(__GNUC__) && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9)))
+		#if defined(__x86_64__) || defined(__i386__)
+			#define HAVE_AVX2_DRAWERS
+			#define AVX2_TARGET __attribute__((target("avx2")))
+		#endif
+	#elif defined(_MSC_VER) && (_MSC_VER >= 1700) && (defined(_M_X64) || defined(_M_IX86))
+		#define HAVE_AVX2_DRAWERS
+		#define AVX2_TARGET
+	#endif
+#endif
+
+/* NEON is part of every AArch64 CPU.  32-bit ARM builds only get the NEON
+   drawers if the compiler is told to use NEON. */
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+	#include <arm_neon.h>
+	#define HAVE_NEON_DRAWERS
+#endif
@@ -28,6 +28,7 @@
 #include "v_palette.h"
 #include "m_vectors.h"
 #include "v_video.h"
+#include "r_draw.h"
 
 // killough 10/98: special mask indicates sky flat comes from sidedef
 #define PL_SKYFLAT (0x80000000)
@@ -67,6 +68,22 @@ extern int				loopcount;
 
 extern fixed_t			render_lerp_amount;
 
+// The parts of drawing the view that are timed for -renderbench.  While
+// r_timephases is set, R_RenderPlayerView stores how long each one took in
+// r_phasetime.  Walls are the wall columns drawn during the BSP walk, which
+// are not counted towards the BSP walk itself.
+enum renderphase_t
+{
+	RPHASE_BSP,
+	RPHASE_WALLS,
+	RPHASE_PLANES,
+	RPHASE_MASKED,
+	NUMRENDERPHASES
+};
+
+extern bool				r_timephases;
+extern dtime_t			r_phasetime[NUMRENDERPHASES];
+
 // [SL] Current color blending values (including palette effects)
 extern fargb_t blend_color;
 
@@ -113,9 +130,9 @@ extern int				lightscaleymul;
 //
 // Function pointers to switch refresh/drawing functions.
 //
-extern void 			(*colfunc) (void);
-extern void 			(*spanfunc) (void);
-extern void				(*spanslopefunc) (void);
+extern void 			(*colfunc) (drawcolumn_t&);
+extern void 			(*spanfunc) (drawspan_t&);
+extern void				(*spanslopefunc) (drawspan_t&);
 
 
 //
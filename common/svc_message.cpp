@@ -29,6 +29,8 @@
 
 #include <bitset>
 
+#include <google/protobuf/arena.h>
+
 #include "svc_message.h"
 
 #include "common.pb.h"
@@ -57,6 +59,50 @@ static uint32_t PackBoolArray(const bool* bools, size_t count)
 	return out;
 }
 
+// Size of the memory block the message arena starts out with.
+#define SVC_ARENA_INITIAL_SIZE (256 * 1024)
+
+/**
+ * @brief Arena that messages sent every tic are allocated in.
+ *
+ * Building one of these messages used to cost a heap allocation for the
+ * message and every submessage it had.  The arena hands out memory from a
+ * static block instead and gets reset once per tic, so the block is reused.
+ */
+static google::protobuf::Arena& MessageArena()
+{
+	static uint64_t initial[SVC_ARENA_INITIAL_SIZE / sizeof(uint64_t)];
+	static google::protobuf::Arena* arena = NULL;
+	if (arena == NULL)
+	{
+		google::protobuf::ArenaOptions options;
+		options.initial_block = reinterpret_cast<char*>(initial);
+		options.initial_block_size = sizeof(initial);
+		arena = new google::protobuf::Arena(options);
+	}
+	return *arena;
+}
+
+/**
+ * @brief Create an empty message in the message arena.
+ */
+template <typename MSG>
+static MSG& NewMessage()
+{
+	return *google::protobuf::Arena::CreateMessage<MSG>(&MessageArena());
+}
+
+/**
+ * @brief Free every message built since the last reset.
+ *
+ * Messages returned by reference live in the arena and must be written out
+ * before this is called, which happens at the start of every tic.
+ */
+void SVC_ResetArena()
+{
+	MessageArena().Reset();
+}
+
 odaproto::svc::Disconnect SVC_Disconnect(const char* message)
 {
 	odaproto::svc::Disconnect msg;
@@ -72,9 +118,9 @@ odaproto::svc::Disconnect SVC_Disconnect(const char* message)
 /**
  * @brief Send information about a player.
  */
-odaproto::svc::PlayerInfo SVC_PlayerInfo(player_t& player)
+odaproto::svc::PlayerInfo& SVC_PlayerInfo(player_t& player)
 {
-	odaproto::svc::PlayerInfo msg;
+	odaproto::svc::PlayerInfo& msg = NewMessage<odaproto::svc::PlayerInfo>();
 
 	uint32_t packedweapons = PackBoolArray(player.weaponowned, NUMWEAPONS);
 	msg.mutable_player()->set_weaponowned(packedweapons);
@@ -111,9 +157,9 @@ odaproto::svc::PlayerInfo SVC_PlayerInfo(player_t& player)
 /**
  * @brief Change the location of a player.
  */
-odaproto::svc::MovePlayer SVC_MovePlayer(player_t& player, const int tic)
+odaproto::svc::MovePlayer& SVC_MovePlayer(player_t& player, const int tic)
 {
-	odaproto::svc::MovePlayer msg;
+	odaproto::svc::MovePlayer& msg = NewMessage<odaproto::svc::MovePlayer>();
 
 	odaproto::Actor* act = msg.mutable_actor();
 	odaproto::Player* pl = msg.mutable_player();
@@ -159,9 +205,9 @@ odaproto::svc::MovePlayer SVC_MovePlayer(player_t& player, const int tic)
 /**
  * @brief Send the local player position for a client.
  */
-odaproto::svc::UpdateLocalPlayer SVC_UpdateLocalPlayer(AActor& mo, const int tic)
+odaproto::svc::UpdateLocalPlayer& SVC_UpdateLocalPlayer(AActor& mo, const int tic)
 {
-	odaproto::svc::UpdateLocalPlayer msg;
+	odaproto::svc::UpdateLocalPlayer& msg = NewMessage<odaproto::svc::UpdateLocalPlayer>();
 
 	// client player will update his position if packets were missed
 	odaproto::Actor* act = msg.mutable_actor();
@@ -254,9 +300,9 @@ odaproto::svc::UpdatePing SVC_UpdatePing(player_t& player)
 	return msg;
 }
 
-odaproto::svc::SpawnMobj SVC_SpawnMobj(AActor* mo)
+odaproto::svc::SpawnMobj& SVC_SpawnMobj(AActor* mo)
 {
-	odaproto::svc::SpawnMobj msg;
+	odaproto::svc::SpawnMobj& msg = NewMessage<odaproto::svc::SpawnMobj>();
 
 	odaproto::Actor* base = msg.mutable_baseline();
 	odaproto::Vec3* bpos = base->mutable_pos();
@@ -477,77 +523,108 @@ odaproto::svc::UserInfo SVC_UserInfo(player_t& player, int64_t time)
 	return msg;
 }
 
-/**
- * @brief Update mobj data on the client compared to the baseline.
- */
-odaproto::svc::UpdateMobj SVC_UpdateMobj(AActor& mobj)
+static void WriteMobjState(odaproto::svc::UpdateMobj& msg, const uint32_t netid,
+                           const uint32_t flags, const baseline_t& state)
 {
-	odaproto::svc::UpdateMobj msg;
-
-	uint32_t flags = P_GetMobjBaselineFlags(mobj);
 	msg.set_flags(flags);
 
 	odaproto::Actor* act = msg.mutable_actor();
 	odaproto::Vec3* pos = act->mutable_pos();
 	odaproto::Vec3* mom = act->mutable_mom();
 
-	act->set_netid(mobj.netid);
+	act->set_netid(netid);
 
 	if (flags & baseline_t::POSX)
 	{
-		pos->set_x(mobj.x);
+		pos->set_x(state.pos.x);
 	}
 	if (flags & baseline_t::POSY)
 	{
-		pos->set_y(mobj.y);
+		pos->set_y(state.pos.y);
 	}
 	if (flags & baseline_t::POSZ)
 	{
-		pos->set_z(mobj.z);
+		pos->set_z(state.pos.z);
 	}
 	if (flags & baseline_t::ANGLE)
 	{
-		act->set_angle(mobj.angle);
+		act->set_angle(state.angle);
 	}
 	if (flags & baseline_t::MOVEDIR)
 	{
-		act->set_movedir(mobj.movedir);
+		act->set_movedir(state.movedir);
 	}
 	if (flags & baseline_t::MOVECOUNT)
 	{
-		act->set_movecount(mobj.movecount);
+		act->set_movecount(state.movecount);
 	}
 	if (flags & baseline_t::RNDINDEX)
 	{
-		act->set_rndindex(mobj.rndindex);
+		act->set_rndindex(state.rndindex);
 	}
 	if (flags & baseline_t::TARGET)
 	{
-		act->set_targetid(mobj.target ? mobj.target->netid : 0);
+		act->set_targetid(state.targetid);
 	}
 	if (flags & baseline_t::TRACER)
 	{
-		act->set_tracerid(mobj.tracer ? mobj.tracer->netid : 0);
+		act->set_tracerid(state.tracerid);
 	}
 	if (flags & baseline_t::MOMX)
 	{
-		mom->set_x(mobj.momx);
+		mom->set_x(state.mom.x);
 	}
 	if (flags & baseline_t::MOMY)
 	{
-		mom->set_y(mobj.momy);
+		mom->set_y(state.mom.y);
 	}
 	if (flags & baseline_t::MOMZ)
 	{
-		mom->set_z(mobj.momz);
+		mom->set_z(state.mom.z);
 	}
+}
+
+/**
+ * @brief Update mobj data on the client compared to the baseline.
+ */
+odaproto::svc::UpdateMobj& SVC_UpdateMobj(AActor& mobj)
+{
+	odaproto::svc::UpdateMobj& msg = NewMessage<odaproto::svc::UpdateMobj>();
+
+	const baseline_t state = P_GetMobjBaselineState(mobj);
+	WriteMobjState(msg, mobj.netid, P_GetBaselineDeltaFlags(mobj.baseline, state),
+	               state);
+
+	return msg;
+}
+
+/**
+ * @brief Update mobj data on the client compared to an earlier tracked state.
+ *
+ * @param netid Net ID of the actor.
+ * @param from State the client already has, either the spawn baseline or a
+ *             state it acknowledged.
+ * @param to Current state of the actor.
+ * @param tag Tag the client should remember this state by.
+ * @param basetag Tag of the "from" state, or 0 if it is the spawn baseline.
+ */
+odaproto::svc::UpdateMobj& SVC_UpdateMobjDelta(const uint32_t netid,
+                                               const baseline_t& from,
+                                               const baseline_t& to, const uint32_t tag,
+                                               const uint32_t basetag)
+{
+	odaproto::svc::UpdateMobj& msg = NewMessage<odaproto::svc::UpdateMobj>();
+
+	WriteMobjState(msg, netid, P_GetBaselineDeltaFlags(from, to), to);
+	msg.set_tag(tag);
+	msg.set_basetag(basetag);
 
 	return msg;
 }
 
-odaproto::svc::SpawnPlayer SVC_SpawnPlayer(player_t& player)
+odaproto::svc::SpawnPlayer& SVC_SpawnPlayer(player_t& player)
 {
-	odaproto::svc::SpawnPlayer msg;
+	odaproto::svc::SpawnPlayer& msg = NewMessage<odaproto::svc::SpawnPlayer>();
 
 	msg.set_pid(player.id);
 
@@ -571,9 +648,9 @@ odaproto::svc::SpawnPlayer SVC_SpawnPlayer(player_t& player)
 	return msg;
 }
 
-odaproto::svc::DamagePlayer SVC_DamagePlayer(player_t& player, AActor* inflictor, int health, int armor)
+odaproto::svc::DamagePlayer& SVC_DamagePlayer(player_t& player, AActor* inflictor, int health, int armor)
 {
-	odaproto::svc::DamagePlayer msg;
+	odaproto::svc::DamagePlayer& msg = NewMessage<odaproto::svc::DamagePlayer>();
 
 	msg.set_netid(player.mo->netid);
 	msg.set_inflictorid(inflictor ? inflictor->netid : 0);
@@ -588,10 +665,10 @@ odaproto::svc::DamagePlayer SVC_DamagePlayer(player_t& player, AActor* inflictor
 /**
  * @brief Kill a mobj.
  */
-odaproto::svc::KillMobj SVC_KillMobj(AActor* source, AActor* target, AActor* inflictor,
-                                     int mod, bool joinkill)
+odaproto::svc::KillMobj& SVC_KillMobj(AActor* source, AActor* target, AActor* inflictor,
+                                      int mod, bool joinkill)
 {
-	odaproto::svc::KillMobj msg;
+	odaproto::svc::KillMobj& msg = NewMessage<odaproto::svc::KillMobj>();
 
 	odaproto::Actor* tgt = msg.mutable_target();
 
@@ -758,9 +835,9 @@ odaproto::svc::ActivateLine SVC_ActivateLine(line_t* line, AActor* mo, int side,
 	return msg;
 }
 
-odaproto::svc::MovingSector SVC_MovingSector(const sector_t& sector)
+odaproto::svc::MovingSector& SVC_MovingSector(const sector_t& sector)
 {
-	odaproto::svc::MovingSector msg;
+	odaproto::svc::MovingSector& msg = NewMessage<odaproto::svc::MovingSector>();
 
 	ptrdiff_t sectornum = &sector - ::sectors;
 
@@ -917,10 +994,10 @@ odaproto::svc::MovingSector SVC_MovingSector(const sector_t& sector)
 	return msg;
 }
 
-odaproto::svc::PlaySound SVC_PlaySound(const PlaySoundType& type, int channel, int sfx_id,
-                                       float volume, int attenuation)
+odaproto::svc::PlaySound& SVC_PlaySound(const PlaySoundType& type, int channel, int sfx_id,
+                                        float volume, int attenuation)
 {
-	odaproto::svc::PlaySound msg;
+	odaproto::svc::PlaySound& msg = NewMessage<odaproto::svc::PlaySound>();
 
 	msg.set_channel(channel);
 	msg.set_sfxid(sfx_id);
@@ -955,9 +1032,9 @@ odaproto::svc::TouchSpecial SVC_TouchSpecial(AActor* mo)
 /**
  * @brief Send information about a player
  */
-odaproto::svc::PlayerState SVC_PlayerState(player_t& player)
+odaproto::svc::PlayerState& SVC_PlayerState(player_t& player)
 {
-	odaproto::svc::PlayerState msg;
+	odaproto::svc::PlayerState& msg = NewMessage<odaproto::svc::PlayerState>();
 
 	odaproto::Player* pl = msg.mutable_player();
 
@@ -1170,9 +1247,9 @@ odaproto::svc::IntTimeLeft SVC_IntTimeLeft(const unsigned int timeleft)
 	return msg;
 }
 
-odaproto::svc::RailTrail SVC_RailTrail(const v3double_t& start, const v3double_t& end)
+odaproto::svc::RailTrail& SVC_RailTrail(const v3double_t& start, const v3double_t& end)
 {
-	odaproto::svc::RailTrail msg;
+	odaproto::svc::RailTrail& msg = NewMessage<odaproto::svc::RailTrail>();
 
 	odaproto::Vec3* stmsg = msg.mutable_start();
 	stmsg->set_x(DOUBLE2FIXED(start.x));
@@ -1587,9 +1664,9 @@ odaproto::svc::HordeInfo SVC_HordeInfo(const hordeInfo_t& horde)
 	return msg;
 }
 
-odaproto::svc::NetdemoCap SVC_NetdemoCap(player_t* player)
+odaproto::svc::NetdemoCap& SVC_NetdemoCap(player_t* player)
 {
-	odaproto::svc::NetdemoCap msg;
+	odaproto::svc::NetdemoCap& msg = NewMessage<odaproto::svc::NetdemoCap>();
 
 	odaproto::Actor* act = msg.mutable_actor();
 	odaproto::Player* play = msg.mutable_player();
@@ -79,14 +79,16 @@ struct PlaySoundType
 	}
 };
 
+void SVC_ResetArena();
+
 odaproto::svc::Disconnect SVC_Disconnect(const char* message = NULL);
-odaproto::svc::PlayerInfo SVC_PlayerInfo(player_t& player);
-odaproto::svc::MovePlayer SVC_MovePlayer(player_t& player, const int tic);
-odaproto::svc::UpdateLocalPlayer SVC_UpdateLocalPlayer(AActor& mo, const int tic);
+odaproto::svc::PlayerInfo& SVC_PlayerInfo(player_t& player);
+odaproto::svc::MovePlayer& SVC_MovePlayer(player_t& player, const int tic);
+odaproto::svc::UpdateLocalPlayer& SVC_UpdateLocalPlayer(AActor& mo, const int tic);
 odaproto::svc::LevelLocals SVC_LevelLocals(const level_locals_t& locals, uint32_t flags);
 odaproto::svc::PingRequest SVC_PingRequest();
 odaproto::svc::UpdatePing SVC_UpdatePing(player_t& player);
-odaproto::svc::SpawnMobj SVC_SpawnMobj(AActor* mo);
+odaproto::svc::SpawnMobj& SVC_SpawnMobj(AActor* mo);
 odaproto::svc::DisconnectClient SVC_DisconnectClient(player_t& player);
 odaproto::svc::LoadMap SVC_LoadMap(const OResFiles& wadnames, const OResFiles& patchnames,
                                    const std::string& mapname, int time);
@@ -95,11 +97,15 @@ odaproto::svc::ConsolePlayer SVC_ConsolePlayer(player_t& player,
 odaproto::svc::ExplodeMissile SVC_ExplodeMissile(AActor& mobj);
 odaproto::svc::RemoveMobj SVC_RemoveMobj(AActor& mobj);
 odaproto::svc::UserInfo SVC_UserInfo(player_t& player, int64_t time);
-odaproto::svc::UpdateMobj SVC_UpdateMobj(AActor& mobj);
-odaproto::svc::SpawnPlayer SVC_SpawnPlayer(player_t& player);
-odaproto::svc::DamagePlayer SVC_DamagePlayer(player_t& player, AActor *inflictor, int health, int armor);
-odaproto::svc::KillMobj SVC_KillMobj(AActor* source, AActor* target, AActor* inflictor,
-                                     int mod, bool joinkill);
+odaproto::svc::UpdateMobj& SVC_UpdateMobj(AActor& mobj);
+odaproto::svc::UpdateMobj& SVC_UpdateMobjDelta(const uint32_t netid,
+                                               const baseline_t& from,
+                                               const baseline_t& to, const uint32_t tag,
+                                               const uint32_t basetag);
+odaproto::svc::SpawnPlayer& SVC_SpawnPlayer(player_t& player);
+odaproto::svc::DamagePlayer& SVC_DamagePlayer(player_t& player, AActor *inflictor, int health, int armor);
+odaproto::svc::KillMobj& SVC_KillMobj(AActor* source, AActor* target, AActor* inflictor,
+                                      int mod, bool joinkill);
 odaproto::svc::FireWeapon SVC_FireWeapon(player_t& player);
 odaproto::svc::UpdateSector SVC_UpdateSector(sector_t& sector);
 odaproto::svc::Print SVC_Print(printlevel_t level, const std::string& str);
@@ -107,11 +113,11 @@ odaproto::svc::PlayerMembers SVC_PlayerMembers(player_t& player, byte flags);
 odaproto::svc::TeamMembers SVC_TeamMembers(team_t team);
 odaproto::svc::ActivateLine SVC_ActivateLine(line_t* line, AActor* mo, int side,
                                              LineActivationType type);
-odaproto::svc::MovingSector SVC_MovingSector(const sector_t& sector);
-odaproto::svc::PlaySound SVC_PlaySound(const PlaySoundType& type, int channel, int sfx_id,
-                                       float volume, int attenuation);
+odaproto::svc::MovingSector& SVC_MovingSector(const sector_t& sector);
+odaproto::svc::PlaySound& SVC_PlaySound(const PlaySoundType& type, int channel, int sfx_id,
+                                        float volume, int attenuation);
 odaproto::svc::TouchSpecial SVC_TouchSpecial(AActor* mo);
-odaproto::svc::PlayerState SVC_PlayerState(player_t& player);
+odaproto::svc::PlayerState& SVC_PlayerState(player_t& player);
 odaproto::svc::LevelState SVC_LevelState(const SerializedLevelState& sls);
 odaproto::svc::PlayerQueuePos SVC_PlayerQueuePos(const player_t& source);
 odaproto::svc::ForceTeam SVC_ForceTeam(team_t team);
@@ -127,7 +133,7 @@ odaproto::svc::ConnectClient SVC_ConnectClient(const player_t& player);
 odaproto::svc::MidPrint SVC_MidPrint(const std::string& message, const int time);
 odaproto::svc::ServerGametic SVC_ServerGametic(const byte tic);
 odaproto::svc::IntTimeLeft SVC_IntTimeLeft(const unsigned int timeleft);
-odaproto::svc::RailTrail SVC_RailTrail(const v3double_t& start, const v3double_t& end);
+odaproto::svc::RailTrail& SVC_RailTrail(const v3double_t& start, const v3double_t& end);
 odaproto::svc::LineUpdate SVC_LineUpdate(const line_t& line);
 odaproto::svc::SectorProperties SVC_SectorProperties(sector_t& sector);
 odaproto::svc::LineSideUpdate SVC_LineSideUpdate(const line_t& line, const int sideNum);
@@ -149,4 +155,4 @@ odaproto::svc::MaplistIndex SVC_MaplistIndex(const byte count, const size_t this
                                              const size_t next_index);
 odaproto::svc::Toast SVC_Toast(const toast_t& toast);
 odaproto::svc::HordeInfo SVC_HordeInfo(const hordeInfo_t& horde);
-odaproto::svc::NetdemoCap SVC_NetdemoCap(player_t* player);
+odaproto::svc::NetdemoCap& SVC_NetdemoCap(player_t* player);
@@ -24,6 +24,7 @@
 
 #include "odamex.h"
 
+#include <algorithm>
 #include <map>
 #include <stdlib.h>
 
@@ -33,6 +34,8 @@
 #include "hashtable.h"
 #include "cmdlib.h"
 
+EXTERN_CVAR(debug_zone)
+
 struct OFileLine
 {
 	const char* file;
@@ -60,6 +63,16 @@ struct OFileLine
 
 #define FILELINE OFileLine::create(__FILE__, __LINE__)
 
+// Both zones keep an id in the byte right in front of the memory they hand
+// out, so a pointer can be given back to its zone without a lookup.
+static const byte ZONE_ID_TAG = 0x1d;
+static const byte ZONE_ID_DEBUG = 0x2d;
+
+static byte& ZoneId(void* ptr)
+{
+	return static_cast<byte*>(ptr)[-1];
+}
+
 #define CASE_STR(x) \
 	case x:         \
 		return #x
@@ -85,12 +98,14 @@ static const char* TagStr(const zoneTag_e tag)
 // OZone
 //
 // A memory system that mimics a lot of the Zone system's behaviors but is more
-// friendly to memory analysis tools like valgrind.
+// friendly to memory analysis tools like valgrind.  Only used for allocations
+// made while debug_zone is set, OTagZone below is used otherwise.
 //
-// Memory is allocated on the system heap with operator new. When allocating
+// Memory is allocated on the system heap with malloc. When allocating
 // memory, a pointer to the allocated memory is inserted as the key into a hash
 // table, along with a memory block tag and user pointer (both similar to the
-// Zone memory's system).
+// Zone memory's system).  The only thing in front of the memory is the zone
+// id.
 //
 // Upon freeing allocated memory, the memory the user pointer points to will be
 // set to NULL, the memory will be freed, and the block will be removed from
@@ -109,6 +124,8 @@ class OZone
 	typedef std::map<void*, MemoryBlockInfo> MemoryBlockTable;
 	MemoryBlockTable m_heap;
 
+	static const size_t HEADER_SIZE = 16;
+
 	MemoryBlockTable::iterator dealloc(MemoryBlockTable::iterator& block)
 	{
 		if (block->second.user)
@@ -118,7 +135,8 @@ class OZone
 
 		void* imFree = block->first;
 
-		free(imFree);
+		ZoneId(imFree) = 0;
+		free(static_cast<byte*>(imFree) - HEADER_SIZE);
 
 		MemoryBlockTable::iterator next = block;
 		++next;
@@ -136,6 +154,11 @@ class OZone
 		clear();
 	}
 
+	bool empty() const
+	{
+		return m_heap.empty();
+	}
+
 	void clear()
 	{
 		// Free all memory.
@@ -155,14 +178,17 @@ class OZone
 		}
 
 		// Our interface is malloc-like, so we use malloc and not new.
-		void* ptr = malloc(size);
-		if (ptr == NULL)
+		void* base = malloc(HEADER_SIZE + size);
+		if (base == NULL)
 		{
 			// Don't format these bytes, the byte formatter allocates.
 			I_Error("%s: Could not allocate %" PRI_SIZE_PREFIX "u bytes at %s:%i.",
 			        __FUNCTION__, size, info.shortFile(), info.line);
 		}
 
+		void* ptr = static_cast<byte*>(base) + HEADER_SIZE;
+		ZoneId(ptr) = ZONE_ID_DEBUG;
+
 		// Construct the memory block.
 		MemoryBlockInfo block;
 		block.tag = tag;
@@ -268,15 +294,497 @@ class OZone
 		StrFormatBytes(buf, m_heap.size() * sizeof(MemoryBlockInfo));
 		Printf("  blocks size: %s\n", buf.c_str());
 	}
+} g_debugzone;
+
+//
+// OTagZone
+//
+// The zone used normally.  Every block starts with a small header, and the
+// blocks of each tag are kept in an intrusive list, so freeing a block or
+// changing its tag never has to search for it.
+//
+// Blocks tagged PU_LEVEL or PU_LEVSPEC are carved out of large chunks owned by
+// an arena for that tag, with a freelist per size class so blocks that are
+// freed during the level get reused.  Size classes are 16 bytes apart up to
+// 256 bytes, and four to each power of two above that, so a block is never
+// carved more than a quarter larger than asked.  Only arena blocks with an
+// owner pointer to clear are
+// kept in a tag list, so freeing the level hands the chunks back at once
+// instead of visiting every block.
+//
+// An arena block that has its tag changed to one outside of its arena pins the
+// chunk it lives in.  A pinned chunk outlives its arena and is only released
+// once the last pinned block is freed.
+//
+class OTagZone
+{
+	static const size_t ALIGNMENT = 16;
+	static const size_t CHUNK_SIZE = 256 * 1024;
+	static const int MAX_SMALL_SHIFT = 8;
+	static const int MAX_ARENA_SHIFT = 15;
+	static const size_t MAX_SMALL_BLOCK = 1 << MAX_SMALL_SHIFT;
+	static const size_t MAX_ARENA_BLOCK = 1 << MAX_ARENA_SHIFT;
+	static const size_t NUM_SMALL_CLASSES = MAX_SMALL_BLOCK / ALIGNMENT;
+	static const size_t NUM_CLASSES =
+	    NUM_SMALL_CLASSES + 4 * (MAX_ARENA_SHIFT - MAX_SMALL_SHIFT);
+	static const size_t MAX_SPARE_CHUNKS = 32;
+	static const size_t NUM_TAGS = PU_CACHE + 1;
+	static const int NUM_ARENAS = 2;
+
+	enum blockFlags_e
+	{
+		BF_LINKED = BIT(0), // Block is in the list of its tag.
+		BF_PINNED = BIT(1)  // Arena block whose tag left the arena.
+	};
+
+	struct Chunk
+	{
+		Chunk* next;  // Next chunk of the arena, or spare chunk.
+		size_t used;  // Bytes handed out, including this header.
+		int arena;    // Arena the chunk was carved for.
+		int pins;     // Pinned blocks still living in the chunk.
+		bool retired; // Arena was freed while the chunk was pinned.
+	};
+
+	struct Block
+	{
+		Block* prev;    // Tag list links, next is reused by freelists.
+		Block* next;
+		void** user;    // Pointer owner
+		Chunk* chunk;   // Chunk holding the block, NULL if malloc'ed.
+		uint32_t size;  // Size of allocation, without the header.
+		byte tag;       // PU_* tag
+		byte sizeclass; // Freelist index + 1, 0 if malloc'ed.
+		byte flags;     // BF_* flags
+	};
+
+	struct Arena
+	{
+		zoneTag_e tag;
+		Chunk* chunks; // Chunk being carved first.
+		Block* freelist[NUM_CLASSES];
+	};
+
+	Block* m_tags[NUM_TAGS];
+	Arena m_arenas[NUM_ARENAS];
+	Chunk* m_spare;
+	size_t m_sparecount;
+
+	static size_t roundUp(size_t size)
+	{
+		return (size + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+	}
+
+	// The zone id sits in the last byte of the header.
+	static size_t headerSize()
+	{
+		return roundUp(sizeof(Block) + 1);
+	}
+
+	// Freelist index + 1 of a rounded size, and the size blocks of that class
+	// are carved at.
+	static byte sizeClass(const size_t rounded, size_t& classsize)
+	{
+		if (rounded <= MAX_SMALL_BLOCK)
+		{
+			classsize = rounded;
+			return static_cast<byte>(rounded / ALIGNMENT);
+		}
+
+		// 2^shift < rounded <= 2^(shift + 1), in steps of a quarter of 2^shift
+		int shift = MAX_SMALL_SHIFT;
+		while ((size_t(1) << (shift + 1)) < rounded)
+			shift++;
+
+		const size_t step = size_t(1) << (shift - 2);
+		classsize = (rounded + step - 1) & ~(step - 1);
+		return static_cast<byte>(NUM_SMALL_CLASSES + 4 * (shift - MAX_SMALL_SHIFT) +
+		                         (classsize >> (shift - 2)) - 4);
+	}
+
+	static void* blockData(Block* block)
+	{
+		return reinterpret_cast<byte*>(block) + headerSize();
+	}
+
+	static int arenaIndex(const int tag)
+	{
+		switch (tag)
+		{
+		case PU_LEVEL:
+			return 0;
+		case PU_LEVSPEC:
+			return 1;
+		default:
+			return -1;
+		}
+	}
+
+	Block* findBlock(void* ptr, const OFileLine& info) const
+	{
+		Block* block =
+		    reinterpret_cast<Block*>(static_cast<byte*>(ptr) - headerSize());
+		if (ZoneId(ptr) != ZONE_ID_TAG)
+		{
+			I_Error("%s: Address 0x%p is not tracked by zone at %s:%i.", __FUNCTION__,
+			        ptr, info.shortFile(), info.line);
+		}
+		return block;
+	}
+
+	void link(Block* block)
+	{
+		Block*& head = m_tags[block->tag];
+		block->prev = NULL;
+		block->next = head;
+		if (head != NULL)
+			head->prev = block;
+		head = block;
+		block->flags |= BF_LINKED;
+	}
+
+	void unlink(Block* block)
+	{
+		if (block->prev != NULL)
+			block->prev->next = block->next;
+		else
+			m_tags[block->tag] = block->next;
+		if (block->next != NULL)
+			block->next->prev = block->prev;
+		block->flags &= ~BF_LINKED;
+	}
+
+	Chunk* newChunk(const int arena, const OFileLine& info)
+	{
+		Chunk* chunk = m_spare;
+		if (chunk != NULL)
+		{
+			m_spare = chunk->next;
+			m_sparecount--;
+		}
+		else
+		{
+			chunk = static_cast<Chunk*>(malloc(CHUNK_SIZE));
+			if (chunk == NULL)
+			{
+				I_Error("%s: Could not allocate %" PRI_SIZE_PREFIX "u bytes at %s:%i.",
+				        __FUNCTION__, CHUNK_SIZE, info.shortFile(), info.line);
+			}
+		}
+
+		chunk->next = NULL;
+		chunk->used = roundUp(sizeof(Chunk));
+		chunk->arena = arena;
+		chunk->pins = 0;
+		chunk->retired = false;
+		return chunk;
+	}
+
+	void releaseChunk(Chunk* chunk)
+	{
+		if (m_sparecount >= MAX_SPARE_CHUNKS)
+		{
+			free(chunk);
+			return;
+		}
+
+		chunk->next = m_spare;
+		m_spare = chunk;
+		m_sparecount++;
+	}
+
+	Block* arenaAlloc(const int index, const size_t size, const OFileLine& info)
+	{
+		Arena& arena = m_arenas[index];
+
+		size_t classsize;
+		const byte sizeclass = sizeClass(roundUp(size), classsize);
+		Block* block = arena.freelist[sizeclass - 1];
+		if (block != NULL)
+		{
+			arena.freelist[sizeclass - 1] = block->next;
+			return block;
+		}
+
+		const size_t needed = headerSize() + classsize;
+		Chunk* chunk = arena.chunks;
+		if (chunk == NULL || chunk->used + needed > CHUNK_SIZE)
+		{
+			chunk = newChunk(index, info);
+			chunk->next = arena.chunks;
+			arena.chunks = chunk;
+		}
+
+		block = reinterpret_cast<Block*>(reinterpret_cast<byte*>(chunk) + chunk->used);
+		chunk->used += needed;
+		block->chunk = chunk;
+		block->sizeclass = sizeclass;
+		return block;
+	}
+
+	void resetArena(Arena& arena)
+	{
+		for (Chunk* chunk = arena.chunks; chunk != NULL;)
+		{
+			Chunk* next = chunk->next;
+			if (chunk->pins > 0)
+				chunk->retired = true;
+			else
+				releaseChunk(chunk);
+			chunk = next;
+		}
+
+		arena.chunks = NULL;
+		for (size_t i = 0; i < NUM_CLASSES; i++)
+			arena.freelist[i] = NULL;
+	}
+
+	void dealloc(Block* block)
+	{
+		if (block->user)
+		{
+			*block->user = NULL;
+		}
+
+		if (block->flags & BF_LINKED)
+		{
+			unlink(block);
+		}
+
+		ZoneId(blockData(block)) = 0;
+
+		Chunk* chunk = block->chunk;
+		if (chunk == NULL)
+		{
+			free(block);
+			return;
+		}
+
+		if (block->flags & BF_PINNED)
+		{
+			chunk->pins--;
+			if (chunk->retired)
+			{
+				if (chunk->pins == 0)
+					releaseChunk(chunk);
+				return;
+			}
+		}
+
+		Arena& arena = m_arenas[chunk->arena];
+		block->next = arena.freelist[block->sizeclass - 1];
+		arena.freelist[block->sizeclass - 1] = block;
+	}
+
+  public:
+	OTagZone() : m_spare(NULL), m_sparecount(0)
+	{
+		for (size_t i = 0; i < NUM_TAGS; i++)
+			m_tags[i] = NULL;
+
+		m_arenas[0].tag = PU_LEVEL;
+		m_arenas[1].tag = PU_LEVSPEC;
+		for (int i = 0; i < NUM_ARENAS; i++)
+		{
+			m_arenas[i].chunks = NULL;
+			for (size_t j = 0; j < NUM_CLASSES; j++)
+				m_arenas[i].freelist[j] = NULL;
+		}
+	}
+
+	~OTagZone()
+	{
+		clear();
+
+		while (m_spare != NULL)
+		{
+			Chunk* next = m_spare->next;
+			free(m_spare);
+			m_spare = next;
+		}
+		m_sparecount = 0;
+	}
+
+	void clear()
+	{
+		deallocTags(0, NUM_TAGS - 1);
+	}
+
+	void* alloc(size_t size, zoneTag_e tag, void* user, const OFileLine& info)
+	{
+		// Same as OZone, a zero-sized allocation is NULL.
+		if (size == 0)
+		{
+			return NULL;
+		}
+
+		if (tag <= PU_FREE || tag >= static_cast<int>(NUM_TAGS))
+		{
+			I_Error("%s: Invalid tag %d at %s:%i.", __FUNCTION__, tag,
+			        info.shortFile(), info.line);
+		}
+
+		Block* block;
+		const int arena = arenaIndex(tag);
+		if (arena >= 0 && size <= MAX_ARENA_BLOCK)
+		{
+			block = arenaAlloc(arena, size, info);
+		}
+		else
+		{
+			block = static_cast<Block*>(malloc(headerSize() + size));
+			if (block == NULL)
+			{
+				// Don't format these bytes, the byte formatter allocates.
+				I_Error("%s: Could not allocate %" PRI_SIZE_PREFIX "u bytes at %s:%i.",
+				        __FUNCTION__, size, info.shortFile(), info.line);
+			}
+			block->chunk = NULL;
+			block->sizeclass = 0;
+		}
+
+		block->user = static_cast<void**>(user);
+		block->size = size > MAXUINT ? MAXUINT : static_cast<uint32_t>(size);
+		block->tag = static_cast<byte>(tag);
+		block->flags = 0;
+
+		// Arena blocks nobody points at go away with their arena.
+		if (block->chunk == NULL || block->user != NULL)
+		{
+			link(block);
+		}
+
+		void* ptr = blockData(block);
+		ZoneId(ptr) = ZONE_ID_TAG;
+		if (block->user != NULL)
+		{
+			*block->user = ptr;
+		}
+
+		return ptr;
+	}
+
+	void changeTag(void* ptr, zoneTag_e tag, const OFileLine& info)
+	{
+		if (tag <= PU_FREE || tag >= static_cast<int>(NUM_TAGS))
+		{
+			I_Error("%s: Tried to change a tag to %s at %s:%i.", __FUNCTION__,
+			        TagStr(tag), info.shortFile(), info.line);
+		}
+
+		Block* block = findBlock(ptr, info);
+		if (tag >= PU_PURGELEVEL && block->user == NULL)
+		{
+			I_Error("%s: Found purgable block without an owner at %s:%i.",
+			        __FUNCTION__, info.shortFile(), info.line);
+		}
+
+		if (block->flags & BF_LINKED)
+		{
+			unlink(block);
+		}
+
+		block->tag = static_cast<byte>(tag);
+
+		if (block->chunk != NULL && !(block->flags & BF_PINNED) &&
+		    arenaIndex(tag) != block->chunk->arena)
+		{
+			block->chunk->pins++;
+			block->flags |= BF_PINNED;
+		}
+
+		if (block->chunk == NULL || block->user != NULL || (block->flags & BF_PINNED))
+		{
+			link(block);
+		}
+	}
+
+	void changeOwner(void* ptr, void* user, const OFileLine& info)
+	{
+		// [AM] Nothing calls this as far as I know.
+		I_Error("%s: not implemented", __FUNCTION__);
+	}
+
+	void deallocPtr(void* ptr, const OFileLine& info)
+	{
+		if (ptr == NULL)
+			return;
+
+		dealloc(findBlock(ptr, info));
+	}
+
+	/**
+	 * Dealloc all members
+	 */
+	void deallocTags(const int lowtag, const int hightag)
+	{
+		const int lo = std::max(lowtag, 0);
+		const int hi = std::min(hightag, static_cast<int>(NUM_TAGS) - 1);
+		for (int tag = lo; tag <= hi; tag++)
+		{
+			while (m_tags[tag] != NULL)
+				dealloc(m_tags[tag]);
+		}
+
+		for (int i = 0; i < NUM_ARENAS; i++)
+		{
+			if (m_arenas[i].tag >= lowtag && m_arenas[i].tag <= hightag)
+				resetArena(m_arenas[i]);
+		}
+	}
+
+	void dump(const int lowtag, const int hightag)
+	{
+		size_t total = 0, count = 0;
+		const int lo = std::max(lowtag, 0);
+		const int hi = std::min(hightag, static_cast<int>(NUM_TAGS) - 1);
+		for (int tag = lo; tag <= hi; tag++)
+		{
+			for (Block* block = m_tags[tag]; block != NULL; block = block->next)
+			{
+				total += block->size;
+				count += 1;
+				Printf("0x%p | size:%u tag:%s user:0x%p%s\n",
+				       blockData(block), block->size,
+				       TagStr(static_cast<zoneTag_e>(block->tag)), block->user,
+				       block->chunk != NULL ? " arena" : "");
+			}
+		}
+
+		std::string buf;
+		Printf("  tracked allocation count: %" PRIuSIZE "\n", count);
+
+		StrFormatBytes(buf, total);
+		Printf("  tracked allocs size: %s\n", buf.c_str());
+
+		for (int i = 0; i < NUM_ARENAS; i++)
+		{
+			size_t chunks = 0, used = 0;
+			for (Chunk* chunk = m_arenas[i].chunks; chunk != NULL; chunk = chunk->next)
+			{
+				chunks += 1;
+				used += chunk->used;
+			}
+
+			StrFormatBytes(buf, used);
+			Printf("  %s arena: %" PRIuSIZE " chunks, %s used\n",
+			       TagStr(m_arenas[i].tag), chunks, buf.c_str());
+		}
+
+		StrFormatBytes(buf, m_sparecount * CHUNK_SIZE);
+		Printf("  spare chunks: %s\n", buf.c_str());
+	}
 } g_zone;
 
 
+
 //
 // Z_Close
 //
 void STACK_ARGS Z_Close()
 {
 	g_zone.clear();
+	g_debugzone.clear();
 }
 
 //
@@ -285,6 +793,7 @@ void STACK_ARGS Z_Close()
 void Z_Init()
 {
 	g_zone.clear();
+	g_debugzone.clear();
 }
 
 
@@ -293,7 +802,13 @@ void Z_Init()
 //
 void Z_Free2(void* ptr, const char* file, int line)
 {
-	g_zone.deallocPtr(ptr, OFileLine::create(file, line));
+	if (ptr == NULL)
+		return;
+
+	if (ZoneId(ptr) == ZONE_ID_DEBUG)
+		::g_debugzone.deallocPtr(ptr, OFileLine::create(file, line));
+	else
+		::g_zone.deallocPtr(ptr, OFileLine::create(file, line));
 }
 
 
@@ -301,13 +816,13 @@ void Z_Free2(void* ptr, const char* file, int line)
 // Z_Malloc
 // You can pass a NULL user if the tag is < PU_PURGELEVEL.
 //
-#define MINFRAGMENT	64
-#define ALIGN		8
-
 void* Z_Malloc2(size_t size, const zoneTag_e tag, void* user, const char* file,
                 const int line)
 {
-	return g_zone.alloc(size, tag, user, OFileLine::create(file, line));
+	if (::debug_zone)
+		return ::g_debugzone.alloc(size, tag, user, OFileLine::create(file, line));
+
+	return ::g_zone.alloc(size, tag, user, OFileLine::create(file, line));
 }
 
 
@@ -316,7 +831,8 @@ void* Z_Malloc2(size_t size, const zoneTag_e tag, void* user, const char* file,
 //
 void Z_FreeTags(const zoneTag_e lowtag, const zoneTag_e hightag)
 {
-	return ::g_zone.deallocTags(lowtag, hightag);
+	::g_debugzone.deallocTags(lowtag, hightag);
+	::g_zone.deallocTags(lowtag, hightag);
 }
 
 //
@@ -324,7 +840,10 @@ void Z_FreeTags(const zoneTag_e lowtag, const zoneTag_e hightag)
 //
 void Z_ChangeTag2(void* ptr, const zoneTag_e tag, const char* file, int line)
 {
-	return ::g_zone.changeTag(ptr, tag, OFileLine::create(file, line));
+	if (ZoneId(ptr) == ZONE_ID_DEBUG)
+		::g_debugzone.changeTag(ptr, tag, OFileLine::create(file, line));
+	else
+		::g_zone.changeTag(ptr, tag, OFileLine::create(file, line));
 }
 
 
@@ -339,7 +858,12 @@ void Z_ChangeOwner2(void* ptr, void* user, const char* file, int line)
 //
 void Z_DumpHeap(const zoneTag_e lowtag, const zoneTag_e hightag)
 {
-	::g_zone.dump();
+	::g_zone.dump(lowtag, hightag);
+	if (!::g_debugzone.empty())
+	{
+		Printf("debug zone:\n");
+		::g_debugzone.dump();
+	}
 }
 
 BEGIN_COMMAND(dumpheap)
@@ -112,7 +112,7 @@ void D_DoomLoop (void)
 	{
 		try
 		{
-			D_RunTics(SV_RunTics, SV_DisplayTics);
+			D_RunTics(SV_RunTics, SV_DisplayTics, SV_GetPackets);
 		}
 		catch (CRecoverableError &error)
 		{
@@ -155,7 +155,7 @@ void D_Init()
 	// start the Zone memory manager
 	Z_Init();
 	if (first_time)
-		Printf("Z_Init: Using native allocator with OZone bookkeeping.\n");
+		Printf("Z_Init: Using native allocator with tag arenas for level memory.\n");
 
 	// Load palette and set up colormaps
 	V_InitPalette("PLAYPAL");
@@ -111,13 +111,13 @@ fixed_t		render_lerp_amount;
 
 unsigned int	R_OldBlend = ~0;
 
-void (*colfunc) (void);
+void (*colfunc) (drawcolumn_t&);
 void (*basecolfunc) (void);
 void (*fuzzcolfunc) (void);
 void (*lucentcolfunc) (void);
 void (*transcolfunc) (void);
 void (*tlatedlucentcolfunc) (void);
-void (*spanfunc) (void);
+void (*spanfunc) (drawspan_t&);
 
 void (*hcolfunc_pre) (void);
 void (*hcolfunc_post1) (int hx, int sx, int yl, int yh);
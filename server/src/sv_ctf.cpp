@@ -91,14 +91,20 @@ void SV_CTFEvent(team_t f, flag_score_t event, player_t& who)
 			who.points += ctf_points[event];
 	}
 
+	const EncodedSVC eventmsg(SVC_CTFEvent(event, f, who));
 	for (Players::iterator it = players.begin(); it != players.end(); ++it)
 	{
 		client_t* cl = &(it->client);
+		MSG_WriteSVC(&cl->reliablebuf, eventmsg);
+	}
 
-		MSG_WriteSVC(&cl->reliablebuf, SVC_CTFEvent(event, f, who));
-		if (event == SCORE_CAPTURE)
+	if (event == SCORE_CAPTURE)
+	{
+		const EncodedSVC refreshmsg(SVC_CTFRefresh(tv, false));
+		for (Players::iterator it = players.begin(); it != players.end(); ++it)
 		{
-			MSG_WriteSVC(&cl->reliablebuf, SVC_CTFRefresh(tv, false));
+			client_t* cl = &(it->client);
+			MSG_WriteSVC(&cl->reliablebuf, refreshmsg);
 		}
 	}
 }
@@ -113,6 +113,16 @@ CVAR_RANGE(		sv_flooddelay, "1.5", "Chat flood protection time (in seconds)",
 CVAR_RANGE_FUNC_DECL(sv_maxrate, "200", "Forces clients to be on or below this rate",
 				CVARTYPE_INT, CVAR_SERVERARCHIVE | CVAR_NOENABLEDISABLE, 7.0f, 100000.0f)
 
+CVAR_RANGE(		sv_packetthreads, "2", "Number of extra threads that compress outgoing packets, 0 compresses them all on the main thread",
+				CVARTYPE_INT, CVAR_SERVERARCHIVE | CVAR_NOENABLEDISABLE, 0.0f, 16.0f)
+
+CVAR_RANGE(		sv_packetcompression, "3", "Most expensive packet compression clients may ask for\n" \
+				"// 0 - None\n" \
+				"// 1 - Minilzo\n" \
+				"// 2 - Adaptive huffman\n" \
+				"// 3 - Deflate with a shared dictionary",
+				CVARTYPE_INT, CVAR_SERVERARCHIVE | CVAR_NOENABLEDISABLE, 0.0f, 3.0f)
+
 #ifdef ODA_HAVE_MINIUPNP
 CVAR(			sv_upnp, "1", "Enable UPnP support",
 				CVARTYPE_BOOL, CVAR_SERVERARCHIVE)
@@ -25,6 +25,8 @@
 
 #include "odamex.h"
 
+#include <algorithm>
+
 #include "minilzo.h"
 #include "d_netinf.h"
 #include "z_zone.h"
@@ -39,6 +41,7 @@
 #include "g_game.h"
 #include "sv_main.h"
 #include "g_spawninv.h"
+#include "sv_workers.h"
 
 void	G_PlayerReborn (player_t &player);
 
@@ -54,6 +57,7 @@ EXTERN_CVAR (co_nosilentspawns)
 EXTERN_CVAR (sv_fastmonsters)
 EXTERN_CVAR (sv_freelook)
 EXTERN_CVAR (sv_teamsinplay)
+EXTERN_CVAR (sv_aithreads)
 
 gameaction_t	gameaction;
 gamestate_t 	gamestate = GS_STARTUP;
@@ -97,6 +101,45 @@ BEGIN_COMMAND (pause)
 }
 END_COMMAND (pause)
 
+// Sight checks handed to a worker at a time.
+#define SIGHT_QUERIES_PER_JOB 16
+
+static void SightQueryJob(void* data, size_t index, size_t worker)
+{
+	size_t count = *static_cast<size_t*>(data);
+	size_t end = std::min(count, (index + 1) * SIGHT_QUERIES_PER_JOB);
+
+	for (size_t i = index * SIGHT_QUERIES_PER_JOB; i < end; i++)
+		P_RunSightQuery(i);
+}
+
+//
+// P_PrepareMonsterSight
+//
+// Work out the sight checks monsters are about to make this tic on the
+// worker threads, before the thinkers run one by one.  P_CheckSight only
+// uses an answer while it still holds, so monsters act exactly as they
+// would otherwise, random numbers included.
+//
+void P_PrepareMonsterSight()
+{
+	static WorkerPool workers;
+
+	workers.resize(sv_aithreads.asInt());
+	if (workers.size() == 0)
+		return;
+
+	P_GatherSightQueries();
+
+	size_t count = P_PrepareSightQueries();
+	if (count == 0)
+		return;
+
+	workers.run(SightQueryJob, &count,
+	            (count + SIGHT_QUERIES_PER_JOB - 1) / SIGHT_QUERIES_PER_JOB);
+	P_StartSightQueries();
+}
+
 //
 // G_Ticker
 // Make ticcmd_ts for the players.
@@ -332,14 +332,7 @@ void SV_CheckTeam(player_t &pl);
 //
 void G_DoNewGame()
 {
-	for (Players::iterator it = players.begin();it != players.end();++it)
-	{
-		if(!(it->ingame()))
-			continue;
-
-		MSG_WriteSVC(&it->client.reliablebuf,
-		             SVC_LoadMap(::wadfiles, ::patchfiles, d_mapname, 0));
-	}
+	MSG_BroadcastSVC(CLBUF_RELIABLE, SVC_LoadMap(::wadfiles, ::patchfiles, d_mapname, 0));
 
 	sv_curmap.ForceSet(d_mapname);
 
@@ -642,15 +635,7 @@ void G_DoResetLevel(bool full_reset)
 	}
 
 	// Tell clients that a map reset is incoming.
-	Players::iterator it;
-	for (it = players.begin(); it != players.end(); ++it)
-	{
-		if (!(it->ingame()))
-			continue;
-
-		client_t* cl = &(it->client);
-		MSG_WriteSVC(&cl->reliablebuf, odaproto::svc::ResetMap());
-	}
+	MSG_BroadcastSVC(CLBUF_RELIABLE, odaproto::svc::ResetMap());
 
 	// Unserialize saved snapshot
 	reset_snapshot->Reopen();
@@ -687,6 +672,7 @@ void G_DoResetLevel(bool full_reset)
 	iquehead = iquetail = 0;
 
 	// Clear player information.
+	Players::iterator it;
 	for (it = players.begin(); it != players.end(); ++it)
 	{
 		// Don't let players keep cards through a reset.
@@ -824,10 +810,10 @@ void G_DoLoadLevel (int position)
 			it->timeout_ready = 0;
 
 			// [AM] Make sure the clients are updated on the new ready state
+			const EncodedSVC msg(SVC_PlayerMembers(*it, SVC_PM_READY));
 			for (Players::iterator pit = players.begin();pit != players.end();++pit)
 			{
-				MSG_WriteSVC(&pit->client.reliablebuf,
-				             SVC_PlayerMembers(*it, SVC_PM_READY));
+				MSG_WriteSVC(&pit->client.reliablebuf, msg);
 			}
 		}
 	}
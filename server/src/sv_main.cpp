@@ -69,6 +69,7 @@
 #include "m_wdlstats.h"
 #include "svc_message.h"
 #include "m_cheat.h"
+#include "hashtable.h"
 
 #include <algorithm>
 #include <sstream>
@@ -105,6 +106,7 @@ EXTERN_CVAR(sv_hostname)
 EXTERN_CVAR(sv_email)
 EXTERN_CVAR(sv_waddownload)
 EXTERN_CVAR(sv_maxrate)
+EXTERN_CVAR(sv_packetcompression)
 EXTERN_CVAR(sv_emptyreset)
 EXTERN_CVAR(sv_emptyfreeze)
 EXTERN_CVAR(sv_clientcount)
@@ -177,10 +179,10 @@ CVAR_FUNC_IMPL (sv_maxplayers)
 				it->playerstate = PST_LIVE;
 				it->joindelay = 0;
 
+				const EncodedSVC msg(SVC_PlayerMembers(*it, SVC_PM_SPECTATOR));
 				for (Players::iterator pit = players.begin(); pit != players.end(); ++pit)
 				{
-					MSG_WriteSVC(&pit->client.reliablebuf,
-					             SVC_PlayerMembers(*it, SVC_PM_SPECTATOR));
+					MSG_WriteSVC(&pit->client.reliablebuf, msg);
 				}
 
 				std::string status = SV_BuildKillsDeathsStatusString(*it);
@@ -293,6 +295,7 @@ void SV_UpdateConsolePlayer(player_t &player);
 
 void SV_CheckTeam (player_t & playernum);
 team_t SV_GoodTeam (void);
+static void SV_RescanHiddenMobj(player_t& player);
 
 static void SendServerSettings(player_t& pl);
 
@@ -453,10 +456,11 @@ END_COMMAND (exit)
 
 static void SendLevelState(SerializedLevelState sls)
 {
+	const EncodedSVC msg(SVC_LevelState(sls));
 	for (Players::iterator it = players.begin();it != players.end();++it)
 	{
 		client_t& cl = it->client;
-		MSG_WriteSVC(&cl.reliablebuf, SVC_LevelState(sls));
+		MSG_WriteSVC(&cl.reliablebuf, msg);
 	}
 }
 
@@ -528,15 +532,36 @@ Players::iterator SV_GetFreeClient(void)
 	return --it;
 }
 
+// Connected clients by address, so an incoming packet doesn't have to be
+// compared against every player.
+typedef OHashTable<unsigned long long, player_t*> ClientAddresses;
+static ClientAddresses client_addresses;
+
+static unsigned long long SV_AddressKey(const netadr_t& adr)
+{
+	return ((unsigned long long)adr.ip[0] << 40) | ((unsigned long long)adr.ip[1] << 32) |
+	       ((unsigned long long)adr.ip[2] << 24) | ((unsigned long long)adr.ip[3] << 16) |
+	       adr.port;
+}
+
+//
+// SV_ForgetClientAddress
+//
+static void SV_ForgetClientAddress(player_t& player)
+{
+	ClientAddresses::iterator it =
+	    client_addresses.find(SV_AddressKey(player.client.address));
+	if (it != client_addresses.end() && it->second == &player)
+		client_addresses.erase(it);
+}
+
 player_t &SV_FindPlayerByAddr(void)
 {
-	for (Players::iterator it = players.begin();it != players.end();++it)
-	{
-		if (NET_CompareAdr(it->client.address, net_from))
-		   return *it;
-	}
+	ClientAddresses::iterator it = client_addresses.find(SV_AddressKey(net_from));
+	if (it == client_addresses.end())
+		return idplayer(0);
 
-	return idplayer(0);
+	return *it->second;
 }
 
 //
@@ -595,6 +620,8 @@ Players::iterator SV_RemoveDisconnectedPlayer(Players::iterator it)
 		it->mo = AActor::AActorPtr();
 	}
 
+	SV_ForgetClientAddress(*it);
+
 	// remove this player from the global players vector
 	Players::iterator next;
 	next = players.erase(it);
@@ -667,12 +694,13 @@ void SV_Sound (AActor *mo, byte channel, const char *name, byte attenuation)
 		y = mo->y;
 	}
 
+	const EncodedSVC msg(
+	    SVC_PlaySound(PlaySoundType(mo), channel, sfx_id, 1.0f, attenuation));
 	for (Players::iterator it = players.begin();it != players.end();++it)
 	{
 		cl = &(it->client);
 
-		MSG_WriteSVC(&cl->reliablebuf, SVC_PlaySound(PlaySoundType(mo), channel, sfx_id,
-		                                             1.0f, attenuation));
+		MSG_WriteSVC(&cl->reliablebuf, msg);
 	}
 }
 
@@ -724,6 +752,8 @@ void UV_SoundAvoidPlayer (AActor *mo, byte channel, const char *name, byte atten
 		return;
 	}
 
+	const EncodedSVC msg(
+	    SVC_PlaySound(PlaySoundType(mo), channel, sfx_id, 1.0f, attenuation));
 	for (Players::iterator it = players.begin();it != players.end();++it)
 	{
 		if(&pl == &*it)
@@ -731,8 +761,7 @@ void UV_SoundAvoidPlayer (AActor *mo, byte channel, const char *name, byte atten
 
 		cl = &(it->client);
 
-		MSG_WriteSVC(&cl->reliablebuf, SVC_PlaySound(PlaySoundType(mo), channel, sfx_id,
-		                                             1.0f, attenuation));
+		MSG_WriteSVC(&cl->reliablebuf, msg);
 	}
 }
 
@@ -754,14 +783,15 @@ void SV_SoundTeam (byte channel, const char* name, byte attenuation, int team)
 		return;
 	}
 
+	const EncodedSVC msg(
+	    SVC_PlaySound(PlaySoundType(), channel, sfx_id, 1.0f, attenuation));
 	for (Players::iterator it = players.begin();it != players.end();++it)
 	{
 		if (it->ingame() && it->userinfo.team == team)
 		{
 			cl = &(it->client);
 
-			MSG_WriteSVC(&cl->reliablebuf, SVC_PlaySound(PlaySoundType(), channel, sfx_id,
-			                                             1.0f, attenuation));
+			MSG_WriteSVC(&cl->reliablebuf, msg);
 		}
 	}
 }
@@ -779,16 +809,8 @@ void SV_Sound (fixed_t x, fixed_t y, byte channel, const char *name, byte attenu
 		return;
 	}
 
-	for (Players::iterator it = players.begin();it != players.end();++it)
-	{
-		if (!(it->ingame()))
-			continue;
-
-		cl = &(it->client);
-
-		MSG_WriteSVC(&cl->reliablebuf, SVC_PlaySound(PlaySoundType(x, y), channel, sfx_id,
-		                                             1.0f, attenuation));
-	}
+	MSG_BroadcastSVC(CLBUF_RELIABLE, SVC_PlaySound(PlaySoundType(x, y), channel, sfx_id,
+	                                               1.0f, attenuation));
 }
 
 //
@@ -796,10 +818,11 @@ void SV_Sound (fixed_t x, fixed_t y, byte channel, const char *name, byte attenu
 //
 void SV_UpdateFrags(player_t &player)
 {
+	const EncodedSVC msg(SVC_PlayerMembers(player, SVC_PM_SCORE));
 	for (Players::iterator it = players.begin();it != players.end();++it)
 	{
 		client_t *cl = &(it->client);
-		MSG_WriteSVC(&cl->reliablebuf, SVC_PlayerMembers(player, SVC_PM_SCORE));
+		MSG_WriteSVC(&cl->reliablebuf, msg);
 	}
 }
 
@@ -818,8 +841,9 @@ Spreads a player's userinfo to every client.
  */
 void SV_BroadcastUserInfo(player_t &player)
 {
+	const EncodedSVC msg(SVC_UserInfo(player, time(NULL) - player.JoinTime));
 	for (Players::iterator it = players.begin();it != players.end();++it)
-		SV_SendUserInfo(player, &(it->client));
+		MSG_WriteSVC(&it->client.reliablebuf, msg);
 }
 
 /**
@@ -1020,6 +1044,7 @@ void SV_ForceSetTeam (player_t &who, team_t team)
 	client_t *cl = &who.client;
 
 	who.userinfo.team = team;
+	SV_RescanHiddenMobj(who);
 	Printf (PRINT_HIGH, "Forcing %s to %s team\n", who.userinfo.netname.c_str(), team == TEAM_NONE ? "NONE" : V_GetTeamColor(team).c_str());
 
 	MSG_WriteSVC(&cl->reliablebuf, SVC_ForceTeam(team));
@@ -1071,6 +1096,38 @@ team_t SV_GoodTeam (void)
 	return smallest_team;
 }
 
+//
+// SV_ClearMobjDeltas
+// Forgets every actor state the client acknowledged, for when its netids
+// or packet sequence start over.
+//
+static void SV_ClearMobjDeltas(client_t* cl)
+{
+	cl->mobjdeltas.clear();
+	cl->pendingmobjs.clear();
+
+	for (size_t i = 0; i < ARRAY_LENGTH(cl->sentmobjs); i++)
+	{
+		cl->sentmobjs[i].sequence = -1;
+		cl->sentmobjs[i].mobjs.clear();
+	}
+}
+
+//
+// SV_ResetMobjDelta
+// The client is about to recreate or forget the actor, so the states it
+// acknowledged are gone and acks still in flight are stale.
+//
+static void SV_ResetMobjDelta(client_t* cl, AActor* mo)
+{
+	client_t::MobjDeltas::iterator it = cl->mobjdeltas.find(mo->netid);
+	if (it == cl->mobjdeltas.end())
+		return;
+
+	it->second.acked = 0;
+	it->second.floor = it->second.sent;
+}
+
 //
 // SV_SendMobjToClient
 //
@@ -1079,6 +1136,7 @@ void SV_SendMobjToClient(AActor *mo, client_t *cl)
 	if (!mo)
 		return;
 
+	SV_ResetMobjDelta(cl, mo);
 	MSG_WriteSVC(&cl->reliablebuf, SVC_SpawnMobj(mo));
 }
 
@@ -1137,6 +1195,7 @@ bool SV_AwarenessUpdate(player_t &player, AActor *mo)
 	{
 		mo->players_aware.unset(player.id);
 
+		SV_ResetMobjDelta(cl, mo);
 		MSG_WriteSVC(&cl->reliablebuf, SVC_RemoveMobj(*mo));
 
 		return true;
@@ -1198,14 +1257,30 @@ bool SV_IsPlayerAllowedToSee(player_t &p, AActor *mo)
 
 #define HARDWARE_CAPABILITY 1000
 
+// Set when a player may not be aware of everything they should be.
+static bool hiddenmobj_rescan = true;
+
+// Players who joined, spectated or changed team since the last tic.  They
+// are checked against every actor right away instead of at the timed pass.
+static bool hiddenmobj_rescanplayer[MAXPLAYERS + 1];
+
+static void SV_RescanHiddenMobj(player_t& player)
+{
+	hiddenmobj_rescanplayer[player.id] = true;
+}
+
 //
 // SV_UpdateHiddenMobj
 //
+// New actors reach every player through their to_spawn queue, so walking
+// every thinker is only a safety net.  It runs once a second, or on the next
+// tic if a player had more to catch up on than a tic allows.  Players who
+// joined, spectated or changed team get their own pass on the same tic.
+//
 void SV_UpdateHiddenMobj(void)
 {
-	// denis - todo - throttle this
 	AActor *mo;
-	TThinkerIterator<AActor> iterator;
+	int updated[MAXPLAYERS + 1] = {0};
 
 	for (Players::iterator it = players.begin(); it != players.end(); ++it)
 	{
@@ -1214,8 +1289,6 @@ void SV_UpdateHiddenMobj(void)
 		if (!pl.mo)
 			continue;
 
-		int updated = 0;
-
 		while (!pl.to_spawn.empty())
 		{
 			mo = pl.to_spawn.front();
@@ -1223,18 +1296,66 @@ void SV_UpdateHiddenMobj(void)
 			pl.to_spawn.pop();
 
 			if (mo && !mo->WasDestroyed())
-				updated += SV_AwarenessUpdate(pl, mo);
+				updated[pl.id] += SV_AwarenessUpdate(pl, mo);
 
-			if (updated > 16)
+			if (updated[pl.id] > 16)
+			{
+				hiddenmobj_rescan = true;
 				break;
+			}
 		}
+	}
 
-		while ((mo = iterator.Next()))
+	for (Players::iterator it = players.begin(); it != players.end(); ++it)
+	{
+		player_t &pl = *it;
+
+		// a joining player has no body until the tic they are reborn on
+		if (!hiddenmobj_rescanplayer[pl.id] || !pl.mo)
+			continue;
+
+		hiddenmobj_rescanplayer[pl.id] = false;
+
+		// everyone else's view of this player
+		for (Players::iterator pit = players.begin(); pit != players.end(); ++pit)
 		{
-			updated += SV_AwarenessUpdate(pl, mo);
+			if (pit->mo && &*pit != &pl)
+				updated[pit->id] += SV_AwarenessUpdate(*pit, pl.mo);
+		}
 
-			if (updated > 16)
+		// this player's view of everything else
+		TThinkerIterator<AActor> iterator;
+		while ((mo = iterator.Next()))
+		{
+			if (updated[pl.id] > 16)
+			{
+				hiddenmobj_rescan = true;
 				break;
+			}
+
+			updated[pl.id] += SV_AwarenessUpdate(pl, mo);
+		}
+	}
+
+	if (!hiddenmobj_rescan && !P_AtInterval(TICRATE))
+		return;
+
+	hiddenmobj_rescan = false;
+
+	TThinkerIterator<AActor> iterator;
+	while ((mo = iterator.Next()))
+	{
+		for (Players::iterator it = players.begin(); it != players.end(); ++it)
+		{
+			player_t &pl = *it;
+
+			if (!pl.mo || updated[pl.id] > 16)
+				continue;
+
+			updated[pl.id] += SV_AwarenessUpdate(pl, mo);
+
+			if (updated[pl.id] > 16)
+				hiddenmobj_rescan = true;
 		}
 	}
 }
@@ -1252,8 +1373,18 @@ void SV_UpdateSector(client_t* cl, int sectornum)
 
 void SV_BroadcastSector(int sectornum)
 {
+	if (sectornum < 0 || sectornum >= numsectors)
+		return;
+
+	sector_t* sector = &sectors[sectornum];
+
+	// Only update moveable sectors to clients
+	if (!sector->moveable)
+		return;
+
+	const EncodedSVC msg(SVC_UpdateSector(*sector));
 	for (Players::iterator it = players.begin();it != players.end();++it)
-		SV_UpdateSector(&(it->client), sectornum);
+		MSG_WriteSVC(&it->client.reliablebuf, msg);
 }
 
 //
@@ -1325,7 +1456,7 @@ void SV_SendMovingSectorUpdate(player_t &player, sector_t *sector)
 
 	buf_t *netbuf = &(player.client.netbuf);
 
-	odaproto::svc::MovingSector msg = SVC_MovingSector(*sector);
+	const odaproto::svc::MovingSector& msg = SVC_MovingSector(*sector);
 	if (!msg.movers())
 	{
 		// No movers in the packet, don't send.
@@ -1456,6 +1587,9 @@ void SV_ClientFullUpdate(player_t &pl)
 {
 	client_t *cl = &pl.client;
 
+	// Netids start over with the level.
+	SV_ClearMobjDeltas(cl);
+
 	MSG_WriteSVC(&cl->reliablebuf, odaproto::svc::FullUpdateStart());
 
 	// Send the player all level locals.
@@ -1484,6 +1618,7 @@ void SV_ClientFullUpdate(player_t &pl)
 			MSG_WriteSVC(&cl->reliablebuf, SVC_TeamMembers(static_cast<team_t>(i)));
 	}
 
+	hiddenmobj_rescan = true;
 	SV_UpdateHiddenMobj();
 
 	// update flags
@@ -1515,18 +1650,21 @@ void SV_UpdateSecret(sector_t& sector, player_t &player)
 	if (!G_IsCoopGame())
 		return;
 
+	const EncodedSVC secretsmsg(SVC_LevelLocals(::level, SVC_LL_SECRETS));
+	const EncodedSVC scoremsg(SVC_PlayerMembers(player, SVC_PM_SCORE));
+	const EncodedSVC eventmsg(SVC_SecretEvent(player, sector));
 	for (Players::iterator it = players.begin(); it != players.end(); ++it)
 	{
 		client_t* cl = &(it->client);
 
-		MSG_WriteSVC(&cl->reliablebuf, SVC_LevelLocals(::level, SVC_LL_SECRETS));
-		MSG_WriteSVC(&cl->reliablebuf, SVC_PlayerMembers(player, SVC_PM_SCORE));
+		MSG_WriteSVC(&cl->reliablebuf, secretsmsg);
+		MSG_WriteSVC(&cl->reliablebuf, scoremsg);
 
 		if (&*it == &player)
 			continue;
 
 		if (!(sector.special & SECRET_MASK) && sector.secretsector)
-			MSG_WriteSVC(&cl->reliablebuf, SVC_SecretEvent(player, sector));
+			MSG_WriteSVC(&cl->reliablebuf, eventmsg);
 	}
 }
 
@@ -1717,6 +1855,32 @@ static void SV_DisconnectOldClient()
 
 void G_DoReborn(player_t& playernum);
 
+/**
+ * @brief Pick the packet compression for a connecting client.
+ *
+ * @detail Clients that know about the other methods send a mask of the
+ *         methods they can read and the one they would like.  Older clients
+ *         send nothing and only read minilzo.
+ */
+static packetCompression_e SV_NegotiateCompression()
+{
+	byte supported = BIT(PACKETCOMP_NONE) | BIT(PACKETCOMP_MINILZO);
+	byte wanted = PACKETCOMP_MINILZO;
+
+	if (MSG_BytesLeft() >= 2)
+	{
+		supported = MSG_ReadByte() | BIT(PACKETCOMP_NONE);
+		wanted = MSG_ReadByte();
+	}
+
+	// Don't go past what the server is willing to spend on compression.
+	int method = MIN<int>(wanted, sv_packetcompression.asInt());
+	while (method > PACKETCOMP_NONE && !(supported & BIT(method)))
+		method--;
+
+	return static_cast<packetCompression_e>(method);
+}
+
 //
 //	SV_ConnectClient
 //
@@ -1775,6 +1939,7 @@ void SV_ConnectClient()
 
 	// clear and reinitialize client network info
 	cl->address = net_from;
+	client_addresses[SV_AddressKey(net_from)] = player;
 	cl->last_received = gametic;
 	cl->reliable_bps = 0;
 	cl->unreliable_bps = 0;
@@ -1786,11 +1951,9 @@ void SV_ConnectClient()
 	SZ_Clear(&cl->netbuf);
 	SZ_Clear(&cl->reliablebuf);
 
-	for (size_t i = 0; i < ARRAY_LENGTH(cl->oldpackets); i++)
-	{
-		cl->oldpackets[i].sequence = -1;
-		SZ_Clear(&cl->oldpackets[i].data);
-	}
+	SV_ClearOldPackets(*cl);
+
+	SV_ClearMobjDeltas(cl);
 
 	cl->sequence = 0;
 	cl->last_sequence = -1;
@@ -1857,6 +2020,10 @@ void SV_ConnectClient()
 		return;
 	}
 
+	cl->compressor = huffman_server();
+	cl->compression = SV_NegotiateCompression();
+	cl->features = MSG_BytesLeft() >= 1 ? MSG_ReadByte() : 0;
+
 	// send consoleplayer number
 	MSG_WriteSVC(&cl->reliablebuf, SVC_ConsolePlayer(*player, cl->digest));
 	SV_SendPacket(*player);
@@ -1979,10 +2146,11 @@ void SV_DisconnectClient(player_t &who)
 		return;
 
 	// tell others clients about it
+	const EncodedSVC msg(SVC_DisconnectClient(who));
 	for (Players::iterator it = players.begin(); it != players.end(); ++it)
 	{
 		client_t &cl = it->client;
-		MSG_WriteSVC(&cl.reliablebuf, SVC_DisconnectClient(who));
+		MSG_WriteSVC(&cl.reliablebuf, msg);
 	}
 
 	Maplist_Disconnect(who);
@@ -2040,6 +2208,7 @@ void SV_SendDisconnectSignal()
 	}
 
 	players.clear();
+	client_addresses.clear();
 }
 
 //
@@ -2059,6 +2228,7 @@ void SV_SendReconnectSignal()
 	}
 
 	players.clear();
+	client_addresses.clear();
 }
 
 //
@@ -2067,9 +2237,10 @@ void SV_SendReconnectSignal()
 //
 void SV_ExitLevel()
 {
+	const EncodedSVC msg((odaproto::svc::ExitLevel()));
 	for (Players::iterator it = players.begin(); it != players.end(); ++it)
 	{
-		MSG_WriteSVC(&(it->client.reliablebuf), odaproto::svc::ExitLevel());
+		MSG_WriteSVC(&(it->client.reliablebuf), msg);
 	}
 }
 
@@ -2391,12 +2562,12 @@ void STACK_ARGS SV_BroadcastPrintf(int printlevel, const char* format, ...)
 	if (printlevel == PRINT_NORCON)
 		printlevel = PRINT_HIGH;
 
+	const EncodedSVC msg(SVC_Print(static_cast<printlevel_t>(printlevel), string));
 	for (Players::iterator it = players.begin(); it != players.end(); ++it)
 	{
 		cl = &(it->client);
 
-		MSG_WriteSVC(&cl->reliablebuf,
-		             SVC_Print(static_cast<printlevel_t>(printlevel), string));
+		MSG_WriteSVC(&cl->reliablebuf, msg);
 	}
 }
 
@@ -2430,6 +2601,7 @@ void STACK_ARGS SV_BroadcastPrintfButPlayer(int printlevel, int player_id, const
 	if (printlevel == PRINT_NORCON)
 		printlevel = PRINT_HIGH;
 
+	const EncodedSVC msg(SVC_Print(static_cast<printlevel_t>(printlevel), string));
 	for (Players::iterator it = players.begin(); it != players.end(); ++it)
 	{
 		cl = &(it->client);
@@ -2439,8 +2611,7 @@ void STACK_ARGS SV_BroadcastPrintfButPlayer(int printlevel, int player_id, const
 		if (cl == excluded_client)
 			continue;
 
-		MSG_WriteSVC(&cl->reliablebuf,
-		             SVC_Print(static_cast<printlevel_t>(printlevel), string));
+		MSG_WriteSVC(&cl->reliablebuf, msg);
 	}
 }
 
@@ -2457,6 +2628,7 @@ void STACK_ARGS SV_SpectatorPrintf(int level, const char *fmt, ...)
 
 	Printf(level, "%s", string);  // print to the console
 
+	const EncodedSVC msg(SVC_Print(static_cast<printlevel_t>(level), string));
 	for (Players::iterator it = players.begin(); it != players.end(); ++it)
 	{
 		cl = &(it->client);
@@ -2464,8 +2636,7 @@ void STACK_ARGS SV_SpectatorPrintf(int level, const char *fmt, ...)
 		bool spectator = it->spectator || !it->ingame();
 		if (spectator)
 		{
-			MSG_WriteSVC(&cl->reliablebuf,
-			             SVC_Print(static_cast<printlevel_t>(level), string));
+			MSG_WriteSVC(&cl->reliablebuf, msg);
 		}
 	}
 }
@@ -2513,6 +2684,7 @@ void STACK_ARGS SV_TeamPrintf(int level, int who, const char *fmt, ...)
 
 	player_t* player = &idplayer(who);
 
+	const EncodedSVC msg(SVC_Print(static_cast<printlevel_t>(level), string));
 	for (Players::iterator it = players.begin(); it != players.end(); ++it)
 	{
 		if (it->userinfo.team != player->userinfo.team)
@@ -2527,8 +2699,7 @@ void STACK_ARGS SV_TeamPrintf(int level, int who, const char *fmt, ...)
 		if (cl->allow_rcon) // [mr.crispy -- sept 23 2013] RCON guy already got it when it printed to the console
 			continue;
 
-		MSG_WriteSVC(&cl->reliablebuf,
-		             SVC_Print(static_cast<printlevel_t>(level), string));
+		MSG_WriteSVC(&cl->reliablebuf, msg);
 	}
 }
 
@@ -2542,6 +2713,7 @@ void SVC_TeamSay(player_t &player, const char* message)
 {
 	const char* team = GetTeamInfo(player.userinfo.team)->ColorStringUpper.c_str();
 
+	const EncodedSVC msg(SVC_Say(true, player.id, message));
 	for (Players::iterator it = players.begin(); it != players.end(); ++it)
 	{
 		// Player needs to be valid.
@@ -2554,7 +2726,7 @@ void SVC_TeamSay(player_t &player, const char* message)
 		if (spectator || it->userinfo.team != player.userinfo.team)
 			continue;
 
-		MSG_WriteSVC(&it->client.reliablebuf, SVC_Say(true, player.id, message));
+		MSG_WriteSVC(&it->client.reliablebuf, msg);
 	}
 }
 
@@ -2571,6 +2743,7 @@ void SVC_SpecSay(player_t &player, const char* message)
 	else
 		Printf(PRINT_TEAMCHAT, "<SPEC> %s: %s\n", player.userinfo.netname.c_str(), message);
 
+	const EncodedSVC msg(SVC_Say(true, player.id, message));
 	for (Players::iterator it = players.begin(); it != players.end(); ++it)
 	{
 		// Player needs to be valid.
@@ -2582,7 +2755,7 @@ void SVC_SpecSay(player_t &player, const char* message)
 		if (!spectator)
 			continue;
 
-		MSG_WriteSVC(&it->client.reliablebuf, SVC_Say(true, player.id, message));
+		MSG_WriteSVC(&it->client.reliablebuf, msg);
 	}
 }
 
@@ -2599,13 +2772,14 @@ void SVC_Say(player_t &player, const char* message)
 	else
 		Printf(PRINT_CHAT, "<CHAT> %s: %s\n", player.userinfo.netname.c_str(), message);
 
+	const EncodedSVC msg(SVC_Say(false, player.id, message));
 	for (Players::iterator it = players.begin(); it != players.end(); ++it)
 	{
 		// Player needs to be valid.
 		if (!validplayer(*it))
 			continue;
 
-		MSG_WriteSVC(&it->client.reliablebuf, SVC_Say(false, player.id, message));
+		MSG_WriteSVC(&it->client.reliablebuf, msg);
 	}
 }
 
@@ -2745,35 +2919,250 @@ bool SV_PrivMsg(player_t &player)
 	return true;
 }
 
+// Actors in the same or a neighbouring cell as a player's view are updated
+// whenever they are due, the others every FAR_UPDATE_DIVISOR'th time.
+static const int INTEREST_CELL_SHIFT = 4; // 16 map blocks, 2048 units
+static const int FAR_UPDATE_DIVISOR = 4;
+
+/**
+ * @brief An actor update that is due this tic, with the actor state captured
+ *        once for every client that is allowed to see the actor.
+ */
+struct MobjUpdate
+{
+	AActor* mo;
+	baseline_t state;
+	bool everyone; // due for far away players as well
+
+	MobjUpdate(AActor* mo, bool everyone)
+	    : mo(mo), state(P_GetMobjBaselineState(*mo)), everyone(everyone)
+	{
+	}
+};
+typedef std::vector<MobjUpdate> MobjUpdates;
+typedef std::vector<const MobjUpdate*> MobjUpdateRefs;
+
 //
-// SV_UpdateMissiles
-// Updates missiles position sometimes.
+// SV_ViewActor
+// The actor a player is watching the level from.
 //
-void SV_UpdateMissiles(player_t &pl)
+static AActor* SV_ViewActor(player_t& pl)
 {
-    AActor *mo;
+	player_t& target = idplayer(pl.spying);
+	if (validplayer(target) && &target != &pl && target.mo && P_CanSpy(pl, target))
+		return target.mo;
 
-    TThinkerIterator<AActor> iterator;
-    while ( (mo = iterator.Next() ) )
-    {
-		if (!(mo->flags & MF_MISSILE) || mo->flags & MF_SKULLFLY)
+	return pl.mo;
+}
+
+/**
+ * @brief A coarse grid over the blockmap that records which players are
+ *        viewing the level from each cell.  It is rebuilt once per tic so
+ *        an actor update only has to be matched against nearby players.
+ */
+class InterestGrid
+{
+	int m_width;
+	int m_height;
+	std::vector<std::vector<player_t*> > m_cells;
+	std::vector<size_t> m_used;
+
+	void cellOf(const AActor* mo, int& cx, int& cy) const
+	{
+		cx = (mo->x - bmaporgx) >> (MAPBLOCKSHIFT + INTEREST_CELL_SHIFT);
+		cy = (mo->y - bmaporgy) >> (MAPBLOCKSHIFT + INTEREST_CELL_SHIFT);
+		cx = clamp(cx, 0, m_width - 1);
+		cy = clamp(cy, 0, m_height - 1);
+	}
+
+  public:
+	InterestGrid() : m_width(0), m_height(0)
+	{
+	}
+
+	void build()
+	{
+		for (size_t i = 0; i < m_used.size(); i++)
+			m_cells[m_used[i]].clear();
+		m_used.clear();
+
+		m_width = (bmapwidth >> INTEREST_CELL_SHIFT) + 1;
+		m_height = (bmapheight >> INTEREST_CELL_SHIFT) + 1;
+		if (m_cells.size() < static_cast<size_t>(m_width * m_height))
+			m_cells.resize(m_width * m_height);
+
+		for (Players::iterator it = players.begin(); it != players.end(); ++it)
+		{
+			if (!it->ingame())
+				continue;
+
+			AActor* view = SV_ViewActor(*it);
+			if (!view)
+				continue;
+
+			int cx, cy;
+			cellOf(view, cx, cy);
+
+			std::vector<player_t*>& cell = m_cells[cy * m_width + cx];
+			if (cell.empty())
+				m_used.push_back(cy * m_width + cx);
+			cell.push_back(&*it);
+		}
+	}
+
+	void addNear(const MobjUpdate& update, MobjUpdateRefs interest[]) const
+	{
+		int cx, cy;
+		cellOf(update.mo, cx, cy);
+
+		for (int y = MAX(cy - 1, 0); y <= MIN(cy + 1, m_height - 1); y++)
+		{
+			for (int x = MAX(cx - 1, 0); x <= MIN(cx + 1, m_width - 1); x++)
+			{
+				const std::vector<player_t*>& cell = m_cells[y * m_width + x];
+				for (size_t i = 0; i < cell.size(); i++)
+					interest[cell[i]->id].push_back(&update);
+			}
+		}
+	}
+};
+
+//
+// SV_WriteMobjDelta
+// Writes an actor update to the client's unreliable buffer, relative to the
+// newest state of the actor the client acknowledged.  Falls back to the
+// spawn baseline if that state may have left the client's history, and
+// every baseline_t::KEYFRAME updates so a client that lost track catches up.
+// Clients without CLF_MOBJDELTAS always get updates relative to the spawn
+// baseline.
+//
+static void SV_WriteMobjDelta(client_t* cl, const MobjUpdate& update)
+{
+	const uint32_t netid = update.mo->netid;
+
+	if (!(cl->features & CLF_MOBJDELTAS))
+	{
+		MSG_WriteSVC(&cl->netbuf, SVC_UpdateMobjDelta(netid, update.mo->baseline,
+		                                              update.state, 0, 0));
+		return;
+	}
+
+	client_t::mobjDelta_t& delta = cl->mobjdeltas[netid];
+
+	const unsigned int count = delta.sent + 1;
+	const uint32_t tag = (count - 1) % baseline_t::MAX_TAG + 1;
+
+	if (delta.acked && count % baseline_t::KEYFRAME != 0 &&
+	    count - delta.acked <= baseline_t::HISTORY)
+	{
+		const uint32_t basetag = (delta.acked - 1) % baseline_t::MAX_TAG + 1;
+		MSG_WriteSVC(&cl->netbuf, SVC_UpdateMobjDelta(netid, delta.ackedstate,
+		                                              update.state, tag, basetag));
+	}
+	else
+	{
+		MSG_WriteSVC(&cl->netbuf, SVC_UpdateMobjDelta(netid, update.mo->baseline,
+		                                              update.state, tag, 0));
+	}
+
+	delta.sent = count;
+
+	client_t::mobjSent_t sent;
+	sent.netid = netid;
+	sent.count = count;
+	sent.state = update.state;
+	cl->pendingmobjs.push_back(sent);
+}
+
+//
+// SV_CollectMobjUpdates
+// Gathers missiles and monsters whose position is due to be sent this tic.
+//
+static void SV_CollectMobjUpdates(MobjUpdates& missiles, MobjUpdates& monsters)
+{
+	AActor *mo;
+
+	missiles.clear();
+	monsters.clear();
+
+	TThinkerIterator<AActor> iterator;
+	while ( (mo = iterator.Next() ) )
+	{
+		if ((mo->flags & MF_MISSILE) && !(mo->flags & MF_SKULLFLY) &&
+		    mo->type != MT_PLASMA)
+		{
+			// update missile position every 30 tics
+			// Revenant tracers and Mancubus fireballs need to be updated more
+			// often (and custom tracers)
+			int interval = 30;
+			if (mo->type == MT_TRACER || mo->type == MT_FATSHOT ||
+			    mo->flags2 & MF2_SEEKERMISSILE)
+				interval = 5;
+
+			if ((gametic + mo->netid) % interval == 0)
+			{
+				missiles.push_back(MobjUpdate(
+				    mo, (gametic + mo->netid) % (interval * FAR_UPDATE_DIVISOR) == 0));
+			}
+		}
+
+		// Ignore corpses.
+		if (mo->flags & MF_CORPSE)
+			continue;
+
+		// We don't handle updating non-monsters here.
+		if (!(mo->flags & MF_COUNTKILL || mo->type == MT_SKULL))
 			continue;
 
-		if (mo->type == MT_PLASMA)
+		// update monster position every 7 tics
+		if ((gametic+mo->netid) % 7)
 			continue;
 
-		// update missile position every 30 tics
-		if (((gametic+mo->netid) % 30) && (mo->type != MT_TRACER) && (mo->type != MT_FATSHOT) && !(mo->flags2 & MF2_SEEKERMISSILE))
+		if (!mo->target)
 			continue;
-		// Revenant tracers and Mancubus fireballs need to be updated more often (and custom tracers)
-		else if (((gametic+mo->netid) % 5) && (mo->type == MT_TRACER || mo->type == MT_FATSHOT || mo->flags2 & MF2_SEEKERMISSILE))
+
+		monsters.push_back(
+		    MobjUpdate(mo, (gametic + mo->netid) % (7 * FAR_UPDATE_DIVISOR) == 0));
+	}
+}
+
+//
+// SV_CollectInterest
+// Hands each update to the players that should get it this tic, so every
+// player only looks at the actors around them.
+//
+static void SV_CollectInterest(const MobjUpdates& updates, const InterestGrid& grid,
+                               MobjUpdateRefs interest[])
+{
+	for (MobjUpdates::const_iterator it = updates.begin(); it != updates.end(); ++it)
+	{
+		if (!it->everyone)
+		{
+			grid.addNear(*it, interest);
 			continue;
+		}
+
+		for (Players::iterator pit = players.begin(); pit != players.end(); ++pit)
+		{
+			if (pit->ingame())
+				interest[pit->id].push_back(&*it);
+		}
+	}
+}
 
-		if(SV_IsPlayerAllowedToSee(pl, mo))
+//
+// SV_UpdateMissiles
+// Updates missiles position sometimes.
+//
+void SV_UpdateMissiles(player_t &pl, const MobjUpdateRefs& missiles)
+{
+	for (MobjUpdateRefs::const_iterator it = missiles.begin(); it != missiles.end(); ++it)
+	{
+		if(SV_IsPlayerAllowedToSee(pl, (*it)->mo))
 		{
 			client_t *cl = &pl.client;
 
-			MSG_WriteSVC(&cl->netbuf, SVC_UpdateMobj(*mo));
+			SV_WriteMobjDelta(cl, **it);
 
             if (cl->netbuf.cursize >= 1024)
                 if(!SV_SendPacket(pl))
@@ -2789,6 +3178,7 @@ void SV_UpdateMobj(AActor* mo)
 	if (mo->player)
 		return;
 
+	const EncodedSVC msg(SVC_UpdateMobj(*mo));
 	for (Players::iterator it = players.begin(); it != players.end(); ++it)
 	{
 		if (!(it->ingame()))
@@ -2797,7 +3187,7 @@ void SV_UpdateMobj(AActor* mo)
 		if (SV_IsPlayerAllowedToSee(*it, mo))
 		{
 			client_t* cl = &(it->client);
-			MSG_WriteSVC(&cl->reliablebuf, SVC_UpdateMobj(*mo));
+			MSG_WriteSVC(&cl->reliablebuf, msg);
 		}
 	}
 }
@@ -2805,6 +3195,7 @@ void SV_UpdateMobj(AActor* mo)
 // Update the given actors state immediately.
 void SV_UpdateMobjState(AActor* mo)
 {
+	const EncodedSVC msg(SVC_MobjState(mo));
 	for (Players::iterator it = players.begin(); it != players.end(); ++it)
 	{
 		if (!(it->ingame()))
@@ -2813,36 +3204,21 @@ void SV_UpdateMobjState(AActor* mo)
 		if (SV_IsPlayerAllowedToSee(*it, mo))
 		{
 			client_t* cl = &(it->client);
-			MSG_WriteSVC(&cl->reliablebuf, SVC_MobjState(mo));
+			MSG_WriteSVC(&cl->reliablebuf, msg);
 		}
 	}
 }
 
 // Keep tabs on monster positions and angles.
-void SV_UpdateMonsters(player_t &pl)
+void SV_UpdateMonsters(player_t &pl, const MobjUpdateRefs& monsters)
 {
-	AActor *mo;
-
-	TThinkerIterator<AActor> iterator;
-	while ((mo = iterator.Next()))
+	for (MobjUpdateRefs::const_iterator it = monsters.begin(); it != monsters.end(); ++it)
 	{
-		// Ignore corpses.
-		if (mo->flags & MF_CORPSE)
-			continue;
-
-		// We don't handle updating non-monsters here.
-		if (!(mo->flags & MF_COUNTKILL || mo->type == MT_SKULL))
-			continue;
-
-		// update monster position every 7 tics
-		if ((gametic+mo->netid) % 7)
-			continue;
-
-		if (SV_IsPlayerAllowedToSee(pl, mo) && mo->target)
+		if (SV_IsPlayerAllowedToSee(pl, (*it)->mo))
 		{
 			client_t *cl = &pl.client;
 
-			MSG_WriteSVC(&cl->netbuf, SVC_UpdateMobj(*mo));
+			SV_WriteMobjDelta(cl, **it);
 
 			if (cl->netbuf.cursize >= 1024)
 			{
@@ -2887,6 +3263,7 @@ void SV_ActorTarget(AActor *actor)
 	if (actor->player)
 		return;
 
+	const EncodedSVC msg(SVC_UpdateMobj(*actor));
 	for (Players::iterator it = players.begin();it != players.end();++it)
 	{
 		if (!(it->ingame()))
@@ -2897,7 +3274,7 @@ void SV_ActorTarget(AActor *actor)
 		if(!SV_IsPlayerAllowedToSee(*it, actor))
 			continue;
 
-		MSG_WriteSVC(&cl->reliablebuf, SVC_UpdateMobj(*actor));
+		MSG_WriteSVC(&cl->reliablebuf, msg);
 	}
 }
 
@@ -2906,15 +3283,7 @@ void SV_ActorTarget(AActor *actor)
 //
 void SV_ActorTracer(AActor *actor)
 {
-	for (Players::iterator it = players.begin();it != players.end();++it)
-	{
-		if (!(it->ingame()))
-			continue;
-
-		client_t *cl = &(it->client);
-
-		MSG_WriteSVC(&cl->reliablebuf, SVC_UpdateMobj(*actor));
-	}
+	MSG_BroadcastSVC(CLBUF_RELIABLE, SVC_UpdateMobj(*actor));
 }
 
 //
@@ -2972,10 +3341,11 @@ void SV_UpdateMonsterRespawnCount()
 	if (!G_IsCoopGame())
 		return;
 
+	const EncodedSVC msg(SVC_LevelLocals(::level, SVC_LL_MONSTER_RESPAWNS));
 	for (Players::iterator it = players.begin(); it != players.end(); ++it)
 	{
 		client_t* cl = &(it->client);
-		MSG_WriteSVC(&cl->reliablebuf, SVC_LevelLocals(::level, SVC_LL_MONSTER_RESPAWNS));
+		MSG_WriteSVC(&cl->reliablebuf, msg);
 	}
 }
 
@@ -2992,11 +3362,13 @@ void SV_CalcPing(player_t &player)
 }
 
 //
-// SV_UpdatePing
-// send pings to a client
+// SV_CollectPings
+// Encodes the ping of every player, if it is time to send them.
 //
-void SV_UpdatePing(client_t* cl)
+static void SV_CollectPings(std::vector<EncodedSVC>& out)
 {
+	out.clear();
+
 	if (!P_AtInterval(101))
 		return;
 
@@ -3005,7 +3377,20 @@ void SV_UpdatePing(client_t* cl)
 		if (!(it->ingame()))
 			continue;
 
-		MSG_WriteSVC(&cl->reliablebuf, SVC_UpdatePing(*it));
+		out.push_back(EncodedSVC(SVC_UpdatePing(*it)));
+	}
+}
+
+//
+// SV_UpdatePing
+// send pings to a client
+//
+void SV_UpdatePing(client_t* cl, const std::vector<EncodedSVC>& pings)
+{
+	for (std::vector<EncodedSVC>::const_iterator it = pings.begin(); it != pings.end();
+	     ++it)
+	{
+		MSG_WriteSVC(&cl->reliablebuf, *it);
 	}
 }
 
@@ -3077,13 +3462,22 @@ void SV_SendPackets()
 	for (size_t i = 0;i < fair_send;i++)
 		++begin;
 
+#ifndef SIMULATE_LATENCY
+	// Hand the packets of every client to the kernel together.  Delayed
+	// sends come from another thread, so they can't share the batch.
+	NET_BeginSendBatch();
+#endif
+
 	// Loop through all players in a staggered fashion.
+	static std::vector<player_t*> sendto;
+	sendto.clear();
+
 	Players::iterator it = begin;
 	do
 	{
 		// [AM] Don't send packets to players who haven't acked packet 0
 		if (it->playerstate != PST_CONTACT)
-			SV_SendPacket(*it);
+			sendto.push_back(&*it);
 
 		++it;
 		if (it == players.end())
@@ -3091,6 +3485,12 @@ void SV_SendPackets()
 	}
 	while (it != begin);
 
+	SV_SendPacketBatch(sendto);
+
+#ifndef SIMULATE_LATENCY
+	NET_EndSendBatch();
+#endif
+
 	// Advance the send index.
 	fair_send++;
 }
@@ -3125,6 +3525,36 @@ void SV_WriteCommands(void)
 	Unlag::getInstance().recordPlayerPositions();
 	Unlag::getInstance().recordSectorPositions();
 
+	// Everything that is the same for every client is built once up front,
+	// so the per-client loop below only has to copy bytes around.
+	static MobjUpdates missiles, monsters;
+	static std::vector<EncodedSVC> pings;
+	SV_CollectMobjUpdates(missiles, monsters);
+	SV_CollectPings(pings);
+
+	// Match actor updates to the players near them once, instead of having
+	// every player look at every actor.
+	static InterestGrid grid;
+	static MobjUpdateRefs nearmissiles[MAXPLAYERS + 1];
+	static MobjUpdateRefs nearmonsters[MAXPLAYERS + 1];
+	grid.build();
+	SV_CollectInterest(missiles, grid, nearmissiles);
+	SV_CollectInterest(monsters, grid, nearmonsters);
+
+	// Player movement only differs by the recipient's client tic, so each
+	// player's move is serialized once without it.
+	static std::vector<EncodedTicSVC> moves;
+	moves.clear();
+	static size_t moveindex[MAXPLAYERS + 1];
+	for (Players::iterator pit = players.begin(); pit != players.end(); ++pit)
+	{
+		if (!(pit->ingame()) || !(pit->mo) || pit->spectator)
+			continue;
+
+		moveindex[pit->id] = moves.size();
+		moves.push_back(EncodedTicSVC(SVC_MovePlayer(*pit, 0)));
+	}
+
 	for (Players::iterator it = players.begin(); it != players.end(); ++it)
 	{
 		client_t *cl = &(it->client);
@@ -3151,7 +3581,7 @@ void SV_WriteCommands(void)
 			if(!SV_IsPlayerAllowedToSee(*it, pit->mo))
 				continue;
 
-			MSG_WriteSVC(&cl->netbuf, SVC_MovePlayer(*pit, it->tic));
+			MSG_WriteSVC(&cl->netbuf, moves[moveindex[pit->id]], it->tic);
 		}
 
 		// [SL] Send client info about player he is spying on
@@ -3161,17 +3591,22 @@ void SV_WriteCommands(void)
 
 		SV_UpdateConsolePlayer(*it);
 
-		SV_UpdateMissiles(*it);
+		SV_UpdateMissiles(*it, nearmissiles[it->id]);
+		nearmissiles[it->id].clear();
 
-		SV_UpdateMonsters(*it);
+		SV_UpdateMonsters(*it, nearmonsters[it->id]);
+		nearmonsters[it->id].clear();
 
 		SV_UpdateGametype(*it);     // update gametype stuff
 
 		SV_SendPingRequest(cl);     // request ping reply
 
-		SV_UpdatePing(cl);          // send the ping value of all cients to this client
+		SV_UpdatePing(cl, pings);   // send the ping value of all cients to this client
 	}
 
+	missiles.clear();
+	monsters.clear();
+
 	SV_UpdateHiddenMobj();
 
 	SV_UpdateDeadPlayers(); // Update dying players.
@@ -3382,6 +3817,9 @@ void SV_ChangeTeam (player_t &player)  // [Toke - Teams]
 	team_t old_team = player.userinfo.team;
 	player.userinfo.team = team;
 
+	if (team != old_team)
+		SV_RescanHiddenMobj(player);
+
 	if (G_IsTeamGame() && player.mo && player.userinfo.team != old_team &&
 	    !G_IsLevelState(LevelState::WARMUP))
 	{
@@ -3499,6 +3937,7 @@ void SV_JoinPlayer(player_t& player, bool silent)
 
 	// Warn everyone we're not a spectator anymore.
 	player.spectator = false;
+	SV_RescanHiddenMobj(player);
 
 	// Whatever mobj we had it doesn't matter anymore.
 	if (player.mo)
@@ -3518,13 +3957,7 @@ void SV_JoinPlayer(player_t& player, bool silent)
 	}
 
 	// Finally, persist info about our freshly-joining player to the world.
-	for (Players::iterator it = ::players.begin(); it != ::players.end(); ++it)
-	{
-		if (!it->ingame())
-			continue;
-
-		MSG_WriteSVC(&it->client.reliablebuf, SVC_PlayerMembers(player, SVC_MSG_ALL));
-	}
+	MSG_BroadcastSVC(CLBUF_RELIABLE, SVC_PlayerMembers(player, SVC_MSG_ALL));
 
 	// Everything is set, now warn everyone the player joined.
 	if (!silent)
@@ -3556,10 +3989,14 @@ void SV_SpecPlayer(player_t &player, bool silent)
 		G_DoReborn(player);
 
 	player.spectator = true;
+
+	// Other players should stop seeing this one right away.
+	SV_RescanHiddenMobj(player);
+
+	const EncodedSVC msg(SVC_PlayerMembers(player, SVC_PM_SPECTATOR));
 	for (Players::iterator it = ::players.begin(); it != ::players.end(); ++it)
 	{
-		MSG_WriteSVC(&it->client.reliablebuf,
-		             SVC_PlayerMembers(player, SVC_PM_SPECTATOR));
+		MSG_WriteSVC(&it->client.reliablebuf, msg);
 	}
 
 	// [AM] Set player unready if we're in warmup mode.
@@ -3675,10 +4112,10 @@ void SV_SetReady(player_t &player, bool setting, bool silent)
 
 	if (changed) {
 		// Broadcast the new ready state to all connected players.
+		const EncodedSVC msg(SVC_PlayerMembers(player, SVC_PM_READY));
 		for (Players::iterator it = players.begin();it != players.end();++it)
 		{
-			MSG_WriteSVC(&it->client.reliablebuf,
-			             SVC_PlayerMembers(player, SVC_PM_READY));
+			MSG_WriteSVC(&it->client.reliablebuf, msg);
 		}
 	}
 
@@ -4080,8 +4517,9 @@ static void TimeCheck()
 	// [SL] 2011-10-25 - Send the clients the remaining time (measured in seconds)
 	if (P_AtInterval(1 * TICRATE)) // every second
 	{
+		const EncodedSVC msg(SVC_LevelLocals(level, SVC_LL_TIME));
 		for (Players::iterator it = players.begin(); it != players.end(); ++it)
-			MSG_WriteSVC(&it->client.netbuf, SVC_LevelLocals(level, SVC_LL_TIME));
+			MSG_WriteSVC(&it->client.netbuf, msg);
 	}
 }
 
@@ -4093,9 +4531,10 @@ static void IntermissionTimeCheck()
 	// [ML] 2012-2-1 - Copy it for intermission fun
 	if (P_AtInterval(1 * TICRATE)) // every second
 	{
+		const EncodedSVC msg(SVC_IntTimeLeft(level.inttimeleft));
 		for (Players::iterator it = players.begin(); it != players.end(); ++it)
 		{
-			MSG_WriteSVC(&(it->client.netbuf), SVC_IntTimeLeft(level.inttimeleft));
+			MSG_WriteSVC(&(it->client.netbuf), msg);
 		}
 	}
 }
@@ -4212,6 +4651,7 @@ void SV_DisplayTics()
 //
 void SV_RunTics()
 {
+	SVC_ResetArena();
 	SV_GetPackets();
 
 	std::string cmd = I_ConsoleInput();
@@ -4467,11 +4907,12 @@ void OnChangedSwitchTexture (line_t *line, int useAgain)
 	unsigned state = 0, time = 0;
 	P_GetButtonInfo(line, state, time);
 
+	const EncodedSVC msg(SVC_Switch(*line, state, time));
 	for (Players::iterator it = players.begin();it != players.end();++it)
 	{
 		client_t *cl = &(it->client);
 
-		MSG_WriteSVC(&cl->reliablebuf, SVC_Switch(*line, state, time));
+		MSG_WriteSVC(&cl->reliablebuf, msg);
 	}
 }
 
@@ -4481,25 +4922,17 @@ void SV_OnActivatedLine(line_t* line, AActor* mo, const int side,
 	if (P_LineSpecialMovesSector(line->special))
 		return;
 
-	for (Players::iterator it = players.begin();it != players.end();++it)
-	{
-		if (!(it->ingame()))
-			continue;
-
-		client_t *cl = &(it->client);
-
-		MSG_WriteSVC(&cl->reliablebuf, SVC_ActivateLine(line, mo, side, activationType));
-	}
+	MSG_BroadcastSVC(CLBUF_RELIABLE, SVC_ActivateLine(line, mo, side, activationType));
 }
 
 void SV_SendDamagePlayer(player_t *player, AActor* inflictor, int healthDamage, int armorDamage)
 {
+	const EncodedSVC msg(SVC_DamagePlayer(*player, inflictor, healthDamage, armorDamage));
 	for (Players::iterator it = players.begin();it != players.end();++it)
 	{
 		client_t *cl = &(it->client);
 
-		MSG_WriteSVC(&cl->reliablebuf,
-		             SVC_DamagePlayer(*player, inflictor, healthDamage, armorDamage));
+		MSG_WriteSVC(&cl->reliablebuf, msg);
 	}
 }
 
@@ -4508,13 +4941,21 @@ void SV_SendDamageMobj(AActor *target, int pain)
 	if (!target)
 		return;
 
+	const EncodedSVC damagemsg(SVC_DamageMobj(target, pain));
+	if (target->player)
+	{
+		for (Players::iterator it = players.begin();it != players.end();++it)
+			MSG_WriteSVC(&it->client.reliablebuf, damagemsg);
+		return;
+	}
+
+	const EncodedSVC updatemsg(SVC_UpdateMobj(*target));
 	for (Players::iterator it = players.begin();it != players.end();++it)
 	{
 		client_t *cl = &(it->client);
 
-		MSG_WriteSVC(&cl->reliablebuf, SVC_DamageMobj(target, pain));
-		if (!target->player)
-			MSG_WriteSVC(&cl->netbuf, SVC_UpdateMobj(*target));
+		MSG_WriteSVC(&cl->reliablebuf, damagemsg);
+		MSG_WriteSVC(&cl->netbuf, updatemsg);
 	}
 }
 
@@ -4524,6 +4965,7 @@ void SV_SendKillMobj(AActor *source, AActor *target, AActor *inflictor,
 	if (!target)
 		return;
 
+	const EncodedSVC msg(SVC_KillMobj(source, target, inflictor, ::MeansOfDeath, joinkill));
 	for (Players::iterator it = players.begin();it != players.end();++it)
 	{
 		client_t *cl = &(it->client);
@@ -4531,8 +4973,7 @@ void SV_SendKillMobj(AActor *source, AActor *target, AActor *inflictor,
 		if (!SV_IsPlayerAllowedToSee(*it, target))
 			continue;
 
-		MSG_WriteSVC(&cl->reliablebuf,
-		             SVC_KillMobj(source, target, inflictor, ::MeansOfDeath, joinkill));
+		MSG_WriteSVC(&cl->reliablebuf, msg);
 	}
 }
 
@@ -4541,8 +4982,11 @@ void SV_SendDestroyActor(AActor *mo)
 {
 	if (mo->netid && mo->type != MT_PUFF)
 	{
+		const EncodedSVC msg(SVC_RemoveMobj(*mo));
 		for (Players::iterator it = players.begin();it != players.end();++it)
 		{
+			it->client.mobjdeltas.erase(mo->netid);
+
 			if (mo->players_aware.get(it->id))
 			{
 				client_t *cl = &(it->client);
@@ -4550,7 +4994,7 @@ void SV_SendDestroyActor(AActor *mo)
 				// denis - todo - need a queue for destroyed (lost awareness)
 				// objects, as a flood of destroyed things could easily overflow a
 				// buffer
-				MSG_WriteSVC(&cl->reliablebuf, SVC_RemoveMobj(*mo));
+				MSG_WriteSVC(&cl->reliablebuf, msg);
 			}
 		}
 	}
@@ -4559,6 +5003,8 @@ void SV_SendDestroyActor(AActor *mo)
 // Missile exploded so tell clients about it
 void SV_ExplodeMissile(AActor *mo)
 {
+	const EncodedSVC updatemsg(SVC_UpdateMobj(*mo));
+	const EncodedSVC explodemsg(SVC_ExplodeMissile(*mo));
 	for (Players::iterator it = players.begin();it != players.end();++it)
 	{
 		client_t *cl = &(it->client);
@@ -4566,8 +5012,8 @@ void SV_ExplodeMissile(AActor *mo)
 		if (!SV_IsPlayerAllowedToSee(*it, mo))
 			continue;
 
-		MSG_WriteSVC(&cl->reliablebuf, SVC_UpdateMobj(*mo));
-		MSG_WriteSVC(&cl->reliablebuf, SVC_ExplodeMissile(*mo));
+		MSG_WriteSVC(&cl->reliablebuf, updatemsg);
+		MSG_WriteSVC(&cl->reliablebuf, explodemsg);
 	}
 }
 
@@ -61,9 +61,12 @@ void SV_ConnectClient2(player_t& player);
 void SV_WriteCommands(void);
 void SV_ClearClientsBPS(void);
 bool SV_SendPacket(player_t &pl);
+void SV_ClearOldPackets(client_t& cl);
+void SV_SendPacketBatch(const std::vector<player_t*>& to);
 void SV_AcknowledgePacket(player_t &player);
 void SV_DisplayTics();
 void SV_RunTics();
+void SV_GetPackets();
 void SV_ParseCommands(player_t &player);
 void SV_UpdateFrags (player_t &player);
 void SV_RemoveCorpses (void);
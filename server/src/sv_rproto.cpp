@@ -28,6 +28,7 @@
 #include "sv_main.h"
 #include "huffman.h"
 #include "i_net.h"
+#include "sv_workers.h"
 
 #ifdef SIMULATE_LATENCY
 #include <thread>
@@ -37,17 +38,16 @@
 QWORD I_MSTime (void);
 
 EXTERN_CVAR (log_packetdebug)
+EXTERN_CVAR (sv_packetthreads)
 #ifdef SIMULATE_LATENCY
 EXTERN_CVAR (sv_latency)
 #endif
 
-buf_t plain(MAX_UDP_PACKET); // denis - todo - call_terms destroys these statics on quit
-buf_t sendd(MAX_UDP_PACKET);
-
 const static size_t PACKET_FLAG_INDEX = sizeof(uint32_t);
 const static size_t PACKET_MESSAGE_INDEX = PACKET_FLAG_INDEX + 1;
 const static size_t PACKET_HEADER_SIZE = PACKET_MESSAGE_INDEX;
 const static size_t PACKET_OLD_MASK = 0xFF;
+const static size_t OLD_PACKET_DATA_MIN = 16 * 1024;
 
 //
 // CompressPacket
@@ -58,25 +58,54 @@ const static size_t PACKET_OLD_MASK = 0xFF;
 //
 // [AM] Cleaned the old huffman calls for code clarity sake.
 //
-static void CompressPacket(buf_t& send, const size_t reserved, client_t* cl)
+// Compresses with the method the client asked for when it connected.  Resent
+// packets reuse old sequence numbers, so they never touch the adaptive
+// huffman codecs and fall back to minilzo.
+//
+static void CompressPacket(client_t& cl, buf_t& send, const size_t reserved,
+                           CompressScratch& scratch, const bool resend)
 {
-	if (plain.maxsize() < send.maxsize())
-	{
-		plain.resize(send.maxsize());
-	}
-
-	plain.setcursize(send.size());
-	memcpy(plain.ptr(), send.ptr(), send.size());
+	if (send.size() <= reserved)
+		return;
 
 	byte method = 0;
-	if (MSG_CompressMinilzo(send, reserved, 0))
+	switch (cl.compression)
 	{
-		// Successful compression, set the compression flag bit.
-		method |= SVF_COMPRESSED;
+	case PACKETCOMP_NONE:
+		break;
+	case PACKETCOMP_HUFFMAN:
+		if (!resend)
+		{
+			// BuildPacket just used up this sequence number.
+			const unsigned int sequence = cl.sequence - 1;
+			const byte codec = cl.compressor.get_codec_id() ? SVF_HUFFMAN_CODEC : 0;
+
+			// Grab the packet before compressing it, the client builds the
+			// next codec from the same bytes.
+			if (cl.compressor.packet_sent(sequence, send.ptr() + reserved,
+			                              send.size() - reserved))
+				method |= SVF_HUFFMAN_TRACK | codec;
+
+			if (MSG_CompressAdaptive(cl.compressor.get_codec(), send, reserved, 0,
+			                         scratch))
+				method |= SVF_HUFFMAN | codec;
+			break;
+		}
+		// fall through
+	case PACKETCOMP_MINILZO:
+		if (MSG_CompressMinilzo(send, reserved, 0, scratch))
+		{
+			// Successful compression, set the compression flag bit.
+			method |= SVF_COMPRESSED;
+		}
+		break;
+	case PACKETCOMP_DEFLATE:
+		if (MSG_CompressDeflate(send, reserved, 0, scratch))
+			method |= SVF_DEFLATE;
+		break;
 	}
 
 	send.ptr()[PACKET_FLAG_INDEX] |= method;
-	DPrintf("CompressPacket %x " PRIuSIZE "\n", method, send.size());
 }
 
 #ifdef SIMULATE_LATENCY
@@ -128,15 +157,98 @@ void SV_SendPacketDelayed(buf_t& packet, player_t& pl)
 }
 #endif
 
-//
-// SV_SendPacket
-//
-bool SV_SendPacket(player_t &pl)
+/**
+ * @brief Check if a range of a client's old packet data is still in use.
+ */
+static bool OldPacketDataInUse(const client_t& cl, const size_t offset, const size_t size)
+{
+	for (size_t i = 0; i < ARRAY_LENGTH(cl.oldpackets); i++)
+	{
+		const client_t::oldPacket_t& old = cl.oldpackets[i];
+		if (old.sequence == -1)
+			continue;
+
+		if (offset < old.offset + old.size && old.offset < offset + size)
+			return true;
+	}
+
+	return false;
+}
+
+/**
+ * @brief Save the reliable part of a packet so it can be resent if it is
+ *        missed.
+ *
+ * @param cl Client the packet is sent to.
+ * @param sequence Sequence number of the packet.
+ * @param reliable Reliable data of the packet, may be empty.
+ */
+static void SaveOldPacket(client_t& cl, const int sequence, const buf_t& reliable)
+{
+	client_t::oldPacket_t& old = cl.oldpackets[sequence & PACKET_OLD_MASK];
+
+	// The packet that used this slot can't be resent anymore.
+	old.sequence = -1;
+	old.size = 0;
+
+	if (reliable.cursize == 0)
+		return;
+
+	size_t offset = cl.oldpackethead;
+	if (offset + reliable.cursize > cl.oldpacketdata.size())
+		offset = 0;
+
+	if (offset + reliable.cursize > cl.oldpacketdata.size() ||
+	    OldPacketDataInUse(cl, offset, reliable.cursize))
+	{
+		// Every byte that might still be resent is in the way, so grow into
+		// fresh space past all of it.  Existing offsets stay valid.
+		offset = cl.oldpacketdata.size();
+		cl.oldpacketdata.resize(
+		    MAX(MAX(offset * 2, offset + reliable.cursize), OLD_PACKET_DATA_MIN));
+	}
+
+	memcpy(&cl.oldpacketdata[offset], reliable.data, reliable.cursize);
+	cl.oldpackethead = offset + reliable.cursize;
+
+	old.sequence = sequence;
+	old.offset = offset;
+	old.size = reliable.cursize;
+}
+
+/**
+ * @brief Forget every packet that could be resent to a client and release
+ *        the memory holding them.
+ */
+void SV_ClearOldPackets(client_t& cl)
+{
+	for (size_t i = 0; i < ARRAY_LENGTH(cl.oldpackets); i++)
+		cl.oldpackets[i] = client_t::oldPacket_t();
+
+	std::vector<byte>().swap(cl.oldpacketdata);
+	cl.oldpackethead = 0;
+}
+
+/**
+ * @brief Assemble the next packet for a client out of its reliable and
+ *        unreliable buffers.
+ *
+ * @param pl Player to build the packet for.
+ * @param sendd Buffer to build the packet in, left empty if there is nothing
+ *              to send.
+ * @return False if the client was dropped.
+ */
+static bool BuildPacket(player_t& pl, buf_t& sendd)
 {
 	int				bps = 0; // bytes per second, not bits per second
 
 	client_t *cl = &pl.client;
 
+	if (sendd.maxsize() < MAX_UDP_PACKET)
+		sendd.resize(MAX_UDP_PACKET);
+
+	sendd.clear();
+
 	if (cl->reliablebuf.overflowed)
 	{ 
 		SZ_Clear(&cl->netbuf);
@@ -146,34 +258,28 @@ bool SV_SendPacket(player_t &pl)
 	}
 	else
 		if (cl->netbuf.overflowed)
+		{
 			SZ_Clear(&cl->netbuf);
+			cl->pendingmobjs.clear();
+		}
 
 	// [SL] 2012-05-04 - Don't send empty packets - they still have overhead
 	if (cl->reliablebuf.cursize + cl->netbuf.cursize == 0)
 		return true;
 
-	sendd.clear();
-
 	// save the reliable message 
 	// it will be retransmited, if it's missed
-	client_t::oldPacket_t& old = cl->oldpackets[cl->sequence & PACKET_OLD_MASK];
-
-	old.data.clear();
-	if (cl->reliablebuf.cursize)
-	{
-		// copy the reliable data into the buffer.
-		old.sequence = cl->sequence;
-		SZ_Write(&old.data, cl->reliablebuf.data, cl->reliablebuf.cursize);
-	}
-	else
-	{
-		old.sequence = -1;
-	}
+	SaveOldPacket(*cl, cl->sequence, cl->reliablebuf);
 
 	cl->packetnum++; // packetnum will never be more than 255
 	                 // because sizeof(packetnum) == 1. Don't need
 	                 // to use &0xff. Cool, eh? ;-)
 
+	// tracked actor updates only count as sent if the unreliable part is
+	client_t::sentMobjs_t& sentmobjs = cl->sentmobjs[cl->sequence & PACKET_OLD_MASK];
+	sentmobjs.sequence = cl->sequence;
+	sentmobjs.mobjs.clear();
+
 	// copy sequence
 	MSG_WriteLong(&sendd, cl->sequence++);
 	MSG_WriteByte(&sendd, 0); // Flags, filled out later.
@@ -196,16 +302,22 @@ bool SV_SendPacket(player_t &pl)
 	  {
          SZ_Write (&sendd, cl->netbuf.data, cl->netbuf.cursize);
 	     cl->unreliable_bps += cl->netbuf.cursize;
+	     sentmobjs.mobjs.swap(cl->pendingmobjs);
 	  }
     
 	SZ_Clear(&cl->netbuf);
+	cl->pendingmobjs.clear();
 	SZ_Clear(&cl->reliablebuf);
-	
-	// compress the packet, but not the sequence id
-	if (sendd.size() > PACKET_HEADER_SIZE)
-	{
-		CompressPacket(sendd, PACKET_HEADER_SIZE, cl);
-	}
+
+	return true;
+}
+
+/**
+ * @brief Put a built, and possibly compressed, packet on the wire.
+ */
+static void FinishPacket(player_t& pl, buf_t& sendd)
+{
+	client_t *cl = &pl.client;
 
 	if (log_packetdebug)
 	{
@@ -216,12 +328,119 @@ bool SV_SendPacket(player_t &pl)
 #ifdef SIMULATE_LATENCY
 	SV_SendPacketDelayed(sendd, pl);
 #else
-
 	NET_SendPacket(sendd, cl->address);
 #endif
+}
+
+//
+// SV_SendPacket
+//
+bool SV_SendPacket(player_t &pl)
+{
+	static buf_t sendd(MAX_UDP_PACKET);
+	static CompressScratch scratch;
+
+	if (!BuildPacket(pl, sendd))
+		return false;
+
+	if (sendd.cursize == 0)
+		return true;
+
+	// compress the packet, but not the sequence id
+	CompressPacket(pl.client, sendd, PACKET_HEADER_SIZE, scratch, false);
+
+	FinishPacket(pl, sendd);
 	return true;
 }
 
+/**
+ * @brief A packet built for a client, waiting to be compressed on a worker.
+ */
+struct PacketJob
+{
+	player_t* pl;
+	buf_t data;
+};
+
+static std::vector<CompressScratch> packetscratch;
+
+static void CompressPacketJob(void* data, size_t index, size_t worker)
+{
+	PacketJob& job = static_cast<PacketJob*>(data)[index];
+	CompressPacket(job.pl->client, job.data, PACKET_HEADER_SIZE, packetscratch[worker],
+	               false);
+}
+
+//
+// SV_SendPacketBatch
+//
+// Sends a packet to every given player.  The packets are built in order,
+// compressed on the worker pool, then sent in the same order.
+//
+void SV_SendPacketBatch(const std::vector<player_t*>& to)
+{
+	static WorkerPool workers;
+	static std::vector<PacketJob> jobs;
+
+	workers.resize(sv_packetthreads.asInt());
+	if (packetscratch.size() < workers.size() + 1)
+		packetscratch.resize(workers.size() + 1);
+
+	if (jobs.size() < to.size())
+		jobs.resize(to.size());
+
+	size_t count = 0;
+	for (size_t i = 0; i < to.size(); i++)
+	{
+		PacketJob& job = jobs[count];
+		job.pl = to[i];
+
+		if (BuildPacket(*job.pl, job.data) && job.data.cursize > 0)
+			count++;
+	}
+
+	if (count == 0)
+		return;
+
+	workers.run(CompressPacketJob, &jobs[0], count);
+
+	for (size_t i = 0; i < count; i++)
+		FinishPacket(*jobs[i].pl, jobs[i].data);
+}
+
+/**
+ * @brief Let the tracked actor updates of an acknowledged packet become the
+ *        base of later updates.
+ *
+ * @param cl Client that acknowledged the packet.
+ * @param sequence Sequence number of the packet.
+ */
+static void AcknowledgeMobjs(client_t& cl, const int sequence)
+{
+	client_t::sentMobjs_t& sent = cl.sentmobjs[sequence & PACKET_OLD_MASK];
+	if (sent.sequence != sequence)
+		return;
+
+	for (size_t i = 0; i < sent.mobjs.size(); i++)
+	{
+		const client_t::mobjSent_t& mobj = sent.mobjs[i];
+
+		client_t::MobjDeltas::iterator it = cl.mobjdeltas.find(mobj.netid);
+		if (it == cl.mobjdeltas.end())
+			continue;
+
+		client_t::mobjDelta_t& delta = it->second;
+		if (mobj.count > delta.acked && mobj.count > delta.floor)
+		{
+			delta.acked = mobj.count;
+			delta.ackedstate = mobj.state;
+		}
+	}
+
+	sent.sequence = -1;
+	sent.mobjs.clear();
+}
+
 /**
  * @brief Send an old reliable packet with old data on the wire.
  * 
@@ -244,17 +463,15 @@ static void SendOldPacket(player_t& pl, const int sequence)
 	MSG_WriteByte(&send, 0); // Flags, filled out later.
 
 	// copy the reliable message to the packet
-	if (old.data.cursize)
+	if (old.size)
 	{
-		SZ_Write(&send, old.data.data, old.data.cursize);
-		cl.reliable_bps += old.data.cursize;
+		SZ_Write(&send, &cl.oldpacketdata[old.offset], old.size);
+		cl.reliable_bps += old.size;
 	}
 
 	// compress the packet, but not the sequence id
-	if (send.size() > PACKET_HEADER_SIZE)
-	{
-		CompressPacket(send, PACKET_HEADER_SIZE, &cl);
-	}
+	static CompressScratch scratch;
+	CompressPacket(cl, send, PACKET_HEADER_SIZE, scratch, true);
 
 	NET_SendPacket(send, cl.address);
 }
@@ -269,6 +486,7 @@ void SV_AcknowledgePacket(player_t &player)
 	int sequence = MSG_ReadLong();
 
 	cl->compressor.packet_acked(sequence);
+	AcknowledgeMobjs(*cl, sequence);
 
 	// packet is missed
 	if (sequence - cl->last_sequence > 1)
@@ -0,0 +1,286 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// $Id$
+//
+// Copyright (C) 2006-2020 by The Odamex Team.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//	A small pool of threads for running independent server jobs.
+//
+//-----------------------------------------------------------------------------
+
+
+#include "odamex.h"
+
+#include "sv_workers.h"
+
+#include <vector>
+
+#include "win32inc.h"
+#ifndef _WIN32
+#include <pthread.h>
+#endif
+
+namespace
+{
+
+//
+// Mutex
+//
+class Mutex
+{
+#ifdef _WIN32
+	CRITICAL_SECTION m_cs;
+
+  public:
+	Mutex() { InitializeCriticalSection(&m_cs); }
+	~Mutex() { DeleteCriticalSection(&m_cs); }
+	void lock() { EnterCriticalSection(&m_cs); }
+	void unlock() { LeaveCriticalSection(&m_cs); }
+#else
+	pthread_mutex_t m_mutex;
+
+  public:
+	Mutex() { pthread_mutex_init(&m_mutex, NULL); }
+	~Mutex() { pthread_mutex_destroy(&m_mutex); }
+	void lock() { pthread_mutex_lock(&m_mutex); }
+	void unlock() { pthread_mutex_unlock(&m_mutex); }
+#endif
+};
+
+//
+// Semaphore
+//
+class Semaphore
+{
+#ifdef _WIN32
+	HANDLE m_sem;
+
+  public:
+	Semaphore() { m_sem = CreateSemaphore(NULL, 0, LONG_MAX, NULL); }
+	~Semaphore() { CloseHandle(m_sem); }
+	void post() { ReleaseSemaphore(m_sem, 1, NULL); }
+	void wait() { WaitForSingleObject(m_sem, INFINITE); }
+#else
+	// Unnamed POSIX semaphores are missing on OSX, so build one.
+	pthread_mutex_t m_mutex;
+	pthread_cond_t m_cond;
+	unsigned int m_count;
+
+  public:
+	Semaphore() : m_count(0)
+	{
+		pthread_mutex_init(&m_mutex, NULL);
+		pthread_cond_init(&m_cond, NULL);
+	}
+
+	~Semaphore()
+	{
+		pthread_cond_destroy(&m_cond);
+		pthread_mutex_destroy(&m_mutex);
+	}
+
+	void post()
+	{
+		pthread_mutex_lock(&m_mutex);
+		m_count++;
+		pthread_cond_signal(&m_cond);
+		pthread_mutex_unlock(&m_mutex);
+	}
+
+	void wait()
+	{
+		pthread_mutex_lock(&m_mutex);
+		while (m_count == 0)
+			pthread_cond_wait(&m_cond, &m_mutex);
+		m_count--;
+		pthread_mutex_unlock(&m_mutex);
+	}
+#endif
+};
+
+} // namespace
+
+struct WorkerPool::Impl
+{
+	struct Thread
+	{
+		WorkerPool* pool;
+		size_t index;
+#ifdef _WIN32
+		HANDLE handle;
+#else
+		pthread_t handle;
+#endif
+	};
+
+	std::vector<Thread*> threads;
+	Semaphore start;
+	Semaphore done;
+	Mutex lock;
+	bool quit;
+
+	// The batch being run.
+	JobFunc func;
+	void* data;
+	size_t count;
+	size_t next;
+
+	Impl() : quit(false), func(NULL), data(NULL), count(0), next(0)
+	{
+	}
+
+	static void threadMain(Thread* thread)
+	{
+		Impl* impl = thread->pool->m_impl;
+
+		for (;;)
+		{
+			impl->start.wait();
+			if (impl->quit)
+				break;
+
+			thread->pool->work(thread->index);
+			impl->done.post();
+		}
+	}
+
+#ifdef _WIN32
+	static DWORD WINAPI startThread(LPVOID arg)
+	{
+		threadMain(static_cast<Thread*>(arg));
+		return 0;
+	}
+#else
+	static void* startThread(void* arg)
+	{
+		threadMain(static_cast<Thread*>(arg));
+		return NULL;
+	}
+#endif
+};
+
+WorkerPool::WorkerPool() : m_impl(new Impl)
+{
+}
+
+WorkerPool::~WorkerPool()
+{
+	resize(0);
+	delete m_impl;
+}
+
+size_t WorkerPool::size() const
+{
+	return m_impl->threads.size();
+}
+
+/**
+ * @brief Stop all worker threads and start the given number of new ones.
+ */
+void WorkerPool::resize(size_t threads)
+{
+	if (threads == m_impl->threads.size())
+		return;
+
+	m_impl->quit = true;
+	for (size_t i = 0; i < m_impl->threads.size(); i++)
+		m_impl->start.post();
+
+	for (size_t i = 0; i < m_impl->threads.size(); i++)
+	{
+		Impl::Thread* thread = m_impl->threads[i];
+#ifdef _WIN32
+		WaitForSingleObject(thread->handle, INFINITE);
+		CloseHandle(thread->handle);
+#else
+		pthread_join(thread->handle, NULL);
+#endif
+		delete thread;
+	}
+
+	m_impl->threads.clear();
+	m_impl->quit = false;
+
+	for (size_t i = 0; i < threads; i++)
+	{
+		Impl::Thread* thread = new Impl::Thread;
+		thread->pool = this;
+		thread->index = i + 1;
+
+#ifdef _WIN32
+		thread->handle = CreateThread(NULL, 0, Impl::startThread, thread, 0, NULL);
+		bool ok = thread->handle != NULL;
+#else
+		bool ok = pthread_create(&thread->handle, NULL, Impl::startThread, thread) == 0;
+#endif
+		if (!ok)
+		{
+			Printf(PRINT_HIGH, "WorkerPool: could not start a worker thread.\n");
+			delete thread;
+			break;
+		}
+
+		m_impl->threads.push_back(thread);
+	}
+}
+
+/**
+ * @brief Run func for every index from 0 to count - 1 and wait until all
+ *        of them are done.
+ */
+void WorkerPool::run(JobFunc func, void* data, size_t count)
+{
+	if (m_impl->threads.empty() || count <= 1)
+	{
+		for (size_t i = 0; i < count; i++)
+			func(data, i, 0);
+		return;
+	}
+
+	m_impl->lock.lock();
+	m_impl->func = func;
+	m_impl->data = data;
+	m_impl->count = count;
+	m_impl->next = 0;
+	m_impl->lock.unlock();
+
+	for (size_t i = 0; i < m_impl->threads.size(); i++)
+		m_impl->start.post();
+
+	work(0);
+
+	for (size_t i = 0; i < m_impl->threads.size(); i++)
+		m_impl->done.wait();
+}
+
+/**
+ * @brief Take jobs from the current batch until there are none left.
+ */
+void WorkerPool::work(size_t worker)
+{
+	for (;;)
+	{
+		m_impl->lock.lock();
+		size_t index = m_impl->next++;
+		m_impl->lock.unlock();
+
+		if (index >= m_impl->count)
+			break;
+
+		m_impl->func(m_impl->data, index, worker);
+	}
+}
+
+VERSION_CONTROL (sv_workers_cpp, "$Id$")
@@ -0,0 +1,60 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// $Id$
+//
+// Copyright (C) 2006-2020 by The Odamex Team.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//	A small pool of threads for running independent server jobs.
+//
+//-----------------------------------------------------------------------------
+
+#pragma once
+
+/**
+ * @brief A pool of worker threads that runs batches of independent jobs.
+ *
+ * The calling thread helps with the jobs and only returns once all of them
+ * are done, so jobs may use anything the caller set up beforehand.  With no
+ * worker threads the jobs simply run on the calling thread.
+ */
+class WorkerPool
+{
+  public:
+	/**
+	 * @brief A job in a batch.
+	 *
+	 * @param data Data passed to run().
+	 * @param index Index of the job in the batch.
+	 * @param worker Thread running the job, 0 for the calling thread and
+	 *               1 to size() for the workers.
+	 */
+	typedef void (*JobFunc)(void* data, size_t index, size_t worker);
+
+	WorkerPool();
+	~WorkerPool();
+
+	size_t size() const;
+	void resize(size_t threads);
+	void run(JobFunc func, void* data, size_t count);
+
+  private:
+	struct Impl;
+	Impl* m_impl;
+
+	WorkerPool(const WorkerPool&);
+	WorkerPool& operator=(const WorkerPool&);
+
+	void work(size_t worker);
+};
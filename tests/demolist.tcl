@@ -6,6 +6,9 @@ exec tclsh "$0" "$@"
 # runs ./odamex -nosound -novideo +demotest DEMONAME[.LMP] -file WADFILE.WAD
 # against list of demos in the DEMOLIST file
 #
+# any arguments are passed on to odamex before +demotest, e.g.
+# "+sv_sightmatrix 2" checks the computed sight matrix against every demo
+#
 # assumes file input format:
 # DOOM2.WAD {PWAD.WAD DEH.DEH ...} DEMOLUMP.LMP {15eb4720 3ccc7a1 3fc7e27 800000}
 #
@@ -50,6 +53,10 @@ while { ![eof $file] } {
 		}
 	}
 	
+	if { [llength $argv] > 0 } {
+		append args " [join $argv]"
+	}
+
 	if [file exists tests/$lump] {
 		append args " +demotest tests/$lump"
 	} else {
@@ -58,6 +65,7 @@ while { ![eof $file] } {
 	append args " +logfile odamex.log"
 
 	set demotest "CRASHED"
+	set sightmatrix ""
 	catch {
 		if [file exists odamex.exe] {
 			eval exec odamex.exe [split $args] > tmp
@@ -72,6 +80,9 @@ while { ![eof $file] } {
 			if { [string range $line 0 8] == "demotest:" } {
 				set demotest [string range $line 9 end]
 			}
+			if { [string first "sightmatrix:" $line] != -1 } {
+				set sightmatrix $line
+			}
 		}
 		close $log
 	}
@@ -81,6 +92,8 @@ while { ![eof $file] } {
 
 	if { $result != $expected} {
 		puts "FAIL $demo | $result"
+	} elseif { $sightmatrix != "" } {
+		puts "FAIL $demo | $sightmatrix"
 	} else {
 		puts "PASS $demo | $result"
 	}